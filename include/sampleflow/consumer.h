@@ -19,12 +19,21 @@
 #include <sampleflow/auxiliary_data.h>
 #include <sampleflow/producer.h>
 #include <sampleflow/parallel_mode.h>
+#include <sampleflow/gate_schedule.h>
+#include <sampleflow/span.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/spsc_queue.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <boost/signals2.hpp>
 
+#include <algorithm>
 #include <list>
+#include <memory>
 #include <utility>
 #include <future>
 #include <atomic>
+#include <thread>
+#include <condition_variable>
 
 
 namespace SampleFlow
@@ -69,6 +78,32 @@ namespace SampleFlow
    * appropriately.
    *
    *
+   * ### Querying results ###
+   *
+   * Consumers that compute something from the samples they receive make
+   * the result available through up to three member functions, all of
+   * which can be called from any thread at any time, including while
+   * samples are being processed:
+   * - `get()` returns the current result as a newly created object of
+   *   the class's `value_type`.
+   * - `get_into(result)` writes the same information into an existing
+   *   object. If `result` already has the correct size -- for example,
+   *   because it was filled by a previous call -- then no memory is
+   *   allocated. This is the function of choice for polling a consumer
+   *   frequently, say to update a progress display.
+   * - `visit(visitor)` calls `visitor` with a `const` reference to an
+   *   object of type `value_type` that holds the same information, while
+   *   holding the lock that protects the state of the consumer. If a class
+   *   stores its result in exactly this form, the reference is to that
+   *   internal object and nothing is copied. Otherwise, the class
+   *   assembles the result in a scratch object that it keeps between
+   *   calls, so that memory is only allocated the first time; the
+   *   documentation of each class says which of the two is the case.
+   *   Because consume() has to wait while the visitor runs, the visitor
+   *   should return quickly. It must not call any other member functions
+   *   of the consumer.
+   *
+   *
    * @tparam InputType The C++ type used to describe samples. For example,
    *   if one samples from a continuous, one-dimensional distribution, then
    *   an appropriate type may be `double`. If one samples from the two
@@ -165,17 +200,163 @@ namespace SampleFlow
        *   finished yet. If, for example, `queue_size` is one and a previous
        *   sample has not completed processing, then a newly incoming sample
        *   will be held up (and the current process will block) until the
-       *   previous sample has completed processing.
+       *   previous sample has completed processing. In
+       *   ParallelMode::ingestion mode, this is the number of samples each
+       *   upstream connection can have in its lane before it blocks.
        *
        * @note This function needs to be be called *before* this consumer or
        *   filter is connected to any upstream producer (or other filter), and
        *   in particular before any samples are actually sent to the current
        *   object.
+       *
+       * @note Consumers of non-owning sample types such as types::Span
+       *   can not process samples asynchronously (or in
+       *   ParallelMode::ingestion mode), because the data the sample refers
+       *   to may no longer exist by the time it is processed.
        */
       void
       set_parallel_mode (const ParallelMode parallel_mode,
                          const unsigned int queue_size = 1);
 
+      /**
+       * Set the priority with which this consumer or filter processes
+       * samples in asynchronous mode. By default, asynchronous consumers
+       * start a separate task via `std::async` for each sample, and all
+       * of these tasks compete equally for the available processor cores.
+       * Once a priority has been set via this function, tasks are instead
+       * submitted to the shared thread pool returned by
+       * Utilities::shared_thread_pool(), which starts pending tasks in
+       * order of their priority. See the Priority `enum` for more
+       * information.
+       *
+       * On the shared thread pool, at most `queue_size` tasks of this
+       * object (see set_parallel_mode()) are pending or running at any
+       * given time. If this limit has been reached when a new sample
+       * arrives, the sample is processed right away on the thread that
+       * sent it, rather than by a new task. A consumer with a low priority
+       * thereby slows down its producer when the pool is busy with more
+       * urgent work, instead of accumulating copies of samples without
+       * bound. (Blocking the producer until one of the pending tasks has
+       * finished would instead deadlock if the producer itself runs on the
+       * shared thread pool.)
+       *
+       * The priority has no effect in synchronous mode.
+       *
+       * @note Like set_parallel_mode(), this function needs to be called
+       *   *before* this consumer or filter is connected to any upstream
+       *   producer.
+       */
+      void
+      set_priority (const Priority priority);
+
+      /**
+       * Declare that this consumer or filter will only ever be connected to
+       * a single upstream producer, and that this producer sends samples
+       * from one thread at a time. This is the most common situation:
+       * A sampler running on one thread, with a number of consumers
+       * attached to it.
+       *
+       * If the object processes samples synchronously (the default), then
+       * this allows it to use a substantially cheaper path for each sample:
+       * The machinery with which the synchronous mode keeps track of
+       * samples that may be processed concurrently is skipped, and
+       * consume() is called directly. Furthermore, derived classes that
+       * protect their state with a Utilities::SingleWriterMutex (and have
+       * registered it via register_single_writer_mutex()) no longer need
+       * to acquire a mutex in consume(); functions such as `get()` can
+       * still be called from other threads at any time.
+       *
+       * The same optimizations for the mutexes of derived classes are
+       * applied automatically in ParallelMode::ingestion mode, in which
+       * consume() is only ever called from one thread.
+       *
+       * @note Like set_parallel_mode(), this function needs to be called
+       *   *before* this consumer or filter is connected to any upstream
+       *   producer. It is an error to connect the object to more than one
+       *   producer after calling this function, or to connect it to a
+       *   Filter that processes samples asynchronously.
+       */
+      void
+      declare_single_producer ();
+
+      /**
+       * Return whether declare_single_producer() has been called for this
+       * object. Code that calls consume() directly, rather than through a
+       * connection to a producer, can use this to check that it does not
+       * do so concurrently with the single producer this object expects.
+       */
+      bool
+      has_declared_single_producer () const;
+
+      /**
+       * Set a schedule that determines which of the incoming samples this
+       * consumer or filter should actually process; all other samples are
+       * ignored as if they had never been sent. See the GateSchedule class
+       * for more information.
+       *
+       * Checking whether a sample is to be processed happens before any
+       * other work is done on it (in particular, before it is copied into
+       * a task in asynchronous mode), and so ignored samples cost next to
+       * nothing.
+       *
+       * @note Like set_parallel_mode(), this function needs to be called
+       *   *before* this consumer or filter is connected to any upstream
+       *   producer.
+       */
+      void
+      set_gate_schedule (const GateSchedule &gate_schedule);
+
+      /**
+       * Enable processing of samples. Consumers are enabled by default.
+       * Unlike set_gate_schedule(), this function (and disable()) can
+       * be called at any time and from any thread, including while
+       * samples are being produced. If a gate schedule has been set, then
+       * samples are subject to it in addition to being enabled.
+       */
+      void
+      enable ();
+
+      /**
+       * Disable processing of samples: Until enable() is called, all
+       * samples sent to this object are ignored. This is done by blocking
+       * the connections to all upstream producers, so that a producer
+       * skips a disabled consumer without copying the sample and its
+       * auxiliary data for it and without calling any of the functions of
+       * this class. What remains is the cost the producer pays to check
+       * whether each of its connections is blocked. Samples that are
+       * already being processed when this function is called are not
+       * affected.
+       */
+      void
+      disable ();
+
+      /**
+       * Return whether this object is currently enabled.
+       */
+      bool
+      is_enabled () const;
+
+      /**
+       * Return the parallel modes this object supports, i.e., the value the
+       * constructor of the derived class has passed to the constructor of
+       * this class. This is a bitwise combination of the values of the
+       * ParallelMode enum; to test whether a particular mode is supported,
+       * use code such as
+       * @code
+       *   (static_cast<int>(consumer.get_supported_parallel_modes())
+       *    & static_cast<int>(ParallelMode::asynchronous)) != 0
+       * @endcode
+       */
+      ParallelMode
+      get_supported_parallel_modes () const;
+
+      /**
+       * Return the parallel mode set via set_parallel_mode(), or
+       * ParallelMode::synchronous if that function has not been called.
+       */
+      ParallelMode
+      get_parallel_mode () const;
+
       /**
        * Ensure that all samples currently being worked on by this object
        * are finished up. In a parallel context, there may still be new samples
@@ -206,6 +387,17 @@ namespace SampleFlow
       void
       disconnect_and_flush ();
 
+    protected:
+      /**
+       * Register a mutex with which a derived class protects its state, so
+       * that it can be switched into single-writer mode if consume() is
+       * known to be called from only one thread at a time; see
+       * declare_single_producer(). Derived classes typically call this
+       * function in their constructors.
+       */
+      void
+      register_single_writer_mutex (Utilities::SingleWriterMutex &mutex);
+
     private:
 
       /**
@@ -218,6 +410,16 @@ namespace SampleFlow
        */
       std::list<std::pair<boost::signals2::connection,boost::signals2::connection>> connections_to_producers;
 
+      /**
+       * For each of the sample connections in the list above, an object
+       * that blocks the connection while this object is disabled, along
+       * with a mutex that guards this list and the `enabled` flag below
+       * against concurrent calls to enable(), disable(), and
+       * connect_to_producer().
+       */
+      std::list<boost::signals2::shared_connection_block> connection_blocks;
+      std::mutex enabled_mutex;
+
       /**
        * How newly incoming samples should be processed.
        *
@@ -242,6 +444,44 @@ namespace SampleFlow
        */
       std::atomic<unsigned int> queue_size;
 
+      /**
+       * Whether asynchronous tasks are to be run on the shared thread pool,
+       * and with which priority. See set_priority().
+       */
+      bool use_shared_thread_pool;
+      Priority priority;
+
+      /**
+       * Whether declare_single_producer() has been called, and the mutexes
+       * registered via register_single_writer_mutex().
+       */
+      bool has_single_producer;
+      std::list<Utilities::SingleWriterMutex *> single_writer_mutexes;
+
+      /**
+       * If declare_single_producer() has been called, flags that indicate
+       * whether the producer is currently sending a sample, and whether
+       * disconnect_and_flush() has closed the connection. These play the
+       * same role as the corresponding flags of IngestionLane.
+       */
+      std::atomic<bool> single_producer_is_busy;
+      std::atomic<bool> single_producer_is_closed;
+
+      /**
+       * Whether this object currently processes samples. See enable()
+       * and disable().
+       */
+      std::atomic<bool> enabled;
+
+      /**
+       * The gate schedule set by set_gate_schedule(), whether it lets all
+       * samples pass (in which case we do not need to count samples), and
+       * the number of samples that have been checked against it so far.
+       */
+      GateSchedule gate_schedule;
+      bool is_gated;
+      std::atomic<types::sample_index> n_gated_samples;
+
       /**
        * A mutex that controls access to all of the data structures involved
        * in parallel processing of samples. In particular, this includes
@@ -256,6 +496,41 @@ namespace SampleFlow
        */
       std::list<std::shared_future<void>> background_tasks;
 
+      /**
+       * A structure that describes the lane through which one upstream
+       * connection sends samples in ParallelMode::ingestion mode. In
+       * addition to the queue itself, it stores two flags with which
+       * disconnect_and_flush() can make sure that the upstream producer
+       * is not currently writing into the queue, and will not do so
+       * in the future.
+       */
+      struct IngestionLane
+      {
+        IngestionLane (const std::size_t capacity);
+
+        Utilities::SPSCQueue<std::pair<InputType,AuxiliaryData>> queue;
+        std::atomic<bool> is_closed;
+        std::atomic<bool> is_pushing;
+      };
+
+      /**
+       * The lanes of all connections made in ParallelMode::ingestion mode,
+       * along with a mutex that guards the list and that the draining
+       * thread holds while it is working on samples.
+       */
+      std::list<std::unique_ptr<IngestionLane>> ingestion_lanes;
+      std::mutex ingestion_mutex;
+
+      /**
+       * The thread that drains the ingestion lanes, along with the
+       * variables that are used to put it to sleep when there is nothing
+       * to do, to wake it up again, and to tell it to stop.
+       */
+      std::thread             drain_thread;
+      std::condition_variable drain_condition;
+      std::atomic<bool>       drain_thread_is_waiting;
+      std::atomic<bool>       stop_drain_thread;
+
 
       /**
        * Ensure that the queue of background tasks does not grow beyond
@@ -263,6 +538,38 @@ namespace SampleFlow
        * objects that have already completed.
        */
       void trim_background_queue();
+
+      /**
+       * The same as trim_background_queue(), but for use by callers that
+       * already hold the `parallel_mode_mutex` lock.
+       */
+      void remove_finished_background_tasks();
+
+      /**
+       * Return whether an incoming sample should be processed, based on
+       * whether this object is enabled and on the gate schedule.
+       */
+      bool admit_sample();
+
+      /**
+       * Return whether all ingestion lanes are empty. This function must
+       * be called while holding the `ingestion_mutex` lock.
+       */
+      bool ingestion_lanes_are_empty() const;
+
+      /**
+       * Put all registered mutexes into single-writer mode if we know that
+       * consume() is only called from one thread at a time, and into the
+       * regular mode otherwise.
+       */
+      void update_single_writer_mutexes();
+
+      /**
+       * The function that runs on the draining thread in
+       * ParallelMode::ingestion mode: Repeatedly go over all lanes and
+       * process a batch of samples from each, until told to stop.
+       */
+      void drain_ingestion_lanes();
   };
 
 
@@ -272,7 +579,17 @@ namespace SampleFlow
     :
     parallel_mode (static_cast<int>(ParallelMode::synchronous)),
     supported_parallel_modes (supported_parallel_modes),
-    queue_size (1)
+    queue_size (1),
+    use_shared_thread_pool (false),
+    priority (Priority::normal),
+    has_single_producer (false),
+    single_producer_is_busy (false),
+    single_producer_is_closed (false),
+    enabled (true),
+    is_gated (false),
+    n_gated_samples (0),
+    drain_thread_is_waiting (false),
+    stop_drain_thread (false)
   {}
 
 
@@ -283,10 +600,21 @@ namespace SampleFlow
     // The destructor of derived classes needs to call
     // disconnect_and_flush().
     assert (connections_to_producers.size() == 0);
+    assert (drain_thread.joinable() == false);
   }
 
 
 
+  template <typename InputType>
+  Consumer<InputType>::IngestionLane::IngestionLane (const std::size_t capacity)
+    :
+    queue (capacity),
+    is_closed (false),
+    is_pushing (false)
+  {}
+
+
+
   template <typename InputType>
   void
   Consumer<InputType>::
@@ -339,9 +667,40 @@ namespace SampleFlow
         // samples.
         case ParallelMode::synchronous:
         {
+          // If we have been promised that there is only one producer that
+          // sends one sample at a time, then none of this is necessary and
+          // we can call `consume()` directly. We only need to make sure
+          // that disconnect_and_flush() can wait for a sample that is
+          // currently being processed, and that no sample is processed
+          // once it has returned. This is done in the same way as for the
+          // ingestion lanes below.
+          if (has_single_producer)
+            {
+              assert (connections_to_producers.size() == 0);
+              single_producer_is_closed = false;
+
+              sample_consumer =
+                [this](InputType sample, AuxiliaryData aux_data)
+              {
+                if (this->admit_sample() == false)
+                  return;
+
+                single_producer_is_busy = true;
+                if (single_producer_is_closed == false)
+                  this->consume (std::move(sample), std::move(aux_data));
+                single_producer_is_busy.store (false, std::memory_order_release);
+              };
+
+              break;
+            }
+
           sample_consumer =
             [&](InputType sample, AuxiliaryData aux_data)
           {
+            // First check whether we are to process this sample at all:
+            if (this->admit_sample() == false)
+              return;
+
             // Create a task that calls `consume()`. We're eventually going to
             // run this task synchronously, so we can take all arguments of the
             // underlying lambda as references. The point of wrapping it all
@@ -394,6 +753,11 @@ namespace SampleFlow
           sample_consumer =
             [&](InputType sample, AuxiliaryData aux_data)
           {
+            // First check whether we are to process this sample at all. This
+            // happens before we copy the sample into a task below.
+            if (this->admit_sample() == false)
+              return;
+
             // Create a task that calls `consume()`. First, because we're going
             // to run this task at some later time, we need to copy the sample
             // and aux data at this point. (If we were using C++14, we could
@@ -405,6 +769,13 @@ namespace SampleFlow
               this->consume (std::move(sample), std::move(aux_data));
             };
 
+            // If we run on the shared thread pool and already have as many
+            // tasks pending or running as we are allowed to, we will
+            // instead execute the task on the current thread. See the
+            // documentation of set_priority(). Like in the synchronous
+            // case, we still need a future that flush() can wait for.
+            std::packaged_task<void ()> inline_worker;
+
             // We then also need to put a future object into the queue that we
             // can query for unfinished objects. Since the queue is a shared
             // state, we need to access it under a lock. Once we are under the
@@ -419,12 +790,27 @@ namespace SampleFlow
               if (connections_to_producers.size() == 0)
                 return;
 
-              // Then start the task in the background and let the OS decide when
-              // it wants to execute it. The result is a std::future object that
-              // we can query for completion of the task, and we will hold on
-              // to this future object because we need to wait for tasks to finish
-              // in flush().
-              std::future<void> future = std::async(std::launch::async, worker);
+              // Then start the task in the background and let the OS (or,
+              // if a priority has been set, the shared thread pool) decide
+              // when it wants to execute it. The result is a std::future
+              // object that we can query for completion of the task, and we
+              // will hold on to this future object because we need to wait
+              // for tasks to finish in flush().
+              if (use_shared_thread_pool
+                  &&
+                  (background_tasks.size() >= queue_size))
+                {
+                  remove_finished_background_tasks();
+                  if (background_tasks.size() >= queue_size)
+                    inline_worker = std::packaged_task<void ()> (worker);
+                }
+
+              std::future<void> future
+                = (inline_worker.valid() ?
+                   inline_worker.get_future() :
+                   use_shared_thread_pool ?
+                   Utilities::shared_thread_pool().submit (worker, static_cast<int>(priority)) :
+                   std::async(std::launch::async, worker));
 
               // Next emplace the shared future object into the queue, in order
               // to allow other threads to wait for the termination of
@@ -432,6 +818,11 @@ namespace SampleFlow
               background_tasks.emplace_back (future.share());
             }
 
+            // If we decided to process the sample on the current thread, do
+            // so outside the lock:
+            if (inline_worker.valid())
+              inline_worker();
+
 
             // Finally, ensure that the queue does not grow beyond bound by
             // removing shared_futures that have already been satisfied
@@ -442,6 +833,76 @@ namespace SampleFlow
         }
 
 
+        // In ingestion mode, every connection gets its own lane into which
+        // the lambda function below writes samples. None of the other
+        // data structures of this class are touched on this path, and in
+        // particular we do not take any locks, unless the lane is full or
+        // the draining thread is asleep and needs to be woken up.
+        //
+        // As in the other cases, we need to make sure that no sample is
+        // processed after disconnect_and_flush() has returned. Here, this
+        // is done via the two flags of each lane: The lambda function
+        // first announces that it is about to push a sample, and then
+        // checks whether the lane has been closed.
+        // disconnect_and_flush() does the same in the opposite order: it
+        // first closes the lane and then waits for any push that might
+        // already be in progress. Because both use sequentially consistent
+        // operations, at least one of the two sees the other's write.
+        case ParallelMode::ingestion:
+        {
+          IngestionLane *lane;
+          {
+            std::lock_guard<std::mutex> ingestion_lock (ingestion_mutex);
+            ingestion_lanes.emplace_back (new IngestionLane (std::max (queue_size.load(), 1U)));
+            lane = ingestion_lanes.back().get();
+          }
+
+          if (drain_thread.joinable() == false)
+            {
+              stop_drain_thread = false;
+              drain_thread = std::thread ([this]()
+              {
+                this->drain_ingestion_lanes();
+              });
+            }
+
+          sample_consumer =
+            [this,lane](InputType sample, AuxiliaryData aux_data)
+          {
+            if (this->admit_sample() == false)
+              return;
+
+            lane->is_pushing = true;
+            if (lane->is_closed)
+              {
+                lane->is_pushing = false;
+                return;
+              }
+
+            // Move the sample into the lane. If the lane is full, wait
+            // for the draining thread to catch up.
+            std::pair<InputType,AuxiliaryData> element (std::move(sample),
+                                                        std::move(aux_data));
+            while (lane->queue.try_push (std::move(element)) == false)
+              std::this_thread::yield();
+
+            lane->is_pushing = false;
+
+            // If the draining thread has gone to sleep, wake it up. We
+            // need to hold the lock while doing so to ensure that the
+            // notification does not arrive between the time the thread
+            // has last checked the lanes and the time it starts waiting.
+            if (drain_thread_is_waiting)
+              {
+                std::lock_guard<std::mutex> ingestion_lock (ingestion_mutex);
+                drain_condition.notify_one();
+              }
+          };
+
+          break;
+        }
+
+
         default:
           assert(false);
       }
@@ -457,9 +918,13 @@ namespace SampleFlow
       this->flush();
     };
 
-    // Finally hook it all up:
+    // Finally hook it all up. If this object is currently disabled, the
+    // new connection starts out blocked.
+    std::lock_guard<std::mutex> enabled_lock (enabled_mutex);
     connections_to_producers.emplace_back (
       producer.connect_to_signals (sample_consumer, flush_slot));
+    connection_blocks.emplace_back (connections_to_producers.back().first,
+                                    /* initially_blocked = */ !enabled.load());
   }
 
 
@@ -471,12 +936,179 @@ namespace SampleFlow
                      const unsigned int queue_size)
   {
     assert (connections_to_producers.size() == 0);
-    assert ((static_cast<int>(parallel_mode)
-             & static_cast<int>(supported_parallel_modes))
-            != 0);
+    assert ((parallel_mode == ParallelMode::ingestion)
+            ||
+            ((static_cast<int>(parallel_mode)
+              & static_cast<int>(supported_parallel_modes))
+             != 0));
+    assert ((types::is_span<InputType>::value == false)
+            ||
+            (parallel_mode == ParallelMode::synchronous));
 
     this->parallel_mode = static_cast<int>(parallel_mode);
     this->queue_size = queue_size;
+
+    update_single_writer_mutexes();
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  set_priority (const Priority priority)
+  {
+    assert (connections_to_producers.size() == 0);
+
+    this->priority = priority;
+    this->use_shared_thread_pool = true;
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  declare_single_producer ()
+  {
+    assert (connections_to_producers.size() == 0);
+
+    has_single_producer = true;
+    update_single_writer_mutexes();
+  }
+
+
+
+  template <typename InputType>
+  bool
+  Consumer<InputType>::
+  has_declared_single_producer () const
+  {
+    return has_single_producer;
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  register_single_writer_mutex (Utilities::SingleWriterMutex &mutex)
+  {
+    assert (connections_to_producers.size() == 0);
+
+    single_writer_mutexes.push_back (&mutex);
+    update_single_writer_mutexes();
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  update_single_writer_mutexes ()
+  {
+    // In asynchronous mode, consume() may be called concurrently even if
+    // there is only one producer.
+    const bool single_writer
+      = ((static_cast<ParallelMode>(parallel_mode.load()) == ParallelMode::ingestion)
+         ||
+         (has_single_producer
+          &&
+          (static_cast<ParallelMode>(parallel_mode.load()) == ParallelMode::synchronous)));
+
+    for (auto mutex : single_writer_mutexes)
+      mutex->set_single_writer (single_writer);
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  set_gate_schedule (const GateSchedule &gate_schedule)
+  {
+    assert (connections_to_producers.size() == 0);
+
+    this->gate_schedule = gate_schedule;
+    this->is_gated = !gate_schedule.is_always_open();
+    this->n_gated_samples = 0;
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  enable ()
+  {
+    std::lock_guard<std::mutex> enabled_lock (enabled_mutex);
+    enabled.store (true, std::memory_order_relaxed);
+    for (auto &block : connection_blocks)
+      block.unblock();
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  disable ()
+  {
+    std::lock_guard<std::mutex> enabled_lock (enabled_mutex);
+    enabled.store (false, std::memory_order_relaxed);
+    for (auto &block : connection_blocks)
+      block.block();
+  }
+
+
+
+  template <typename InputType>
+  bool
+  Consumer<InputType>::
+  is_enabled () const
+  {
+    return enabled.load (std::memory_order_relaxed);
+  }
+
+
+
+  template <typename InputType>
+  ParallelMode
+  Consumer<InputType>::
+  get_supported_parallel_modes () const
+  {
+    return supported_parallel_modes;
+  }
+
+
+
+  template <typename InputType>
+  ParallelMode
+  Consumer<InputType>::
+  get_parallel_mode () const
+  {
+    return static_cast<ParallelMode>(parallel_mode.load());
+  }
+
+
+
+  template <typename InputType>
+  bool
+  Consumer<InputType>::
+  admit_sample ()
+  {
+    // Disabled objects are normally not called at all because their
+    // connections are blocked, but a sample may have been sent just
+    // before disable() blocked them:
+    if (enabled.load (std::memory_order_relaxed) == false)
+      return false;
+
+    // If there is a schedule, count the sample and check whether its
+    // index falls into an open window:
+    if (is_gated)
+      return gate_schedule.is_open (n_gated_samples.fetch_add (1, std::memory_order_relaxed));
+
+    return true;
   }
 
 
@@ -495,16 +1127,57 @@ namespace SampleFlow
     {
       std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
 
+      std::lock_guard<std::mutex> enabled_lock (enabled_mutex);
+
       for (auto &connection : connections_to_producers)
         {
           connection.first.disconnect ();
           connection.second.disconnect ();
         }
       connections_to_producers.clear();
+      connection_blocks.clear();
     }
 
+    // In ingestion mode, also close all lanes and wait for pushes into
+    // them that may currently be in progress. See the comments in
+    // connect_to_producer() about why this is necessary. We must not hold
+    // the lock while waiting, because a push may be waiting for the
+    // draining thread to make room in a full lane.
+    {
+      std::lock_guard<std::mutex> ingestion_lock (ingestion_mutex);
+      for (auto &lane : ingestion_lanes)
+        lane->is_closed = true;
+    }
+    for (auto &lane : ingestion_lanes)
+      while (lane->is_pushing)
+        std::this_thread::yield();
+
+    // Likewise for the connection to a single producer, if one has
+    // been declared.
+    if (has_single_producer)
+      {
+        single_producer_is_closed = true;
+        while (single_producer_is_busy)
+          std::this_thread::yield();
+      }
+
     // Then flush() the current state.
     flush ();
+
+    // Finally shut down the draining thread, if there is one. At this
+    // point, all lanes are empty and no further samples can arrive, so
+    // we can also get rid of the lanes themselves.
+    if (drain_thread.joinable())
+      {
+        {
+          std::lock_guard<std::mutex> ingestion_lock (ingestion_mutex);
+          stop_drain_thread = true;
+          drain_condition.notify_one();
+        }
+        drain_thread.join();
+
+        ingestion_lanes.clear();
+      }
   }
 
 
@@ -527,6 +1200,96 @@ namespace SampleFlow
     // we are under the lock, no new futures can have been added. So
     // just clear the whole array
     background_tasks.clear();
+
+    // If we have a single producer that is currently sending a sample
+    // from another thread, wait for it to be processed.
+    while (single_producer_is_busy)
+      std::this_thread::yield();
+
+    // In ingestion mode, wait until the draining thread has processed
+    // all samples that are currently in the lanes. The draining thread
+    // holds the lock while it works on samples, and only removes a
+    // sample from its lane once it has been processed; consequently, if
+    // we find all lanes empty while holding the lock, then there is also
+    // no sample left that is still being processed.
+    while (true)
+      {
+        {
+          std::lock_guard<std::mutex> ingestion_lock (ingestion_mutex);
+          if (ingestion_lanes_are_empty())
+            break;
+        }
+        std::this_thread::yield();
+      }
+  }
+
+
+
+  template <typename InputType>
+  bool
+  Consumer<InputType>::
+  ingestion_lanes_are_empty() const
+  {
+    for (const auto &lane : ingestion_lanes)
+      if (lane->queue.empty() == false)
+        return false;
+    return true;
+  }
+
+
+
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  drain_ingestion_lanes()
+  {
+    // The maximal number of samples we take from one lane before moving
+    // on to the next. This ensures that no producer can starve the others.
+    const unsigned int batch_size = 64;
+
+    std::unique_lock<std::mutex> ingestion_lock (ingestion_mutex);
+    while (true)
+      {
+        bool found_samples = false;
+        for (auto &lane : ingestion_lanes)
+          for (unsigned int n=0; n<batch_size; ++n)
+            {
+              std::pair<InputType,AuxiliaryData> *element = lane->queue.front();
+              if (element == nullptr)
+                break;
+
+              this->consume (std::move(element->first), std::move(element->second));
+              lane->queue.pop();
+              found_samples = true;
+            }
+
+        if (found_samples == true)
+          {
+            // Give other threads (in particular, connect_to_producer() and
+            // flush()) a chance to get the lock before we go over the lanes
+            // again.
+            ingestion_lock.unlock();
+            std::this_thread::yield();
+            ingestion_lock.lock();
+          }
+        else
+          {
+            if (stop_drain_thread)
+              return;
+
+            // Nothing to do: go to sleep until a producer wakes us up.
+            // Producers check the flag after pushing a sample, so we
+            // need to set it before checking for the last time whether
+            // there is anything in the lanes.
+            drain_thread_is_waiting = true;
+            drain_condition.wait (ingestion_lock,
+                                  [this]()
+            {
+              return (stop_drain_thread || !this->ingestion_lanes_are_empty());
+            });
+            drain_thread_is_waiting = false;
+          }
+      }
   }
 
 
@@ -537,7 +1300,16 @@ namespace SampleFlow
   trim_background_queue()
   {
     std::lock_guard<std::mutex> parallel_lock (parallel_mode_mutex);
+    remove_finished_background_tasks();
+  }
+
+
 
+  template <typename InputType>
+  void
+  Consumer<InputType>::
+  remove_finished_background_tasks()
+  {
     // For each std::shared_future object, first check whether it
     // has completed (either because someone has waited for it,
     // or because it has finished since someone last looked).
@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_CONSUMERS_ACCEPTANCE_RATIO_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 #include <mutex>
 #include <valarray>
@@ -101,12 +102,30 @@ namespace SampleFlow
          */
         double get () const;
 
+        /**
+         * Like get(), but write the result into the object given as argument.
+         * This function exists for consistency with other consumer classes;
+         * since the result is just a number, it is no more efficient than
+         * get().
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the current acceptance ratio, which is computed
+         * from the stored counts on every call. See the Consumer class for the
+         * general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
          * The current value of accepted values as described in the introduction
@@ -122,7 +141,7 @@ namespace SampleFlow
         /**
          * Previous sample
          */
-        InputType previous_sample;
+        types::StorageType<InputType> previous_sample;
     };
 
 
@@ -136,7 +155,9 @@ namespace SampleFlow
       Consumer<InputType>(ParallelMode::synchronous),
       n_samples (0),
       n_accepted_samples (0)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -190,6 +211,24 @@ namespace SampleFlow
           return true;
         }
 
+
+        /**
+         * A function that compares a types::Span object with the
+         * `std::valarray` object a previous Span sample has been copied into.
+         */
+        template <typename T>
+        bool is_equal (const types::Span<T> &t1,
+                       const std::valarray<typename std::remove_cv<T>::type> &t2)
+        {
+          if (t1.size() != t2.size())
+            return false;
+
+          for (unsigned int i=0; i<t1.size(); ++i)
+            if (t1[i] != t2[i])
+              return false;
+
+          return true;
+        }
       }
     }
 
@@ -200,14 +239,14 @@ namespace SampleFlow
     AcceptanceRatio<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       // If this is the first sample we see, naturally, this sample is accepted.
       if (n_samples == 0)
         {
           n_samples          = 1;
           n_accepted_samples = 1;
-          previous_sample    = sample;
+          previous_sample    = Utilities::to_storage (std::move (sample));
         }
       else
         // Check if new sample is not equal to previous sample and
@@ -225,7 +264,7 @@ namespace SampleFlow
               // The new sample is different. Update the counter and store
               // the new sample.
               ++n_accepted_samples;
-              previous_sample = sample;
+              previous_sample = Utilities::to_storage (std::move (sample));
               ++n_samples;
             }
         }
@@ -238,14 +277,41 @@ namespace SampleFlow
     AcceptanceRatio<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      value_type acceptance_ratio;
+      get_into (acceptance_ratio);
+      return acceptance_ratio;
+    }
+
+
+
+    template <typename InputType>
+    void
+    AcceptanceRatio<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
 
       if (n_samples > 0)
-        return (static_cast<double>(n_accepted_samples)
-                /
-                static_cast<double>(n_samples));
+        result = (static_cast<double>(n_accepted_samples)
+                  /
+                  static_cast<double>(n_samples));
       else
-        return 0.0;
+        result = 0.0;
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    AcceptanceRatio<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visitor (n_samples > 0 ?
+               static_cast<double>(n_accepted_samples) / static_cast<double>(n_samples) :
+               0.0);
     }
   }
 }
@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_CONSUMERS_ACTION_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <mutex>
 
 
@@ -143,7 +144,7 @@ namespace SampleFlow
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         const std::function<void (InputType, AuxiliaryData)> action_function;
     };
@@ -156,7 +157,9 @@ namespace SampleFlow
       :
       Consumer<InputType>(supported_parallel_modes),
       action_function (action)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -173,7 +176,7 @@ namespace SampleFlow
     Action<InputType>::
     consume (InputType sample, AuxiliaryData aux_data)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       action_function (std::move (sample), std::move(aux_data));
     }
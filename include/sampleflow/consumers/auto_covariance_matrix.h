@@ -17,10 +17,15 @@
 #define SAMPLEFLOW_CONSUMERS_AUTOCOVARIANCEMATRIX_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 #include <sampleflow/element_access.h>
+#include <sampleflow/linear_algebra.h>
+#include <sampleflow/lags.h>
+#include <algorithm>
 #include <mutex>
 #include <deque>
+#include <vector>
 
 #include <boost/numeric/ublas/matrix.hpp>
 
@@ -59,6 +64,14 @@ namespace SampleFlow
      *   same, though the current class returns $1\times 1$ matrices whereas
      *   the latter class just returns numbers for each lag $l$.
      *
+     * @note For complex-valued samples, the transpose in the formula above
+     *   is replaced by the conjugate transpose. The outer products that
+     *   dominate the cost of this class are computed by
+     *   Utilities::scaled_rank1_update() on contiguous copies of the
+     *   samples; for `std::complex` entries, this function operates on
+     *   interleaved real and imaginary parts so that the compiler can
+     *   vectorize it.
+     *
      *
      * <h3> Algorithm </h3>
      *
@@ -228,7 +241,12 @@ namespace SampleFlow
      * The computations made by this class are quite expensive,
      * even more expensive than the ones made by the AutoCovarianceTrace
      * class. The techniques described there to make computations
-     * cheaper also apply to the current class.
+     * cheaper also apply to the current class. In particular, this includes
+     * computing auto-covariances only for a sparse set of lags (for example,
+     * the one returned by Utilities::geometric_lags()) via the second
+     * constructor of this class. Since the cost of this class is dominated
+     * by the ${\cal O}(d^2)$ work per lag and sample, this reduces the cost
+     * by the ratio of the number of lags to the maximal lag.
      *
      *
      * ### Threading model ###
@@ -267,10 +285,23 @@ namespace SampleFlow
          *
          * @param[in] lag_length A number that indicates how many autocovariance
          *   values we want to calculate, i.e., how far back in the past we
-         *   want to check how correlated each sample is.
+         *   want to check how correlated each sample is. The class then
+         *   computes auto-covariances for all lags $l=0,1,\ldots,$`lag_length`.
          */
         AutoCovarianceMatrix(const unsigned int lag_length);
 
+        /**
+         * Constructor for the case where auto-covariances should only be
+         * computed for a given set of lags $l$, rather than for all lags
+         * up to a maximal lag.
+         *
+         * @param[in] lags The lags for which auto-covariances are to be
+         *   computed. These need to be sorted in strictly increasing order.
+         *   Utilities::geometric_lags() returns a set of lags that is often
+         *   useful for this purpose.
+         */
+        AutoCovarianceMatrix(const std::vector<unsigned int> &lags);
+
         /**
          * Destructor. This function also makes sure that all samples this
          * object may have received have been fully processed. To this end,
@@ -304,39 +335,128 @@ namespace SampleFlow
          *   corresponds to the auto-covariance of lag $l$. As a consequence,
          *   the first entry ($l=0$) is the trace of the covariance matrix
          *   that would have been returned by the CovarianceMatrix class.
+         *   If the object was constructed with a set of lags, then the
+         *   vector instead has one element for each of these lags, in the
+         *   same order; get_lags() returns this set.
          */
         value_type get() const;
 
+        /**
+         * Return the set of lags for which this object computes
+         * auto-covariances.
+         */
+        const std::vector<unsigned int> &
+        get_lags() const;
+
+        /**
+         * Like the previous function, but only compute and return the
+         * autocovariance matrix $\gamma(l)$ for a single lag $l$. This is
+         * substantially cheaper than calling the previous function and
+         * picking out one element of the result: it only requires
+         * ${\cal O}(d^2)$ instead of ${\cal O}(kd^2)$ operations (where
+         * $d$ is the number of components of the samples and $k$ the maximal
+         * lag), and only a single matrix has to be allocated.
+         *
+         * The lag $l$ needs to be one of the lags for which this object
+         * computes auto-covariances (see get_lags()).
+         *
+         * If no samples have been processed so far, then an empty matrix
+         * is returned.
+         */
+        boost::numeric::ublas::matrix<scalar_type>
+        get (const unsigned int lag) const;
+
+        /**
+         * Like the previous function, but compute and return the
+         * autocovariance matrices $\gamma(l)$ for all lags between
+         * `first_lag` and `last_lag` (both inclusive), in increasing order.
+         * If the object was constructed with a maximal lag, then the $i$th
+         * element of the returned vector corresponds to lag `first_lag+i`;
+         * otherwise, the returned vector only contains the matrices for those
+         * lags in the given range that were passed to the constructor.
+         */
+        value_type
+        get (const unsigned int first_lag,
+             const unsigned int last_lag) const;
+
+        /**
+         * Return the traces $\text{trace}\,\gamma(l)$ of the autocovariance
+         * matrices for all lags $l=0,\ldots,k$ (or, if a set of lags was
+         * passed to the constructor, for these lags), i.e., the same
+         * information the AutoCovarianceTrace class would compute. Since only the diagonal
+         * entries of the matrices are needed, this requires only
+         * ${\cal O}(kd)$ operations.
+         */
+        std::vector<scalar_type>
+        get_trace () const;
+
+        /**
+         * Compute the autocovariance matrix $\gamma(l)$ for lag $l$ and
+         * write it into the matrix given as first argument. If this matrix
+         * already has the correct size, no memory is allocated; this makes
+         * the function suitable for polling the current state of the
+         * computations frequently.
+         */
+        void
+        get_into (boost::numeric::ublas::matrix<scalar_type> &autocovariance,
+                  const unsigned int lag) const;
+
+        /**
+         * Like the previous function, but compute the autocovariance matrices
+         * for all lags, i.e., the same information as returned by get(). If
+         * the argument already has the correct size and contains matrices of
+         * the correct size, no memory is allocated.
+         */
+        void
+        get_into (value_type &autocovariances) const;
+
+        /**
+         * Call `visitor` with the autocovariance matrices for all lags. These
+         * are computed from the running sums this class stores, in a scratch
+         * object, on every call. See the Consumer class for the general
+         * contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * A scratch object used by visit().
+         */
+        mutable value_type visit_scratch;
 
         /**
-         * Describes the maximal lag up to which we calculate auto-covariances.
+         * The set of lags for which we calculate auto-covariances, and the
+         * largest of them.
          */
+        const std::vector<unsigned int> lags;
         const unsigned int max_lag;
 
         /**
          * The current value of $\bar{x}_k$ as described in the introduction
          * of this class. For more detailed description of calculation, check mean_value.h
          */
-        InputType current_mean;
+        types::StorageType<InputType> current_mean;
 
         /**
          * A data type used to store the past few samples.
          */
-        using PreviousSamples = std::deque<InputType>;
+        using PreviousSamples = std::deque<types::StorageType<InputType>>;
 
         /**
          * Update variables necessary to compute the autocovariation. See their
          * definition in the documentation of this class.
          */
         value_type alpha;
-        std::vector<InputType> beta;
-        std::vector<InputType> eta;
+        std::vector<types::StorageType<InputType>> beta;
+        std::vector<types::StorageType<InputType>> eta;
 
         /**
          * Save previous samples needed to do calculations when a new sample
@@ -348,10 +468,34 @@ namespace SampleFlow
          */
         PreviousSamples previous_samples;
 
+        /**
+         * Contiguous copies of the elements of the samples in
+         * `previous_samples`, in the same order. These are what the
+         * kernels used to update $\alpha$ operate on.
+         */
+        std::deque<std::vector<scalar_type>> previous_values;
+
         /**
          * The number of samples processed so far.
          */
         types::sample_index n_samples;
+
+        /**
+         * Return the position of the given lag in the `lags` array.
+         */
+        unsigned int
+        lag_index (const unsigned int lag) const;
+
+        /**
+         * Compute the autocovariance matrix for the lag with the given index
+         * in the `lags` array from the current values of $\alpha$, $\beta$,
+         * $\eta$, and $\bar x$, and write it into the given matrix, resizing
+         * it if necessary. This function assumes that the caller holds the
+         * mutex.
+         */
+        void
+        compute_autocovariance (const unsigned int lag_index,
+                                boost::numeric::ublas::matrix<scalar_type> &autocovariance) const;
     };
 
 
@@ -359,11 +503,27 @@ namespace SampleFlow
     template <typename InputType>
     AutoCovarianceMatrix<InputType>::
     AutoCovarianceMatrix (unsigned int lag_length)
+      :
+      AutoCovarianceMatrix (Utilities::consecutive_lags (lag_length))
+    {}
+
+
+
+    template <typename InputType>
+    AutoCovarianceMatrix<InputType>::
+    AutoCovarianceMatrix (const std::vector<unsigned int> &lags)
       :
       Consumer<InputType>(ParallelMode::synchronous),
-      max_lag(lag_length),
+      lags (lags),
+      max_lag (lags.size() > 0 ? lags.back() : 0),
       n_samples (0)
-    {}
+    {
+      assert (lags.size() > 0);
+      for (unsigned int i=1; i<lags.size(); ++i)
+        assert (lags[i] > lags[i-1]);
+
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -380,37 +540,39 @@ namespace SampleFlow
     AutoCovarianceMatrix<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       // If this is the first sample we see, initialize all components
       // After the first sample, the autocovariance vector
       // is the zero vector since a single sample does not have any friends yet.
       if (n_samples == 0)
         {
-          // Initialize the alpha and beta vectors to a length of lag_length+1
-          // (so that we can compute the variance plus lag_length auto-variances)
-          alpha.resize(max_lag+1);
+          // Initialize the alpha, beta, and eta vectors to one element per lag
+          alpha.resize(lags.size());
           for (auto &a : alpha)
             a.resize (Utilities::size(sample), Utilities::size(sample));
-          beta.resize(max_lag+1);
-          eta.resize(max_lag+1);
+          beta.resize(lags.size());
+          eta.resize(lags.size());
+          current_mean = Utilities::to_storage(sample);
 
-          for (unsigned int l=0; l<=max_lag; ++l)
+          for (unsigned int i=0; i<lags.size(); ++i)
             {
-              // Initialize beta[i] to zero; first initialize it to 'sample'
-              // so that it has the right size already. Do the same for eta.
-              beta[l] = sample;
-              eta[l] = sample;
+              // Initialize beta[i] to zero; first initialize it to the
+              // first sample (stored in current_mean) so that it has the right
+              // size already. Do the same for eta.
+              beta[i] = current_mean;
+              eta[i] = current_mean;
               for (unsigned int j=0; j<Utilities::size(sample); ++j)
                 {
-                  Utilities::get_nth_element(beta[l], j) = 0;
-                  Utilities::get_nth_element(eta[l], j) = 0;
+                  Utilities::get_nth_element(beta[i], j) = 0;
+                  Utilities::get_nth_element(eta[i], j) = 0;
                 }
             }
-          current_mean = sample;
 
           // Push the first sample to the front of the list of samples:
-          previous_samples.push_front (sample);
+          previous_samples.push_front (Utilities::to_storage(sample));
+          previous_values.emplace_front ();
+          Utilities::copy_to_contiguous (sample, previous_values.front());
           n_samples = 1;
         }
       else
@@ -419,63 +581,68 @@ namespace SampleFlow
           // length (plus one, for l=0), drop the oldest sample at the end of this
           // block. This makes sure that we always have all samples up to a lag of l+1
           // available, which we need for the initialization step
-          previous_samples.push_front (sample);
+          previous_samples.push_front (Utilities::to_storage(sample));
+          previous_values.emplace_front ();
+          Utilities::copy_to_contiguous (sample, previous_values.front());
+          const std::size_t n = previous_values.front().size();
 
-          for (unsigned int l=0; l<=max_lag; ++l)
+          for (unsigned int i=0; i<lags.size(); ++i)
             {
+              const unsigned int l = lags[i];
               if (n_samples == l+1)
                 {
                   // We need to initialize alpha via the formula
-                  // alpha_{l+2}(l) = sum_{t=1}^2 x_{t+l} x_t
-                  for (unsigned int i=0; i<Utilities::size(sample); ++i)
-                    for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                      alpha[l](i,j) += Utilities::get_nth_element (previous_samples[0], i) *
-                                       Utilities::get_nth_element (previous_samples[l], j);
-                  for (unsigned int i=0; i<Utilities::size(sample); ++i)
-                    for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                      alpha[l](i,j) += Utilities::get_nth_element (previous_samples[1], i) *
-                                       Utilities::get_nth_element (previous_samples[l+1], j);
-
-                  beta[l] = previous_samples[0];
-                  beta[l] += previous_samples[1];
-
-                  eta[l] += previous_samples[l];
-                  eta[l] += previous_samples[l+1];
+                  // alpha_{l+2}(l) = sum_{t=1}^2 x_{t+l} x_t^T
+                  scalar_type *alpha_l = &alpha[i].data()[0];
+                  Utilities::scaled_rank1_update (alpha_l,
+                                                  previous_values[0].data(),
+                                                  previous_values[l].data(),
+                                                  n, 1., 1.);
+                  Utilities::scaled_rank1_update (alpha_l,
+                                                  previous_values[1].data(),
+                                                  previous_values[l+1].data(),
+                                                  n, 1., 1.);
+
+                  beta[i] = previous_samples[0];
+                  beta[i] += previous_samples[1];
+
+                  eta[i] += previous_samples[l];
+                  eta[i] += previous_samples[l+1];
                 }
               else if (n_samples >= l+2)
                 {
-                  // Update alpha
-                  boost::numeric::ublas::matrix<scalar_type> alphaupd = -alpha[l];
-                  for (unsigned int i=0; i<Utilities::size(sample); ++i)
-                    for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                      {
-                        alphaupd(i,j) += Utilities::get_nth_element (sample, i) *
-                                         Utilities::get_nth_element (previous_samples[l], j);
-                      }
-                  alphaupd *= 1./(n_samples-l);
-                  alpha[l] += alphaupd;
+                  // Update alpha via
+                  //   alpha += (x_{t+l} x_t^T - alpha)/(n-l)
+                  const double factor = 1./(n_samples-l);
+                  Utilities::scaled_rank1_update (&alpha[i].data()[0],
+                                                  previous_values[0].data(),
+                                                  previous_values[l].data(),
+                                                  n, 1.-factor, factor);
 
                   // Update beta. Start with the current sample and add up
                   // the updates.
-                  InputType betaupd = sample;
-                  betaupd -= beta[l];
+                  types::StorageType<InputType> betaupd = previous_samples[0];
+                  betaupd -= beta[i];
                   betaupd *= 1./(n_samples-l);
-                  beta[l] += betaupd;
+                  beta[i] += betaupd;
 
                   // Finally also update eta
-                  InputType etaupd = previous_samples[l];
-                  etaupd -= eta[l];
+                  types::StorageType<InputType> etaupd = previous_samples[l];
+                  etaupd -= eta[i];
                   etaupd *= 1./(n_samples-l);
-                  eta[l] += etaupd;
+                  eta[i] += etaupd;
                 }
             }
 
           if (previous_samples.size() > max_lag+1)
-            previous_samples.pop_back ();
+            {
+              previous_samples.pop_back ();
+              previous_values.pop_back ();
+            }
           ++n_samples;
 
           // Then also update the running mean:
-          InputType update = sample;
+          types::StorageType<InputType> update = Utilities::to_storage(std::move(sample));
           update -= current_mean;
           update /= n_samples;
           current_mean += update;
@@ -484,41 +651,187 @@ namespace SampleFlow
 
 
 
+    template <typename InputType>
+    unsigned int
+    AutoCovarianceMatrix<InputType>::
+    lag_index (const unsigned int lag) const
+    {
+      const auto p = std::lower_bound (lags.begin(), lags.end(), lag);
+      assert ((p != lags.end()) && (*p == lag));
+      return p - lags.begin();
+    }
+
+
+
+    template <typename InputType>
+    void
+    AutoCovarianceMatrix<InputType>::
+    compute_autocovariance (const unsigned int lag_index,
+                            boost::numeric::ublas::matrix<scalar_type> &autocovariance) const
+    {
+      assert (lag_index < lags.size());
+
+      if (n_samples == 0)
+        {
+          autocovariance.resize (0, 0, false);
+          return;
+        }
+
+      const std::size_t n = Utilities::size(current_mean);
+      if ((autocovariance.size1() != n) || (autocovariance.size2() != n))
+        autocovariance.resize (n, n, false);
+
+      const unsigned int l = lags[lag_index];
+      const scalar_type mean_factor = (n_samples > l+1 ?
+                                       1. + 1./(n_samples-l-1) :
+                                       0.);
+      for (unsigned int i=0; i<n; ++i)
+        {
+          const scalar_type mean_i = Utilities::get_nth_element(current_mean, i);
+          const scalar_type beta_i = Utilities::get_nth_element(beta[lag_index], i);
+          for (unsigned int j=0; j<n; ++j)
+            {
+              const scalar_type mean_j = Utilities::get_nth_element(current_mean, j);
+              autocovariance(i,j) = alpha[lag_index](i,j)
+                                    - mean_i * Utilities::conj(Utilities::get_nth_element(eta[lag_index], j))
+                                    - beta_i * Utilities::conj(mean_j)
+                                    + mean_factor * mean_i * Utilities::conj(mean_j);
+            }
+        }
+    }
+
+
+
     template <typename InputType>
     typename AutoCovarianceMatrix<InputType>::value_type
     AutoCovarianceMatrix<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      value_type current_autocovariation;
+      get_into (current_autocovariation);
+      return current_autocovariation;
+    }
+
 
-      value_type current_autocovariation(max_lag+1);
-      for (auto &a : current_autocovariation)
-        a.resize (Utilities::size(current_mean), Utilities::size(current_mean));
 
-      for (int l=0; l<=max_lag; ++l)
+    template <typename InputType>
+    boost::numeric::ublas::matrix<typename AutoCovarianceMatrix<InputType>::scalar_type>
+    AutoCovarianceMatrix<InputType>::
+    get (const unsigned int lag) const
+    {
+      boost::numeric::ublas::matrix<scalar_type> autocovariance;
+      get_into (autocovariance, lag);
+      return autocovariance;
+    }
+
+
+
+    template <typename InputType>
+    typename AutoCovarianceMatrix<InputType>::value_type
+    AutoCovarianceMatrix<InputType>::
+    get (const unsigned int first_lag,
+         const unsigned int last_lag) const
+    {
+      assert (first_lag <= last_lag);
+
+      const unsigned int begin = std::lower_bound (lags.begin(), lags.end(), first_lag) - lags.begin();
+      const unsigned int end   = std::upper_bound (lags.begin(), lags.end(), last_lag) - lags.begin();
+
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      value_type current_autocovariation (end-begin);
+      for (unsigned int i=begin; i<end; ++i)
+        compute_autocovariance (i, current_autocovariation[i-begin]);
+
+      return current_autocovariation;
+    }
+
+
+
+    template <typename InputType>
+    std::vector<typename AutoCovarianceMatrix<InputType>::scalar_type>
+    AutoCovarianceMatrix<InputType>::
+    get_trace () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      std::vector<scalar_type> traces (lags.size(), scalar_type(0));
+      if (n_samples == 0)
+        return traces;
+
+      const std::size_t n = Utilities::size(current_mean);
+      for (unsigned int k=0; k<lags.size(); ++k)
         {
-          current_autocovariation[l] = alpha[l];
-
-          for (unsigned int i=0; i<Utilities::size(current_mean); ++i)
-            for (unsigned int j=0; j<Utilities::size(current_mean); ++j)
-              current_autocovariation[l](i,j) -= Utilities::get_nth_element(current_mean,i) *
-                                                 Utilities::get_nth_element(eta[l], j);
-
-          for (unsigned int i=0; i<Utilities::size(current_mean); ++i)
-            for (unsigned int j=0; j<Utilities::size(current_mean); ++j)
-              current_autocovariation[l](i,j) -= Utilities::get_nth_element(beta[l],i) *
-                                                 Utilities::get_nth_element(current_mean, j);
-
-          if (n_samples > l+1 )
-            for (unsigned int i=0; i<Utilities::size(current_mean); ++i)
-              for (unsigned int j=0; j<Utilities::size(current_mean); ++j)
-                current_autocovariation[l](i,j) += (1. + 1./(n_samples-l-1))
-                                                   *
-                                                   Utilities::get_nth_element(current_mean,i) *
-                                                   Utilities::get_nth_element(current_mean,j);
+          const unsigned int l = lags[k];
+          const scalar_type mean_factor = (n_samples > l+1 ?
+                                           1. + 1./(n_samples-l-1) :
+                                           0.);
+          for (unsigned int i=0; i<n; ++i)
+            {
+              const scalar_type mean_i = Utilities::get_nth_element(current_mean, i);
+              traces[k] += alpha[k](i,i)
+                           - mean_i * Utilities::conj(Utilities::get_nth_element(eta[k], i))
+                           - Utilities::get_nth_element(beta[k], i) * Utilities::conj(mean_i)
+                           + mean_factor * mean_i * Utilities::conj(mean_i);
+            }
         }
 
-      return current_autocovariation;
+      return traces;
+    }
+
+
+
+    template <typename InputType>
+    void
+    AutoCovarianceMatrix<InputType>::
+    get_into (boost::numeric::ublas::matrix<scalar_type> &autocovariance,
+              const unsigned int lag) const
+    {
+      const unsigned int index = lag_index (lag);
+
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      compute_autocovariance (index, autocovariance);
+    }
+
+
+
+    template <typename InputType>
+    void
+    AutoCovarianceMatrix<InputType>::
+    get_into (value_type &autocovariances) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      autocovariances.resize (lags.size());
+      for (unsigned int i=0; i<lags.size(); ++i)
+        compute_autocovariance (i, autocovariances[i]);
+    }
+
+
+
+    template <typename InputType>
+    const std::vector<unsigned int> &
+    AutoCovarianceMatrix<InputType>::
+    get_lags () const
+    {
+      return lags;
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    AutoCovarianceMatrix<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visit_scratch.resize (lags.size());
+      for (unsigned int i=0; i<lags.size(); ++i)
+        compute_autocovariance (i, visit_scratch[i]);
+      visitor (static_cast<const value_type &>(visit_scratch));
     }
   }
 }
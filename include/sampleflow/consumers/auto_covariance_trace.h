@@ -17,10 +17,14 @@
 #define SAMPLEFLOW_CONSUMERS_AUTOCOVARIANCETRACE_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 #include <sampleflow/element_access.h>
+#include <sampleflow/linear_algebra.h>
+#include <sampleflow/lags.h>
 #include <mutex>
 #include <deque>
+#include <vector>
 
 #include <boost/numeric/ublas/matrix.hpp>
 
@@ -83,6 +87,11 @@ namespace SampleFlow
      *   same, though the latter returns $1\times 1$ matrices whereas the
      *   current class just returns numbers for each lag $l$.
      *
+     * @note For complex-valued samples, every product $a^T b$ in the
+     *   formulas of this class is to be read as $\sum_j a_j \overline{b_j}$.
+     *   The results are then the traces of the matrices computed by the
+     *   AutoCovarianceMatrix class, and $\hat\gamma(0)$ is real-valued.
+     *
      *
      * <h3> Algorithm </h3>
      *
@@ -92,8 +101,8 @@ namespace SampleFlow
      * In the following, let us only consider the case when we have already seen
      * $n\ge k$ samples, so that all of the $\hat\gamma(l)$ can actually be computed.
      *
-     * Let us expand the formula above and then denote some of its parts as $\hat\alpha$
-     * and $\hat\beta$:
+     * Let us expand the formula above and then denote some of its parts as
+     * $\hat\alpha$, $\hat\beta$, and $\hat\eta$:
      * @f{align*}{
      *   \hat\gamma(l)
      *   &=
@@ -101,18 +110,24 @@ namespace SampleFlow
      * \\&=
      *   \underbrace{\frac{1}{n-l-1}\sum_{t=1}^{n-l}{x_{t+l}^T x_{t}}}_{\hat\alpha_n(l)}
      *   -
+     *   {\underbrace{\left[ \frac{1}{n-l-1}\sum_{t=1}^{n-l}x_{t+l} \right]}_{\hat\beta_n(l)}}^T
+     *   \bar{x}_n
+     *   -
      *   \bar{x}_n^T
-     *   \underbrace{\left[ \frac{1}{n-l-1}\sum_{t=1}^{n-l}(x_{t+l}+x_{t}) \right]}_{\hat\beta_n(l)}
+     *   \underbrace{\left[ \frac{1}{n-l-1}\sum_{t=1}^{n-l}x_{t} \right]}_{\hat\eta_n(l)}
      *   +
      *   \frac{n-l}{n-l-1}\bar{x}_n^T \bar{x}_n
      * \\&=
-     *   \hat\alpha_n(l)-\bar{x}_n^T \hat \beta_n(l)+\frac{n-l}{n-l-1} \bar{x}_n^T \bar{x}_n
-     * \\&=
-     *   \hat\alpha_n(l)-\bar{x}_n^T \hat \beta_n(l)+\left(1+\frac{1}{n-l-1}\right) \bar{x}_n^T \bar{x}_n.
+     *   \hat\alpha_n(l)-\hat \beta_n(l)^T \bar{x}_n - \bar{x}_n^T \hat \eta_n(l)
+     *   +\left(1+\frac{1}{n-l-1}\right) \bar{x}_n^T \bar{x}_n.
      * @f}
+     * For real-valued samples, only the sum $\hat\beta_n(l)+\hat\eta_n(l)$
+     * would be needed, but for complex-valued samples the two terms are
+     * conjugated differently and we have to keep them apart.
      *
      * For each new sample, we then need to update the scalars $\hat\alpha_{n+1}(l)$,
-     * vectors $\hat\beta_{n+1}(l)$, and sample mean $\bar{x}_{n+1}$. The
+     * vectors $\hat\beta_{n+1}(l)$ and $\hat\eta_{n+1}(l)$, and sample mean
+     * $\bar{x}_{n+1}$. The
      * principle of updating $\bar x_{n+1}$ is equivalent to what the MeanValue
      * class does. For $\hat\alpha$, we use that
      * @f{align*}{
@@ -150,24 +165,22 @@ namespace SampleFlow
      *  \\
      *  \hat\beta_{l+2}(l)
      *  &=
-     *  \frac{1}{l+2-l-1}\sum_{t=1}^{l+2-l}(x_{t+l}+x_{t})
+     *  \frac{1}{l+2-l-1}\sum_{t=1}^{l+2-l}x_{t+l}
      *  \\
      *  &=
-     *  \sum_{t=1}^{2}(x_{t+l}+x_{t})
-     *  \\
-     *  &=
-     *  (x_{l+1}+x_{1}) + (x_{l+2}+x_{2}),
+     *  x_{l+1} + x_{l+2},
      *  \\
      *   \hat\beta_{n+1}(l)
-     *   &= \frac{1}{n-l}\sum_{t=1}^{n+1-l}(x_{t+l}+x_{t})
+     *   &= \frac{1}{n-l}\sum_{t=1}^{n+1-l}x_{t+l}
      *   \qquad\qquad\qquad (\text{for}\, n\ge l+2)
      * \\
-     *   &= \frac{1}{n-l} \left[\sum_{t=1}^{n-l}(x_{t+l}+x_{t}) + (x_{n+1}+x_{n+1-l})\right]
-     * \\
-     *   &= \frac{1}{n-l} \left[(n-l-1)\beta_n(l) + (x_{n+1}+x_{n+1-l})\right]
+     *   &= \frac{1}{n-l} \left[(n-l-1)\hat\beta_n(l) + x_{n+1}\right]
      * \\
-     *   &= \beta_n(l) - \frac{1}{n-l}\beta_n(l) + \frac{1}{n-l} (x_{n+1}+x_{n+1-l}).
+     *   &= \hat\beta_n(l) - \frac{1}{n-l}\hat\beta_n(l) + \frac{1}{n-l} x_{n+1},
      * @f}
+     * and in the same way $\hat\eta_{l+2}(l) = x_1 + x_2$ and
+     * $\hat\eta_{n+1}(l) = \hat\eta_n(l) - \frac{1}{n-l}\hat\eta_n(l)
+     * + \frac{1}{n-l} x_{n+1-l}$.
      *
      *
      * ### Making computing this operation less expensive ###
@@ -270,6 +283,24 @@ namespace SampleFlow
      * rate when computing the autocovariance to a point where it no longer
      * is prohibitively expensive works.
      *
+     * A different approach that does not discard any samples is to compute
+     * auto-covariances only for a sparse set of lags, rather than for all
+     * lags between zero and the maximal lag. To this end, the class has a
+     * second constructor that takes the set of lags to consider; a good
+     * choice for slowly mixing chains is a geometrically spaced set of
+     * lags, such as the one returned by Utilities::geometric_lags():
+     * @code
+     *   SampleFlow::Consumers::AutoCovarianceTrace<SampleType>
+     *     covariance(SampleFlow::Utilities::geometric_lags(10000));
+     *   covariance.connect_to_producer (sampler);
+     * @endcode
+     * This computes auto-covariances for only 27 lags between zero and
+     * 8192, rather than for 10,001 lags, and the work per sample is
+     * reduced by the same factor. The class still needs to store the last
+     * `max_lag+2` samples to compute auto-covariances at lag `max_lag`
+     * exactly, but storing a sample is cheap compared to the work required
+     * for each lag.
+     *
      *
      * ### Threading model ###
      *
@@ -307,10 +338,23 @@ namespace SampleFlow
          *
          * @param[in] lag_length A number that indicates how many autocovariance
          *   values we want to calculate, i.e., how far back in the past we
-         *   want to check how correlated each sample is.
+         *   want to check how correlated each sample is. The class then
+         *   computes auto-covariances for all lags $l=0,1,\ldots,$`lag_length`.
          */
         AutoCovarianceTrace(const unsigned int lag_length);
 
+        /**
+         * Constructor for the case where auto-covariances should only be
+         * computed for a given set of lags $l$, rather than for all lags
+         * up to a maximal lag.
+         *
+         * @param[in] lags The lags for which auto-covariances are to be
+         *   computed. These need to be sorted in strictly increasing order.
+         *   Utilities::geometric_lags() returns a set of lags that is often
+         *   useful for this purpose.
+         */
+        AutoCovarianceTrace(const std::vector<unsigned int> &lags);
+
         /**
          * Destructor. This function also makes sure that all samples this
          * object may have received have been fully processed. To this end,
@@ -344,53 +388,98 @@ namespace SampleFlow
          *   corresponds to the auto-covariance of lag $l$. As a consequence,
          *   the first entry ($l=0$) is the trace of the covariance matrix
          *   that would have been returned by the CovarianceMatrix class.
+         *   If the object was constructed with a set of lags, then the
+         *   vector instead has one element for each of these lags, in the
+         *   same order; get_lags() returns this set.
          */
         value_type get() const;
 
+        /**
+         * Like get(), but write the autocovariances into `result`, reusing its
+         * memory if it already has one entry per lag. See the documentation of
+         * the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the autocovariances for all lags. These are
+         * computed from the running sums this class stores, in a scratch
+         * object, on every call. See the Consumer class for the general
+         * contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
+        /**
+         * Return the set of lags for which this object computes
+         * auto-covariances.
+         */
+        const std::vector<unsigned int> &
+        get_lags() const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
-         * Describes the maximal lag up to which we calculate auto-covariances.
+         * A scratch object used by visit().
          */
-        const unsigned int max_lag;
+        mutable value_type visit_scratch;
 
         /**
-         * The current value of $\bar{x}_k$ as described in the introduction
-         * of this class. For more detailed description of calculation, check mean_value.h
+         * The set of lags for which we calculate auto-covariances, and the
+         * largest of them.
          */
-        InputType current_mean;
+        const std::vector<unsigned int> lags;
+        const unsigned int max_lag;
 
         /**
-         * A data type used to store the past few samples.
+         * The current value of $\bar{x}_k$ as described in the introduction
+         * of this class. For more detailed description of calculation, check mean_value.h
          */
-        using PreviousSamples = std::deque<InputType>;
+        types::StorageType<InputType> current_mean;
 
         /**
          * Update variables necessary to compute the autocovariation. See their
-         * definition in the documentation of this class.
+         * definition in the documentation of this class. $\beta$ and $\eta$
+         * are stored as contiguous arrays of the elements of the samples so
+         * that they can be updated in place from `previous_values`.
          */
         std::vector<scalar_type> alpha;
-        std::vector<InputType> beta;
+        std::vector<std::vector<scalar_type>> beta;
+        std::vector<std::vector<scalar_type>> eta;
 
         /**
-         * Save previous samples needed to do calculations when a new sample
-         * comes in.
+         * Save the elements of previous samples needed to do calculations
+         * when a new sample comes in, newest first. The inner products
+         * needed to update $\alpha$ are computed on these using
+         * Utilities::dot_conj().
          *
-         * These samples are stored in a double-ended queue (`std::deque`) so
+         * The samples are stored in a double-ended queue (`std::deque`) so
          * that it is efficient to push a new sample to the front of the list
-         * as well as to remove one from the end of the list.
+         * as well as to remove one from the end of the list. Once the list
+         * is full, the array of the oldest sample is re-used for the newest
+         * one.
          */
-        PreviousSamples previous_samples;
+        std::deque<std::vector<scalar_type>> previous_values;
 
         /**
          * The number of samples processed so far.
          */
         types::sample_index n_samples;
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the mutex.
+         */
+        void
+        assemble (value_type &result) const;
     };
 
 
@@ -398,11 +487,27 @@ namespace SampleFlow
     template <typename InputType>
     AutoCovarianceTrace<InputType>::
     AutoCovarianceTrace (unsigned int lag_length)
+      :
+      AutoCovarianceTrace (Utilities::consecutive_lags (lag_length))
+    {}
+
+
+
+    template <typename InputType>
+    AutoCovarianceTrace<InputType>::
+    AutoCovarianceTrace (const std::vector<unsigned int> &lags)
       :
       Consumer<InputType>(ParallelMode::synchronous),
-      max_lag(lag_length),
+      lags (lags),
+      max_lag (lags.size() > 0 ? lags.back() : 0),
       n_samples (0)
-    {}
+    {
+      assert (lags.size() > 0);
+      for (unsigned int i=1; i<lags.size(); ++i)
+        assert (lags[i] > lags[i-1]);
+
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -419,97 +524,90 @@ namespace SampleFlow
     AutoCovarianceTrace<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
+
+      // Save the sample at the front of the list of previous samples. We
+      // need the samples up to a lag of max_lag+1 for the initialization
+      // step below; if the list already holds that many, re-use the array
+      // of the oldest sample rather than allocating a new one.
+      if (previous_values.size() > max_lag+1)
+        {
+          std::vector<scalar_type> oldest = std::move (previous_values.back());
+          previous_values.pop_back ();
+          previous_values.push_front (std::move (oldest));
+        }
+      else
+        previous_values.emplace_front ();
+      Utilities::copy_to_contiguous (sample, previous_values.front());
+      const std::vector<scalar_type> &x = previous_values[0];
+      const std::size_t n = x.size();
 
       // If this is the first sample we see, initialize all components
       // After the first sample, the autocovariance vector
       // is the zero vector since a single sample does not have any friends yet.
       if (n_samples == 0)
         {
-          // Initialize the alpha and beta vectors to a length of lag_length+1
-          // (so that we can compute the variance plus lag_length auto-variances)
-          alpha = std::vector<double>(max_lag+1, 0.);
-          beta.resize(max_lag+1);
-
-          for (unsigned int l=0; l<=max_lag; ++l)
-            {
-              // Initialize beta[i] to zero; first initialize it to 'sample'
-              // so that it has the right size already
-              beta[l] = sample;
-              for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                {
-                  Utilities::get_nth_element(beta[l], j) = 0;
-                }
-            }
-          current_mean = sample;
+          // Initialize the alpha, beta, and eta vectors to one element per
+          // lag, and each element of beta and eta to a zero vector
+          alpha = std::vector<scalar_type>(lags.size(), scalar_type(0));
+          beta.assign (lags.size(), std::vector<scalar_type>(n, scalar_type(0)));
+          eta.assign (lags.size(), std::vector<scalar_type>(n, scalar_type(0)));
+          current_mean = Utilities::to_storage(std::move(sample));
 
-          // Push the first sample to the front of the list of samples:
-          previous_samples.push_front (sample);
           n_samples = 1;
         }
       else
         {
-          // Now save the sample. If the list is becoming longer than the lag
-          // length (plus one, for l=0), drop the oldest sample at the end of this
-          // block. This makes sure that we always have all samples up to a lag of l+1
-          // available, which we need for the initialization step
-          previous_samples.push_front (sample);
-
-          for (unsigned int l=0; l<=max_lag; ++l)
+          for (unsigned int i=0; i<lags.size(); ++i)
             {
+              const unsigned int l = lags[i];
+              const std::vector<scalar_type> &x_lagged = previous_values[l];
               if (n_samples == l+1)
                 {
                   // We need to initialize alpha via the formula
-                  // alpha_{l+2}(l) = sum_{t=1}^2 x_{t+l} x_t
-                  alpha[l] = 0;
-                  for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                    alpha[l] += Utilities::get_nth_element (previous_samples[0], j) *
-                                Utilities::get_nth_element (previous_samples[l], j);
-                  for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                    alpha[l] += Utilities::get_nth_element (previous_samples[1], j) *
-                                Utilities::get_nth_element (previous_samples[l+1], j);
-
-                  beta[l] = previous_samples[0];
-                  beta[l] += previous_samples[1];
-                  beta[l] += previous_samples[l];
-                  beta[l] += previous_samples[l+1];
+                  // alpha_{l+2}(l) = sum_{t=1}^2 x_{t+l} x_t, and beta and
+                  // eta as the sums of the leading and lagging samples
+                  const std::vector<scalar_type> &x_previous = previous_values[1];
+                  const std::vector<scalar_type> &x_previous_lagged = previous_values[l+1];
+                  alpha[i] = Utilities::dot_conj (x.data(), x_lagged.data(), n)
+                             + Utilities::dot_conj (x_previous.data(),
+                                                    x_previous_lagged.data(),
+                                                    n);
+
+                  for (std::size_t j=0; j<n; ++j)
+                    {
+                      beta[i][j] = x[j] + x_previous[j];
+                      eta[i][j]  = x_lagged[j] + x_previous_lagged[j];
+                    }
                 }
               else if (n_samples >= l+2)
                 {
+                  const double factor = 1./(n_samples-l);
+
                   // Update alpha
-                  double alphaupd = -alpha[l];
-                  for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                    {
-                      alphaupd += Utilities::get_nth_element (sample, j) *
-                                  Utilities::get_nth_element (previous_samples[l], j);
-                    }
-                  alphaupd *= 1./(n_samples-l);
-                  alpha[l] += alphaupd;
+                  scalar_type alphaupd = Utilities::dot_conj (x.data(), x_lagged.data(), n)
+                                         - alpha[i];
+                  alphaupd *= factor;
+                  alpha[i] += alphaupd;
 
-                  // Update beta. Start with the current sample and add up
-                  // the updates.
-                  InputType betaupd = sample;
-                  for (unsigned int j=0; j<Utilities::size(sample); ++j)
+                  // Update beta and eta in place
+                  for (std::size_t j=0; j<n; ++j)
                     {
-                      Utilities::get_nth_element(betaupd, j)
-                      += Utilities::get_nth_element (previous_samples[l], j);
+                      scalar_type betaupd = x[j] - beta[i][j];
+                      betaupd *= factor;
+                      beta[i][j] += betaupd;
 
-                      Utilities::get_nth_element(betaupd, j)
-                      -= Utilities::get_nth_element (beta[l], j);
-
-                      Utilities::get_nth_element(betaupd, j)
-                      *= 1./(n_samples-l);
+                      scalar_type etaupd = x_lagged[j] - eta[i][j];
+                      etaupd *= factor;
+                      eta[i][j] += etaupd;
                     }
-                  beta[l] += betaupd;
                 }
             }
 
-          if (previous_samples.size() > max_lag+1)
-            previous_samples.pop_back ();
           ++n_samples;
 
           // Then also update the running mean:
-          InputType update = sample;
+          types::StorageType<InputType> update = Utilities::to_storage(std::move(sample));
           update -= current_mean;
           update /= n_samples;
           current_mean += update;
@@ -519,32 +617,78 @@ namespace SampleFlow
 
 
     template <typename InputType>
-    typename AutoCovarianceTrace<InputType>::value_type
+    void
     AutoCovarianceTrace<InputType>::
-    get () const
+    assemble (value_type &result) const
     {
-      std::lock_guard<std::mutex> lock(mutex);
-
-      std::vector<scalar_type> current_autocovariation(max_lag+1,
-                                                       scalar_type(0));
+      result.assign (lags.size(), scalar_type(0));
+      if (n_samples == 0)
+        return;
 
-      for (int l=0; l<=max_lag; ++l)
+      for (unsigned int i=0; i<lags.size(); ++i)
         {
-          current_autocovariation[l] = alpha[l];
+          const unsigned int l = lags[i];
+          result[i] = alpha[i];
 
+          const scalar_type mean_factor = (n_samples > l+1 ?
+                                           1. + 1./(n_samples-l-1) :
+                                           0.);
           for (unsigned int j=0; j<Utilities::size(current_mean); ++j)
-            current_autocovariation[l] -= Utilities::get_nth_element(current_mean,j) *
-                                          Utilities::get_nth_element(beta[l], j);
-
-          if (n_samples > l+1 )
-            for (unsigned int j=0; j<Utilities::size(current_mean); ++j)
-              current_autocovariation[l] += (1. + 1./(n_samples-l-1))
-                                            *
-                                            Utilities::get_nth_element(current_mean,j) *
-                                            Utilities::get_nth_element(current_mean,j);
+            {
+              const scalar_type mean_j = Utilities::get_nth_element(current_mean, j);
+              result[i] += - beta[i][j] * Utilities::conj(mean_j)
+                           - mean_j * Utilities::conj(eta[i][j])
+                           + mean_factor * mean_j * Utilities::conj(mean_j);
+            }
         }
+    }
+
 
-      return current_autocovariation;
+
+    template <typename InputType>
+    typename AutoCovarianceTrace<InputType>::value_type
+    AutoCovarianceTrace<InputType>::
+    get () const
+    {
+      value_type result;
+      get_into (result);
+      return result;
+    }
+
+
+
+    template <typename InputType>
+    void
+    AutoCovarianceTrace<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    AutoCovarianceTrace<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
+    }
+
+
+
+    template <typename InputType>
+    const std::vector<unsigned int> &
+    AutoCovarianceTrace<InputType>::
+    get_lags () const
+    {
+      return lags;
     }
   }
 }
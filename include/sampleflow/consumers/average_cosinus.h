@@ -4,6 +4,7 @@
 #define SAMPLEFLOW_CONSUMERS_AVERAGE_COSINE_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 #include <list>
 #include <mutex>
@@ -93,12 +94,29 @@ namespace SampleFlow
          */
         std::vector<scalar_type> get() const;
 
+        /**
+         * Like get(), but write the average cosines into `result`, reusing its
+         * memory if it already has the correct size. See the documentation of
+         * the Consumer class for the general contract.
+         */
+        void
+        get_into (std::vector<scalar_type> &result) const;
+
+        /**
+         * Call `visitor` with a reference to the vector of running average
+         * cosines this class stores, without copying it. See the Consumer class
+         * for the general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
          * The data type, where we save multiple set of previous samples.
@@ -135,7 +153,9 @@ namespace SampleFlow
       history_length(length),
       n_samples (0)
 
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -153,7 +173,7 @@ namespace SampleFlow
     AverageCosineBetweenSuccessiveSamples<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       // If this is the first sample we see, initialize all components
       // After the first sample, the average cosine vector.
@@ -221,11 +241,35 @@ namespace SampleFlow
     AverageCosineBetweenSuccessiveSamples<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
 
       return current_avg_cosine;
     }
 
+
+
+    template <typename InputType>
+    void
+    AverageCosineBetweenSuccessiveSamples<InputType>::
+    get_into (std::vector<scalar_type> &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      result = current_avg_cosine;
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    AverageCosineBetweenSuccessiveSamples<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visitor (current_avg_cosine);
+    }
   }
 }
 
@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_CONSUMERS_COUNT_SAMPLES_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 #include <mutex>
 
@@ -88,12 +89,29 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Like get(), but write the result into the object given as argument.
+         * This function exists for consistency with other consumer classes;
+         * since the result is just a number, it is no more efficient than
+         * get().
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with a reference to the sample counter. See the
+         * Consumer class for the general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
          * The number of samples received so far.
@@ -111,7 +129,9 @@ namespace SampleFlow
                                        |
                                        static_cast<int>(ParallelMode::asynchronous))),
       n_samples (0)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -129,7 +149,7 @@ namespace SampleFlow
     CountSamples<InputType>::
     consume (InputType /*sample*/, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       ++n_samples;
     }
@@ -141,11 +161,35 @@ namespace SampleFlow
     CountSamples<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
 
       return n_samples;
     }
 
+
+
+    template <typename InputType>
+    void
+    CountSamples<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      result = n_samples;
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    CountSamples<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visitor (n_samples);
+    }
   }
 }
 
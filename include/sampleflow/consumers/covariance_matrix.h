@@ -17,8 +17,11 @@
 #define SAMPLEFLOW_CONSUMERS_COVARIANCE_MATRIX_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
+#include <sampleflow/linear_algebra.h>
 #include <mutex>
+#include <vector>
 
 #include <boost/numeric/ublas/matrix.hpp>
 
@@ -43,6 +46,15 @@ namespace SampleFlow
      * and
      * https://en.wikipedia.org/wiki/Algorithms_for_calculating_variance#Online .
      *
+     * For complex-valued samples, the transpose in the formula above is
+     * replaced by the conjugate transpose, and $C_k$ is Hermitian. In either
+     * case, the class only stores (and updates) the upper triangle of the
+     * matrix, in a contiguous array; the updates are performed by the
+     * kernels in Utilities::scaled_hermitian_rank1_update(), which for
+     * `std::complex` entries operate on interleaved real and imaginary parts
+     * so that the compiler can vectorize them. The full matrix is only
+     * assembled when get() is called.
+     *
      *
      * ### Threading model ###
      *
@@ -111,29 +123,66 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Like get(), but write the covariance matrix into `result`, reusing
+         * its memory if it already has the correct size. See the documentation
+         * of the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the full covariance matrix. Since this class only
+         * stores the upper triangle, the matrix is assembled from it in a
+         * scratch object on every call. See the Consumer class for the general
+         * contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
-         * The current value of $\bar x_k$ as described in the introduction
-         * of this class.
+         * A scratch object used by visit().
          */
-        InputType           current_mean;
+        mutable value_type visit_scratch;
 
         /**
          * The current value of $\bar x_k$ as described in the introduction
          * of this class.
          */
-        value_type current_covariance_matrix;
+        types::StorageType<InputType> current_mean;
+
+        /**
+         * The upper triangle of the current value of $C_k$ as described in
+         * the introduction of this class, stored row by row.
+         */
+        std::vector<scalar_type> packed_covariance_matrix;
+
+        /**
+         * Scratch space for the difference between the current sample and
+         * the previous mean.
+         */
+        std::vector<scalar_type> delta;
 
         /**
          * The number of samples processed so far.
          */
         types::sample_index n_samples;
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the mutex.
+         */
+        void
+        assemble (value_type &result) const;
     };
 
 
@@ -146,7 +195,9 @@ namespace SampleFlow
                                        |
                                        static_cast<int>(ParallelMode::asynchronous))),
       n_samples (0)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -164,7 +215,7 @@ namespace SampleFlow
     CovarianceMatrix<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       // If this is the first sample we see, initialize the matrix with
       // this sample. After the first sample, the covariance matrix
@@ -175,27 +226,30 @@ namespace SampleFlow
       if (n_samples == 0)
         {
           n_samples = 1;
-          current_covariance_matrix.resize (Utilities::size(sample), Utilities::size(sample));
-          current_mean = std::move(sample);
+          const std::size_t n = Utilities::size(sample);
+          packed_covariance_matrix.assign (n*(n+1)/2, scalar_type(0));
+          current_mean = Utilities::to_storage(std::move(sample));
         }
       else
         {
           // Otherwise update the previously computed covariance by the current
           // sample; this also requires updating the current running mean.
+          // The covariance update
+          //   C_ij += delta_i conj(delta_j)/n - C_ij/(n-1)
+          // is done on a contiguous copy of delta.
           ++n_samples;
 
-          InputType delta = sample;
-          delta -= current_mean;
-          for (unsigned int i=0; i<Utilities::size(sample); ++i)
-            {
-              const auto delta_i = Utilities::get_nth_element(delta, i);
-              for (unsigned int j=0; j<Utilities::size(sample); ++j)
-                {
-                  const auto delta_j = Utilities::conj(Utilities::get_nth_element(delta, j));
-                  current_covariance_matrix(i,j) += ((delta_i*delta_j)/(1.0*n_samples)) - current_covariance_matrix(i,j)/((1.0*n_samples)-1);
-                }
-            }
-          InputType mean_update = sample;
+          types::StorageType<InputType> difference = Utilities::to_storage(sample);
+          difference -= current_mean;
+          Utilities::copy_to_contiguous (difference, delta);
+
+          Utilities::scaled_hermitian_rank1_update (packed_covariance_matrix.data(),
+                                                    delta.data(),
+                                                    delta.size(),
+                                                    1. - 1./((1.0*n_samples)-1),
+                                                    1./(1.0*n_samples));
+
+          types::StorageType<InputType> mean_update = Utilities::to_storage(std::move(sample));
           mean_update -= current_mean;
           mean_update /= n_samples;
           current_mean += mean_update;
@@ -204,14 +258,59 @@ namespace SampleFlow
 
 
 
+    template <typename InputType>
+    void
+    CovarianceMatrix<InputType>::
+    assemble (value_type &result) const
+    {
+      // Assemble the full matrix from its upper triangle:
+      const std::size_t n = (n_samples > 0 ? Utilities::size(current_mean) : 0);
+      if ((result.size1() != n) || (result.size2() != n))
+        result.resize (n, n, false);
+      for (std::size_t i=0; i<n; ++i)
+        for (std::size_t j=i; j<n; ++j)
+          {
+            result(i,j) = packed_covariance_matrix[Utilities::packed_upper_triangle_index(i,j,n)];
+            result(j,i) = Utilities::conj(result(i,j));
+          }
+    }
+
+
+
     template <typename InputType>
     typename CovarianceMatrix<InputType>::value_type
     CovarianceMatrix<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      value_type result;
+      get_into (result);
+      return result;
+    }
+
+
+
+    template <typename InputType>
+    void
+    CovarianceMatrix<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    CovarianceMatrix<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
 
-      return current_covariance_matrix;
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
     }
 
   }
@@ -0,0 +1,433 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+#ifndef SAMPLEFLOW_CONSUMERS_DECIMATED_TRACE_H
+#define SAMPLEFLOW_CONSUMERS_DECIMATED_TRACE_H
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  namespace Consumers
+  {
+    /**
+     * A Consumer class that keeps a decimated version of the "trace" of
+     * all components of the samples, i.e., of the values $x_{k,c}$ of
+     * component $c$ as a function of the sample index $k$, in a fixed amount
+     * of memory. Plotting such trace plots is a common way to visually
+     * assess whether a Markov chain mixes well, but for long chains one
+     * would otherwise have to store (or output via StreamOutput) all samples.
+     *
+     * To this end, the class splits the sequence of samples into consecutive
+     * "buckets" of equal width $w$ (i.e., each bucket represents $w$
+     * consecutive samples), and for each bucket and each component only
+     * stores the minimum, the maximum, and the mean value of the samples in
+     * the bucket. Plotting the minimum and maximum of each bucket then
+     * shows the same envelope one would see when plotting all samples.
+     *
+     * The number of buckets $B$ (which must be even) is fixed in the
+     * constructor. Initially, each bucket represents a single sample. Once
+     * all buckets are full, adjacent pairs of buckets are merged into one,
+     * so that $B/2$ buckets of width $2w$ are in use and $B/2$ are free
+     * again; in other words, the resolution of the trace is halved whenever
+     * the number of samples doubles. Merging costs ${\cal O}(B)$ operations
+     * per component, but since it only happens after $B/2$ more buckets have
+     * been filled, the cost per sample is constant on average.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * consume() member function can be called concurrently and from multiple
+     * threads. However, a trace only makes sense if samples are processed
+     * in the order in which they were produced, and so the class only
+     * supports synchronous processing.
+     *
+     *
+     * @tparam InputType The C++ type used for the samples $x_k$. It needs to
+     *   be possible to access the elements of samples via
+     *   Utilities::get_nth_element(), and these elements need to be real
+     *   numbers. All samples need to have the same number of elements.
+     */
+    template <typename InputType>
+    class DecimatedTrace : public Consumer<InputType>
+    {
+      public:
+        /**
+         * A structure that describes one bucket of the trace of one component.
+         */
+        struct Bucket
+        {
+          /**
+           * The index of the first sample represented by this bucket, and the
+           * number of samples it represents.
+           */
+          types::sample_index first_sample_index;
+          types::sample_index n_samples;
+
+          /**
+           * The smallest, largest, and mean value of the component over the
+           * samples represented by this bucket.
+           */
+          double min;
+          double max;
+          double mean;
+        };
+
+        /**
+         * The type of the information generated by this class, i.e., the type
+         * of the object returned by get(). It is a vector with one element for
+         * each component of the samples, each of which is a vector of buckets
+         * in the order of the samples they represent.
+         */
+        using value_type = std::vector<std::vector<Bucket>>;
+
+        /**
+         * Constructor.
+         *
+         * @param[in] n_buckets The number of buckets used to represent the
+         *   trace of each component. This must be an even number.
+         */
+        DecimatedTrace (const unsigned int n_buckets = 1024);
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~DecimatedTrace ();
+
+        /**
+         * Process one sample by adding it to the current bucket, if necessary
+         * after starting a new bucket or merging existing ones.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class does not know what to do with any such data and consequently
+         *   simply ignores it.
+         */
+        virtual
+        void
+        consume (InputType sample, AuxiliaryData aux_data) override;
+
+        /**
+         * Return the decimated trace of all components. The last bucket of
+         * each component may represent fewer samples than the other ones.
+         */
+        value_type
+        get () const;
+
+        /**
+         * Like get(), but write the trace into `result`, reusing the memory of
+         * its per-component vectors if they already have the correct size. See
+         * the documentation of the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the trace in the form returned by get(). This
+         * class stores the minima, maxima, and sums of all buckets in flat
+         * arrays, and every call converts them into Bucket objects in a scratch
+         * object. See the Consumer class for the general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
+        /**
+         * Return the number of samples each (complete) bucket currently
+         * represents.
+         */
+        types::sample_index
+        get_bucket_width () const;
+
+        /**
+         * Write the decimated trace into the given stream in a format that
+         * can be plotted with gnuplot. Each bucket results in one line with
+         * the index of the first sample of the bucket, followed by the
+         * minimum, maximum, and mean value of each component. For example,
+         * `plot "trace.txt" using 1:2:3 with filledcurves` shows the envelope
+         * of the first component.
+         */
+        void
+        write_gnuplot (std::ostream &&output_stream) const;
+
+      private:
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * A scratch object used by visit().
+         */
+        mutable value_type visit_scratch;
+
+        /**
+         * The maximal number of buckets, the number of buckets currently in
+         * use, the number of samples each (complete) bucket represents, and
+         * the number of samples in the last bucket.
+         */
+        const unsigned int  n_buckets;
+        unsigned int        n_used_buckets;
+        types::sample_index bucket_width;
+        types::sample_index n_samples_in_last_bucket;
+
+        /**
+         * The number of components of the samples.
+         */
+        std::size_t n_components;
+
+        /**
+         * The minima, maxima, and sums of the values of each component for
+         * each bucket. The data for component $c$ and bucket $b$ is stored at
+         * index $c B + b$.
+         */
+        std::vector<double> mins;
+        std::vector<double> maxs;
+        std::vector<double> sums;
+
+        /**
+         * Merge pairs of adjacent buckets.
+         */
+        void
+        merge_buckets ();
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the mutex.
+         */
+        void
+        assemble (value_type &result) const;
+    };
+
+
+
+    template <typename InputType>
+    DecimatedTrace<InputType>::
+    DecimatedTrace (const unsigned int n_buckets)
+      :
+      n_buckets (n_buckets),
+      n_used_buckets (0),
+      bucket_width (1),
+      n_samples_in_last_bucket (0),
+      n_components (0)
+    {
+      assert (n_buckets >= 2);
+      assert (n_buckets % 2 == 0);
+
+      this->register_single_writer_mutex (mutex);
+    }
+
+
+
+    template <typename InputType>
+    DecimatedTrace<InputType>::
+    ~DecimatedTrace ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    void
+    DecimatedTrace<InputType>::
+    consume (InputType sample, AuxiliaryData /*aux_data*/)
+    {
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
+
+      if (n_components == 0)
+        {
+          n_components = Utilities::size(sample);
+          mins.resize (n_components * n_buckets);
+          maxs.resize (n_components * n_buckets);
+          sums.resize (n_components * n_buckets);
+        }
+      assert (Utilities::size(sample) == n_components);
+
+      // If the last bucket is full (or if there is none yet), start a new
+      // one. If all buckets are in use, first merge pairs of buckets. Since
+      // all buckets are full at that point, the merged buckets are full, too.
+      if ((n_used_buckets == 0) || (n_samples_in_last_bucket == bucket_width))
+        {
+          if (n_used_buckets == n_buckets)
+            merge_buckets ();
+
+          ++n_used_buckets;
+          n_samples_in_last_bucket = 0;
+        }
+
+      // Then add the sample to the last bucket:
+      const unsigned int b = n_used_buckets - 1;
+      for (std::size_t c=0; c<n_components; ++c)
+        {
+          const double value = Utilities::get_nth_element (sample, c);
+          const std::size_t index = c*n_buckets + b;
+          if (n_samples_in_last_bucket == 0)
+            {
+              mins[index] = value;
+              maxs[index] = value;
+              sums[index] = value;
+            }
+          else
+            {
+              mins[index] = std::min (mins[index], value);
+              maxs[index] = std::max (maxs[index], value);
+              sums[index] += value;
+            }
+        }
+      ++n_samples_in_last_bucket;
+    }
+
+
+
+    template <typename InputType>
+    void
+    DecimatedTrace<InputType>::
+    merge_buckets ()
+    {
+      for (std::size_t c=0; c<n_components; ++c)
+        {
+          double *min = &mins[c*n_buckets];
+          double *max = &maxs[c*n_buckets];
+          double *sum = &sums[c*n_buckets];
+          for (unsigned int b=0; b<n_buckets/2; ++b)
+            {
+              min[b] = std::min (min[2*b], min[2*b+1]);
+              max[b] = std::max (max[2*b], max[2*b+1]);
+              sum[b] = sum[2*b] + sum[2*b+1];
+            }
+        }
+
+      n_used_buckets = n_buckets/2;
+      bucket_width *= 2;
+      n_samples_in_last_bucket = bucket_width;
+    }
+
+
+
+    template <typename InputType>
+    void
+    DecimatedTrace<InputType>::
+    assemble (value_type &result) const
+    {
+      result.resize (n_components);
+      for (std::size_t c=0; c<n_components; ++c)
+        {
+          result[c].resize (n_used_buckets);
+          for (unsigned int b=0; b<n_used_buckets; ++b)
+            {
+              const std::size_t index = c*n_buckets + b;
+              const types::sample_index n_samples = (b == n_used_buckets-1 ?
+                                                     n_samples_in_last_bucket :
+                                                     bucket_width);
+              result[c][b] = Bucket { b*bucket_width, n_samples,
+                                      mins[index], maxs[index],
+                                      sums[index] / n_samples
+                                    };
+            }
+        }
+    }
+
+
+
+    template <typename InputType>
+    typename DecimatedTrace<InputType>::value_type
+    DecimatedTrace<InputType>::
+    get () const
+    {
+      value_type result;
+      get_into (result);
+      return result;
+    }
+
+
+
+    template <typename InputType>
+    void
+    DecimatedTrace<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    DecimatedTrace<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
+    }
+
+
+
+    template <typename InputType>
+    types::sample_index
+    DecimatedTrace<InputType>::
+    get_bucket_width () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      return bucket_width;
+    }
+
+
+
+    template <typename InputType>
+    void
+    DecimatedTrace<InputType>::
+    write_gnuplot (std::ostream &&output_stream) const
+    {
+      const auto trace = get();
+
+      if (trace.size() > 0)
+        for (std::size_t b=0; b<trace[0].size(); ++b)
+          {
+            output_stream << trace[0][b].first_sample_index;
+            for (std::size_t c=0; c<trace.size(); ++c)
+              output_stream << ' ' << trace[c][b].min
+                            << ' ' << trace[c][b].max
+                            << ' ' << trace[c][b].mean;
+            output_stream << '\n';
+          }
+
+      output_stream << std::flush;
+    }
+  }
+}
+
+#endif
@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_CONSUMERS_HISTOGRAM_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 
 #include <mutex>
@@ -196,6 +197,25 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Like get(), but write the histogram into `result`, reusing its memory
+         * if it already has as many entries as there are bins. See the
+         * documentation of the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the histogram in the form returned by get(). This
+         * class only stores the bin counts, so every call copies the boundaries
+         * and counts of all bins into a scratch object -- a cost proportional
+         * to the number of bins, though without allocating memory after the
+         * first call. See the Consumer class for the general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
         /**
          * Write the histogram into a file in such a way that it can
          * be visualized using the Gnuplot program. Internally, this function
@@ -226,7 +246,12 @@ namespace SampleFlow
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * A scratch object used by visit().
+         */
+        mutable value_type visit_scratch;
 
         /**
          * A variable that describes the left end points of each of the
@@ -251,6 +276,14 @@ namespace SampleFlow
          * abort.
          */
         unsigned int bin_number (const double value) const;
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the mutex.
+         */
+        void
+        assemble (value_type &result) const;
     };
 
 
@@ -267,6 +300,8 @@ namespace SampleFlow
       interval_points(n_bins+1),
       bins (n_bins)
     {
+      this->register_single_writer_mutex (mutex);
+
       assert (min_value < max_value);
 
       // Set up the break points between the bins:
@@ -292,6 +327,8 @@ namespace SampleFlow
       interval_points(n_bins+1),
       bins (n_bins)
     {
+      this->register_single_writer_mutex (mutex);
+
       assert (min_pre_value < max_pre_value);
 
       // Set up the break points between the bins:
@@ -322,7 +359,9 @@ namespace SampleFlow
                                        static_cast<int>(ParallelMode::asynchronous))),
       interval_points(o.interval_points),
       bins (o.bins)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -349,38 +388,63 @@ namespace SampleFlow
 
       if (bin >= 0  &&  bin < bins.size())
         {
-          std::lock_guard<std::mutex> lock(mutex);
+          std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
           ++bins[bin];
         }
     }
 
 
 
+    template <typename InputType>
+    void
+    Histogram<InputType>::
+    assemble (value_type &result) const
+    {
+      if (result.size() != bins.size())
+        result.resize (bins.size());
+
+      for (unsigned int bin=0; bin<bins.size(); ++bin)
+        result[bin] = std::make_tuple (interval_points[bin],
+                                       interval_points[bin+1],
+                                       bins[bin]);
+    }
+
+
+
     template <typename InputType>
     typename Histogram<InputType>::value_type
     Histogram<InputType>::
     get () const
     {
-      // First create the output table and breakpoints. We can do
-      // this without holding the lock since we're not accessing
-      // information that is subject to change when a new sample
-      // comes in.
-      value_type return_value (bins.size());
-      for (unsigned int bin=0; bin<bins.size(); ++bin)
-        {
-          std::get<0>(return_value[bin]) = interval_points[bin];
-          std::get<1>(return_value[bin]) = interval_points[bin+1];
-        }
+      value_type result;
+      get_into (result);
+      return result;
+    }
 
-      // Now fill the bin sizes under a lock as they are subject to
-      // change from other threads:
-      std::lock_guard<std::mutex> lock(mutex);
-      for (unsigned int bin=0; bin<bins.size(); ++bin)
-        {
-          std::get<2>(return_value[bin]) = bins[bin];
-        }
 
-      return return_value;
+
+    template <typename InputType>
+    void
+    Histogram<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    Histogram<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
     }
 
 
@@ -17,6 +17,8 @@
 #define SAMPLEFLOW_CONSUMERS_LAST_SAMPLE_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
+#include <sampleflow/types.h>
 #include <mutex>
 
 
@@ -43,9 +45,17 @@ namespace SampleFlow
       public:
         /**
          * The type of the information generated by this class, i.e., the type
-         * of the object returned by get(). This is of course the InputType.
+         * of the object returned by get(). This is the InputType, unless the
+         * InputType is a non-owning type such as types::Span, in which case
+         * the last sample is copied into an object of type
+         * types::StorageType<InputType>.
          */
-        using value_type = InputType;
+        using value_type = types::StorageType<InputType>;
+
+        /**
+         * Constructor.
+         */
+        LastSample ();
 
         /**
          * Destructor. This function also makes sure that all samples this
@@ -79,21 +89,47 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Like get(), but write the last sample into `result`, reusing its
+         * memory if it already has the correct size. See the documentation of
+         * the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with a reference to the stored copy of the last
+         * sample, without copying it again. See the Consumer class for the
+         * general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
          * The value of the last sample seen by consume().
          */
-        InputType last_sample;
+        value_type last_sample;
     };
 
 
 
+    template <typename InputType>
+    LastSample<InputType>::
+    LastSample ()
+    {
+      this->register_single_writer_mutex (mutex);
+    }
+
+
+
     template <typename InputType>
     LastSample<InputType>::
     ~LastSample ()
@@ -108,9 +144,9 @@ namespace SampleFlow
     LastSample<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
-      last_sample = std::move (sample);
+      last_sample = Utilities::to_storage (std::move (sample));
     }
 
 
@@ -120,11 +156,35 @@ namespace SampleFlow
     LastSample<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
 
       return last_sample;
     }
 
+
+
+    template <typename InputType>
+    void
+    LastSample<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      result = last_sample;
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    LastSample<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visitor (last_sample);
+    }
   }
 }
 
@@ -0,0 +1,757 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_CONSUMERS_MARGINAL_HISTOGRAMS_H
+#define SAMPLEFLOW_CONSUMERS_MARGINAL_HISTOGRAMS_H
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <tuple>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <cassert>
+
+
+namespace SampleFlow
+{
+  namespace Consumers
+  {
+    /**
+     * A Consumer class that computes histograms of all components of
+     * vector-valued samples at once, i.e., the histograms of all
+     * one-dimensional marginal distributions. The same could be achieved by
+     * connecting one Filters::ComponentSplitter and one Histogram object
+     * per component to the producer, but for $d$ components this requires
+     * $d$ signal invocations, $d$ copies of each sample, and locking $d$
+     * mutexes per sample. In contrast, this class stores the counts of all
+     * histograms in a single, contiguous $d\times n_\text{bins}$ array and
+     * processes all components of a sample in one pass: It first computes
+     * the bin indices of all components in a simple loop over contiguous
+     * arrays of left end points and inverse bin widths (which compilers can
+     * vectorize), and then increments the corresponding counts.
+     *
+     * All components use the same number of bins, and all bins of one
+     * component have the same width. The ranges covered by the histograms
+     * can either be provided per component, or they can be determined
+     * automatically:
+     * - If ranges are given, samples whose components lie outside the
+     *   range of that component are simply not counted for that component,
+     *   as in the Histogram class.
+     * - If ranges are determined automatically, the class first collects
+     *   a number of calibration samples and then chooses for each
+     *   component a range that covers the values of these samples (plus a
+     *   small margin). Later, if a component of a sample lies outside the
+     *   range of its histogram, then that histogram's range is doubled
+     *   towards the side of the sample and pairs of adjacent bins are
+     *   merged, as many times as necessary. This way, the histograms
+     *   always count every sample exactly, while the number of bins stays
+     *   fixed. (For this to work, the number of bins needs to be even.)
+     *   If fewer calibration samples than requested have been received
+     *   when the producer calls flush(), then the ranges are chosen
+     *   based on the samples received so far.
+     *
+     * In either case, components that are not finite (i.e., infinities or
+     * NaNs) are never counted, and the adaptive ranges are only based on
+     * finite values.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * consume() member function can be called concurrently and from multiple
+     * threads. To avoid contention in asynchronous mode, the counts are
+     * kept in several "shards", each with its own array of counts and its
+     * own mutex; each thread adds its samples to a shard determined by its
+     * thread id, and get() adds up the counts of all shards. The ranges of
+     * the histograms are shared by all shards; if they need to grow, then
+     * the locks of all shards are acquired so that all shards can be
+     * rebinned consistently.
+     *
+     * Because the shards have their own mutexes, this class does not
+     * register a Utilities::SingleWriterMutex with the base class. Calling
+     * Consumer::declare_single_producer(), or using ParallelMode::ingestion, is
+     * therefore allowed but does not make consume() any cheaper.
+     *
+     *
+     * @tparam InputType The C++ type used for the samples $x_k$ processed
+     *   by this class. The functions Utilities::size() and
+     *   Utilities::get_nth_element() need to work for this type, and the
+     *   elements of samples need to be convertible to `double`.
+     */
+    template <typename InputType>
+    class MarginalHistograms : public Consumer<InputType>
+    {
+      public:
+        /**
+         * The type of the information generated by this class, i.e., the type
+         * of the object returned by get(). This is a vector with one element
+         * per component of the samples; each of these elements has the same
+         * format as the data returned by Histogram::get(), i.e., it is a
+         * vector of triplets (left end point, right end point, number of
+         * samples), one for each bin.
+         */
+        using value_type = std::vector<std::vector<std::tuple<double,double,types::sample_index>>>;
+
+        /**
+         * Constructor for histograms with fixed, given ranges.
+         *
+         * This class does not care in which order samples are processed, and
+         * consequently calls the base class constructor with
+         * `ParallelMode::synchronous | ParallelMode::asynchronous` as argument.
+         *
+         * @param[in] min_values The left end points of the ranges over which
+         *   histograms are to be generated, one for each component of the
+         *   samples.
+         * @param[in] max_values The right end points of the ranges, one for
+         *   each component.
+         * @param[in] n_bins The number of bins of each histogram.
+         * @param[in] n_shards The number of separate arrays of counts; see
+         *   the discussion of the threading model in the class
+         *   documentation. If zero, use the number of hardware threads.
+         */
+        MarginalHistograms (const std::vector<double> &min_values,
+                            const std::vector<double> &max_values,
+                            const unsigned int n_bins,
+                            const unsigned int n_shards = 0);
+
+        /**
+         * Constructor for histograms whose ranges are determined
+         * automatically, as described in the class documentation.
+         *
+         * @param[in] n_bins The number of bins of each histogram. Must be
+         *   even.
+         * @param[in] n_calibration_samples The number of samples used to
+         *   choose the initial ranges of the histograms.
+         * @param[in] n_shards The number of separate arrays of counts. If
+         *   zero, use the number of hardware threads.
+         */
+        MarginalHistograms (const unsigned int n_bins,
+                            const types::sample_index n_calibration_samples = 100,
+                            const unsigned int n_shards = 0);
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~MarginalHistograms ();
+
+        /**
+         * Process one sample by updating the histograms of all of its
+         * components.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class does not know what to do with any such data and consequently
+         *   simply ignores it.
+         */
+        virtual
+        void
+        consume (InputType sample, AuxiliaryData aux_data) override;
+
+        /**
+         * Wait for all samples to be processed (by calling the base class
+         * function) and, if the ranges of the histograms are to be determined
+         * automatically but calibration has not finished yet, determine
+         * them from the samples received so far.
+         */
+        virtual
+        void
+        flush () override;
+
+        /**
+         * Return the histograms in the format discussed in the documentation
+         * of the `value_type` type. If no samples have been processed (or
+         * calibration has not finished), the returned object is empty.
+         */
+        value_type
+        get () const;
+
+        /**
+         * Like get(), but write the histograms into `result`, reusing its
+         * memory if it already has the correct size. See the documentation of
+         * the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the histograms in the form returned by get().
+         * Since the counts are spread over several shards, every call adds them
+         * up in a scratch object while holding the locks of all shards. See the
+         * Consumer class for the general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
+        /**
+         * Return the number of samples in each bin, as a contiguous array
+         * in which the $n_\text{bins}$ counts of component zero come first,
+         * followed by those of component one, etc.
+         */
+        std::vector<types::sample_index>
+        get_counts () const;
+
+      private:
+        /**
+         * The number of bins per component, and whether the ranges are
+         * determined automatically.
+         */
+        const unsigned int n_bins;
+        const bool adaptive_ranges;
+
+        /**
+         * The number of components of the samples. Zero until the ranges
+         * have been set up.
+         */
+        unsigned int n_components;
+
+        /**
+         * For each component, the left end point of the histogram's range,
+         * the width of each bin, and its inverse. These arrays are only
+         * changed while holding the locks of all shards.
+         */
+        std::vector<double> left_end_points;
+        std::vector<double> bin_widths;
+        std::vector<double> inverse_bin_widths;
+
+        /**
+         * A structure that represents the counts of one shard, along with
+         * a mutex guarding them and some scratch space.
+         */
+        struct Shard
+        {
+          std::mutex mutex;
+          std::vector<types::sample_index> counts;
+          std::vector<double> values;
+          std::vector<long> bins;
+        };
+
+        /**
+         * The shards. They are stored via pointers because mutexes can not
+         * be moved.
+         */
+        std::vector<std::unique_ptr<Shard> > shards;
+
+        /**
+         * A class that acquires the locks of all shards (in a fixed order)
+         * in its constructor, and releases them in its destructor. Unlike
+         * a vector of `std::unique_lock` objects, this does not require
+         * allocating memory.
+         */
+        class AllShardsLock
+        {
+          public:
+            AllShardsLock (const std::vector<std::unique_ptr<Shard> > &shards)
+              : shards (shards)
+            {
+              for (auto &s : shards)
+                s->mutex.lock();
+            }
+
+            ~AllShardsLock ()
+            {
+              for (auto s = shards.rbegin(); s != shards.rend(); ++s)
+                (*s)->mutex.unlock();
+            }
+
+          private:
+            const std::vector<std::unique_ptr<Shard> > &shards;
+        };
+
+        /**
+         * A scratch object used by visit(). It is protected by the locks of
+         * all shards.
+         */
+        mutable value_type visit_scratch;
+
+        /**
+         * Data for the calibration phase: The number of samples to be
+         * collected, the values of the samples collected so far (stored
+         * one after the other), a flag indicating whether calibration has
+         * finished, and a mutex guarding the calibration data.
+         */
+        const types::sample_index n_calibration_samples;
+        std::vector<double> calibration_values;
+        std::atomic<bool> calibrated;
+        mutable std::mutex calibration_mutex;
+
+        /**
+         * Choose ranges based on the samples collected during calibration,
+         * set up the counts, and count the calibration samples. Must be
+         * called while holding the calibration mutex.
+         */
+        void
+        finish_calibration ();
+
+        /**
+         * Count a sample whose components are stored in `shard.values`. Must
+         * be called while holding the lock of the given shard, which is
+         * released (and possibly re-acquired) by this function.
+         */
+        void
+        count (Shard &shard,
+               std::unique_lock<std::mutex> &lock);
+
+        /**
+         * Double the range of the histogram of component `c` towards the
+         * given value until it contains the value, merging pairs of bins
+         * in all shards. Must be called while holding the locks of all
+         * shards.
+         */
+        void
+        grow_range (const unsigned int c,
+                    const double value);
+
+        /**
+         * Return the shard that the calling thread should use.
+         */
+        Shard &
+        get_shard () const;
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the locks of all shards.
+         */
+        void
+        assemble (value_type &result) const;
+    };
+
+
+
+    template <typename InputType>
+    MarginalHistograms<InputType>::
+    MarginalHistograms (const std::vector<double> &min_values,
+                        const std::vector<double> &max_values,
+                        const unsigned int n_bins,
+                        const unsigned int n_shards)
+      :
+      Consumer<InputType>(ParallelMode(static_cast<int>(ParallelMode::synchronous)
+                                       |
+                                       static_cast<int>(ParallelMode::asynchronous))),
+      n_bins (n_bins),
+      adaptive_ranges (false),
+      n_components (min_values.size()),
+      left_end_points (min_values),
+      bin_widths (min_values.size()),
+      inverse_bin_widths (min_values.size()),
+      n_calibration_samples (0),
+      calibrated (true)
+    {
+      assert (n_bins > 0);
+      assert (min_values.size() == max_values.size());
+
+      for (unsigned int c=0; c<n_components; ++c)
+        {
+          assert (min_values[c] < max_values[c]);
+          bin_widths[c] = (max_values[c] - min_values[c]) / n_bins;
+          inverse_bin_widths[c] = 1. / bin_widths[c];
+        }
+
+      const unsigned int n = (n_shards == 0 ?
+                              std::max (1U, std::thread::hardware_concurrency()) :
+                              n_shards);
+      for (unsigned int s=0; s<n; ++s)
+        {
+          shards.emplace_back (new Shard());
+          shards.back()->counts.resize (n_components * n_bins, 0);
+        }
+    }
+
+
+
+    template <typename InputType>
+    MarginalHistograms<InputType>::
+    MarginalHistograms (const unsigned int n_bins,
+                        const types::sample_index n_calibration_samples,
+                        const unsigned int n_shards)
+      :
+      Consumer<InputType>(ParallelMode(static_cast<int>(ParallelMode::synchronous)
+                                       |
+                                       static_cast<int>(ParallelMode::asynchronous))),
+      n_bins (n_bins),
+      adaptive_ranges (true),
+      n_components (0),
+      n_calibration_samples (n_calibration_samples),
+      calibrated (false)
+    {
+      assert (n_bins > 0);
+      assert (n_bins % 2 == 0);
+      assert (n_calibration_samples > 0);
+
+      const unsigned int n = (n_shards == 0 ?
+                              std::max (1U, std::thread::hardware_concurrency()) :
+                              n_shards);
+      for (unsigned int s=0; s<n; ++s)
+        shards.emplace_back (new Shard());
+    }
+
+
+
+    template <typename InputType>
+    MarginalHistograms<InputType>::
+    ~MarginalHistograms ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    void
+    MarginalHistograms<InputType>::
+    consume (InputType sample, AuxiliaryData /*aux_data*/)
+    {
+      // As long as we are still calibrating, just store the sample. We
+      // need to check the flag again after acquiring the lock, since
+      // another thread may have finished calibration in between.
+      if (calibrated.load(std::memory_order_acquire) == false)
+        {
+          std::lock_guard<std::mutex> lock(calibration_mutex);
+          if (calibrated.load(std::memory_order_relaxed) == false)
+            {
+              const unsigned int size = Utilities::size(sample);
+              if (n_components == 0)
+                n_components = size;
+              assert (size == n_components);
+
+              for (unsigned int c=0; c<size; ++c)
+                calibration_values.push_back (Utilities::get_nth_element(sample, c));
+
+              if (calibration_values.size() == n_calibration_samples * n_components)
+                finish_calibration ();
+
+              return;
+            }
+        }
+
+      // Otherwise copy the components of the sample into the scratch space
+      // of our shard and count them:
+      Shard &shard = get_shard();
+      std::unique_lock<std::mutex> lock(shard.mutex);
+
+      assert (Utilities::size(sample) == n_components);
+      shard.values.resize (n_components);
+      for (unsigned int c=0; c<n_components; ++c)
+        shard.values[c] = Utilities::get_nth_element(sample, c);
+
+      count (shard, lock);
+    }
+
+
+
+    template <typename InputType>
+    void
+    MarginalHistograms<InputType>::
+    count (Shard &shard,
+           std::unique_lock<std::mutex> &lock)
+    {
+      // First compute the bin indices of all components. This loop only
+      // works on contiguous arrays of doubles and can be vectorized.
+      // Converting a double to an integer is undefined if the value does
+      // not fit, so compare the scaled offset against the range of bins
+      // while it is still a double, and mark values that are out of range
+      // with -1. This includes infinities and NaNs (for which all
+      // comparisons are false). Offsets in the range are non-negative,
+      // and so the conversion rounds down.
+      const double *values = shard.values.data();
+      const double *left   = left_end_points.data();
+      const double *inverse_widths = inverse_bin_widths.data();
+      const double n_bins_as_double = n_bins;
+      shard.bins.resize (n_components);
+      long *bins = shard.bins.data();
+      for (unsigned int c=0; c<n_components; ++c)
+        {
+          const double offset = (values[c] - left[c]) * inverse_widths[c];
+          bins[c] = ((offset >= 0) && (offset < n_bins_as_double)
+                     ?
+                     static_cast<long>(offset)
+                     :
+                     -1);
+        }
+
+      // Then increment the counts. Components that are out of range are
+      // either ignored or, if we are to adapt ranges, collected for later.
+      // Non-finite values are always ignored.
+      std::vector<unsigned int> out_of_range;
+      for (unsigned int c=0; c<n_components; ++c)
+        if (bins[c] >= 0)
+          ++shard.counts[c*n_bins + bins[c]];
+        else if (adaptive_ranges && std::isfinite(values[c]))
+          out_of_range.push_back (c);
+
+      if (out_of_range.size() == 0)
+        return;
+
+      // If some components were out of range, then we need to grow the
+      // ranges. This requires acquiring the locks of all shards, which we
+      // need to do in a fixed order to avoid deadlocks; so release our own
+      // lock first and then acquire all of them.
+      std::vector<double> out_of_range_values;
+      for (const unsigned int c : out_of_range)
+        out_of_range_values.push_back (values[c]);
+      lock.unlock();
+
+      AllShardsLock all_locks (shards);
+
+      for (unsigned int i=0; i<out_of_range.size(); ++i)
+        {
+          const unsigned int c = out_of_range[i];
+          grow_range (c, out_of_range_values[i]);
+
+          // The value is now within the range, but round-off may still
+          // put it just outside, so clamp before converting to an integer
+          // (in a way that also maps a NaN offset to a valid bin):
+          const double offset = (out_of_range_values[i] - left_end_points[c])
+                                * inverse_bin_widths[c];
+          const unsigned int bin
+            = static_cast<unsigned int>(offset > 0 ? std::min (offset, n_bins-1.) : 0.);
+          ++shard.counts[c*n_bins + bin];
+        }
+    }
+
+
+
+    template <typename InputType>
+    void
+    MarginalHistograms<InputType>::
+    grow_range (const unsigned int c,
+                const double value)
+    {
+      while (true)
+        {
+          const double left  = left_end_points[c];
+          const double right = left + n_bins*bin_widths[c];
+          if ((value >= left) && (value < right))
+            return;
+
+          // Double the range towards the value. If we grow to the left,
+          // the old bins end up in the right half of the new ones and
+          // vice versa.
+          const bool grow_left = (value < left);
+          const unsigned int offset = (grow_left ? n_bins/2 : 0);
+          for (auto &shard : shards)
+            {
+              types::sample_index *counts = &shard->counts[c*n_bins];
+              std::vector<types::sample_index> merged (n_bins, 0);
+              for (unsigned int b=0; b<n_bins/2; ++b)
+                merged[offset + b] = counts[2*b] + counts[2*b+1];
+              std::copy (merged.begin(), merged.end(), counts);
+            }
+
+          if (grow_left)
+            left_end_points[c] = right - 2*(right-left);
+          bin_widths[c] *= 2;
+          inverse_bin_widths[c] = 1. / bin_widths[c];
+        }
+    }
+
+
+
+    template <typename InputType>
+    void
+    MarginalHistograms<InputType>::
+    finish_calibration ()
+    {
+      assert (calibrated == false);
+      assert (n_components > 0);
+
+      const std::size_t n_samples = calibration_values.size() / n_components;
+
+      // Choose the range of each component so that it covers all
+      // (finite) calibration samples, plus a margin of 5% on either side.
+      // If a component has no finite values at all, center the range
+      // at zero.
+      left_end_points.resize (n_components);
+      bin_widths.resize (n_components);
+      inverse_bin_widths.resize (n_components);
+      for (unsigned int c=0; c<n_components; ++c)
+        {
+          double min_value = std::numeric_limits<double>::infinity();
+          double max_value = -std::numeric_limits<double>::infinity();
+          for (std::size_t k=0; k<n_samples; ++k)
+            if (std::isfinite (calibration_values[k*n_components + c]))
+              {
+                min_value = std::min (min_value, calibration_values[k*n_components + c]);
+                max_value = std::max (max_value, calibration_values[k*n_components + c]);
+              }
+          if (min_value > max_value)
+            min_value = max_value = 0;
+
+          const double margin = (max_value > min_value ?
+                                 0.05 * (max_value - min_value) :
+                                 0.5);
+          left_end_points[c] = min_value - margin;
+          bin_widths[c] = (max_value - min_value + 2*margin) / n_bins;
+          inverse_bin_widths[c] = 1. / bin_widths[c];
+        }
+
+      for (auto &shard : shards)
+        shard->counts.resize (n_components * n_bins, 0);
+
+      // Then count the calibration samples into the first shard. Nobody
+      // else can access the shards until we set the flag below, but the
+      // count() function expects a lock anyway.
+      Shard &shard = *shards[0];
+      std::unique_lock<std::mutex> lock(shard.mutex);
+      for (std::size_t k=0; k<n_samples; ++k)
+        {
+          shard.values.assign (calibration_values.begin() + k*n_components,
+                               calibration_values.begin() + (k+1)*n_components);
+          count (shard, lock);
+          if (lock.owns_lock() == false)
+            lock.lock();
+        }
+
+      calibration_values.clear();
+      calibration_values.shrink_to_fit();
+      calibrated.store (true, std::memory_order_release);
+    }
+
+
+
+    template <typename InputType>
+    void
+    MarginalHistograms<InputType>::
+    flush ()
+    {
+      Consumer<InputType>::flush();
+
+      std::lock_guard<std::mutex> lock(calibration_mutex);
+      if ((calibrated == false) && (calibration_values.size() > 0))
+        finish_calibration ();
+    }
+
+
+
+    template <typename InputType>
+    typename MarginalHistograms<InputType>::Shard &
+    MarginalHistograms<InputType>::
+    get_shard () const
+    {
+      const std::size_t s = std::hash<std::thread::id>()(std::this_thread::get_id()) % shards.size();
+      return *shards[s];
+    }
+
+
+
+    template <typename InputType>
+    std::vector<types::sample_index>
+    MarginalHistograms<InputType>::
+    get_counts () const
+    {
+      if (calibrated == false)
+        return {};
+
+      // Acquire all locks so that we see a consistent state even if
+      // ranges change concurrently:
+      AllShardsLock all_locks (shards);
+
+      std::vector<types::sample_index> counts (n_components * n_bins, 0);
+      for (const auto &shard : shards)
+        for (std::size_t i=0; i<counts.size(); ++i)
+          counts[i] += shard->counts[i];
+
+      return counts;
+    }
+
+
+
+    template <typename InputType>
+    void
+    MarginalHistograms<InputType>::
+    assemble (value_type &result) const
+    {
+      result.resize (n_components);
+      for (unsigned int c=0; c<n_components; ++c)
+        {
+          result[c].resize (n_bins);
+          for (unsigned int b=0; b<n_bins; ++b)
+            {
+              types::sample_index n_samples = 0;
+              for (const auto &shard : shards)
+                n_samples += shard->counts[c*n_bins + b];
+
+              result[c][b] = std::make_tuple (left_end_points[c] + b*bin_widths[c],
+                                              left_end_points[c] + (b+1)*bin_widths[c],
+                                              n_samples);
+            }
+        }
+    }
+
+
+
+    template <typename InputType>
+    typename MarginalHistograms<InputType>::value_type
+    MarginalHistograms<InputType>::
+    get () const
+    {
+      value_type histograms;
+      get_into (histograms);
+      return histograms;
+    }
+
+
+
+    template <typename InputType>
+    void
+    MarginalHistograms<InputType>::
+    get_into (value_type &result) const
+    {
+      if (calibrated == false)
+        {
+          result.clear ();
+          return;
+        }
+
+      AllShardsLock lock (shards);
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    MarginalHistograms<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      if (calibrated == false)
+        {
+          visitor (value_type());
+          return;
+        }
+
+      AllShardsLock lock (shards);
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
+    }
+
+  }
+}
+
+#endif
@@ -17,6 +17,8 @@
 #define SAMPLEFLOW_CONSUMERS_MAXIMUM_PROBABILITY_SAMPLE_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
+#include <sampleflow/types.h>
 #include <mutex>
 
 
@@ -53,9 +55,12 @@ namespace SampleFlow
         /**
          * The type of the information generated by this class. Here, this
          * is a pair of InputType, the data type used to represent samples,
-         * and the AuxiliaryData that was attached to this sample.
+         * and the AuxiliaryData that was attached to this sample. (If
+         * InputType is a non-owning type such as types::Span, then the
+         * first element of the pair is a copy of type
+         * types::StorageType<InputType> instead.)
          */
-        using value_type = std::pair<InputType,AuxiliaryData>;
+        using value_type = std::pair<types::StorageType<InputType>,AuxiliaryData>;
 
         /**
          * Constructor.
@@ -105,22 +110,36 @@ namespace SampleFlow
         value_type
         get () const;
 
-      private:
         /**
-         * A mutex used to lock access to all member variables when running
-         * on multiple threads.
+         * Like get(), but write the most probable sample and its auxiliary data
+         * into `result`, reusing the sample's memory if it already has the
+         * correct size. See the documentation of the Consumer class for the
+         * general contract.
          */
-        mutable std::mutex mutex;
+        void
+        get_into (value_type &result) const;
 
         /**
-         * The currently most likely sample.
+         * Call `visitor` with a reference to the stored most probable sample
+         * and its auxiliary data, without copying them. See the Consumer class
+         * for the general contract.
          */
-        InputType          current_most_likely_sample;
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
 
+      private:
         /**
-         * The auxiliary data associated with the currently most likely sample.
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
          */
-        AuxiliaryData      current_most_likely_sample_data;
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * The currently most likely sample, along with the auxiliary data
+         * associated with it.
+         */
+        value_type         current_most_likely_sample;
 
         /**
          * The log likelihood of the currently most likely sample. If we have
@@ -140,9 +159,10 @@ namespace SampleFlow
                                        |
                                        static_cast<int>(ParallelMode::asynchronous))),
       current_most_likely_sample (),
-      current_most_likely_sample_data (),
       current_highest_log_likelihood(std::numeric_limits<double>::lowest())
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -166,13 +186,13 @@ namespace SampleFlow
         {
           const double log_likelihood = boost::any_cast<double>(aux_data["relative log likelihood"]);
 
-          std::lock_guard<std::mutex> lock(mutex);
+          std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
           // Check if we have seen any sample at all so far
           if (current_highest_log_likelihood == std::numeric_limits<double>::lowest())
             {
-              current_most_likely_sample = std::move (sample);
-              current_most_likely_sample_data = std::move (aux_data);
+              current_most_likely_sample.first = Utilities::to_storage (std::move (sample));
+              current_most_likely_sample.second = std::move (aux_data);
               current_highest_log_likelihood = log_likelihood;
             }
           else
@@ -180,8 +200,8 @@ namespace SampleFlow
               // We had seen samples before, so check whether this one is better.
               if (log_likelihood > current_highest_log_likelihood)
                 {
-                  current_most_likely_sample = std::move (sample);
-                  current_most_likely_sample_data = std::move (aux_data);
+                  current_most_likely_sample.first = Utilities::to_storage (std::move (sample));
+                  current_most_likely_sample.second = std::move (aux_data);
                   current_highest_log_likelihood = log_likelihood;
                 }
             }
@@ -195,11 +215,35 @@ namespace SampleFlow
     MaximumProbabilitySample<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      return current_most_likely_sample;
+    }
+
+
+
+    template <typename InputType>
+    void
+    MaximumProbabilitySample<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
 
-      return {current_most_likely_sample, current_most_likely_sample_data};
+      result = current_most_likely_sample;
     }
 
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    MaximumProbabilitySample<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visitor (current_most_likely_sample);
+    }
   }
 }
 
@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_CONSUMERS_MEAN_VALUE_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 #include <mutex>
 
@@ -86,9 +87,12 @@ namespace SampleFlow
       public:
         /**
          * The type of the information generated by this class, i.e., in which
-         * the mean value is computed. This is of course the InputType.
+         * the mean value is computed. This is the InputType, unless the
+         * InputType is a non-owning type such as types::Span, in which case
+         * it is a type that stores a copy of the data (see
+         * types::StorageType).
          */
-        using value_type = InputType;
+        using value_type = types::StorageType<InputType>;
 
         /**
          * Constructor.
@@ -131,18 +135,35 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Like get(), but write the mean value into `result`, reusing its
+         * memory if it already has the correct size. See the documentation of
+         * the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with a reference to the running mean value this class
+         * stores, without copying it. See the Consumer class for the general
+         * contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
       private:
         /**
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
          * The current value of $\bar x_k$ as described in the introduction
          * of this class.
          */
-        InputType           current_mean;
+        value_type          current_mean;
 
         /**
          * The number of samples processed so far.
@@ -160,7 +181,9 @@ namespace SampleFlow
                                        |
                                        static_cast<int>(ParallelMode::asynchronous))),
       n_samples (0)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -178,14 +201,14 @@ namespace SampleFlow
     MeanValue<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       // If this is the first sample we see, initialize the current-mean with
       // this sample.
       if (n_samples == 0)
         {
           n_samples = 1;
-          current_mean = std::move(sample);
+          current_mean = Utilities::to_storage(std::move(sample));
         }
       else
         {
@@ -193,7 +216,7 @@ namespace SampleFlow
           // sample.
           ++n_samples;
 
-          InputType update = std::move(sample);
+          value_type update = Utilities::to_storage(std::move(sample));
           update -= current_mean;
           update /= n_samples;
 
@@ -208,11 +231,35 @@ namespace SampleFlow
     MeanValue<InputType>::
     get () const
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
 
       return current_mean;
     }
 
+
+
+    template <typename InputType>
+    void
+    MeanValue<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      result = current_mean;
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    MeanValue<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visitor (current_mean);
+    }
   }
 }
 
@@ -0,0 +1,447 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+#ifndef SAMPLEFLOW_CONSUMERS_MODE_DISCOVERY_H
+#define SAMPLEFLOW_CONSUMERS_MODE_DISCOVERY_H
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  namespace Consumers
+  {
+    /**
+     * A Consumer class that, while samples are being generated, tries to
+     * identify the modes of the distribution the samples are drawn from, and
+     * how often the chain moves from one mode to another. This is useful
+     * because Markov chain samplers often get stuck in one mode of a
+     * multimodal distribution; if that is the case, then one sees only very
+     * few (or no) transitions between modes. Finding this out otherwise
+     * requires storing all samples and clustering them after the fact.
+     *
+     * The class implements a streaming variant of the k-means algorithm
+     * ("sequential leader clustering" combined with MacQueen's online update
+     * of cluster centers): Each incoming sample $x_k$ is assigned to the
+     * closest existing mode center $c_j$. If the distance between the two is
+     * larger than the `new_mode_distance` given to the constructor, and if
+     * fewer than `max_n_modes` modes have been found so far, then the sample
+     * instead starts a new mode with center $x_k$. Otherwise, the center of
+     * the mode it is assigned to is moved towards the sample via
+     * $c_j \leftarrow c_j + \frac{1}{n_j}(x_k-c_j)$ where $n_j$ is the number
+     * of samples assigned to mode $j$ so far, so that $c_j$ is the mean
+     * of all samples assigned to the mode. The class also counts how often
+     * a sample assigned to mode $i$ is followed by one assigned to mode $j$.
+     *
+     * The memory used by this class is independent of the number of samples,
+     * namely ${\cal O}(kd + k^2)$ where $k$ is `max_n_modes` and $d$ the
+     * number of components of the samples, and processing one sample costs
+     * ${\cal O}(kd)$ operations.
+     *
+     * It is often useful to not cluster the samples themselves, but only a
+     * few of their components or some other low-dimensional quantity derived
+     * from them, for example because only some of the parameters are
+     * suspected of being multimodal, or because distances between samples
+     * are not meaningful in all components equally. To this end, the
+     * constructor takes an optional function that maps each sample to the
+     * vector of numbers that are then clustered. By default, all components
+     * of the sample are used.
+     *
+     * Note that the modes found by this algorithm depend on the order of
+     * the samples, and on the choice of `new_mode_distance`: it should be
+     * larger than the typical width of a mode, but smaller than the distance
+     * between modes.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * consume() member function can be called concurrently and from multiple
+     * threads. However, because transitions between modes only make sense
+     * for samples processed in the order in which they were produced, the
+     * class only supports synchronous processing.
+     *
+     *
+     * @tparam InputType The C++ type used for the samples $x_k$. If no
+     *   projection function is given to the constructor, then it needs to be
+     *   possible to access the elements of samples via
+     *   Utilities::get_nth_element(), and these elements need to be
+     *   convertible to `double`.
+     */
+    template <typename InputType>
+    class ModeDiscovery : public Consumer<InputType>
+    {
+      public:
+        /**
+         * A structure that describes one of the modes found.
+         */
+        struct Mode
+        {
+          /**
+           * The center of the mode, i.e., the mean value of the (projected)
+           * samples assigned to it.
+           */
+          std::vector<double> location;
+
+          /**
+           * The number of samples assigned to this mode, and the fraction of
+           * all samples this corresponds to.
+           */
+          types::sample_index n_samples;
+          double              weight;
+        };
+
+        /**
+         * The type of the information generated by this class, i.e., the type
+         * of the object returned by get(). It is a vector with one element
+         * for each mode found so far, in the order in which they were found.
+         */
+        using value_type = std::vector<Mode>;
+
+        /**
+         * Constructor.
+         *
+         * @param[in] max_n_modes The maximal number of modes the class tries
+         *   to identify.
+         * @param[in] new_mode_distance The distance a (projected) sample needs
+         *   to have from all existing mode centers to start a new mode.
+         * @param[in] projection A function that maps each sample to the
+         *   vector of numbers used in clustering. All of these vectors need
+         *   to have the same length. If this argument is not given, the
+         *   components of the sample are used.
+         */
+        ModeDiscovery (const unsigned int max_n_modes,
+                       const double new_mode_distance,
+                       const std::function<std::vector<double> (const InputType &)> &projection
+                       = std::function<std::vector<double> (const InputType &)>());
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~ModeDiscovery ();
+
+        /**
+         * Process one sample by assigning it to a mode, and updating the
+         * center of that mode as well as the transition counts.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class does not know what to do with any such data and consequently
+         *   simply ignores it.
+         */
+        virtual
+        void
+        consume (InputType sample, AuxiliaryData aux_data) override;
+
+        /**
+         * Return the modes found so far.
+         */
+        value_type
+        get () const;
+
+        /**
+         * Like get(), but write the modes discovered so far into `result`,
+         * reusing its memory where possible. See the documentation of the
+         * Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the modes discovered so far. This class stores
+         * the mode centers in one flat array, and every call converts them into
+         * Mode objects in a scratch object. See the Consumer class for the
+         * general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
+        /**
+         * Return a matrix whose $(i,j)$ entry is the number of times a sample
+         * assigned to mode $i$ was followed by a sample assigned to mode $j$.
+         * The matrix has as many rows and columns as modes have been found so
+         * far. Its diagonal entries count how often the chain stayed in a
+         * mode; a chain that is stuck in a mode has (almost) no nonzero
+         * off-diagonal entries in the corresponding row.
+         */
+        std::vector<std::vector<types::sample_index>>
+        get_transition_counts () const;
+
+      private:
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * A scratch object used by visit().
+         */
+        mutable value_type visit_scratch;
+
+        /**
+         * The parameters passed to the constructor.
+         */
+        const unsigned int max_n_modes;
+        const double new_mode_distance;
+        const std::function<std::vector<double> (const InputType &)> projection;
+
+        /**
+         * The number of components of the projected samples, and the number
+         * of modes found so far.
+         */
+        std::size_t  n_components;
+        unsigned int n_modes;
+
+        /**
+         * The centers of all modes, stored one after the other, and the
+         * number of samples assigned to each mode.
+         */
+        std::vector<double>              centers;
+        std::vector<types::sample_index> n_samples_per_mode;
+
+        /**
+         * The transition counts, stored as a `max_n_modes` by `max_n_modes`
+         * matrix in row-major order, and the mode the previous sample was
+         * assigned to.
+         */
+        std::vector<types::sample_index> transition_counts;
+        unsigned int                     previous_mode;
+
+        /**
+         * Return the vector of numbers that are clustered for the given
+         * sample.
+         */
+        std::vector<double>
+        project (const InputType &sample) const;
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the mutex.
+         */
+        void
+        assemble (value_type &result) const;
+    };
+
+
+
+    template <typename InputType>
+    ModeDiscovery<InputType>::
+    ModeDiscovery (const unsigned int max_n_modes,
+                   const double new_mode_distance,
+                   const std::function<std::vector<double> (const InputType &)> &projection)
+      :
+      max_n_modes (max_n_modes),
+      new_mode_distance (new_mode_distance),
+      projection (projection),
+      n_components (0),
+      n_modes (0),
+      n_samples_per_mode (max_n_modes, 0),
+      transition_counts (max_n_modes * max_n_modes, 0),
+      previous_mode (std::numeric_limits<unsigned int>::max())
+    {
+      assert (max_n_modes >= 1);
+      assert (new_mode_distance > 0);
+
+      this->register_single_writer_mutex (mutex);
+    }
+
+
+
+    template <typename InputType>
+    ModeDiscovery<InputType>::
+    ~ModeDiscovery ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    std::vector<double>
+    ModeDiscovery<InputType>::
+    project (const InputType &sample) const
+    {
+      if (projection)
+        return projection (sample);
+      else
+        {
+          std::vector<double> x (Utilities::size(sample));
+          for (std::size_t c=0; c<x.size(); ++c)
+            x[c] = Utilities::get_nth_element (sample, c);
+          return x;
+        }
+    }
+
+
+
+    template <typename InputType>
+    void
+    ModeDiscovery<InputType>::
+    consume (InputType sample, AuxiliaryData /*aux_data*/)
+    {
+      // Compute the projection before acquiring the lock -- it may be
+      // expensive and does not touch any member variables that change:
+      const std::vector<double> x = project (sample);
+
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
+
+      if (n_modes == 0)
+        {
+          n_components = x.size();
+          centers.resize (max_n_modes * n_components);
+        }
+      assert (x.size() == n_components);
+
+      // Find the closest existing mode:
+      unsigned int closest_mode = 0;
+      double       closest_distance_square = std::numeric_limits<double>::max();
+      for (unsigned int m=0; m<n_modes; ++m)
+        {
+          const double *center = &centers[m*n_components];
+          double distance_square = 0;
+          for (std::size_t c=0; c<n_components; ++c)
+            distance_square += (x[c]-center[c]) * (x[c]-center[c]);
+
+          if (distance_square < closest_distance_square)
+            {
+              closest_mode = m;
+              closest_distance_square = distance_square;
+            }
+        }
+
+      // Then either start a new mode, or move the center of the closest
+      // one towards the current sample:
+      unsigned int mode;
+      if ((n_modes < max_n_modes)
+          &&
+          ((n_modes == 0) ||
+           (closest_distance_square > new_mode_distance*new_mode_distance)))
+        {
+          mode = n_modes;
+          ++n_modes;
+
+          for (std::size_t c=0; c<n_components; ++c)
+            centers[mode*n_components+c] = x[c];
+          n_samples_per_mode[mode] = 1;
+        }
+      else
+        {
+          mode = closest_mode;
+          ++n_samples_per_mode[mode];
+
+          double *center = &centers[mode*n_components];
+          for (std::size_t c=0; c<n_components; ++c)
+            center[c] += (x[c]-center[c]) / n_samples_per_mode[mode];
+        }
+
+      if (previous_mode != std::numeric_limits<unsigned int>::max())
+        ++transition_counts[previous_mode*max_n_modes + mode];
+      previous_mode = mode;
+    }
+
+
+
+    template <typename InputType>
+    void
+    ModeDiscovery<InputType>::
+    assemble (value_type &result) const
+    {
+      types::sample_index n_samples = 0;
+      for (unsigned int m=0; m<n_modes; ++m)
+        n_samples += n_samples_per_mode[m];
+
+      result.resize (n_modes);
+      for (unsigned int m=0; m<n_modes; ++m)
+        {
+          result[m].location.assign (centers.begin() + m*n_components,
+                                     centers.begin() + (m+1)*n_components);
+          result[m].n_samples = n_samples_per_mode[m];
+          result[m].weight = 1. * n_samples_per_mode[m] / n_samples;
+        }
+    }
+
+
+
+    template <typename InputType>
+    typename ModeDiscovery<InputType>::value_type
+    ModeDiscovery<InputType>::
+    get () const
+    {
+      value_type result;
+      get_into (result);
+      return result;
+    }
+
+
+
+    template <typename InputType>
+    void
+    ModeDiscovery<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    ModeDiscovery<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
+    }
+
+
+
+    template <typename InputType>
+    std::vector<std::vector<types::sample_index>>
+    ModeDiscovery<InputType>::
+    get_transition_counts () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      std::vector<std::vector<types::sample_index>>
+      counts (n_modes, std::vector<types::sample_index>(n_modes));
+      for (unsigned int i=0; i<n_modes; ++i)
+        for (unsigned int j=0; j<n_modes; ++j)
+          counts[i][j] = transition_counts[i*max_n_modes + j];
+
+      return counts;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,379 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_CONSUMERS_MULTILEVEL_MEAN_VALUE_H
+#define SAMPLEFLOW_CONSUMERS_MULTILEVEL_MEAN_VALUE_H
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+#include <mutex>
+#include <vector>
+#include <complex>
+
+
+namespace SampleFlow
+{
+  namespace Consumers
+  {
+    /**
+     * A Consumer class that computes the multilevel (telescoping-sum)
+     * estimator
+     * @f{align*}{
+     *   \bar x = \sum_{\ell=0}^L \bar Y_\ell,
+     *   \qquad
+     *   \bar Y_\ell = \frac{1}{N_\ell} \sum_{k=1}^{N_\ell} Y_\ell^{(k)},
+     * @f}
+     * of the mean value from samples produced by a multilevel sampler such
+     * as Producers::MultilevelMetropolisHastings. Here, $Y_0^{(k)}=x_0^{(k)}$
+     * are the samples on the coarsest level, and for $\ell\ge 1$,
+     * $Y_\ell^{(k)}=x_\ell^{(k)}-\Theta_{\ell-1}^{(k)}$ is the difference
+     * between a sample on level $\ell$ and the coarse sample it is paired
+     * with.
+     *
+     * The class reads the level of each sample from the AuxiliaryData entry
+     * "level" (of type `unsigned int`) and, for levels $\ell\ge 1$, the
+     * coarse sample from the entry "coarse sample" (of type `InputType`).
+     * Samples without a "level" entry are ignored.
+     *
+     * In addition to the estimator itself, the class keeps track of the
+     * per-level means $\bar Y_\ell$, the number of samples $N_\ell$, and
+     * the sample variances $V_\ell$ of the $Y_\ell$, summed over all
+     * components of the samples (i.e., the trace of the covariance matrix of
+     * the $Y_\ell$). These are the quantities one needs to assess
+     * whether the number of samples per level is appropriate: The variance of
+     * the estimator is (ignoring correlation between samples) equal to
+     * $\sum_\ell V_\ell/N_\ell$.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * consume() member function can be called concurrently and from multiple
+     * threads.
+     *
+     *
+     * @tparam InputType The C++ type used for the samples. The same
+     *   requirements hold as for the MeanValue class; in addition, the
+     *   functions Utilities::size() and Utilities::get_nth_element() must
+     *   be defined for this type so that variances can be computed.
+     */
+    template <typename InputType>
+    class MultilevelMeanValue : public Consumer<InputType>
+    {
+      public:
+        /**
+         * The type of the information generated by this class, i.e., in which
+         * the mean value is computed. This is of course the InputType.
+         */
+        using value_type = InputType;
+
+        /**
+         * Constructor.
+         *
+         * This class does not care in which order samples are processed, and
+         * consequently calls the base class constructor with
+         * `ParallelMode::synchronous | ParallelMode::asynchronous` as argument.
+         */
+        MultilevelMeanValue ();
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~MultilevelMeanValue ();
+
+        /**
+         * Process one sample by updating the mean value and variance of the
+         * level the sample belongs to.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class reads the "level" and "coarse sample" entries from it.
+         */
+        virtual
+        void
+        consume (InputType     sample,
+                 AuxiliaryData aux_data) override;
+
+        /**
+         * Return the telescoping-sum estimator $\sum_\ell \bar Y_\ell$ of
+         * the mean value. If no samples have been processed so far, then a
+         * default-constructed object of type InputType will be returned.
+         */
+        value_type
+        get () const;
+
+        /**
+         * Like get(), but write the telescoping-sum estimate into `result`. See
+         * the documentation of the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the telescoping-sum estimate, which is formed by
+         * adding up the per-level means in a scratch object on every call. See
+         * the Consumer class for the general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
+        /**
+         * Return the per-level means $\bar Y_\ell$.
+         */
+        std::vector<InputType>
+        get_level_means () const;
+
+        /**
+         * Return the per-level variances $V_\ell$, summed over all
+         * components of the samples.
+         */
+        std::vector<double>
+        get_level_variances () const;
+
+        /**
+         * Return the number of samples $N_\ell$ seen on each level.
+         */
+        std::vector<types::sample_index>
+        get_level_sample_counts () const;
+
+      private:
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * A scratch object used by visit().
+         */
+        mutable value_type visit_scratch;
+
+        /**
+         * The current values of $\bar Y_\ell$.
+         */
+        std::vector<InputType> level_means;
+
+        /**
+         * For each level, the sum of squared deviations from the mean,
+         * summed over all components, as used in Welford's algorithm.
+         */
+        std::vector<double> level_sums_of_squares;
+
+        /**
+         * The number of samples processed so far on each level.
+         */
+        std::vector<types::sample_index> level_n_samples;
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the mutex.
+         */
+        void
+        assemble (value_type &result) const;
+    };
+
+
+
+    template <typename InputType>
+    MultilevelMeanValue<InputType>::
+    MultilevelMeanValue ()
+      :
+      Consumer<InputType>(ParallelMode(static_cast<int>(ParallelMode::synchronous)
+                                       |
+                                       static_cast<int>(ParallelMode::asynchronous)))
+    {
+      this->register_single_writer_mutex (mutex);
+    }
+
+
+
+    template <typename InputType>
+    MultilevelMeanValue<InputType>::
+    ~MultilevelMeanValue ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    void
+    MultilevelMeanValue<InputType>::
+    consume (InputType sample, AuxiliaryData aux_data)
+    {
+      const auto level_entry = aux_data.find ("level");
+      if (level_entry == aux_data.end())
+        return;
+      const unsigned int level = boost::any_cast<unsigned int>(level_entry->second);
+
+      // Compute Y_l for this sample. On levels other than the coarsest,
+      // this is the difference to the coarse sample.
+      InputType Y = std::move(sample);
+      if (level > 0)
+        Y -= boost::any_cast<const InputType &>(aux_data["coarse sample"]);
+
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
+
+      if (level >= level_means.size())
+        {
+          level_means.resize (level+1);
+          level_sums_of_squares.resize (level+1, 0.);
+          level_n_samples.resize (level+1, 0);
+        }
+
+      // If this is the first sample on this level, initialize the mean
+      // with it. Otherwise use Welford's update for mean and variance,
+      // component by component for the latter.
+      if (level_n_samples[level] == 0)
+        {
+          level_n_samples[level] = 1;
+          level_means[level] = std::move(Y);
+        }
+      else
+        {
+          ++level_n_samples[level];
+
+          InputType update = Y;
+          update -= level_means[level];
+
+          InputType old_mean = level_means[level];
+          update /= level_n_samples[level];
+          level_means[level] += update;
+
+          for (unsigned int c=0; c<Utilities::size(Y); ++c)
+            level_sums_of_squares[level]
+            += std::real (Utilities::conj(Utilities::get_nth_element(Y, c)
+                                          - Utilities::get_nth_element(old_mean, c))
+                          * (Utilities::get_nth_element(Y, c)
+                             - Utilities::get_nth_element(level_means[level], c)));
+        }
+    }
+
+
+
+    template <typename InputType>
+    void
+    MultilevelMeanValue<InputType>::
+    assemble (value_type &result) const
+    {
+      // Sum up the per-level means, skipping levels that have not seen
+      // any samples so far:
+      bool first = true;
+      for (unsigned int level=0; level<level_means.size(); ++level)
+        if (level_n_samples[level] > 0)
+          {
+            if (first)
+              {
+                result = level_means[level];
+                first = false;
+              }
+            else
+              result += level_means[level];
+          }
+
+      if (first)
+        result = value_type{};
+    }
+
+
+
+    template <typename InputType>
+    typename MultilevelMeanValue<InputType>::value_type
+    MultilevelMeanValue<InputType>::
+    get () const
+    {
+      value_type result;
+      get_into (result);
+      return result;
+    }
+
+
+
+    template <typename InputType>
+    void
+    MultilevelMeanValue<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    MultilevelMeanValue<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
+    }
+
+
+
+    template <typename InputType>
+    std::vector<InputType>
+    MultilevelMeanValue<InputType>::
+    get_level_means () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      return level_means;
+    }
+
+
+
+    template <typename InputType>
+    std::vector<double>
+    MultilevelMeanValue<InputType>::
+    get_level_variances () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      std::vector<double> variances (level_means.size(), 0.);
+      for (unsigned int level=0; level<level_means.size(); ++level)
+        if (level_n_samples[level] > 1)
+          variances[level] = level_sums_of_squares[level] / (level_n_samples[level]-1);
+
+      return variances;
+    }
+
+
+
+    template <typename InputType>
+    std::vector<types::sample_index>
+    MultilevelMeanValue<InputType>::
+    get_level_sample_counts () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      return level_n_samples;
+    }
+
+  }
+}
+
+#endif
@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_CONSUMERS_PAIR_PairHistogram_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/types.h>
 
 #include <boost/numeric/ublas/matrix.hpp>
@@ -225,6 +226,26 @@ namespace SampleFlow
         value_type
         get () const;
 
+        /**
+         * Like get(), but write the histogram into `result`, reusing its memory
+         * if it already has one entry for each of the two-dimensional bins. See
+         * the documentation of the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with the histogram in the form returned by get(). This
+         * class only stores the matrix of bin counts, so every call copies the
+         * boundaries and counts of all bins into a scratch object, at a cost
+         * proportional to the number of bins (but without allocating memory
+         * after the first call). See the Consumer class for the general
+         * contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
         /**
          * Write the PairHistogram into a file in such a way that it can
          * be visualized using the Gnuplot program. Internally, this function
@@ -256,7 +277,12 @@ namespace SampleFlow
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * A scratch object used by visit().
+         */
+        mutable value_type visit_scratch;
 
         /**
          * A variable that describes the left end points of each of the
@@ -283,6 +309,14 @@ namespace SampleFlow
          */
         unsigned int x_bin_number (const double value) const;
         unsigned int y_bin_number (const double value) const;
+
+        /**
+         * Compute the information returned by get() and store it in the
+         * object given as argument, reusing the memory it already owns where
+         * possible. The caller needs to hold the mutex.
+         */
+        void
+        assemble (value_type &result) const;
     };
 
 
@@ -303,6 +337,8 @@ namespace SampleFlow
       y_interval_points(n_y_bins+1),
       bins (n_x_bins, n_y_bins)
     {
+      this->register_single_writer_mutex (mutex);
+
       // First treat the subdivision of the x-axis:
       {
         assert (min_x_value < max_x_value);
@@ -348,6 +384,8 @@ namespace SampleFlow
       y_interval_points(n_y_bins+1),
       bins (n_x_bins, n_y_bins)
     {
+      this->register_single_writer_mutex (mutex);
+
       // Treat the x-axis subdivision:
       {
         assert (min_x_pre_value < max_x_pre_value);
@@ -399,7 +437,9 @@ namespace SampleFlow
       x_interval_points(o.x_interval_points),
       y_interval_points(o.y_interval_points),
       bins (o.bins)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -433,7 +473,7 @@ namespace SampleFlow
           &&
           y_bin >= 0  &&  y_bin < bins.size2())
         {
-          std::lock_guard<std::mutex> lock(mutex);
+          std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
           ++bins(x_bin,y_bin);
         }
@@ -442,35 +482,59 @@ namespace SampleFlow
 
 
     template <typename InputType>
-    typename PairHistogram<InputType>::value_type
+    void
     PairHistogram<InputType>::
-    get () const
+    assemble (value_type &result) const
     {
-      // First create the output table and breakpoints. We can do
-      // this without holding the lock since we're not accessing
-      // information that is subject to change when a new sample
-      // comes in.
-      value_type return_value (bins.size1() * bins.size2());
+      if (result.size() != bins.size1() * bins.size2())
+        result.resize (bins.size1() * bins.size2());
 
       for (unsigned int x_bin=0; x_bin<bins.size1(); ++x_bin)
         for (unsigned int y_bin=0; y_bin<bins.size2(); ++y_bin)
           {
             const unsigned int bin = x_bin * bins.size2() + y_bin;
-            std::get<0>(return_value[bin]) = {x_interval_points[x_bin], y_interval_points[y_bin]};
-            std::get<1>(return_value[bin]) = {x_interval_points[x_bin+1], y_interval_points[y_bin+1]};
+            std::get<0>(result[bin]) = {x_interval_points[x_bin], y_interval_points[y_bin]};
+            std::get<1>(result[bin]) = {x_interval_points[x_bin+1], y_interval_points[y_bin+1]};
+            std::get<2>(result[bin]) = bins(x_bin,y_bin);
           }
+    }
 
-      // Now fill the bin sizes under a lock as they are subject to
-      // change from other threads:
-      std::lock_guard<std::mutex> lock(mutex);
-      for (unsigned int x_bin=0; x_bin<bins.size1(); ++x_bin)
-        for (unsigned int y_bin=0; y_bin<bins.size2(); ++y_bin)
-          {
-            const unsigned int bin = x_bin * bins.size2() + y_bin;
-            std::get<2>(return_value[bin]) = bins(x_bin,y_bin);
-          }
 
-      return return_value;
+
+    template <typename InputType>
+    typename PairHistogram<InputType>::value_type
+    PairHistogram<InputType>::
+    get () const
+    {
+      value_type result;
+      get_into (result);
+      return result;
+    }
+
+
+
+    template <typename InputType>
+    void
+    PairHistogram<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (result);
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    PairHistogram<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      assemble (visit_scratch);
+      visitor (static_cast<const value_type &>(visit_scratch));
     }
 
 
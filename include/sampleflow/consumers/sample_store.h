@@ -0,0 +1,711 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+#ifndef SAMPLEFLOW_CONSUMERS_SAMPLE_STORE_H
+#define SAMPLEFLOW_CONSUMERS_SAMPLE_STORE_H
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+#include <sampleflow/span.h>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/any.hpp>
+
+
+namespace SampleFlow
+{
+  namespace Consumers
+  {
+    /**
+     * A Consumer class that stores all samples it receives in memory, so
+     * that they can later be analyzed again -- for example, to compute a
+     * histogram with different bins after having looked at a first one --
+     * without having to write them to a file via StreamOutput and read
+     * them back in.
+     *
+     * The samples are stored in *columnar* form: For each component of the
+     * samples, there is an array that stores the values of this component
+     * for all samples, and there is one more array for each of the entries
+     * of the AuxiliaryData objects the user has asked to store (see the
+     * constructor). These arrays are split into chunks of a fixed number of
+     * rows so that storing additional samples never needs to copy previously
+     * stored ones. Once a row has been written, it never changes again.
+     *
+     * Samples generated by Markov chain Monte Carlo methods such as
+     * Producers::MetropolisHastings are often repeated many times in a row
+     * (every time a proposed sample is rejected). If requested in the
+     * constructor, this class stores such repeated samples only once,
+     * along with the number of times it has been repeated (its
+     * "multiplicity"). A sample is considered a repetition of the previous
+     * one if all of its components as well as all of its stored auxiliary
+     * data are equal to the previous one's. Such compression is invisible
+     * to users of the class: Sample indices as used by get() and replay()
+     * refer to samples as they were received, not to rows in which they are
+     * stored.
+     *
+     * The stored samples can be accessed in three ways:
+     * - By index, via the get() function.
+     * - By replaying a range of samples into another Consumer object, via
+     *   replay(). This calls the consume() function of that object for each
+     *   sample in the range, in the order in which they were received.
+     * - By handing the columns, one chunk at a time, to user code via
+     *   visit_chunks(). This is the most efficient way to work on many
+     *   samples at once.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * consume() member function can be called concurrently and from multiple
+     * threads, and all of the functions that access the stored samples can
+     * be called while samples are still being added. Since this class cares
+     * about the order in which samples arrive, it only supports synchronous
+     * processing.
+     *
+     *
+     * @tparam InputType The C++ type used for the samples $x_k$. It needs to
+     *   be possible to access the elements of samples via
+     *   Utilities::get_nth_element(), and all samples need to have the same
+     *   number of elements.
+     */
+    template <typename InputType>
+    class SampleStore : public Consumer<InputType>
+    {
+      public:
+        /**
+         * The data type of the elements of the input type.
+         */
+        using scalar_type = types::ScalarType<InputType>;
+
+        /**
+         * The type in which samples are returned by get(). This is the
+         * InputType unless the InputType is a non-owning type such as
+         * types::Span.
+         */
+        using value_type = types::StorageType<InputType>;
+
+      private:
+        /**
+         * A structure that stores a contiguous range of samples.
+         */
+        struct Chunk
+        {
+          /**
+           * The index of the first sample stored in this chunk, and the number
+           * of samples stored in it. If repeated samples are compressed, then
+           * the latter can be larger than the number of rows.
+           */
+          types::sample_index first_sample_index;
+          types::sample_index n_samples;
+
+          /**
+           * The values of each of the components, and of each of the
+           * auxiliary data entries, for all rows of this chunk.
+           */
+          std::vector<std::vector<scalar_type>> columns;
+          std::vector<std::vector<double>>      auxiliary_columns;
+
+          /**
+           * If repeated samples are compressed, the number of samples
+           * represented by each row, and the index (relative to
+           * `first_sample_index`) of the first sample represented by each
+           * row. Otherwise, these arrays are empty.
+           */
+          std::vector<types::sample_index> multiplicities;
+          std::vector<types::sample_index> row_starts;
+        };
+
+      public:
+        /**
+         * A class that provides read-only access to the data stored in one
+         * chunk of rows. Objects of this type are given to the function
+         * passed to visit_chunks().
+         */
+        class ChunkView
+        {
+          public:
+            /**
+             * Constructor.
+             */
+            ChunkView (const Chunk &chunk);
+
+            /**
+             * The index of the first sample stored in this chunk.
+             */
+            types::sample_index
+            first_sample_index () const;
+
+            /**
+             * The number of samples represented by this chunk.
+             */
+            types::sample_index
+            n_samples () const;
+
+            /**
+             * The number of rows of this chunk. This equals n_samples()
+             * unless repeated samples are compressed.
+             */
+            std::size_t
+            n_rows () const;
+
+            /**
+             * The values of the given component for all rows of this chunk.
+             */
+            types::Span<const scalar_type>
+            column (const unsigned int component) const;
+
+            /**
+             * The values of the given auxiliary data entry for all rows of this
+             * chunk. The index refers to the position of the entry's name in
+             * the list of names given to the constructor of the SampleStore.
+             */
+            types::Span<const double>
+            auxiliary_column (const unsigned int index) const;
+
+            /**
+             * The number of samples represented by each row. If repeated
+             * samples are not compressed, then this is an empty span, and
+             * every row represents exactly one sample.
+             */
+            types::Span<const types::sample_index>
+            multiplicities () const;
+
+          private:
+            /**
+             * The chunk we provide access to.
+             */
+            const Chunk &chunk;
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param[in] auxiliary_column_names The names of the entries of the
+         *   AuxiliaryData objects that accompany samples that should be
+         *   stored along with the samples. These entries must store values
+         *   of type `double`. If a sample does not have one of these entries,
+         *   then a NaN is stored instead.
+         * @param[in] compress_repeated_samples Whether samples that are equal
+         *   to the previous sample should only be stored once; see the
+         *   documentation of this class.
+         * @param[in] chunk_size The number of rows per chunk.
+         */
+        SampleStore (const std::vector<std::string> &auxiliary_column_names = {},
+                     const bool compress_repeated_samples = false,
+                     const std::size_t chunk_size = 4096);
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~SampleStore ();
+
+        /**
+         * Process one sample by appending it to the store.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class stores the entries whose names were given to the
+         *   constructor, and ignores everything else.
+         */
+        virtual
+        void
+        consume (InputType sample, AuxiliaryData aux_data) override;
+
+        /**
+         * Return the number of samples stored so far.
+         */
+        types::sample_index
+        size () const;
+
+        /**
+         * Return the number of rows used to store the samples. This equals
+         * size() unless repeated samples are compressed.
+         */
+        std::size_t
+        n_rows () const;
+
+        /**
+         * Return the sample with the given index, along with the stored
+         * entries of its auxiliary data. If repeated samples are compressed,
+         * the returned AuxiliaryData object also contains an entry
+         * "sample is repeated" of type `bool` that indicates whether the
+         * sample is a repetition of the previous one.
+         */
+        std::pair<value_type,AuxiliaryData>
+        get (const types::sample_index index) const;
+
+        /**
+         * Call `consumer.consume()` for all stored samples with indices
+         * `begin` (inclusive) to `end` (exclusive), in order, and with the
+         * same AuxiliaryData objects get() would return. The `consumer` object
+         * need not be connected to anything, but it may also be connected to
+         * producers -- for example, the same producers that feed the current
+         * object. In the latter case, its consume() function is then called
+         * concurrently from the producers' threads and the current one. The
+         * consumer must therefore not have been declared to have a single
+         * producer via Consumer::declare_single_producer(): Such consumers
+         * do not lock the mutexes that protect their state when consume() is
+         * called. For the same reason, the consumer must not be in
+         * ParallelMode::ingestion mode (see there).
+         *
+         * Because consume() is called directly, the consumer's parallel
+         * mode does not otherwise matter (samples are always processed on
+         * the current thread), and its gate schedule as well as
+         * Consumer::enable() and Consumer::disable() are ignored: all
+         * samples in the given range are replayed.
+         *
+         * Samples are read from the store in batches, and the store is not
+         * locked while `consumer.consume()` is running. As a consequence,
+         * samples can be added to the store while this function is running.
+         * If `end` is larger than the number of samples stored at the time
+         * of the call, then only those samples are replayed.
+         */
+        void
+        replay (Consumer<InputType> &consumer,
+                const types::sample_index begin = 0,
+                const types::sample_index end = std::numeric_limits<types::sample_index>::max()) const;
+
+        /**
+         * Call the given function once for each chunk of stored rows, in
+         * order. The function receives a ChunkView object through which it
+         * can access the columns of the chunk as contiguous arrays.
+         *
+         * The store is locked while this function runs. The function `f`
+         * must therefore not call other member functions of the current
+         * object, and samples sent to the current object are held up until
+         * this function returns.
+         */
+        void
+        visit_chunks (const std::function<void (const ChunkView &)> &f) const;
+
+        /**
+         * Remove all stored samples. Samples received afterwards are again
+         * numbered starting at zero.
+         */
+        void
+        clear ();
+
+      private:
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * The parameters passed to the constructor.
+         */
+        const std::vector<std::string> auxiliary_column_names;
+        const bool                     compress_repeated_samples;
+        const std::size_t              chunk_size;
+
+        /**
+         * The number of components of the samples, and a copy of the first
+         * sample. The latter is used to create objects of type `value_type`
+         * from the stored components.
+         */
+        std::size_t n_components;
+        value_type  prototype;
+
+        /**
+         * The chunks in which samples are stored, and the total number of
+         * samples stored.
+         */
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        types::sample_index                 n_samples;
+
+        /**
+         * Scratch arrays used in consume() to collect the values of the
+         * current sample before they are stored.
+         */
+        std::vector<scalar_type> current_row;
+        std::vector<double>      current_auxiliary_row;
+
+        /**
+         * Return whether `current_row` and `current_auxiliary_row` are equal
+         * to the last stored row. This function must be called while holding
+         * the lock.
+         */
+        bool
+        current_row_is_repeated () const;
+
+        /**
+         * Create the sample with the given index, along with its AuxiliaryData
+         * object. This function must be called while holding the lock.
+         */
+        std::pair<value_type,AuxiliaryData>
+        create_sample (const types::sample_index index) const;
+    };
+
+
+
+    template <typename InputType>
+    SampleStore<InputType>::ChunkView::
+    ChunkView (const Chunk &chunk)
+      :
+      chunk (chunk)
+    {}
+
+
+
+    template <typename InputType>
+    types::sample_index
+    SampleStore<InputType>::ChunkView::
+    first_sample_index () const
+    {
+      return chunk.first_sample_index;
+    }
+
+
+
+    template <typename InputType>
+    types::sample_index
+    SampleStore<InputType>::ChunkView::
+    n_samples () const
+    {
+      return chunk.n_samples;
+    }
+
+
+
+    template <typename InputType>
+    std::size_t
+    SampleStore<InputType>::ChunkView::
+    n_rows () const
+    {
+      return chunk.columns[0].size();
+    }
+
+
+
+    template <typename InputType>
+    types::Span<const typename SampleStore<InputType>::scalar_type>
+    SampleStore<InputType>::ChunkView::
+    column (const unsigned int component) const
+    {
+      assert (component < chunk.columns.size());
+      return {chunk.columns[component].data(), chunk.columns[component].size()};
+    }
+
+
+
+    template <typename InputType>
+    types::Span<const double>
+    SampleStore<InputType>::ChunkView::
+    auxiliary_column (const unsigned int index) const
+    {
+      assert (index < chunk.auxiliary_columns.size());
+      return {chunk.auxiliary_columns[index].data(), chunk.auxiliary_columns[index].size()};
+    }
+
+
+
+    template <typename InputType>
+    types::Span<const types::sample_index>
+    SampleStore<InputType>::ChunkView::
+    multiplicities () const
+    {
+      return {chunk.multiplicities.data(), chunk.multiplicities.size()};
+    }
+
+
+
+    template <typename InputType>
+    SampleStore<InputType>::
+    SampleStore (const std::vector<std::string> &auxiliary_column_names,
+                 const bool compress_repeated_samples,
+                 const std::size_t chunk_size)
+      :
+      auxiliary_column_names (auxiliary_column_names),
+      compress_repeated_samples (compress_repeated_samples),
+      chunk_size (chunk_size),
+      n_components (0),
+      n_samples (0),
+      current_auxiliary_row (auxiliary_column_names.size())
+    {
+      assert (chunk_size > 0);
+
+      this->register_single_writer_mutex (mutex);
+    }
+
+
+
+    template <typename InputType>
+    SampleStore<InputType>::
+    ~SampleStore ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    void
+    SampleStore<InputType>::
+    consume (InputType sample, AuxiliaryData aux_data)
+    {
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
+
+      // If this is the first sample, record its size and keep a copy:
+      if (n_components == 0)
+        {
+          n_components = Utilities::size(sample);
+          prototype = Utilities::to_storage (sample);
+          current_row.resize (n_components);
+        }
+      assert (Utilities::size(sample) == n_components);
+
+      // Collect the components and the auxiliary data of the sample:
+      for (std::size_t c=0; c<n_components; ++c)
+        current_row[c] = Utilities::get_nth_element (sample, c);
+      for (std::size_t k=0; k<auxiliary_column_names.size(); ++k)
+        {
+          const auto entry = aux_data.find (auxiliary_column_names[k]);
+          current_auxiliary_row[k] = (entry != aux_data.end() ?
+                                      boost::any_cast<double>(entry->second) :
+                                      std::numeric_limits<double>::quiet_NaN());
+        }
+
+      // If we compress repeated samples and this is one, just increment the
+      // multiplicity of the last row:
+      if (compress_repeated_samples && current_row_is_repeated())
+        {
+          ++chunks.back()->multiplicities.back();
+          ++chunks.back()->n_samples;
+          ++n_samples;
+          return;
+        }
+
+      // Otherwise append a row, if necessary to a new chunk:
+      if (chunks.empty() || (chunks.back()->columns[0].size() == chunk_size))
+        {
+          std::unique_ptr<Chunk> chunk (new Chunk());
+          chunk->first_sample_index = n_samples;
+          chunk->n_samples = 0;
+          chunk->columns.resize (n_components);
+          for (auto &column : chunk->columns)
+            column.reserve (chunk_size);
+          chunk->auxiliary_columns.resize (auxiliary_column_names.size());
+          for (auto &column : chunk->auxiliary_columns)
+            column.reserve (chunk_size);
+          if (compress_repeated_samples)
+            {
+              chunk->multiplicities.reserve (chunk_size);
+              chunk->row_starts.reserve (chunk_size);
+            }
+          chunks.emplace_back (std::move(chunk));
+        }
+
+      Chunk &chunk = *chunks.back();
+      for (std::size_t c=0; c<n_components; ++c)
+        chunk.columns[c].push_back (current_row[c]);
+      for (std::size_t k=0; k<auxiliary_column_names.size(); ++k)
+        chunk.auxiliary_columns[k].push_back (current_auxiliary_row[k]);
+      if (compress_repeated_samples)
+        {
+          chunk.multiplicities.push_back (1);
+          chunk.row_starts.push_back (chunk.n_samples);
+        }
+
+      ++chunk.n_samples;
+      ++n_samples;
+    }
+
+
+
+    template <typename InputType>
+    bool
+    SampleStore<InputType>::
+    current_row_is_repeated () const
+    {
+      if (chunks.empty())
+        return false;
+
+      const Chunk &chunk = *chunks.back();
+      const std::size_t last_row = chunk.columns[0].size() - 1;
+      for (std::size_t c=0; c<n_components; ++c)
+        if (!(chunk.columns[c][last_row] == current_row[c]))
+          return false;
+      for (std::size_t k=0; k<auxiliary_column_names.size(); ++k)
+        if (!(chunk.auxiliary_columns[k][last_row] == current_auxiliary_row[k]))
+          return false;
+
+      return true;
+    }
+
+
+
+    template <typename InputType>
+    types::sample_index
+    SampleStore<InputType>::
+    size () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      return n_samples;
+    }
+
+
+
+    template <typename InputType>
+    std::size_t
+    SampleStore<InputType>::
+    n_rows () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      std::size_t n = 0;
+      for (const auto &chunk : chunks)
+        n += chunk->columns[0].size();
+      return n;
+    }
+
+
+
+    template <typename InputType>
+    std::pair<typename SampleStore<InputType>::value_type,AuxiliaryData>
+    SampleStore<InputType>::
+    get (const types::sample_index index) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      return create_sample (index);
+    }
+
+
+
+    template <typename InputType>
+    std::pair<typename SampleStore<InputType>::value_type,AuxiliaryData>
+    SampleStore<InputType>::
+    create_sample (const types::sample_index index) const
+    {
+      assert (index < n_samples);
+
+      // Find the chunk that stores the sample: the last one whose first
+      // sample index is not larger than 'index'.
+      const auto chunk_iterator
+        = std::upper_bound (chunks.begin(), chunks.end(), index,
+                            [](const types::sample_index i,
+                               const std::unique_ptr<Chunk> &chunk)
+      {
+        return i < chunk->first_sample_index;
+      }) - 1;
+      const Chunk &chunk = **chunk_iterator;
+
+      // Then find the row within the chunk:
+      const types::sample_index index_within_chunk = index - chunk.first_sample_index;
+      std::size_t row = index_within_chunk;
+      bool is_repeated = false;
+      if (compress_repeated_samples)
+        {
+          row = (std::upper_bound (chunk.row_starts.begin(), chunk.row_starts.end(),
+                                   index_within_chunk)
+                 - chunk.row_starts.begin()) - 1;
+          is_repeated = (index_within_chunk != chunk.row_starts[row]);
+        }
+
+      // Finally create the sample and its auxiliary data:
+      std::pair<value_type,AuxiliaryData> result (prototype, AuxiliaryData());
+      for (std::size_t c=0; c<n_components; ++c)
+        Utilities::get_nth_element (result.first, c) = chunk.columns[c][row];
+      for (std::size_t k=0; k<auxiliary_column_names.size(); ++k)
+        result.second[auxiliary_column_names[k]] = boost::any(chunk.auxiliary_columns[k][row]);
+      if (compress_repeated_samples)
+        result.second["sample is repeated"] = boost::any(is_repeated);
+
+      return result;
+    }
+
+
+
+    template <typename InputType>
+    void
+    SampleStore<InputType>::
+    replay (Consumer<InputType> &consumer,
+            const types::sample_index begin,
+            const types::sample_index end) const
+    {
+      assert (consumer.get_parallel_mode() != ParallelMode::ingestion);
+      assert (consumer.has_declared_single_producer() == false);
+
+      // Copy samples out of the store in batches, and feed them to the
+      // consumer without holding the lock:
+      std::vector<std::pair<value_type,AuxiliaryData>> batch;
+      types::sample_index next = begin;
+      while (true)
+        {
+          batch.clear();
+          {
+            Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+            const types::sample_index batch_end = std::min (std::min (end, n_samples),
+                                                            next + chunk_size);
+            for (; next < batch_end; ++next)
+              batch.emplace_back (create_sample (next));
+          }
+
+          if (batch.empty())
+            return;
+
+          for (auto &sample : batch)
+            consumer.consume (Utilities::from_storage<InputType> (sample.first),
+                              std::move(sample.second));
+        }
+    }
+
+
+
+    template <typename InputType>
+    void
+    SampleStore<InputType>::
+    visit_chunks (const std::function<void (const ChunkView &)> &f) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      for (const auto &chunk : chunks)
+        f (ChunkView(*chunk));
+    }
+
+
+
+    template <typename InputType>
+    void
+    SampleStore<InputType>::
+    clear ()
+    {
+      // This function is not called by the (possibly single) thread that
+      // calls consume(), and so we must not acquire the mutex as a writer.
+      Utilities::SingleWriterMutex::ExclusiveLock lock(mutex);
+
+      chunks.clear();
+      n_samples = 0;
+    }
+  }
+}
+
+#endif
@@ -17,6 +17,7 @@
 #define SAMPLEFLOW_CONSUMERS_STREAM_OUTPUT_H
 
 #include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
 #include <sampleflow/element_access.h>
 #include <mutex>
 #include <ostream>
@@ -99,7 +100,7 @@ namespace SampleFlow
          * A mutex used to lock access to all member variables when running
          * on multiple threads.
          */
-        mutable std::mutex mutex;
+        mutable Utilities::SingleWriterMutex mutex;
 
         /**
          * A reference to the stream to which output will be written for each
@@ -116,7 +117,9 @@ namespace SampleFlow
       :
       Consumer<InputType>(ParallelMode::synchronous),
       output_stream (output_stream)
-    {}
+    {
+      this->register_single_writer_mutex (mutex);
+    }
 
 
 
@@ -181,7 +184,7 @@ namespace SampleFlow
     StreamOutput<InputType>::
     consume (InputType sample, AuxiliaryData /*aux_data*/)
     {
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
 
       internal::StreamOutput::write (sample, output_stream);
       output_stream << std::endl;
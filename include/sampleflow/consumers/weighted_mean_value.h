@@ -0,0 +1,341 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_CONSUMERS_WEIGHTED_MEAN_VALUE_H
+#define SAMPLEFLOW_CONSUMERS_WEIGHTED_MEAN_VALUE_H
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/single_writer_mutex.h>
+#include <sampleflow/types.h>
+#include <mutex>
+#include <string>
+#include <cmath>
+#include <limits>
+#include <cassert>
+
+
+namespace SampleFlow
+{
+  namespace Consumers
+  {
+    /**
+     * A Consumer class that implements computing the running, weighted mean
+     * value
+     * @f{align*}{
+     *   \bar x_k = \frac{\sum_{j=1}^k w_j x_j}{\sum_{j=1}^k w_j}
+     * @f}
+     * over all samples seen so far, where the weight $w_j$ of each sample
+     * is taken from the AuxiliaryData object that accompanies the sample.
+     * Weighted samples are produced by several samplers: For example,
+     * the Producers::StochasticGradientLangevinDynamics class attaches the
+     * step size used to generate a sample (because samples obtained with
+     * decreasing step sizes need to be weighted by the step size to obtain
+     * consistent estimates), and importance sampling methods attach the
+     * (logarithm of the) importance weight of each sample.
+     *
+     * This class uses the same kind of update formula as the MeanValue class:
+     * @f{align*}{
+     *      \bar x_1 &= x_1,
+     *   \\ \bar x_k &= \bar x_{k-1} + \frac{w_k}{W_k} (x_k - \bar x_{k-1}),
+     * @f}
+     * where $W_k=\sum_{j=1}^k w_j$. If the weights are provided as
+     * logarithms, then the class never computes $w_j$ itself but only
+     * ratios $w_j/w_\text{ref}$ relative to the largest weight seen so far.
+     * This avoids overflow and underflow for the very large ranges of
+     * weights that are common in importance sampling. Log weights of
+     * $-\infty$, i.e., samples with zero weight, are allowed (for example
+     * for samples outside the support of the target distribution of an
+     * importance sampler); such samples do not affect the mean.
+     *
+     * Samples whose AuxiliaryData object does not contain an entry of the
+     * given name are ignored.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * consume() member function can be called concurrently and from multiple
+     * threads.
+     *
+     *
+     * @tparam InputType The C++ type used for the samples $x_k$. The same
+     *   requirements hold as for the MeanValue class; in addition, it must
+     *   be possible to multiply objects of this type by a `double`.
+     */
+    template <typename InputType>
+    class WeightedMeanValue : public Consumer<InputType>
+    {
+      public:
+        /**
+         * The type of the information generated by this class, i.e., in which
+         * the mean value is computed. As for the MeanValue class, this is
+         * the InputType unless the InputType is a non-owning type such as
+         * types::Span.
+         */
+        using value_type = types::StorageType<InputType>;
+
+        /**
+         * An enum that describes how the weights are stored in the
+         * AuxiliaryData objects.
+         */
+        enum class WeightType
+        {
+          /**
+           * The AuxiliaryData entry stores the weight $w_j$ itself.
+           */
+          linear,
+
+          /**
+           * The AuxiliaryData entry stores the logarithm $\log w_j$.
+           */
+          logarithmic
+        };
+
+        /**
+         * Constructor.
+         *
+         * This class does not care in which order samples are processed, and
+         * consequently calls the base class constructor with
+         * `ParallelMode::synchronous | ParallelMode::asynchronous` as argument.
+         *
+         * @param[in] weight_name The name of the AuxiliaryData entry that
+         *   stores the weight (or its logarithm) as a `double`.
+         * @param[in] weight_type Whether the entry stores $w_j$ or
+         *   $\log w_j$.
+         */
+        WeightedMeanValue (const std::string &weight_name,
+                           const WeightType weight_type = WeightType::linear);
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~WeightedMeanValue ();
+
+        /**
+         * Process one sample by updating the previously computed mean value
+         * using this one sample and its weight.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class reads the weight of the sample from the entry whose
+         *   name was given to the constructor, and ignores everything else.
+         */
+        virtual
+        void
+        consume (InputType     sample,
+                 AuxiliaryData aux_data) override;
+
+        /**
+         * A function that returns the weighted mean value computed from the
+         * samples seen so far. If no samples have been processed so far, then
+         * a default-constructed object of type InputType will be returned.
+         *
+         * @return The computed mean value.
+         */
+        value_type
+        get () const;
+
+        /**
+         * Like get(), but write the weighted mean value into `result`, reusing
+         * its memory if it already has the correct size. See the documentation
+         * of the Consumer class for the general contract.
+         */
+        void
+        get_into (value_type &result) const;
+
+        /**
+         * Call `visitor` with a reference to the running weighted mean value
+         * this class stores, without copying it. See the Consumer class for the
+         * general contract.
+         */
+        template <typename Visitor>
+        void
+        visit (const Visitor &visitor) const;
+
+      private:
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable Utilities::SingleWriterMutex mutex;
+
+        /**
+         * The name of the AuxiliaryData entry we read weights from, and how
+         * to interpret it.
+         */
+        const std::string weight_name;
+        const WeightType  weight_type;
+
+        /**
+         * The current value of $\bar x_k$ as described in the introduction
+         * of this class.
+         */
+        value_type current_mean;
+
+        /**
+         * The sum of weights $W_k$ seen so far. If weights are given as
+         * logarithms, then this is the sum of weights divided by
+         * $\exp(\text{reference\_log\_weight})$.
+         */
+        double sum_of_weights;
+
+        /**
+         * If weights are given as logarithms, the logarithm of the weight
+         * relative to which we store `sum_of_weights`. This is the largest
+         * finite log weight seen so far.
+         */
+        double reference_log_weight;
+
+        /**
+         * The number of samples processed so far.
+         */
+        types::sample_index n_samples;
+    };
+
+
+
+    template <typename InputType>
+    WeightedMeanValue<InputType>::
+    WeightedMeanValue (const std::string &weight_name,
+                       const WeightType weight_type)
+      :
+      Consumer<InputType>(ParallelMode(static_cast<int>(ParallelMode::synchronous)
+                                       |
+                                       static_cast<int>(ParallelMode::asynchronous))),
+      weight_name (weight_name),
+      weight_type (weight_type),
+      sum_of_weights (0),
+      reference_log_weight (0),
+      n_samples (0)
+    {
+      this->register_single_writer_mutex (mutex);
+    }
+
+
+
+    template <typename InputType>
+    WeightedMeanValue<InputType>::
+    ~WeightedMeanValue ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    void
+    WeightedMeanValue<InputType>::
+    consume (InputType sample, AuxiliaryData aux_data)
+    {
+      const auto weight_entry = aux_data.find (weight_name);
+      if (weight_entry == aux_data.end())
+        return;
+      const double weight_value = boost::any_cast<double>(weight_entry->second);
+
+      std::lock_guard<Utilities::SingleWriterMutex> lock(mutex);
+
+      // Compute the weight of the current sample, relative to the
+      // reference weight if we are working with logarithms. If the new
+      // sample has a larger weight than all previous ones (or if all
+      // previous samples had zero weight), make it the new reference and
+      // rescale the sum of previous weights. A log weight of -infinity
+      // is a valid, zero weight, but it can not serve as a reference:
+      // we would then have to compute exp(-inf - -inf).
+      double weight;
+      if (weight_type == WeightType::linear)
+        weight = weight_value;
+      else if (weight_value == -std::numeric_limits<double>::infinity())
+        weight = 0;
+      else
+        {
+          assert (std::isfinite (weight_value));
+          if ((sum_of_weights == 0) || (weight_value > reference_log_weight))
+            {
+              sum_of_weights *= std::exp (reference_log_weight - weight_value);
+              reference_log_weight = weight_value;
+            }
+          weight = std::exp (weight_value - reference_log_weight);
+        }
+      assert (weight >= 0);
+
+      // If this is the first sample we see, initialize the current-mean with
+      // this sample.
+      if (n_samples == 0)
+        {
+          n_samples = 1;
+          sum_of_weights = weight;
+          current_mean = Utilities::to_storage(std::move(sample));
+        }
+      else
+        {
+          // Otherwise update the previously computed mean by the current
+          // sample. Guard against samples with zero weight as long as
+          // we have not seen anything with a positive weight.
+          ++n_samples;
+          sum_of_weights += weight;
+          if (sum_of_weights == 0)
+            return;
+
+          value_type update = Utilities::to_storage(std::move(sample));
+          update -= current_mean;
+          update *= (weight / sum_of_weights);
+
+          current_mean += update;
+        }
+    }
+
+
+
+    template <typename InputType>
+    typename WeightedMeanValue<InputType>::value_type
+    WeightedMeanValue<InputType>::
+    get () const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      return current_mean;
+    }
+
+
+
+    template <typename InputType>
+    void
+    WeightedMeanValue<InputType>::
+    get_into (value_type &result) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      result = current_mean;
+    }
+
+
+
+    template <typename InputType>
+    template <typename Visitor>
+    void
+    WeightedMeanValue<InputType>::
+    visit (const Visitor &visitor) const
+    {
+      Utilities::SingleWriterMutex::ReadLock lock(mutex);
+
+      visitor (current_mean);
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,214 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_DATA_PARALLEL_LOG_LIKELIHOOD_H
+#define SAMPLEFLOW_DATA_PARALLEL_LOG_LIKELIHOOD_H
+
+#include <sampleflow/thread_pool.h>
+
+#include <functional>
+#include <vector>
+#include <cstddef>
+
+
+namespace SampleFlow
+{
+  namespace Utilities
+  {
+    /**
+     * A class that represents a log likelihood function that is a sum over
+     * (independent) data points, i.e., a function of the form
+     * @f{align*}{
+     *   \log(\pi(x)) = \sum_{i=0}^{N-1} \ell_i(x),
+     * @f}
+     * where $\ell_i(x)$ is the log likelihood of the $i$th datum given
+     * the parameters $x$. For large $N$ -- say, millions of data
+     * points -- evaluating such a function dominates the cost of sampling
+     * algorithms such as Producers::MetropolisHastings that call it once
+     * per step, and it is then worthwhile to evaluate the sum in parallel.
+     *
+     * This class does exactly that: The range of data indices
+     * $0\ldots N-1$ is split into a fixed number of contiguous "shards",
+     * each shard is summed up on one of the threads of a ThreadPool
+     * object, and the partial sums are then added up. Importantly, the
+     * partial sums of each shard are computed in a fixed order, and the
+     * partial sums are added up in a fixed order as well; because the
+     * number of shards is fixed when the object is created (and does not
+     * depend on how threads are scheduled), evaluating the function twice
+     * for the same $x$ yields results that are identical bit by bit. This
+     * is important because the Metropolis-Hastings algorithm compares
+     * log likelihoods and small, random round-off differences would make
+     * runs non-reproducible. By default, the number of shards also does
+     * not depend on the number of threads, so that the same results are
+     * obtained on every machine.
+     *
+     * Objects of this class can be called like a function, and so can
+     * be passed directly as the `log_likelihood` argument of
+     * Producers::MetropolisHastings::sample():
+     * @code
+     *   SampleFlow::Utilities::ThreadPool thread_pool;
+     *   SampleFlow::Utilities::DataParallelLogLikelihood<SampleType>
+     *     log_likelihood ([&](const SampleType &x, const std::size_t i)
+     *                     {
+     *                       return -0.5*(data[i]-x)*(data[i]-x);
+     *                     },
+     *                     data.size(),
+     *                     thread_pool);
+     *
+     *   mh_sampler.sample (x0, log_likelihood, &perturb, n_samples);
+     * @endcode
+     *
+     * @tparam SampleType The type of the samples $x$.
+     */
+    template <typename SampleType>
+    class DataParallelLogLikelihood
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] log_likelihood_term A function that, given a sample $x$
+         *   and the index $i$ of a datum, returns $\ell_i(x)$. This function
+         *   will be called concurrently from several threads.
+         * @param[in] n_data The number $N$ of data points.
+         * @param[in] thread_pool The thread pool on which the evaluation of
+         *   shards is to be scheduled. This class stores a reference to
+         *   this object, so it needs to live at least as long as the
+         *   current object.
+         * @param[in] n_shards The number of shards into which the data set
+         *   is split. The order in which partial sums are added up, and
+         *   consequently the last bits of the result, depend on this
+         *   number; the default is therefore a fixed number rather than
+         *   the number of threads of the thread pool. If zero, one shard
+         *   per thread of the thread pool is used, which makes better use
+         *   of machines with many cores, but ties the results (and any
+         *   accept/reject decisions based on them) to the size of the
+         *   thread pool.
+         */
+        DataParallelLogLikelihood (const std::function<double (const SampleType &, const std::size_t)> &log_likelihood_term,
+                                   const std::size_t n_data,
+                                   ThreadPool &thread_pool,
+                                   const unsigned int n_shards = 16);
+
+        /**
+         * Evaluate $\log(\pi(x)) = \sum_{i=0}^{N-1} \ell_i(x)$.
+         */
+        double
+        operator() (const SampleType &x) const;
+
+        /**
+         * Evaluate the log likelihood term $\ell_i(x)$ of a single datum.
+         */
+        double
+        term (const SampleType &x,
+              const std::size_t i) const;
+
+        /**
+         * Return the number $N$ of data points.
+         */
+        std::size_t
+        n_data () const;
+
+      private:
+        /**
+         * The function that evaluates each term of the sum.
+         */
+        const std::function<double (const SampleType &, const std::size_t)> log_likelihood_term;
+
+        /**
+         * The number of data points.
+         */
+        const std::size_t n_data_points;
+
+        /**
+         * A reference to the thread pool on which we do our work.
+         */
+        ThreadPool &thread_pool;
+
+        /**
+         * The number of shards.
+         */
+        const unsigned int n_shards;
+    };
+
+
+
+    template <typename SampleType>
+    DataParallelLogLikelihood<SampleType>::
+    DataParallelLogLikelihood (const std::function<double (const SampleType &, const std::size_t)> &log_likelihood_term,
+                               const std::size_t n_data,
+                               ThreadPool &thread_pool,
+                               const unsigned int n_shards)
+      :
+      log_likelihood_term (log_likelihood_term),
+      n_data_points (n_data),
+      thread_pool (thread_pool),
+      n_shards (n_shards == 0 ? thread_pool.n_threads() : n_shards)
+    {}
+
+
+
+    template <typename SampleType>
+    double
+    DataParallelLogLikelihood<SampleType>::
+    operator() (const SampleType &x) const
+    {
+      // Let each shard write its partial sum into its own slot. This
+      // avoids any synchronization between shards, and allows us to
+      // add up the partial sums in a deterministic order below.
+      std::vector<double> partial_sums (n_shards, 0.);
+
+      thread_pool.parallel_for (0, n_data_points, n_shards,
+                                [&](const std::size_t begin,
+                                    const std::size_t end,
+                                    const unsigned int shard)
+      {
+        double sum = 0;
+        for (std::size_t i=begin; i<end; ++i)
+          sum += log_likelihood_term (x, i);
+        partial_sums[shard] = sum;
+      });
+
+      double log_likelihood = 0;
+      for (const double partial_sum : partial_sums)
+        log_likelihood += partial_sum;
+
+      return log_likelihood;
+    }
+
+
+
+    template <typename SampleType>
+    double
+    DataParallelLogLikelihood<SampleType>::
+    term (const SampleType &x,
+          const std::size_t i) const
+    {
+      return log_likelihood_term (x, i);
+    }
+
+
+
+    template <typename SampleType>
+    std::size_t
+    DataParallelLogLikelihood<SampleType>::
+    n_data () const
+    {
+      return n_data_points;
+    }
+  }
+}
+
+#endif
@@ -188,14 +188,16 @@ namespace SampleFlow
     /**
      * Like the previous function, but for non-`const` objects for which the
      * returned object is a reference to the elements of the `sample` object.
+     * For types that provide only read access to their elements even if
+     * the object itself is not `const` (for example, types::Span objects
+     * that point to `const` data), this is a `const` reference.
      */
     template <typename SampleType>
     auto get_nth_element (SampleType       &sample,
                           const std::size_t index)
     -> typename std::enable_if<internal::has_subscript_operator<SampleType>::value == true,
-    typename std::remove_cv<
     typename std::remove_reference<
-    decltype(std::declval<SampleType>()[index])>::type>::type>::type &
+    decltype(std::declval<SampleType &>()[index])>::type>::type &
     {
       assert (index < size(sample));
       return sample[index];
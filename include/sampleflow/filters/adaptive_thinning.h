@@ -0,0 +1,359 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_FILTERS_ADAPTIVE_THINNING_H
+#define SAMPLEFLOW_FILTERS_ADAPTIVE_THINNING_H
+
+#include <sampleflow/filter.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <mutex>
+#include <vector>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+namespace SampleFlow
+{
+  namespace Filters
+  {
+    /**
+     * An implementation of the Filter interface that, like the TakeEveryNth
+     * class, only passes on every $n$th sample, but that chooses $n$
+     * automatically. The goal is to thin a Markov chain so that the
+     * samples that are passed on are approximately independent, without
+     * having to guess the correlation length of the chain in advance: If
+     * $n$ is chosen too small, downstream consumers do unnecessary work on
+     * (and may store) strongly correlated samples; if $n$ is chosen too
+     * large, information is thrown away.
+     *
+     * To this end, the class estimates the integrated autocorrelation time
+     * (IAT) $\tau$ of the incoming samples using the method of "batch
+     * means": The incoming samples are grouped into windows of $W$ samples,
+     * and each window is split into $W/b$ consecutive batches of length
+     * $b=\lfloor\sqrt{W}\rfloor$. For each component $c$ of the samples,
+     * the class computes the variance $s_c^2$ of all samples in the window
+     * and the variance $s_{b,c}^2$ of the means of the batches. Because the
+     * mean of $b$ samples of a chain with IAT $\tau_c$ has a variance of
+     * approximately $\tau_c s_c^2/b$, the IAT of component $c$ can be
+     * estimated as
+     * @f{align*}{
+     *   \tau_c \approx b\frac{s_{b,c}^2}{s_c^2},
+     * @f}
+     * and the class then uses $n=\lceil \max_c \tau_c \rceil$ as the
+     * thinning factor. (Components whose variance within the window is
+     * zero are ignored.)
+     *
+     * All of this only requires updating a few running sums per component,
+     * i.e., the effort is ${\cal O}(d)$ per sample for samples with $d$
+     * components, and no samples need to be stored. At the end of each
+     * window, the estimate and the thinning factor are updated and the
+     * statistics are reset, so that the thinning factor follows changes in
+     * the behavior of the chain (for example, after the end of burn-in).
+     * While the first window is being processed, the class uses a thinning
+     * factor that can be provided to the constructor.
+     *
+     * The thinning factor currently in use and the latest estimate of the
+     * IAT can be queried using get_every_nth() and
+     * get_integrated_autocorrelation_time().
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * filter() member function can be called concurrently and from multiple
+     * threads. However, since autocorrelations depend on the order of
+     * samples, this filter only supports the synchronous parallel mode.
+     *
+     *
+     * @tparam InputType The C++ type used to describe the incoming samples.
+     *   For the current class, this is of course also the type used for
+     *   the outgoing samples. The functions Utilities::size() and
+     *   Utilities::get_nth_element() need to work for this type, and the
+     *   elements of samples need to be convertible to `double`.
+     */
+    template <typename InputType>
+    class AdaptiveThinning : public Filter<InputType, InputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] window_length The number $W$ of samples over which
+         *   the integrated autocorrelation time is estimated each time.
+         *   Must be at least 4 so that there are at least two batches.
+         * @param[in] initial_every_nth The thinning factor used until
+         *   the end of the first window, i.e., before a first estimate of
+         *   the integrated autocorrelation time is available.
+         */
+        AdaptiveThinning (const types::sample_index window_length = 10000,
+                          const types::sample_index initial_every_nth = 1);
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~AdaptiveThinning ();
+
+        /**
+         * Process one sample by updating the statistics used to estimate
+         * the integrated autocorrelation time and then checking whether it
+         * is an $n$th sample. If so, pass it on to downstream consumers.
+         * If it isn't, return an empty object which the caller of this
+         * function in the base class will interpret as the instruction to
+         * discard the sample from further processing.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class does not know what to do with any such data and consequently
+         *   simply passed it on.
+         *
+         * @return The sample and its auxiliary data if this is an $n$th
+         *   sample. Otherwise, an empty object.
+         */
+        virtual
+        boost::optional<std::pair<InputType, AuxiliaryData> >
+        filter (InputType sample,
+                AuxiliaryData aux_data) override;
+
+        /**
+         * Return the thinning factor $n$ currently in use.
+         */
+        types::sample_index
+        get_every_nth () const;
+
+        /**
+         * Return the most recent estimate of the integrated autocorrelation
+         * time $\max_c \tau_c$. Before the end of the first window, this
+         * function returns zero.
+         */
+        double
+        get_integrated_autocorrelation_time () const;
+
+      private:
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable std::mutex mutex;
+
+        /**
+         * The length $b$ of batches, and the number $W/b$ of batches per
+         * window.
+         */
+        const types::sample_index batch_length;
+        const types::sample_index n_batches_per_window;
+
+        /**
+         * A counter counting how many samples we have seen since the last
+         * sample we passed on, and the current thinning factor.
+         */
+        types::sample_index counter;
+        types::sample_index every_nth;
+
+        /**
+         * The latest estimate of the integrated autocorrelation time.
+         */
+        double integrated_autocorrelation_time;
+
+        /**
+         * The number of samples in the current batch, and the number of
+         * completed batches in the current window.
+         */
+        types::sample_index n_samples_in_batch;
+        types::sample_index n_batches;
+
+        /**
+         * Running statistics for each component: The mean and the sum of
+         * squared deviations from the mean of all samples in the current
+         * window (updated using Welford's algorithm), the sum of the
+         * samples in the current batch, and the mean and sum of squared
+         * deviations of the batch means of the current window.
+         */
+        std::vector<double> sample_mean;
+        std::vector<double> sample_sum_of_squares;
+        std::vector<double> batch_sum;
+        std::vector<double> batch_means_mean;
+        std::vector<double> batch_means_sum_of_squares;
+
+        /**
+         * Compute a new estimate of the integrated autocorrelation time
+         * from the statistics of the window that has just been completed,
+         * update the thinning factor, and reset the statistics.
+         */
+        void
+        update_thinning_factor ();
+    };
+
+
+
+    template <typename InputType>
+    AdaptiveThinning<InputType>::
+    AdaptiveThinning (const types::sample_index window_length,
+                      const types::sample_index initial_every_nth)
+      :
+      batch_length (static_cast<types::sample_index>(std::sqrt(1.*window_length))),
+      n_batches_per_window (window_length / batch_length),
+      counter (0),
+      every_nth (initial_every_nth),
+      integrated_autocorrelation_time (0),
+      n_samples_in_batch (0),
+      n_batches (0)
+    {
+      assert (window_length >= 4);
+      assert (initial_every_nth >= 1);
+    }
+
+
+
+    template <typename InputType>
+    AdaptiveThinning<InputType>::
+    ~AdaptiveThinning ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    boost::optional<std::pair<InputType, AuxiliaryData> >
+    AdaptiveThinning<InputType>::
+    filter (InputType sample,
+            AuxiliaryData aux_data)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      // Size the statistics upon the first sample:
+      const unsigned int n_components = Utilities::size(sample);
+      if (sample_mean.size() == 0)
+        {
+          sample_mean.resize (n_components, 0.);
+          sample_sum_of_squares.resize (n_components, 0.);
+          batch_sum.resize (n_components, 0.);
+          batch_means_mean.resize (n_components, 0.);
+          batch_means_sum_of_squares.resize (n_components, 0.);
+        }
+      assert (sample_mean.size() == n_components);
+
+      // Update the statistics of the window and the current batch:
+      const types::sample_index n_samples_in_window
+        = n_batches * batch_length + n_samples_in_batch + 1;
+      for (unsigned int c=0; c<n_components; ++c)
+        {
+          const double x = Utilities::get_nth_element(sample, c);
+
+          const double delta = x - sample_mean[c];
+          sample_mean[c] += delta / n_samples_in_window;
+          sample_sum_of_squares[c] += delta * (x - sample_mean[c]);
+
+          batch_sum[c] += x;
+        }
+      ++n_samples_in_batch;
+
+      // If the current batch is complete, update the statistics of the
+      // batch means, and if that also completes the window, compute a
+      // new thinning factor.
+      if (n_samples_in_batch == batch_length)
+        {
+          ++n_batches;
+          for (unsigned int c=0; c<n_components; ++c)
+            {
+              const double batch_mean = batch_sum[c] / batch_length;
+
+              const double delta = batch_mean - batch_means_mean[c];
+              batch_means_mean[c] += delta / n_batches;
+              batch_means_sum_of_squares[c] += delta * (batch_mean - batch_means_mean[c]);
+
+              batch_sum[c] = 0;
+            }
+          n_samples_in_batch = 0;
+
+          if (n_batches == n_batches_per_window)
+            update_thinning_factor ();
+        }
+
+      // Finally decide whether to pass the sample on:
+      ++counter;
+      if (counter >= every_nth)
+        {
+          counter = 0;
+          return
+          {{ std::move(sample), std::move(aux_data)}};
+        }
+      else
+        return
+          {};
+    }
+
+
+
+    template <typename InputType>
+    void
+    AdaptiveThinning<InputType>::
+    update_thinning_factor ()
+    {
+      const types::sample_index n_samples_in_window = n_batches * batch_length;
+
+      double tau = 0;
+      for (unsigned int c=0; c<sample_mean.size(); ++c)
+        {
+          const double sample_variance = sample_sum_of_squares[c] / (n_samples_in_window - 1);
+          const double batch_means_variance = batch_means_sum_of_squares[c] / (n_batches - 1);
+
+          if (sample_variance > 0)
+            tau = std::max (tau, batch_length * batch_means_variance / sample_variance);
+        }
+
+      integrated_autocorrelation_time = tau;
+      every_nth = std::max<types::sample_index> (1,
+                                                 static_cast<types::sample_index>(std::ceil(tau)));
+
+      // Reset the statistics for the next window:
+      n_batches = 0;
+      std::fill (sample_mean.begin(), sample_mean.end(), 0.);
+      std::fill (sample_sum_of_squares.begin(), sample_sum_of_squares.end(), 0.);
+      std::fill (batch_means_mean.begin(), batch_means_mean.end(), 0.);
+      std::fill (batch_means_sum_of_squares.begin(), batch_means_sum_of_squares.end(), 0.);
+    }
+
+
+
+    template <typename InputType>
+    types::sample_index
+    AdaptiveThinning<InputType>::
+    get_every_nth () const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return every_nth;
+    }
+
+
+
+    template <typename InputType>
+    double
+    AdaptiveThinning<InputType>::
+    get_integrated_autocorrelation_time () const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return integrated_autocorrelation_time;
+    }
+
+  }
+}
+
+#endif
@@ -0,0 +1,436 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_FILTERS_AUTOMATIC_BURN_IN_H
+#define SAMPLEFLOW_FILTERS_AUTOMATIC_BURN_IN_H
+
+#include <sampleflow/filter.h>
+#include <sampleflow/types.h>
+
+#include <boost/optional.hpp>
+
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <string>
+#include <cmath>
+#include <cassert>
+
+namespace SampleFlow
+{
+  namespace Filters
+  {
+    /**
+     * An implementation of the Filter interface that, like the DiscardFirstN
+     * class, discards the initial "burn-in" phase of a Markov chain, but
+     * that determines the length of this phase automatically rather than
+     * requiring the user to guess it (and, typically, to over-estimate it
+     * by a large margin to be safe).
+     *
+     * The class looks at a scalar "trace" $t_k$ computed from each sample;
+     * by default, this is the "relative log likelihood" that
+     * Producers::MetropolisHastings and several other producers attach to
+     * each sample as part of the AuxiliaryData object, but the user can
+     * provide a different function (for example, one that returns one
+     * component of the sample). Until burn-in has been detected, incoming
+     * samples are held back in a buffer. Every time `check_interval`
+     * further samples have been received, the class runs the stationarity
+     * diagnostic of J. Geweke: "Evaluating the accuracy of sampling-based
+     * approaches to the calculation of posterior moments", in J. M. Bernardo
+     * et al. (eds.), Bayesian Statistics 4, 1992, on the buffered trace.
+     * Specifically, for candidate cutoffs $c=0, N/10, 2N/10, \ldots, N/2$,
+     * where $N$ is the number of buffered samples, it compares the mean of
+     * the first 10% of the trace $t_c,\ldots,t_{N-1}$ with the mean of its
+     * last 50% using the statistic
+     * @f{align*}{
+     *   z = \frac{\bar t_A - \bar t_B}{\sqrt{\sigma_A^2 + \sigma_B^2}},
+     * @f}
+     * where $\sigma_A^2,\sigma_B^2$ are estimates of the variances of the
+     * two means that account for the autocorrelation of the chain (computed
+     * using batch means). The smallest candidate cutoff for which
+     * $|z|$ is less than a given threshold is taken as the end of burn-in:
+     * All buffered samples before the cutoff are discarded, all later ones
+     * are passed on to downstream consumers, and from then on the filter
+     * passes on every sample it receives.
+     *
+     * In order to bound memory consumption, the buffer holds at most
+     * `max_buffer_size` samples. If the buffer is full and burn-in has not
+     * been detected yet, then the first half of the buffer is discarded
+     * (i.e., considered part of the burn-in phase) before testing
+     * continues. This is consistent with the test: If no cutoff up to
+     * $N/2$ leads to a stationary trace, then the first half of the buffer
+     * is not part of the stationary phase.
+     *
+     * The index of the first sample that was passed on (counting all
+     * samples this filter has received, starting at zero) can be queried
+     * using get_cutoff(). If the producer stops before burn-in has been
+     * detected, then no samples are passed on at all.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * filter() member function can be called concurrently and from multiple
+     * threads. However, since burn-in is a property of the order of
+     * samples, this filter only supports the synchronous parallel mode.
+     *
+     *
+     * @tparam InputType The C++ type used to describe the incoming samples.
+     *   For the current class, this is of course also the type used for
+     *   the outgoing samples.
+     */
+    template <typename InputType>
+    class AutomaticBurnIn : public Filter<InputType, InputType>
+    {
+      public:
+        /**
+         * Constructor. Use the "relative log likelihood" entry of the
+         * AuxiliaryData object of each sample (which needs to be of type
+         * `double`) as the trace.
+         *
+         * @param[in] check_interval The number of samples after which the
+         *   stationarity test is repeated. The test is run for the first
+         *   time once this many samples have been received. Must be at
+         *   least 40: For the largest candidate cutoff $c=N/2$, the first
+         *   10% of the remaining trace consist of only $N/20$ samples, and
+         *   the variance of their mean can only be estimated via batch
+         *   means if there are at least two of them.
+         * @param[in] max_buffer_size The maximal number of samples held back
+         *   while waiting for burn-in to be detected. Must be at least
+         *   twice the check interval.
+         * @param[in] z_threshold The threshold for the Geweke statistic
+         *   $|z|$ below which the trace is considered stationary.
+         */
+        AutomaticBurnIn (const types::sample_index check_interval = 1000,
+                         const types::sample_index max_buffer_size = 100000,
+                         const double z_threshold = 2);
+
+        /**
+         * Constructor. Same as above, but use the given function to compute
+         * the trace from each sample and its auxiliary data. The same
+         * restrictions on the arguments hold as for the previous
+         * constructor.
+         */
+        AutomaticBurnIn (const std::function<double (const InputType &, const AuxiliaryData &)> &trace,
+                         const types::sample_index check_interval = 1000,
+                         const types::sample_index max_buffer_size = 100000,
+                         const double z_threshold = 2);
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~AutomaticBurnIn ();
+
+        /**
+         * Process one sample. If burn-in has already been detected, simply
+         * pass the sample on. Otherwise, add the sample to the buffer and,
+         * if it is time to do so, test for stationarity. If burn-in is
+         * detected, all buffered samples after the cutoff are sent to
+         * downstream consumers from within this function.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class uses it to compute the trace, and passes it on unchanged.
+         *
+         * @return The sample and its auxiliary data if burn-in had already
+         *   been detected before. Otherwise, an empty object.
+         */
+        virtual
+        boost::optional<std::pair<InputType, AuxiliaryData> >
+        filter (InputType sample,
+                AuxiliaryData aux_data) override;
+
+        /**
+         * Return the index of the first sample that is considered to be
+         * past the burn-in phase, counting all samples received by this
+         * object starting at zero. If burn-in has not been detected yet,
+         * return an empty object.
+         */
+        boost::optional<types::sample_index>
+        get_cutoff () const;
+
+      private:
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable std::mutex mutex;
+
+        /**
+         * The function computing the trace, and the parameters passed to
+         * the constructor.
+         */
+        const std::function<double (const InputType &, const AuxiliaryData &)> trace;
+        const types::sample_index check_interval;
+        const types::sample_index max_buffer_size;
+        const double z_threshold;
+
+        /**
+         * The samples held back so far along with their auxiliary data and
+         * their trace values, and the index of the first buffered sample.
+         */
+        std::deque<std::pair<InputType, AuxiliaryData> > buffer;
+        std::deque<double> trace_values;
+        types::sample_index first_buffered_index;
+
+        /**
+         * The number of samples received since the last test.
+         */
+        types::sample_index n_samples_since_check;
+
+        /**
+         * The cutoff, once detected.
+         */
+        boost::optional<types::sample_index> cutoff;
+
+        /**
+         * Run the Geweke test for all candidate cutoffs and return the
+         * smallest one (relative to the start of the buffer) for which
+         * the trace is considered stationary, if any.
+         */
+        boost::optional<std::size_t>
+        find_cutoff () const;
+
+        /**
+         * Return an estimate of the variance of the mean of
+         * `trace_values[begin...end-1]` based on batch means.
+         */
+        double
+        variance_of_mean (const std::size_t begin,
+                          const std::size_t end) const;
+
+        /**
+         * The default trace: Return the "relative log likelihood" entry of
+         * the auxiliary data of a sample.
+         */
+        static
+        double
+        relative_log_likelihood (const InputType &sample,
+                                 const AuxiliaryData &aux_data);
+    };
+
+
+
+    template <typename InputType>
+    AutomaticBurnIn<InputType>::
+    AutomaticBurnIn (const types::sample_index check_interval,
+                     const types::sample_index max_buffer_size,
+                     const double z_threshold)
+      :
+      AutomaticBurnIn (&AutomaticBurnIn<InputType>::relative_log_likelihood,
+                       check_interval, max_buffer_size, z_threshold)
+    {}
+
+
+
+    template <typename InputType>
+    AutomaticBurnIn<InputType>::
+    AutomaticBurnIn (const std::function<double (const InputType &, const AuxiliaryData &)> &trace,
+                     const types::sample_index check_interval,
+                     const types::sample_index max_buffer_size,
+                     const double z_threshold)
+      :
+      trace (trace),
+      check_interval (check_interval),
+      max_buffer_size (max_buffer_size),
+      z_threshold (z_threshold),
+      first_buffered_index (0),
+      n_samples_since_check (0)
+    {
+      // The test splits the trace after the largest candidate cutoff N/2
+      // into segments, the shortest of which has N/20 samples. The batch
+      // means used in variance_of_mean() need at least two samples (and
+      // consequently two batches) in each segment, and the test is first
+      // run with N=check_interval.
+      assert (check_interval >= 40);
+      assert (max_buffer_size >= 2*check_interval);
+    }
+
+
+
+    template <typename InputType>
+    AutomaticBurnIn<InputType>::
+    ~AutomaticBurnIn ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    boost::optional<std::pair<InputType, AuxiliaryData> >
+    AutomaticBurnIn<InputType>::
+    filter (InputType sample,
+            AuxiliaryData aux_data)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      // Once burn-in has been detected, we are just a pass-through filter:
+      if (cutoff)
+        return
+        {{ std::move(sample), std::move(aux_data)}};
+
+      // Otherwise buffer the sample. If the buffer is full, first drop
+      // its older half.
+      if (buffer.size() == max_buffer_size)
+        {
+          const std::size_t n_dropped = buffer.size() / 2;
+          buffer.erase (buffer.begin(), buffer.begin() + n_dropped);
+          trace_values.erase (trace_values.begin(), trace_values.begin() + n_dropped);
+          first_buffered_index += n_dropped;
+        }
+
+      trace_values.push_back (trace(sample, aux_data));
+      buffer.emplace_back (std::move(sample), std::move(aux_data));
+      ++n_samples_since_check;
+
+      if (n_samples_since_check < check_interval)
+        return
+          {};
+      n_samples_since_check = 0;
+
+      // Run the test and, if successful, release everything after the
+      // cutoff and free the buffer.
+      const boost::optional<std::size_t> buffer_cutoff = find_cutoff();
+      if (buffer_cutoff)
+        {
+          cutoff = first_buffered_index + *buffer_cutoff;
+
+          for (std::size_t i=*buffer_cutoff; i<buffer.size(); ++i)
+            this->issue_sample (std::move(buffer[i].first),
+                                std::move(buffer[i].second));
+
+          buffer.clear();
+          buffer.shrink_to_fit();
+          trace_values.clear();
+          trace_values.shrink_to_fit();
+        }
+
+      return
+        {};
+    }
+
+
+
+    template <typename InputType>
+    boost::optional<std::size_t>
+    AutomaticBurnIn<InputType>::
+    find_cutoff () const
+    {
+      const std::size_t N = trace_values.size();
+
+      for (unsigned int i=0; i<=5; ++i)
+        {
+          const std::size_t c = i * N / 10;
+
+          // Split the trace after the candidate cutoff into the first 10%
+          // and the last 50%:
+          const std::size_t n = N - c;
+          const std::size_t end_A = c + n/10;
+          const std::size_t begin_B = N - n/2;
+
+          double mean_A = 0;
+          for (std::size_t k=c; k<end_A; ++k)
+            mean_A += trace_values[k];
+          mean_A /= (end_A - c);
+
+          double mean_B = 0;
+          for (std::size_t k=begin_B; k<N; ++k)
+            mean_B += trace_values[k];
+          mean_B /= (N - begin_B);
+
+          const double variance = variance_of_mean (c, end_A) + variance_of_mean (begin_B, N);
+
+          // A trace that is constant in both segments is stationary if the
+          // means agree; otherwise compute the z-score.
+          if (variance == 0)
+            {
+              if (mean_A == mean_B)
+                return c;
+            }
+          else if (std::fabs(mean_A - mean_B) / std::sqrt(variance) < z_threshold)
+            return c;
+        }
+
+      return
+        {};
+    }
+
+
+
+    template <typename InputType>
+    double
+    AutomaticBurnIn<InputType>::
+    variance_of_mean (const std::size_t begin,
+                      const std::size_t end) const
+    {
+      // Split the segment into batches of length sqrt(n), and estimate the
+      // variance of the mean of the whole segment as the variance of the
+      // batch means divided by the number of batches.
+      const std::size_t n = end - begin;
+      const std::size_t batch_length = std::max<std::size_t> (1, static_cast<std::size_t>(std::sqrt(1.*n)));
+      const std::size_t n_batches = n / batch_length;
+      assert (n_batches >= 2);
+
+      std::vector<double> batch_means (n_batches, 0.);
+      double mean = 0;
+      for (std::size_t b=0; b<n_batches; ++b)
+        {
+          for (std::size_t k=0; k<batch_length; ++k)
+            batch_means[b] += trace_values[begin + b*batch_length + k];
+          batch_means[b] /= batch_length;
+          mean += batch_means[b];
+        }
+      mean /= n_batches;
+
+      double variance = 0;
+      for (const double batch_mean : batch_means)
+        variance += (batch_mean - mean) * (batch_mean - mean);
+      variance /= (n_batches - 1);
+
+      return variance / n_batches;
+    }
+
+
+
+    template <typename InputType>
+    double
+    AutomaticBurnIn<InputType>::
+    relative_log_likelihood (const InputType &,
+                             const AuxiliaryData &aux_data)
+    {
+      assert (aux_data.find("relative log likelihood") != aux_data.end());
+      return boost::any_cast<double>(aux_data.at("relative log likelihood"));
+    }
+
+
+
+    template <typename InputType>
+    boost::optional<types::sample_index>
+    AutomaticBurnIn<InputType>::
+    get_cutoff () const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      return cutoff;
+    }
+
+  }
+}
+
+#endif
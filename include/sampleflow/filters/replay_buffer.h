@@ -0,0 +1,447 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+#ifndef SAMPLEFLOW_FILTERS_REPLAY_BUFFER_H
+#define SAMPLEFLOW_FILTERS_REPLAY_BUFFER_H
+
+#include <sampleflow/filter.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  namespace Filters
+  {
+    /**
+     * A filter that passes all samples on unchanged, but also retains a
+     * history of the samples it has seen so that consumers that are
+     * attached later can be fed all of the samples they have missed.
+     *
+     * Connecting a consumer to a producer via Consumer::connect_to_producer()
+     * while sampling is already under way means that the consumer only sees
+     * samples generated from then on. But in interactive analysis sessions,
+     * one often only attaches diagnostics once one has noticed that
+     * something is wrong. If the sampler feeds its samples through an object
+     * of the current class, one can instead call connect_with_history(): The
+     * consumer is then first fed the samples stored in the history on a
+     * background thread, and once it has caught up with the samples the
+     * filter has received in the meantime, it is connected to the filter like
+     * any other consumer. None of this pauses the sampler. The consumer sees
+     * every sample that is in the history at the time it gets there exactly
+     * once, and in the order in which the filter has received them.
+     *
+     * The history can be bounded: If more samples are received than the
+     * capacity given to the constructor, then the oldest ones are forgotten,
+     * and a consumer attached later only sees the most recent ones. (This may
+     * also happen while a consumer is catching up, if the sampler produces
+     * samples faster than the consumer can process them.) Furthermore, if
+     * requested, samples that are equal to the previous one are stored only
+     * once, along with their number of repetitions. This is useful for the
+     * output of Metropolis-Hastings-type samplers in which a large fraction
+     * of samples are repetitions of the previous sample. In that case, only
+     * the auxiliary data of the first and the last repetition are stored,
+     * and the repetitions in between are replayed with the latter.
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * filter() member function can be called concurrently and from multiple
+     * threads. In order to guarantee that consumers switching from the
+     * history to the live stream of samples neither miss a sample nor see one
+     * twice, the filter holds a lock while it passes a sample on to
+     * downstream consumers; consequently, downstream consumers that work
+     * synchronously process samples one at a time even if samples arrive
+     * concurrently.
+     *
+     * While a consumer attached via connect_with_history() catches up, its
+     * consume() function is called directly from the background thread,
+     * regardless of the consumer's parallel mode; its gate schedule and
+     * whether it is enabled (see Consumer::enable() and
+     * Consumer::disable()) are also ignored for the samples it is fed from
+     * the history, though not for the ones it receives once it is
+     * connected. The consumer must not be in ParallelMode::ingestion mode,
+     * for the reasons explained in the documentation of that mode. The
+     * flush() function of this class waits for all consumers that are
+     * still catching up to finish doing so.
+     *
+     *
+     * @tparam InputType The C++ type used to describe the incoming samples.
+     *   For the current class, this is of course also the type used for
+     *   the outgoing samples.
+     */
+    template <typename InputType>
+    class ReplayBuffer : public Filter<InputType, InputType>
+    {
+      public:
+        /**
+         * The type in which samples are stored in the history. This is the
+         * InputType unless the InputType is a non-owning type such as
+         * types::Span.
+         */
+        using value_type = types::StorageType<InputType>;
+
+        /**
+         * Constructor.
+         *
+         * @param[in] capacity The maximal number of samples to retain. By
+         *   default, all samples are retained.
+         * @param[in] compress_repeated_samples Whether samples that are
+         *   equal to the previous one should only be stored once. If a
+         *   sample is repeated, the AuxiliaryData object of its first
+         *   occurrence is stored, along with that of its last repetition;
+         *   when replaying the history, the latter is sent along with all
+         *   repetitions.
+         */
+        ReplayBuffer (const types::sample_index capacity = std::numeric_limits<types::sample_index>::max(),
+                      const bool compress_repeated_samples = false);
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed, and that all
+         * consumers attached via connect_with_history() have caught up. To
+         * this end, it calls the Consumers::disconnect_and_flush() function
+         * of the base class.
+         */
+        virtual ~ReplayBuffer ();
+
+        /**
+         * Process one sample by adding it to the history and passing it on
+         * to all connected consumers.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. The current
+         *   class stores it along with the sample, and passes it on.
+         *
+         * @return An empty object. The sample is passed on to downstream
+         *   consumers by this function itself; see the discussion of
+         *   threading in the documentation of this class.
+         */
+        virtual
+        boost::optional<std::pair<InputType, AuxiliaryData> >
+        filter (InputType sample,
+                AuxiliaryData aux_data) override;
+
+        /**
+         * Wait for all consumers attached via connect_with_history() to
+         * catch up, then call the flush() function of the base class.
+         */
+        virtual
+        void
+        flush () override;
+
+        /**
+         * Attach the given consumer to this filter, first feeding it all
+         * samples currently stored in the history (and those that arrive
+         * while it is catching up) on a background thread, and then
+         * connecting it to this filter so that it sees all further samples.
+         * This function returns immediately.
+         *
+         * The consumer must not be in ParallelMode::ingestion mode; see the
+         * discussion of threading in the documentation of this class.
+         *
+         * The consumer must not be destroyed before it has caught up, i.e.,
+         * before flush() has been called on this object (which happens, for
+         * example, at the end of the `sample()` function of the producer
+         * that feeds this filter).
+         */
+        void
+        connect_with_history (Consumer<InputType> &consumer);
+
+        /**
+         * Return the number of samples this filter has received so far,
+         * and the number of samples currently stored in the history.
+         */
+        std::pair<types::sample_index,types::sample_index>
+        get_history_size () const;
+
+      private:
+        /**
+         * A structure describing one entry of the history: a sample, the
+         * number of times it has been repeated, the index of its first
+         * occurrence, and the auxiliary data of its first and last
+         * occurrence. The latter is only stored if the sample has been
+         * repeated, i.e., if `multiplicity` is larger than one.
+         */
+        struct Entry
+        {
+          value_type                      sample;
+          AuxiliaryData                   first_aux_data;
+          boost::optional<AuxiliaryData>  last_aux_data;
+          types::sample_index first_sample_index;
+          types::sample_index multiplicity;
+        };
+
+        /**
+         * A mutex used to lock access to all member variables when running
+         * on multiple threads.
+         */
+        mutable std::mutex mutex;
+
+        /**
+         * The parameters passed to the constructor.
+         */
+        const types::sample_index capacity;
+        const bool                compress_repeated_samples;
+
+        /**
+         * The history, the number of samples it represents, and the number
+         * of samples received so far.
+         */
+        std::deque<Entry>   history;
+        types::sample_index n_samples_in_history;
+        types::sample_index n_samples;
+
+        /**
+         * The threads on which consumers attached via connect_with_history()
+         * are catching up.
+         */
+        std::list<std::thread> catch_up_threads;
+
+        /**
+         * The function run on the background threads started by
+         * connect_with_history().
+         */
+        void
+        catch_up (Consumer<InputType> &consumer);
+
+        /**
+         * Return whether two samples have the same elements.
+         */
+        static
+        bool
+        samples_are_equal (const value_type &sample_1,
+                           const value_type &sample_2);
+    };
+
+
+
+    template <typename InputType>
+    ReplayBuffer<InputType>::
+    ReplayBuffer (const types::sample_index capacity,
+                  const bool compress_repeated_samples)
+      :
+      capacity (capacity),
+      compress_repeated_samples (compress_repeated_samples),
+      n_samples_in_history (0),
+      n_samples (0)
+    {}
+
+
+
+    template <typename InputType>
+    ReplayBuffer<InputType>::
+    ~ReplayBuffer ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    boost::optional<std::pair<InputType, AuxiliaryData> >
+    ReplayBuffer<InputType>::
+    filter (InputType sample,
+            AuxiliaryData aux_data)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      // Add the sample to the history, either by increasing the multiplicity
+      // of the last entry or by adding a new entry. Since we still need to
+      // pass the auxiliary data on below, this requires one copy of it.
+      value_type stored_sample = Utilities::to_storage (sample);
+      if (compress_repeated_samples
+          && !history.empty()
+          && samples_are_equal (history.back().sample, stored_sample))
+        {
+          ++history.back().multiplicity;
+          history.back().last_aux_data = aux_data;
+        }
+      else
+        history.emplace_back (Entry {std::move(stored_sample),
+                                     aux_data, boost::none,
+                                     n_samples, 1});
+      ++n_samples;
+      ++n_samples_in_history;
+
+      // Then drop the oldest samples if we have exceeded the capacity:
+      while (n_samples_in_history > capacity)
+        {
+          Entry &front = history.front();
+          if (front.multiplicity > 1)
+            {
+              --front.multiplicity;
+              ++front.first_sample_index;
+              if (front.multiplicity > 1)
+                front.first_aux_data = *front.last_aux_data;
+              else
+                {
+                  front.first_aux_data = std::move(*front.last_aux_data);
+                  front.last_aux_data = boost::none;
+                }
+            }
+          else
+            history.pop_front();
+          --n_samples_in_history;
+        }
+
+      // Finally pass the sample on. We do this while still holding the lock
+      // so that catch_up() can connect a consumer to this object at a
+      // well-defined point: every sample is either already in the history
+      // when the consumer is connected, or is sent through the connection.
+      this->issue_sample (std::move(sample), std::move(aux_data));
+
+      return {};
+    }
+
+
+
+    template <typename InputType>
+    void
+    ReplayBuffer<InputType>::
+    flush ()
+    {
+      // Wait for all consumers that are still catching up. Take the threads
+      // out of the list under the lock, but join them without holding it
+      // since they need the lock to make progress.
+      std::list<std::thread> threads;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.swap (catch_up_threads);
+      }
+      for (auto &thread : threads)
+        thread.join();
+
+      Filter<InputType,InputType>::flush();
+    }
+
+
+
+    template <typename InputType>
+    void
+    ReplayBuffer<InputType>::
+    connect_with_history (Consumer<InputType> &consumer)
+    {
+      assert (consumer.get_parallel_mode() != ParallelMode::ingestion);
+
+      std::lock_guard<std::mutex> lock(mutex);
+
+      catch_up_threads.emplace_back ([this, &consumer]()
+      {
+        this->catch_up (consumer);
+      });
+    }
+
+
+
+    template <typename InputType>
+    void
+    ReplayBuffer<InputType>::
+    catch_up (Consumer<InputType> &consumer)
+    {
+      // The maximal number of samples we copy out of the history at a time.
+      const types::sample_index batch_size = 1024;
+
+      types::sample_index next_sample = 0;
+      std::vector<std::pair<value_type,AuxiliaryData>> batch;
+      while (true)
+        {
+          batch.clear();
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // If we have seen all samples, connect the consumer to the live
+            // stream. Because filter() holds the lock while it adds samples
+            // to the history and passes them on, the consumer will see all
+            // following samples through the connection.
+            if (next_sample >= n_samples)
+              {
+                consumer.connect_to_producer (*this);
+                return;
+              }
+
+            // Skip samples that are no longer in the history:
+            if (history.empty())
+              {
+                next_sample = n_samples;
+                continue;
+              }
+            next_sample = std::max (next_sample, history.front().first_sample_index);
+
+            // Find the entry that stores the next sample, and copy samples
+            // out of the history starting there:
+            auto entry = std::upper_bound (history.begin(), history.end(), next_sample,
+                                           [](const types::sample_index index,
+                                              const Entry &e)
+            {
+              return index < e.first_sample_index;
+            }) - 1;
+            for (; (entry != history.end()) && (batch.size() < batch_size); ++entry)
+              for (; (next_sample < entry->first_sample_index + entry->multiplicity)
+                   && (batch.size() < batch_size);
+                   ++next_sample)
+                batch.emplace_back (entry->sample,
+                                    (next_sample == entry->first_sample_index ?
+                                     entry->first_aux_data :
+                                     *entry->last_aux_data));
+          }
+
+          for (auto &sample : batch)
+            consumer.consume (Utilities::from_storage<InputType> (sample.first),
+                              std::move(sample.second));
+        }
+    }
+
+
+
+    template <typename InputType>
+    std::pair<types::sample_index,types::sample_index>
+    ReplayBuffer<InputType>::
+    get_history_size () const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      return {n_samples, n_samples_in_history};
+    }
+
+
+
+    template <typename InputType>
+    bool
+    ReplayBuffer<InputType>::
+    samples_are_equal (const value_type &sample_1,
+                       const value_type &sample_2)
+    {
+      if (Utilities::size(sample_1) != Utilities::size(sample_2))
+        return false;
+      for (std::size_t i=0; i<Utilities::size(sample_1); ++i)
+        if (!(Utilities::get_nth_element(sample_1,i) == Utilities::get_nth_element(sample_2,i)))
+          return false;
+      return true;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,702 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_FILTERS_ROUTER_H
+#define SAMPLEFLOW_FILTERS_ROUTER_H
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/producer.h>
+#include <sampleflow/types.h>
+#include <sampleflow/span.h>
+#include <sampleflow/linear_algebra.h>
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/numeric/ublas/matrix.hpp>
+
+namespace SampleFlow
+{
+  namespace Filters
+  {
+    /**
+     * A class that distributes incoming samples over a number of "replicas",
+     * each of which is a Producer to which one can connect consumers. Each
+     * sample is sent to exactly one of the replicas, and each replica
+     * issues its samples on its own thread.
+     *
+     * The purpose of this class is to scale expensive consumers across
+     * several processor cores. A consumer such as CovarianceMatrix for very
+     * high dimensional samples, or an Action object that evaluates a
+     * posterior-predictive model for each sample, can process only one
+     * sample at a time, even if it is running in asynchronous mode, because
+     * its consume() function serializes on a mutex. If the quantity the
+     * consumer computes does not depend on the order of samples, one can
+     * instead create $R$ copies of the consumer, connect each to one of the
+     * replicas of a Router object, and combine their results at the end:
+     * @code
+     *   SampleFlow::Filters::Router<SampleType> router (4);
+     *   router.connect_to_producer (mh_sampler);
+     *
+     *   std::vector<std::unique_ptr<SampleFlow::Consumers::MeanValue<SampleType>>> means;
+     *   for (unsigned int r=0; r<router.n_replicas(); ++r)
+     *     {
+     *       means.emplace_back (new SampleFlow::Consumers::MeanValue<SampleType>());
+     *       means.back()->connect_to_producer (router.replica(r));
+     *     }
+     *
+     *   mh_sampler.sample (...);
+     *
+     *   std::vector<SampleType> replica_means;
+     *   for (const auto &m : means)
+     *     replica_means.push_back (m->get());
+     *   const SampleType mean = router.merge_averages (replica_means);
+     * @endcode
+     * The consumers themselves do not need to be modified for this. Because
+     * each replica's samples are issued on a single thread, the consumers
+     * connected to a replica see their samples one at a time and in the
+     * order in which the router received them.
+     *
+     * The class supports two policies for choosing the replica a sample is
+     * sent to:
+     * - Policy::round_robin sends sample $k$ to replica $k \mod R$. This
+     *   results in each replica receiving the same number of samples (up to
+     *   one), and the distribution of samples does not depend on timing.
+     * - Policy::least_loaded sends each sample to the replica that has the
+     *   fewest samples waiting or in process. This is preferable if the
+     *   cost of processing a sample varies, but the distribution of samples
+     *   over replicas then depends on timing and is not reproducible.
+     *
+     * Each replica has a queue of samples that have been received but not
+     * yet processed. If a queue has reached its maximal length, then the
+     * consume() function blocks until the replica has caught up, to bound
+     * the amount of memory used.
+     *
+     * Samples are copied into the queues. This class can therefore not be
+     * used with non-owning sample types such as types::Span.
+     *
+     *
+     * ### Merging results ###
+     *
+     * The class keeps track of how many samples each replica has issued.
+     * The merge() function uses these counts to combine per-replica results
+     * via a user-provided function, and merge_averages() is a shortcut for
+     * the common case where each replica computes an average (such as a
+     * mean value) and the overall result is the average weighted by the
+     * number of samples.
+     *
+     * Not all quantities can be merged knowing only the per-replica values
+     * and sample counts. In particular, merging covariance matrices also
+     * requires each replica's mean value. For this case, the
+     * merge_covariances() function takes the values computed by a
+     * Consumers::MeanValue and a Consumers::CovarianceMatrix object
+     * connected to each replica, and combines them using the pairwise
+     * update formula of Chan, Golub, and LeVeque (1979).
+     *
+     *
+     * ### Threading model ###
+     *
+     * The consume() function of this class is thread-safe. Consumers
+     * connected to a replica are called from that replica's thread.
+     *
+     *
+     * @tparam InputType The C++ type used to describe the incoming samples.
+     *   This is also the type of the samples issued by the replicas.
+     */
+    template <typename InputType>
+    class Router : public Consumer<InputType>
+    {
+      public:
+        static_assert (types::is_span<InputType>::value == false,
+                       "The Router class stores copies of samples and can "
+                       "consequently not be used with non-owning sample types.");
+
+        /**
+         * An enum describing how samples are distributed over replicas.
+         */
+        enum class Policy
+        {
+          /**
+           * Send samples to replicas in turn.
+           */
+          round_robin,
+
+          /**
+           * Send each sample to the replica with the fewest samples that are
+           * queued or currently being processed.
+           */
+          least_loaded
+        };
+
+        /**
+         * Constructor.
+         *
+         * This class does not care in which order samples are processed, and
+         * consequently calls the base class constructor with
+         * `ParallelMode::synchronous | ParallelMode::asynchronous` as argument.
+         *
+         * @param[in] n_replicas The number $R$ of replicas.
+         * @param[in] policy How samples are distributed over replicas.
+         * @param[in] max_queue_length The maximal number of samples that may
+         *   be queued for each replica before consume() blocks.
+         */
+        Router (const unsigned int n_replicas,
+                const Policy policy = Policy::round_robin,
+                const unsigned int max_queue_length = 1024);
+
+        /**
+         * Destructor. This function makes sure that all samples this object
+         * has received have been processed by the replicas, and then
+         * terminates the replica threads.
+         */
+        virtual ~Router ();
+
+        /**
+         * Put the sample into the queue of one of the replicas.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. It is passed
+         *   on unchanged along with the sample.
+         */
+        virtual
+        void
+        consume (InputType     sample,
+                 AuxiliaryData aux_data) override;
+
+        /**
+         * Wait for all samples that have been received so far to be issued
+         * by the replicas, and then flush all consumers connected to the
+         * replicas.
+         */
+        virtual
+        void
+        flush () override;
+
+        /**
+         * Return the number of replicas.
+         */
+        unsigned int
+        n_replicas () const;
+
+        /**
+         * Return the Producer object that represents the `r`th replica. This
+         * is the object consumers need to be connected to.
+         */
+        Producer<InputType> &
+        replica (const unsigned int r);
+
+        /**
+         * Return how many samples each replica has issued so far.
+         */
+        std::vector<types::sample_index>
+        get_replica_sample_counts () const;
+
+        /**
+         * Combine results computed by consumers connected to the replicas.
+         * `replica_values[r]` is the value computed by the consumer(s)
+         * connected to replica `r`. The function folds these values from
+         * left to right by calling `combine(a, n_a, b, n_b)`, where `a` is
+         * the result of combining the previous replicas, `n_a` the number
+         * of samples it represents, and `b` and `n_b` are the value and
+         * number of samples of the next replica. Replicas that have not
+         * issued any samples are skipped.
+         *
+         * If no replica has issued any samples, a default-constructed object
+         * is returned.
+         */
+        template <typename ValueType>
+        ValueType
+        merge (const std::vector<ValueType> &replica_values,
+               const std::function<ValueType (const ValueType &, const types::sample_index,
+                                              const ValueType &, const types::sample_index)> &combine) const;
+
+        /**
+         * Combine averages computed by consumers connected to the replicas
+         * (for example, mean values) into the average over all samples by
+         * weighting each replica's value by the number of samples it has
+         * issued. `ValueType` needs to support the operations `+=`, `*=`
+         * with a `double`, and copying.
+         */
+        template <typename ValueType>
+        ValueType
+        merge_averages (const std::vector<ValueType> &replica_values) const;
+
+        /**
+         * Combine covariance matrices computed by Consumers::CovarianceMatrix
+         * objects connected to the replicas into the covariance matrix of
+         * all samples. Because the covariance is computed relative to the
+         * mean value, this requires the mean value of the samples of each
+         * replica as well, as computed by Consumers::MeanValue objects
+         * connected to the same replicas.
+         *
+         * If replicas $a$ and $b$ have issued $n_a$ and $n_b$ samples with
+         * mean values $\bar x_a,\bar x_b$ and covariance matrices $C_a,C_b$,
+         * then with $n=n_a+n_b$ and $\delta=\bar x_b-\bar x_a$, the
+         * covariance matrix of the samples of both replicas is
+         * @f{align*}{
+         *   C = \frac{1}{n-1} \left[ (n_a-1) C_a + (n_b-1) C_b
+         *       + \frac{n_a n_b}{n} \delta \delta^H \right],
+         * @f}
+         * and this formula is applied from left to right to all replicas
+         * that have issued samples.
+         *
+         * If fewer than two samples have been issued in total, the function
+         * returns the covariance matrix of the only replica that has issued
+         * a sample, or an empty matrix.
+         */
+        boost::numeric::ublas::matrix<types::ScalarType<InputType>>
+        merge_covariances (const std::vector<InputType> &replica_means,
+                           const std::vector<boost::numeric::ublas::matrix<types::ScalarType<InputType>>> &replica_covariances) const;
+
+      private:
+        /**
+         * A class that represents one replica: A Producer, along with the
+         * queue of samples it has yet to issue and the thread that issues
+         * them.
+         */
+        class Replica : public Producer<InputType>
+        {
+          public:
+            /**
+             * Issue the given sample to the consumers connected to this
+             * replica.
+             */
+            void issue (InputType sample, AuxiliaryData aux_data);
+
+            /**
+             * Flush the consumers connected to this replica.
+             */
+            void flush ();
+
+            /**
+             * The queue of samples not yet issued.
+             */
+            std::deque<std::pair<InputType,AuxiliaryData>> queue;
+
+            /**
+             * The number of samples that are in the queue or are currently
+             * being issued.
+             */
+            std::atomic<unsigned int> load;
+
+            /**
+             * The number of samples issued so far.
+             */
+            types::sample_index n_issued_samples;
+
+            /**
+             * A mutex that guards `queue` and `n_issued_samples`, and a
+             * condition variable used to signal changes of the queue.
+             */
+            mutable std::mutex mutex;
+            std::condition_variable condition;
+
+            /**
+             * A flag that tells the replica thread to terminate once the queue
+             * is empty.
+             */
+            bool shutting_down;
+
+            /**
+             * The thread that issues samples.
+             */
+            std::thread thread;
+        };
+
+        /**
+         * The function executed by each replica's thread.
+         */
+        void
+        replica_loop (Replica &replica);
+
+        /**
+         * The replicas.
+         */
+        std::vector<std::unique_ptr<Replica>> replicas;
+
+        /**
+         * The policy used to choose replicas, and the maximal queue length.
+         */
+        const Policy policy;
+        const unsigned int max_queue_length;
+
+        /**
+         * A counter used for the round-robin policy.
+         */
+        std::atomic<types::sample_index> n_routed_samples;
+    };
+
+
+
+    template <typename InputType>
+    void
+    Router<InputType>::Replica::
+    issue (InputType sample, AuxiliaryData aux_data)
+    {
+      this->issue_sample (std::move(sample), std::move(aux_data));
+    }
+
+
+
+    template <typename InputType>
+    void
+    Router<InputType>::Replica::
+    flush ()
+    {
+      this->flush_consumers ();
+    }
+
+
+
+    template <typename InputType>
+    Router<InputType>::
+    Router (const unsigned int n_replicas,
+            const Policy policy,
+            const unsigned int max_queue_length)
+      :
+      Consumer<InputType>(ParallelMode(static_cast<int>(ParallelMode::synchronous)
+                                       |
+                                       static_cast<int>(ParallelMode::asynchronous))),
+      policy (policy),
+      max_queue_length (max_queue_length),
+      n_routed_samples (0)
+    {
+      assert (n_replicas > 0);
+      assert (max_queue_length > 0);
+
+      for (unsigned int r=0; r<n_replicas; ++r)
+        {
+          replicas.emplace_back (new Replica());
+          Replica &replica = *replicas.back();
+          replica.load = 0;
+          replica.n_issued_samples = 0;
+          replica.shutting_down = false;
+          replica.thread = std::thread ([this, &replica]()
+          {
+            this->replica_loop (replica);
+          });
+        }
+    }
+
+
+
+    template <typename InputType>
+    Router<InputType>::
+    ~Router ()
+    {
+      this->disconnect_and_flush();
+
+      for (auto &replica : replicas)
+        {
+          {
+            std::lock_guard<std::mutex> lock (replica->mutex);
+            replica->shutting_down = true;
+          }
+          replica->condition.notify_all();
+          replica->thread.join();
+        }
+    }
+
+
+
+    template <typename InputType>
+    void
+    Router<InputType>::
+    consume (InputType sample, AuxiliaryData aux_data)
+    {
+      // First choose a replica:
+      unsigned int r = 0;
+      switch (policy)
+        {
+          case Policy::round_robin:
+            r = n_routed_samples++ % replicas.size();
+            break;
+
+          case Policy::least_loaded:
+          {
+            ++n_routed_samples;
+            unsigned int min_load = replicas[0]->load;
+            for (unsigned int i=1; i<replicas.size(); ++i)
+              {
+                const unsigned int load = replicas[i]->load;
+                if (load < min_load)
+                  {
+                    min_load = load;
+                    r = i;
+                  }
+              }
+            break;
+          }
+
+          default:
+            assert (false);
+        }
+
+      // Then put the sample into its queue, waiting for space to become
+      // available if necessary:
+      Replica &replica = *replicas[r];
+      {
+        std::unique_lock<std::mutex> lock (replica.mutex);
+        replica.condition.wait (lock, [&]()
+        {
+          return (replica.queue.size() < max_queue_length);
+        });
+
+        replica.queue.emplace_back (std::move(sample), std::move(aux_data));
+        ++replica.load;
+      }
+      replica.condition.notify_all();
+    }
+
+
+
+    template <typename InputType>
+    void
+    Router<InputType>::
+    replica_loop (Replica &replica)
+    {
+      while (true)
+        {
+          std::pair<InputType,AuxiliaryData> sample_and_aux_data;
+          {
+            std::unique_lock<std::mutex> lock (replica.mutex);
+            replica.condition.wait (lock, [&]()
+            {
+              return (replica.shutting_down || !replica.queue.empty());
+            });
+
+            if (replica.queue.empty())
+              return;
+
+            sample_and_aux_data = std::move(replica.queue.front());
+            replica.queue.pop_front();
+          }
+
+          // Tell anyone waiting for space in the queue that there is now
+          // space available, then issue the sample outside the lock:
+          replica.condition.notify_all();
+          replica.issue (std::move(sample_and_aux_data.first),
+                         std::move(sample_and_aux_data.second));
+
+          {
+            std::lock_guard<std::mutex> lock (replica.mutex);
+            ++replica.n_issued_samples;
+            --replica.load;
+          }
+          replica.condition.notify_all();
+        }
+    }
+
+
+
+    template <typename InputType>
+    void
+    Router<InputType>::
+    flush ()
+    {
+      // First make sure that all calls to consume() have finished, so
+      // that no new samples can appear in the queues:
+      Consumer<InputType>::flush();
+
+      // Then wait for each replica to empty its queue and to finish
+      // issuing its last sample, and flush its consumers:
+      for (auto &replica : replicas)
+        {
+          {
+            std::unique_lock<std::mutex> lock (replica->mutex);
+            replica->condition.wait (lock, [&]()
+            {
+              return (replica->load == 0);
+            });
+          }
+          replica->flush();
+        }
+    }
+
+
+
+    template <typename InputType>
+    unsigned int
+    Router<InputType>::
+    n_replicas () const
+    {
+      return replicas.size();
+    }
+
+
+
+    template <typename InputType>
+    Producer<InputType> &
+    Router<InputType>::
+    replica (const unsigned int r)
+    {
+      assert (r < replicas.size());
+      return *replicas[r];
+    }
+
+
+
+    template <typename InputType>
+    std::vector<types::sample_index>
+    Router<InputType>::
+    get_replica_sample_counts () const
+    {
+      std::vector<types::sample_index> counts;
+      for (const auto &replica : replicas)
+        {
+          std::lock_guard<std::mutex> lock (replica->mutex);
+          counts.push_back (replica->n_issued_samples);
+        }
+      return counts;
+    }
+
+
+
+    template <typename InputType>
+    template <typename ValueType>
+    ValueType
+    Router<InputType>::
+    merge (const std::vector<ValueType> &replica_values,
+           const std::function<ValueType (const ValueType &, const types::sample_index,
+                                          const ValueType &, const types::sample_index)> &combine) const
+    {
+      assert (replica_values.size() == replicas.size());
+
+      const std::vector<types::sample_index> counts = get_replica_sample_counts();
+
+      ValueType merged_value {};
+      types::sample_index n_merged_samples = 0;
+      for (unsigned int r=0; r<replicas.size(); ++r)
+        if (counts[r] > 0)
+          {
+            if (n_merged_samples == 0)
+              merged_value = replica_values[r];
+            else
+              merged_value = combine (merged_value, n_merged_samples,
+                                      replica_values[r], counts[r]);
+            n_merged_samples += counts[r];
+          }
+
+      return merged_value;
+    }
+
+
+
+    template <typename InputType>
+    template <typename ValueType>
+    ValueType
+    Router<InputType>::
+    merge_averages (const std::vector<ValueType> &replica_values) const
+    {
+      return merge<ValueType> (replica_values,
+                               [](const ValueType &a, const types::sample_index n_a,
+                                  const ValueType &b, const types::sample_index n_b)
+      {
+        ValueType result = a;
+        result *= (1.*n_a/(n_a+n_b));
+
+        ValueType scaled_b = b;
+        scaled_b *= (1.*n_b/(n_a+n_b));
+        result += scaled_b;
+
+        return result;
+      });
+    }
+
+
+
+    template <typename InputType>
+    boost::numeric::ublas::matrix<types::ScalarType<InputType>>
+    Router<InputType>::
+    merge_covariances (const std::vector<InputType> &replica_means,
+                       const std::vector<boost::numeric::ublas::matrix<types::ScalarType<InputType>>> &replica_covariances) const
+    {
+      using scalar_type = types::ScalarType<InputType>;
+
+      assert (replica_means.size() == replicas.size());
+      assert (replica_covariances.size() == replicas.size());
+
+      const std::vector<types::sample_index> counts = get_replica_sample_counts();
+
+      // Accumulate the sum of squares (n-1)C, rather than C itself, along
+      // with the mean value of the replicas merged so far:
+      boost::numeric::ublas::matrix<scalar_type> sum_of_squares;
+      std::vector<scalar_type> merged_mean;
+      std::vector<scalar_type> replica_mean;
+      std::vector<scalar_type> delta;
+      types::sample_index n_merged_samples = 0;
+      unsigned int first_replica = replicas.size();
+      for (unsigned int r=0; r<replicas.size(); ++r)
+        if (counts[r] > 0)
+          {
+            const types::sample_index n_b = counts[r];
+            const double replica_weight = 1.*n_b - 1;
+
+            if (n_merged_samples == 0)
+              {
+                first_replica = r;
+                Utilities::copy_to_contiguous (replica_means[r], merged_mean);
+                sum_of_squares = replica_covariances[r];
+                sum_of_squares *= replica_weight;
+              }
+            else
+              {
+                const std::size_t n = merged_mean.size();
+                assert (replica_covariances[r].size1() == n);
+                assert (replica_covariances[r].size2() == n);
+
+                Utilities::copy_to_contiguous (replica_means[r], replica_mean);
+                assert (replica_mean.size() == n);
+
+                const double n_total = 1.*n_merged_samples + n_b;
+                delta.resize (n);
+                for (std::size_t i=0; i<n; ++i)
+                  delta[i] = replica_mean[i] - merged_mean[i];
+
+                const double cross_weight = 1.*n_merged_samples*n_b/n_total;
+                for (std::size_t i=0; i<n; ++i)
+                  for (std::size_t j=0; j<n; ++j)
+                    sum_of_squares(i,j) += replica_covariances[r](i,j) * replica_weight
+                                           + delta[i] * Utilities::conj(delta[j]) * cross_weight;
+
+                for (std::size_t i=0; i<n; ++i)
+                  merged_mean[i] += delta[i] * (n_b/n_total);
+              }
+
+            n_merged_samples += n_b;
+          }
+
+      // With a single sample, sum_of_squares has been multiplied by zero
+      // above, so return the covariance matrix of that sample's replica:
+      if (n_merged_samples < 2)
+        return (n_merged_samples == 0 ?
+                boost::numeric::ublas::matrix<scalar_type>() :
+                replica_covariances[first_replica]);
+
+      sum_of_squares /= (1.*n_merged_samples - 1);
+      return sum_of_squares;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,160 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_FILTERS_SELECT_CHAIN_H
+#define SAMPLEFLOW_FILTERS_SELECT_CHAIN_H
+
+#include <sampleflow/filter.h>
+
+#include <string>
+
+namespace SampleFlow
+{
+  namespace Filters
+  {
+    /**
+     * An implementation of the Filter interface that only passes on the
+     * samples of one chain of a producer that runs several chains at the
+     * same time and issues their samples interleaved, such as
+     * Producers::MultiChainMetropolisHastings. Which chain a sample belongs
+     * to is read from an entry of type `unsigned int` in the AuxiliaryData
+     * object that accompanies the sample; by default, this is the
+     * "chain index" entry. Samples that belong to other chains, or whose
+     * AuxiliaryData object does not contain the entry, are discarded.
+     *
+     * Consumers that assume that successive samples belong to the same
+     * chain (for example Consumers::AcceptanceRatio or
+     * Consumers::AutoCovarianceTrace) must not be connected to a
+     * multi-chain producer directly; instead, one creates one object of the
+     * current class per chain, and connects a separate consumer to each of
+     * them:
+     * @code
+     *   std::vector<std::unique_ptr<SampleFlow::Filters::SelectChain<SampleType>>> chains;
+     *   std::vector<std::unique_ptr<SampleFlow::Consumers::AcceptanceRatio<SampleType>>> acceptance_ratios;
+     *   for (unsigned int w=0; w<n_chains; ++w)
+     *     {
+     *       chains.emplace_back (new SampleFlow::Filters::SelectChain<SampleType>(w));
+     *       chains.back()->connect_to_producer (sampler);
+     *
+     *       acceptance_ratios.emplace_back (new SampleFlow::Consumers::AcceptanceRatio<SampleType>());
+     *       acceptance_ratios.back()->connect_to_producer (*chains.back());
+     *     }
+     * @endcode
+     *
+     *
+     * ### Threading model ###
+     *
+     * The implementation of this class is thread-safe, i.e., its
+     * filter() member function can be called concurrently and from multiple
+     * threads. (It does not store any state that could change.)
+     *
+     *
+     * @tparam InputType The C++ type used to describe the incoming samples.
+     *   For the current class, this is of course also the type used for
+     *   the outgoing samples.
+     */
+    template <typename InputType>
+    class SelectChain : public Filter<InputType, InputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] chain_index The index of the chain whose samples are to
+         *   be passed on.
+         * @param[in] aux_data_name The name of the AuxiliaryData entry that
+         *   stores the index of the chain a sample belongs to.
+         */
+        SelectChain (const unsigned int chain_index,
+                     const std::string &aux_data_name = "chain index");
+
+        /**
+         * Destructor. This function also makes sure that all samples this
+         * object may have received have been fully processed. To this end,
+         * it calls the Consumers::disconnect_and_flush() function of the
+         * base class.
+         */
+        virtual ~SelectChain ();
+
+        /**
+         * Process one sample by checking whether it belongs to the selected
+         * chain and if so, pass it on to downstream consumers. If it
+         * doesn't, return an empty object which the caller of this function
+         * in the base class will interpret as the instruction to discard the
+         * sample from further processing.
+         *
+         * @param[in] sample The sample to process.
+         * @param[in] aux_data Auxiliary data about this sample. It is
+         *   passed on unchanged.
+         *
+         * @return The sample and its auxiliary data if the sample belongs
+         *   to the selected chain. Otherwise, an empty object.
+         */
+        virtual
+        boost::optional<std::pair<InputType, AuxiliaryData> >
+        filter (InputType sample,
+                AuxiliaryData aux_data) override;
+
+      private:
+        /**
+         * The index of the chain to pass on, and the name of the
+         * AuxiliaryData entry to read chain indices from.
+         */
+        const unsigned int chain_index;
+        const std::string  aux_data_name;
+    };
+
+
+
+    template <typename InputType>
+    SelectChain<InputType>::
+    SelectChain (const unsigned int chain_index,
+                 const std::string &aux_data_name)
+      : chain_index (chain_index),
+        aux_data_name (aux_data_name)
+    {}
+
+
+
+    template <typename InputType>
+    SelectChain<InputType>::
+    ~SelectChain ()
+    {
+      this->disconnect_and_flush();
+    }
+
+
+
+    template <typename InputType>
+    boost::optional<std::pair<InputType, AuxiliaryData> >
+    SelectChain<InputType>::
+    filter (InputType sample,
+            AuxiliaryData aux_data)
+    {
+      const auto entry = aux_data.find (aux_data_name);
+      if ((entry != aux_data.end())
+          &&
+          (boost::any_cast<unsigned int>(entry->second) == chain_index))
+        return
+        {{ std::move(sample), std::move(aux_data)}};
+      else
+        return
+          {};
+    }
+
+  }
+}
+
+#endif
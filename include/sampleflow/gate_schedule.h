@@ -0,0 +1,153 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_GATE_SCHEDULE_H
+#define SAMPLEFLOW_GATE_SCHEDULE_H
+
+#include <sampleflow/types.h>
+
+#include <cassert>
+
+
+namespace SampleFlow
+{
+  /**
+   * A class that describes which of the samples sent to a Consumer (or
+   * Filter) object should actually be processed. This is set through the
+   * Consumer::set_gate_schedule() function, and is useful for diagnostics
+   * that are too expensive to run on every sample but that one wants to
+   * run periodically -- for example, computing a full
+   * Consumers::AutoCovarianceMatrix on 1,000 out of every 100,000 samples.
+   *
+   * A schedule is described by three numbers: An offset $o$, a window
+   * length $w$, and a period $p$. The $k$th sample (counting from zero)
+   * is then processed if $k\ge o$ and $(k-o) \mod p < w$. In other words,
+   * after skipping the first $o$ samples, the consumer processes $w$
+   * samples, then ignores $p-w$ samples, then processes the next $w$
+   * samples, etc. The static member functions of this class create
+   * schedules for common cases.
+   *
+   * Samples are counted in the order in which they arrive at the consumer,
+   * and only while the consumer is enabled (see Consumer::enable() and
+   * Consumer::disable()).
+   */
+  class GateSchedule
+  {
+    public:
+      /**
+       * Constructor. Create a schedule that lets all samples pass.
+       */
+      GateSchedule ();
+
+      /**
+       * Create a schedule that lets the first $w$ samples of every $p$
+       * samples pass, after skipping the first $o$ samples.
+       */
+      static
+      GateSchedule
+      periodic_window (const types::sample_index window_length,
+                       const types::sample_index period,
+                       const types::sample_index offset = 0);
+
+      /**
+       * Create a schedule that lets every $n$th sample pass, starting with
+       * the sample with index `offset`.
+       */
+      static
+      GateSchedule
+      every_nth (const types::sample_index n,
+                 const types::sample_index offset = 0);
+
+      /**
+       * Return whether the sample with index $k$ should be processed.
+       */
+      bool
+      is_open (const types::sample_index k) const;
+
+      /**
+       * Return whether this schedule lets all samples pass.
+       */
+      bool
+      is_always_open () const;
+
+    private:
+      /**
+       * The window length, period, and offset of the schedule.
+       */
+      types::sample_index window_length;
+      types::sample_index period;
+      types::sample_index offset;
+  };
+
+
+
+  inline
+  GateSchedule::GateSchedule ()
+    :
+    window_length (1),
+    period (1),
+    offset (0)
+  {}
+
+
+
+  inline
+  GateSchedule
+  GateSchedule::periodic_window (const types::sample_index window_length,
+                                 const types::sample_index period,
+                                 const types::sample_index offset)
+  {
+    assert (period > 0);
+    assert (window_length <= period);
+
+    GateSchedule schedule;
+    schedule.window_length = window_length;
+    schedule.period = period;
+    schedule.offset = offset;
+    return schedule;
+  }
+
+
+
+  inline
+  GateSchedule
+  GateSchedule::every_nth (const types::sample_index n,
+                           const types::sample_index offset)
+  {
+    return periodic_window (1, n, offset);
+  }
+
+
+
+  inline
+  bool
+  GateSchedule::is_open (const types::sample_index k) const
+  {
+    return ((k >= offset)
+            &&
+            ((k - offset) % period < window_length));
+  }
+
+
+
+  inline
+  bool
+  GateSchedule::is_always_open () const
+  {
+    return ((offset == 0) && (window_length == period));
+  }
+}
+
+#endif
@@ -0,0 +1,602 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_GRAPH_H
+#define SAMPLEFLOW_GRAPH_H
+
+#include <sampleflow/parallel_mode.h>
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <utility>
+#include <type_traits>
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+#include <cassert>
+
+
+namespace SampleFlow
+{
+  template <typename OutputType> class Producer;
+  template <typename InputType> class Consumer;
+
+  namespace internal
+  {
+    namespace Graph
+    {
+      /**
+       * A type-erased holder for an object owned by a SampleFlow::Graph,
+       * along with the information the graph needs about it.
+       */
+      struct Node
+      {
+        virtual ~Node () = default;
+
+        /**
+         * The addresses by which the object can be referred to: the address
+         * of the object itself and, if the object is a producer, consumer,
+         * or both (i.e., a filter), the addresses of its Producer and
+         * Consumer base class subobjects. These may differ from the address
+         * of the object itself if a class has more than one base class.
+         */
+        std::vector<const void *> addresses;
+
+        /**
+         * A function that calls `flush()` on the object. Empty if the
+         * object is not a consumer.
+         */
+        std::function<void ()> flush;
+
+        /**
+         * A function that returns whether the object is a consumer that
+         * can process samples asynchronously, and a function that switches
+         * it into asynchronous mode with the given queue size. Empty if the
+         * object is not a consumer.
+         */
+        std::function<bool ()> supports_asynchronous_mode;
+        std::function<void (const unsigned int)> set_asynchronous_mode;
+
+        /**
+         * Whether the user has marked the object as expensive, and the
+         * queue size to use if it is switched into asynchronous mode.
+         */
+        bool is_expensive = false;
+        unsigned int queue_size = 0;
+
+        /**
+         * The indices of the nodes this node sends samples to.
+         */
+        std::vector<std::size_t> successors;
+      };
+
+
+      /**
+       * The concrete holder for objects of type `T`.
+       */
+      template <typename T>
+      struct NodeHolder : public Node
+      {
+        template <typename... Args>
+        NodeHolder (Args &&... args)
+          :
+          object (std::forward<Args>(args)...)
+        {}
+
+        T object;
+      };
+
+
+      /**
+       * Return the Producer or Consumer base class subobject of the given
+       * object. These functions are only used to deduce the template
+       * arguments of the base classes of an object.
+       */
+      template <typename OutputType>
+      const Producer<OutputType> *
+      producer_base (const Producer<OutputType> *object)
+      {
+        return object;
+      }
+
+      template <typename InputType>
+      const Consumer<InputType> *
+      consumer_base (const Consumer<InputType> *object)
+      {
+        return object;
+      }
+
+
+      /**
+       * Add the address of the Producer base class subobject of the object
+       * stored in a node to the node's addresses if `T` is a producer, and
+       * likewise for the Consumer base class. The fallbacks do nothing.
+       */
+      template <typename T>
+      auto add_producer_address (NodeHolder<T> &node, int)
+      -> decltype(producer_base(std::declval<const T *>()), void())
+      {
+        node.addresses.push_back (producer_base (&node.object));
+      }
+
+      template <typename T>
+      void add_producer_address (NodeHolder<T> &, long)
+      {}
+
+      template <typename T>
+      auto add_consumer_address (NodeHolder<T> &node, int)
+      -> decltype(consumer_base(std::declval<const T *>()), void())
+      {
+        node.addresses.push_back (consumer_base (&node.object));
+      }
+
+      template <typename T>
+      void add_consumer_address (NodeHolder<T> &, long)
+      {}
+
+
+      /**
+       * Set up the consumer-related functions of a node if `T` is a
+       * consumer, i.e., if it has a `flush()` and a
+       * `get_supported_parallel_modes()` member function.
+       */
+      template <typename T>
+      auto setup_consumer (NodeHolder<T> &node, int)
+      -> decltype(std::declval<T &>().flush(),
+                  std::declval<T &>().get_supported_parallel_modes(),
+                  void())
+      {
+        T &object = node.object;
+        node.flush = [&object]()
+        {
+          object.flush();
+        };
+        node.supports_asynchronous_mode = [&object]()
+        {
+          return ((static_cast<int>(object.get_supported_parallel_modes())
+                   & static_cast<int>(ParallelMode::asynchronous)) != 0);
+        };
+        node.set_asynchronous_mode = [&object](const unsigned int queue_size)
+        {
+          object.set_parallel_mode (ParallelMode::asynchronous, queue_size);
+        };
+      }
+
+
+      /**
+       * The fallback for objects that are not consumers (i.e., producers).
+       */
+      template <typename T>
+      void setup_consumer (NodeHolder<T> &, long)
+      {}
+    }
+  }
+
+
+
+  /**
+   * A container that owns the producers, filters, and consumers that make
+   * up a SampleFlow graph, and that knows how they are connected.
+   *
+   * In the simplest use of SampleFlow, all of these objects are local
+   * variables that are connected by calling Consumer::connect_to_producer().
+   * This works, but it puts the burden of getting the details right on the
+   * user: Objects need to be destroyed in the right order, flushing needs
+   * to happen in the right order, and since no object knows about the
+   * graph as a whole, nothing can make decisions based on it. This class
+   * addresses these issues:
+   * - Objects are created by calling add(), which returns a reference to
+   *   the newly created object; the object is owned by the graph and lives
+   *   as long as the graph.
+   * - Objects are connected by calling connect(), which records the edge
+   *   and asserts that it does not create a cycle. Because the parallel
+   *   mode of a consumer can only be set before it is connected, edges are
+   *   only recorded by connect() and the actual connections are made in
+   *   build().
+   * - build() uses the global view of the graph to choose how each node
+   *   processes its samples: Consumers that have been marked as expensive
+   *   via mark_as_expensive(), that are leaves of the graph (i.e., that do
+   *   not send samples on to other nodes), and that support it, are
+   *   switched into asynchronous mode so that they run on worker threads
+   *   rather than blocking the producer. Nodes that are not leaves are not
+   *   switched, because this would change the order in which downstream
+   *   nodes see samples. build() then connects all edges, upstream nodes
+   *   first.
+   * - flush() flushes all consumers in topological order, i.e., each
+   *   consumer is only flushed after everything upstream of it has been
+   *   flushed.
+   * - The destructor flushes the graph and then destroys nodes in
+   *   topological order: When a node is destroyed, everything upstream of it
+   *   is already gone, so it can no longer receive samples, and everything
+   *   downstream of it is still alive to receive the samples it is still
+   *   processing.
+   *
+   * A typical use looks like this:
+   * @code
+   *   SampleFlow::Graph graph;
+   *   auto &sampler   = graph.add<Producers::MetropolisHastings<SampleType>>();
+   *   auto &thinning  = graph.add<Filters::TakeEveryNth<SampleType>>(10);
+   *   auto &mean      = graph.add<Consumers::MeanValue<SampleType>>();
+   *   auto &acm       = graph.add<Consumers::AutoCovarianceMatrix<SampleType>>(20);
+   *
+   *   graph.connect (sampler, thinning);
+   *   graph.connect (thinning, mean);
+   *   graph.connect (thinning, acm);
+   *   graph.mark_as_expensive (acm);
+   *   graph.build ();
+   *
+   *   sampler.sample (...);
+   * @endcode
+   *
+   * Objects can only be added to and connected in a graph before build()
+   * is called.
+   */
+  class Graph
+  {
+    public:
+      /**
+       * Constructor. Create an empty graph.
+       */
+      Graph ();
+
+      /**
+       * Destructor. Flush all consumers and then destroy all nodes in
+       * topological order.
+       */
+      ~Graph ();
+
+      /**
+       * Create an object of type `NodeType` by passing the given arguments to
+       * its constructor, and add it to the graph.
+       *
+       * @return A reference to the newly created object. The object is owned
+       *   by the graph.
+       */
+      template <typename NodeType, typename... Args>
+      NodeType &
+      add (Args &&... args);
+
+      /**
+       * Record that `consumer` is to receive the samples of `producer`. Both
+       * objects need to have been created by add(), and the edge must not
+       * create a cycle. The actual connection is made in build().
+       *
+       * The objects may be passed as references to the objects returned by
+       * add(), or as references to their Producer or Consumer base classes.
+       * If one of them has not been created by add(), an exception of type
+       * `std::invalid_argument` is thrown; the same is true for all other
+       * functions of this class that take a node as argument.
+       */
+      template <typename ProducerType, typename ConsumerType>
+      void
+      connect (ProducerType &producer,
+               ConsumerType &consumer);
+
+      /**
+       * Mark the given consumer as expensive. If it is a leaf of the graph
+       * and supports asynchronous processing, build() switches it into
+       * asynchronous mode with the given queue size. If the queue size is
+       * zero, the number of hardware threads is used.
+       */
+      template <typename NodeType>
+      void
+      mark_as_expensive (NodeType &node,
+                         const unsigned int queue_size = 0);
+
+      /**
+       * Choose the parallel modes of all nodes as described in the class
+       * documentation and connect all edges. Must be called exactly once,
+       * before any samples are produced.
+       */
+      void
+      build ();
+
+      /**
+       * Flush all consumers in topological order.
+       */
+      void
+      flush ();
+
+      /**
+       * Return the number of nodes in the graph.
+       */
+      std::size_t
+      n_nodes () const;
+
+      /**
+       * Return the indices of all nodes in topological order, i.e., such
+       * that each node comes after all of the nodes that send samples to it.
+       * Nodes are numbered in the order in which they were added.
+       */
+      std::vector<std::size_t>
+      topological_order () const;
+
+      /**
+       * Return whether the given node was switched into asynchronous mode by
+       * build().
+       */
+      template <typename NodeType>
+      bool
+      is_asynchronous (const NodeType &node) const;
+
+    private:
+      /**
+       * The nodes of the graph.
+       */
+      std::vector<std::unique_ptr<internal::Graph::Node> > nodes;
+
+      /**
+       * Functions that connect the edges of the graph, along with the
+       * index of the node upstream of the edge.
+       */
+      std::vector<std::pair<std::size_t, std::function<void ()> > > edges;
+
+      /**
+       * For each node, whether it was switched into asynchronous mode.
+       */
+      std::vector<bool> asynchronous;
+
+      /**
+       * Whether build() has been called.
+       */
+      bool is_built;
+
+      /**
+       * Return the index of the node at the given address, which may be the
+       * address of the object or of its Producer or Consumer base class
+       * subobjects. Throw an exception if there is no such node.
+       */
+      std::size_t
+      find_node (const void *address) const;
+
+      /**
+       * Return whether node `to` can be reached from node `from`
+       * by following edges.
+       */
+      bool
+      is_reachable (const std::size_t from,
+                    const std::size_t to) const;
+  };
+
+
+
+  inline
+  Graph::Graph ()
+    :
+    is_built (false)
+  {}
+
+
+
+  inline
+  Graph::~Graph ()
+  {
+    flush ();
+
+    for (const std::size_t n : topological_order())
+      nodes[n].reset ();
+  }
+
+
+
+  template <typename NodeType, typename... Args>
+  NodeType &
+  Graph::add (Args &&... args)
+  {
+    assert (is_built == false);
+
+    std::unique_ptr<internal::Graph::NodeHolder<NodeType> >
+    node (new internal::Graph::NodeHolder<NodeType>(std::forward<Args>(args)...));
+    node->addresses.push_back (&node->object);
+    internal::Graph::add_producer_address (*node, 0);
+    internal::Graph::add_consumer_address (*node, 0);
+    internal::Graph::setup_consumer (*node, 0);
+
+    NodeType &object = node->object;
+    nodes.emplace_back (std::move(node));
+    return object;
+  }
+
+
+
+  template <typename ProducerType, typename ConsumerType>
+  void
+  Graph::connect (ProducerType &producer,
+                  ConsumerType &consumer)
+  {
+    assert (is_built == false);
+
+    const std::size_t from = find_node (&producer);
+    const std::size_t to   = find_node (&consumer);
+
+    // Adding the edge creates a cycle if 'from' can already be
+    // reached from 'to' (including the case from==to):
+    assert (!is_reachable (to, from));
+
+    nodes[from]->successors.push_back (to);
+    edges.emplace_back (from,
+                        [&producer, &consumer]()
+    {
+      consumer.connect_to_producer (producer);
+    });
+  }
+
+
+
+  template <typename NodeType>
+  void
+  Graph::mark_as_expensive (NodeType &node,
+                            const unsigned int queue_size)
+  {
+    assert (is_built == false);
+
+    const std::size_t n = find_node (&node);
+    nodes[n]->is_expensive = true;
+    nodes[n]->queue_size = (queue_size == 0 ?
+                            std::max (1U, std::thread::hardware_concurrency()) :
+                            queue_size);
+  }
+
+
+
+  inline
+  void
+  Graph::build ()
+  {
+    assert (is_built == false);
+    is_built = true;
+
+    // First choose parallel modes: Expensive leaves that support it
+    // run asynchronously.
+    asynchronous.assign (nodes.size(), false);
+    for (std::size_t n=0; n<nodes.size(); ++n)
+      if (nodes[n]->is_expensive
+          && nodes[n]->successors.empty()
+          && nodes[n]->supports_asynchronous_mode
+          && nodes[n]->supports_asynchronous_mode())
+        {
+          nodes[n]->set_asynchronous_mode (nodes[n]->queue_size);
+          asynchronous[n] = true;
+        }
+
+    // Then connect the edges, upstream nodes first:
+    std::vector<std::size_t> position (nodes.size());
+    const std::vector<std::size_t> order = topological_order();
+    for (std::size_t i=0; i<order.size(); ++i)
+      position[order[i]] = i;
+
+    std::stable_sort (edges.begin(), edges.end(),
+                      [&position](const std::pair<std::size_t, std::function<void ()> > &a,
+                                  const std::pair<std::size_t, std::function<void ()> > &b)
+    {
+      return position[a.first] < position[b.first];
+    });
+    for (const auto &edge : edges)
+      edge.second ();
+  }
+
+
+
+  inline
+  void
+  Graph::flush ()
+  {
+    for (const std::size_t n : topological_order())
+      if (nodes[n] && nodes[n]->flush)
+        nodes[n]->flush ();
+  }
+
+
+
+  inline
+  std::size_t
+  Graph::n_nodes () const
+  {
+    return nodes.size();
+  }
+
+
+
+  inline
+  std::vector<std::size_t>
+  Graph::topological_order () const
+  {
+    // Kahn's algorithm. Among the nodes that are ready, always take the
+    // one with the smallest index so that the order is deterministic.
+    std::vector<std::size_t> n_predecessors (nodes.size(), 0);
+    for (const auto &node : nodes)
+      if (node)
+        for (const std::size_t s : node->successors)
+          ++n_predecessors[s];
+
+    std::vector<std::size_t> order;
+    std::vector<bool> done (nodes.size(), false);
+    while (order.size() < nodes.size())
+      {
+        std::size_t next = nodes.size();
+        for (std::size_t n=0; n<nodes.size(); ++n)
+          if (!done[n] && n_predecessors[n] == 0)
+            {
+              next = n;
+              break;
+            }
+        assert (next < nodes.size());
+
+        done[next] = true;
+        order.push_back (next);
+        if (nodes[next])
+          for (const std::size_t s : nodes[next]->successors)
+            --n_predecessors[s];
+      }
+
+    return order;
+  }
+
+
+
+  template <typename NodeType>
+  bool
+  Graph::is_asynchronous (const NodeType &node) const
+  {
+    assert (is_built == true);
+    return asynchronous[find_node (&node)];
+  }
+
+
+
+  inline
+  std::size_t
+  Graph::find_node (const void *address) const
+  {
+    for (std::size_t n=0; n<nodes.size(); ++n)
+      if (nodes[n]
+          &&
+          (std::find (nodes[n]->addresses.begin(), nodes[n]->addresses.end(), address)
+           != nodes[n]->addresses.end()))
+        return n;
+
+    // The object was not created by add(). Callers would index out of
+    // bounds with any index we could return, so we need to throw.
+    throw std::invalid_argument ("The object passed to a SampleFlow::Graph "
+                                 "function was not created by Graph::add().");
+  }
+
+
+
+  inline
+  bool
+  Graph::is_reachable (const std::size_t from,
+                       const std::size_t to) const
+  {
+    std::vector<bool> visited (nodes.size(), false);
+    std::vector<std::size_t> stack (1, from);
+    while (!stack.empty())
+      {
+        const std::size_t n = stack.back();
+        stack.pop_back();
+        if (n == to)
+          return true;
+        if (visited[n])
+          continue;
+        visited[n] = true;
+        for (const std::size_t s : nodes[n]->successors)
+          stack.push_back (s);
+      }
+    return false;
+  }
+}
+
+#endif
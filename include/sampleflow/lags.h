@@ -0,0 +1,80 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+#ifndef SAMPLEFLOW_LAGS_H
+#define SAMPLEFLOW_LAGS_H
+
+#include <cassert>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  namespace Utilities
+  {
+    /**
+     * Return the set of lags $0,1,\ldots,$`max_lag`. This is the set of
+     * lags for which classes such as Consumers::AutoCovarianceTrace and
+     * Consumers::AutoCovarianceMatrix compute auto-covariances if they are
+     * only given a maximal lag.
+     */
+    inline
+    std::vector<unsigned int>
+    consecutive_lags (const unsigned int max_lag)
+    {
+      std::vector<unsigned int> lags (max_lag+1);
+      for (unsigned int l=0; l<=max_lag; ++l)
+        lags[l] = l;
+      return lags;
+    }
+
+
+
+    /**
+     * Return a set of lags between zero and `max_lag` (inclusive) that are
+     * spaced approximately geometrically: Within each "octave"
+     * $[2^k,2^{k+1})$, the function returns `n_per_octave` equally spaced
+     * lags (or all lags in the octave if there are fewer than that). For
+     * example, for `n_per_octave=2`, the returned set is
+     * $0,1,2,3,4,6,8,12,16,24,\ldots$.
+     *
+     * Such lag sets are useful for slowly mixing chains, for which one needs
+     * to compute auto-covariances out to large lags to find out when
+     * samples become uncorrelated, but for which it does not matter
+     * whether the auto-covariance is known at lag 5,434 or 5,440. Computing
+     * auto-covariances only for a geometrically spaced set of lags makes the
+     * cost per sample proportional to $\log(\text{max\_lag})$ rather than
+     * to `max_lag`.
+     */
+    inline
+    std::vector<unsigned int>
+    geometric_lags (const unsigned int max_lag,
+                    const unsigned int n_per_octave = 2)
+    {
+      assert (n_per_octave >= 1);
+
+      std::vector<unsigned int> lags (1, 0);
+      for (unsigned long long octave_start=1; octave_start<=max_lag; octave_start*=2)
+        for (unsigned int j=0; j<n_per_octave; ++j)
+          {
+            const unsigned long long lag = octave_start + (octave_start*j)/n_per_octave;
+            if ((lag > lags.back()) && (lag <= max_lag))
+              lags.push_back (lag);
+          }
+      return lags;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,231 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_LINEAR_ALGEBRA_H
+#define SAMPLEFLOW_LINEAR_ALGEBRA_H
+
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <complex>
+#include <vector>
+#include <cstddef>
+
+
+namespace SampleFlow
+{
+  namespace Utilities
+  {
+    /**
+     * Copy the elements of a sample into a contiguous array of its scalar
+     * type, resizing the array if necessary. Consumers that perform
+     * ${\cal O}(d^2)$ work per sample use this to obtain an array on which
+     * the kernels below can operate, at a cost of ${\cal O}(d)$.
+     */
+    template <typename SampleType>
+    void
+    copy_to_contiguous (const SampleType &sample,
+                        std::vector<types::ScalarType<SampleType>> &values)
+    {
+      const unsigned int n = Utilities::size(sample);
+      values.resize (n);
+      for (unsigned int i=0; i<n; ++i)
+        values[i] = Utilities::get_nth_element(sample, i);
+    }
+
+
+
+    /**
+     * Return the index of the element $(i,j)$, $i\le j$, of a Hermitian (or
+     * symmetric) $n\times n$ matrix in an array that stores only the upper
+     * triangle of the matrix, row by row.
+     */
+    inline
+    std::size_t
+    packed_upper_triangle_index (const std::size_t i,
+                                 const std::size_t j,
+                                 const std::size_t n)
+    {
+      return i*n - i*(i+1)/2 + j;
+    }
+
+
+
+    /**
+     * Compute $\sum_{i=0}^{n-1} x_i \overline{y_i}$. This is the general
+     * implementation for real-valued scalars.
+     */
+    template <typename T>
+    T
+    dot_conj (const T *x,
+              const T *y,
+              const std::size_t n)
+    {
+      T sum = 0;
+      for (std::size_t i=0; i<n; ++i)
+        sum += x[i] * y[i];
+      return sum;
+    }
+
+
+
+    /**
+     * Compute $\sum_{i=0}^{n-1} x_i \overline{y_i}$ for complex-valued
+     * arrays. `std::complex<T>` is guaranteed to be laid out as two
+     * consecutive objects of type `T`, and this function treats the
+     * arrays as interleaved real and imaginary parts so that the loop only
+     * involves real arithmetic and can be vectorized.
+     */
+    template <typename T>
+    std::complex<T>
+    dot_conj (const std::complex<T> *x,
+              const std::complex<T> *y,
+              const std::size_t n)
+    {
+      const T *xx = reinterpret_cast<const T *>(x);
+      const T *yy = reinterpret_cast<const T *>(y);
+
+      // (a+ib)(c-id) = (ac+bd) + i(bc-ad)
+      T real = 0;
+      T imag = 0;
+      for (std::size_t i=0; i<n; ++i)
+        {
+          real += xx[2*i] * yy[2*i]   + xx[2*i+1] * yy[2*i+1];
+          imag += xx[2*i+1] * yy[2*i] - xx[2*i] * yy[2*i+1];
+        }
+      return {real, imag};
+    }
+
+
+
+    /**
+     * Perform the update $A_{ij} \leftarrow a A_{ij} + b x_i \overline{y_j}$
+     * for an $n\times n$ matrix $A$ stored row by row in a contiguous
+     * array. This is the general implementation for real-valued scalars.
+     */
+    template <typename T>
+    void
+    scaled_rank1_update (T *A,
+                         const T *x,
+                         const T *y,
+                         const std::size_t n,
+                         const double a,
+                         const double b)
+    {
+      for (std::size_t i=0; i<n; ++i)
+        {
+          const T bx_i = b * x[i];
+          T *A_i = A + i*n;
+          for (std::size_t j=0; j<n; ++j)
+            A_i[j] = a * A_i[j] + bx_i * y[j];
+        }
+    }
+
+
+
+    /**
+     * Perform the update $A_{ij} \leftarrow a A_{ij} + b x_i \overline{y_j}$
+     * for complex-valued arrays, operating on interleaved real and
+     * imaginary parts.
+     */
+    template <typename T>
+    void
+    scaled_rank1_update (std::complex<T> *A,
+                         const std::complex<T> *x,
+                         const std::complex<T> *y,
+                         const std::size_t n,
+                         const double a,
+                         const double b)
+    {
+      const T *yy = reinterpret_cast<const T *>(y);
+      for (std::size_t i=0; i<n; ++i)
+        {
+          const T bx_re = b * x[i].real();
+          const T bx_im = b * x[i].imag();
+          T *A_i = reinterpret_cast<T *>(A + i*n);
+          for (std::size_t j=0; j<n; ++j)
+            {
+              A_i[2*j]   = a * A_i[2*j]   + (bx_re * yy[2*j]   + bx_im * yy[2*j+1]);
+              A_i[2*j+1] = a * A_i[2*j+1] + (bx_im * yy[2*j]   - bx_re * yy[2*j+1]);
+            }
+        }
+    }
+
+
+
+    /**
+     * Perform the update $A_{ij} \leftarrow a A_{ij} + b x_i \overline{x_j}$
+     * for a Hermitian (or, for real scalars, symmetric) $n\times n$ matrix
+     * $A$ of which only the upper triangle is stored, row by row (see
+     * packed_upper_triangle_index()). This is the general implementation for
+     * real-valued scalars.
+     */
+    template <typename T>
+    void
+    scaled_hermitian_rank1_update (T *A,
+                                   const T *x,
+                                   const std::size_t n,
+                                   const double a,
+                                   const double b)
+    {
+      for (std::size_t i=0; i<n; ++i)
+        {
+          const T bx_i = b * x[i];
+          T *A_i = A + packed_upper_triangle_index(i, i, n);
+          const T *x_i = x + i;
+          for (std::size_t j=0; j<n-i; ++j)
+            A_i[j] = a * A_i[j] + bx_i * x_i[j];
+        }
+    }
+
+
+
+    /**
+     * Perform the update $A_{ij} \leftarrow a A_{ij} + b x_i \overline{x_j}$
+     * for a Hermitian matrix with complex-valued entries of which only the
+     * upper triangle is stored, operating on interleaved real and imaginary
+     * parts.
+     */
+    template <typename T>
+    void
+    scaled_hermitian_rank1_update (std::complex<T> *A,
+                                   const std::complex<T> *x,
+                                   const std::size_t n,
+                                   const double a,
+                                   const double b)
+    {
+      for (std::size_t i=0; i<n; ++i)
+        {
+          const T bx_re = b * x[i].real();
+          const T bx_im = b * x[i].imag();
+          T *A_i = reinterpret_cast<T *>(A + packed_upper_triangle_index(i, i, n));
+          const T *x_i = reinterpret_cast<const T *>(x + i);
+
+          // The diagonal entry is real. Treat it separately so that
+          // round-off does not create an imaginary part.
+          A_i[0] = a * A_i[0] + (bx_re * x_i[0] + bx_im * x_i[1]);
+          A_i[1] = a * A_i[1];
+
+          for (std::size_t j=1; j<n-i; ++j)
+            {
+              A_i[2*j]   = a * A_i[2*j]   + (bx_re * x_i[2*j]   + bx_im * x_i[2*j+1]);
+              A_i[2*j+1] = a * A_i[2*j+1] + (bx_im * x_i[2*j]   - bx_re * x_i[2*j+1]);
+            }
+        }
+    }
+  }
+}
+
+#endif
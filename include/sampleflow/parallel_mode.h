@@ -100,7 +100,87 @@ namespace SampleFlow
      *   samples are written to the stream in the order in which they were
      *   sent (though this may not in fact be the case).
      */
-    asynchronous = 2
+    asynchronous = 2,
+
+    /**
+     * Process samples on a separate thread that is owned by the Consumer
+     * or Filter object, and that receives samples from each upstream
+     * connection through its own queue (an "ingestion lane", implemented
+     * by the Utilities::SPSCQueue class).
+     *
+     * This mode is meant for consumers that are fed by many producers at
+     * once -- say, the chains of a multi-chain sampler each running on
+     * their own thread. In the other two modes, every sample these
+     * producers send contends for the same locks: a mutex of the Consumer
+     * base class that protects the list of pending tasks, and typically
+     * also the mutex with which the derived class protects its state.
+     * With many producers, this contention quickly limits how many chains
+     * one can usefully run. In contrast, in the `ingestion` mode, a producer
+     * only ever writes into its own lane, which does not require taking
+     * a lock, and a single thread drains all lanes in batches and calls
+     * Consumer::consume() for each sample. The producer does not have to
+     * wait for the sample to be processed, unless its lane is full (the
+     * size of each lane is the "queue size" argument to
+     * Consumer::set_parallel_mode()).
+     *
+     * Because consume() is only ever called from a single thread, and
+     * because samples from each upstream connection are processed in the
+     * order in which they were sent, this mode can be used with all
+     * consumers, whether or not they care about the order of samples; it
+     * does not have to be listed among the parallel modes the consumer
+     * supports. Samples from different connections are interleaved in
+     * an unspecified way, just as in the `synchronous` mode.
+     *
+     * The fact that consume() is only called from the thread that drains
+     * the lanes is also used to make the consumer's state cheaper to
+     * protect: The Utilities::SingleWriterMutex objects of consumers in
+     * this mode do not lock anything when consume() writes to the state.
+     * Code that calls consume() directly, rather than through a connection
+     * -- for example Consumers::SampleStore::replay() or
+     * Filters::ReplayBuffer::connect_with_history() -- must therefore not
+     * be used with consumers in this mode, since that would call consume()
+     * from a second thread.
+     */
+    ingestion = 4
+  };
+
+
+  /**
+   * An enumeration that designates how urgently a Consumer (or Filter)
+   * object that processes samples asynchronously should be given
+   * computational resources, relative to other such objects. This is set
+   * through the Consumer::set_priority() function.
+   *
+   * Consumers for which a priority has been set run their tasks on the
+   * shared thread pool returned by Utilities::shared_thread_pool(), which
+   * always starts the pending task with the highest priority first. This
+   * way, consumers whose results are needed quickly (for example, a
+   * consumer that monitors convergence and whose results the producer
+   * polls) are kept up to date, whereas the tasks of consumers that just
+   * need to eventually see all samples (for example, output to a file or a
+   * large Consumers::AutoCovarianceMatrix) only run when there is nothing
+   * more urgent to do. While the machine is busy, the number of pending
+   * tasks of each such consumer is bounded by the `queue_size` given to
+   * Consumer::set_parallel_mode(); beyond that, the consumer processes
+   * samples on the thread that sends them, and so throttles its producer.
+   * See Consumer::set_priority() for details.
+   */
+  enum class Priority : int
+  {
+    /**
+     * Bulk work that should only use otherwise idle resources.
+     */
+    low = -1,
+
+    /**
+     * The default.
+     */
+    normal = 0,
+
+    /**
+     * Latency-sensitive work that should overtake everything else.
+     */
+    high = 1
   };
 }
 
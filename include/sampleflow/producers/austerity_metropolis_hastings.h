@@ -0,0 +1,277 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_AUSTERITY_METROPOLIS_HASTINGS_H
+#define SAMPLEFLOW_PRODUCERS_AUSTERITY_METROPOLIS_HASTINGS_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/types.h>
+
+#include <boost/math/distributions/students_t.hpp>
+
+#include <random>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <numeric>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the approximate, "austerity" variant of the
+     * Metropolis-Hastings algorithm described in
+     * A. Korattikara, Y. Chen, M. Welling: "Austerity in MCMC land: Cutting
+     * the Metropolis-Hastings budget", Proceedings of the 31st International
+     * Conference on Machine Learning, 2014.
+     *
+     * The algorithm is intended for posterior distributions of the form
+     * @f{align*}{
+     *   \pi(x) \propto p(x) \prod_{i=0}^{N-1} p(y_i|x),
+     * @f}
+     * i.e., with a prior $p(x)$ and a likelihood that is the product of
+     * the likelihoods of $N$ independent data points $y_i$. If $N$ is
+     * very large, evaluating $\pi(x)$ is expensive, and that is
+     * what the MetropolisHastings class needs to do for every trial sample.
+     * However, most accept/reject decisions are clear-cut and one does not
+     * actually need to look at *all* data points to determine with high
+     * confidence whether or not to accept a trial sample $\tilde x$.
+     *
+     * The standard Metropolis-Hastings algorithm accepts $\tilde x$ if
+     * @f{align*}{
+     *   \frac 1N \sum_{i=0}^{N-1} \ell_i
+     *   >
+     *   \mu_0
+     *   =
+     *   \frac 1N \left[\log u + \log p(x) - \log p(\tilde x)
+     *                  + \log\frac{\pi_\text{proposal}(\tilde x|x)}
+     *                             {\pi_\text{proposal}(x|\tilde x)}\right],
+     * @f}
+     * where $\ell_i = \log p(y_i|\tilde x) - \log p(y_i|x)$ and $u$ is a
+     * uniformly distributed random number in $[0,1]$. The left hand
+     * side is the mean of the $\ell_i$ over the whole data set. The
+     * austerity algorithm instead looks at a random subset (drawn without
+     * replacement) of $n<N$ data points, computes the mean $\bar\ell$ and
+     * standard deviation $s$ of the $\ell_i$ over this subset, and performs
+     * a Student t-test with test statistic
+     * $t = (\bar\ell-\mu_0)/\sigma$ where
+     * $\sigma = \frac{s}{\sqrt{n}}\sqrt{1-\frac{n-1}{N-1}}$ is the
+     * standard error of the mean, including the correction for a finite
+     * population. If the probability of the t-statistic being at least
+     * $|t|$ is less than a given tolerance $\varepsilon$, then the algorithm
+     * decides to accept the trial sample if $\bar\ell>\mu_0$ and to
+     * reject it otherwise. If the test is inconclusive, more data points
+     * are added to the subset and the test is repeated. In the worst case,
+     * all $N$ data points are used and the decision is then the same as
+     * for the exact Metropolis-Hastings algorithm.
+     *
+     * The result is an *approximate* Markov chain whose stationary
+     * distribution differs from $\pi(x)$ by an amount that is controlled
+     * by $\varepsilon$; for $\varepsilon=0$, the algorithm reduces to the
+     * exact Metropolis-Hastings algorithm. The benefit is that most
+     * decisions only need to look at a small fraction of the data set.
+     *
+     * The AuxiliaryData object associated with each sample stores two
+     * entries:
+     * - An entry with name "sample is repeated" that stores a `bool`
+     *   indicating whether the algorithm has chosen the current
+     *   sample as an accepted trial sample (if `false`) or whether
+     *   it is a repeated sample because the trial sample has been
+     *   rejected (if `true`).
+     * - An entry with name "number of data points evaluated" of type
+     *   `types::sample_index` that stores how many data points were
+     *   needed to make the decision for the current step.
+     *
+     * Unlike the MetropolisHastings class, this class does not attach the
+     * "relative log likelihood" of samples since it never computes it.
+     *
+     * @tparam OutputType The type of the samples $x$.
+     */
+    template <typename OutputType>
+    class AusterityMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects.
+         *
+         * @param[in] starting_point The initial sample $x_0$.
+         * @param[in] log_prior A function object that, when called with a
+         *   sample $x$, returns $\log(p(x))$.
+         * @param[in] log_likelihood_term A function object that, when called
+         *   with a sample $x$ and the index $i$ of a datum, returns
+         *   $\log(p(y_i|x))$. (Objects of type
+         *   Utilities::DataParallelLogLikelihood provide such a function via
+         *   their `term()` member function.)
+         * @param[in] n_data The number $N$ of data points.
+         * @param[in] perturb A function object that, when given a sample
+         *   $x$, returns a trial sample $\tilde x$ and the ratio
+         *   $\frac{\pi_\text{proposal}(\tilde x|x)}
+         *         {\pi_\text{proposal}(x|\tilde x)}$. This is the same
+         *   as for the MetropolisHastings class.
+         * @param[in] n_samples The number of (new) samples to be produced.
+         * @param[in] batch_size The number of data points that are added to
+         *   the subset used in the sequential test every time the test is
+         *   inconclusive. Must be at least two.
+         * @param[in] error_tolerance The tolerance $\varepsilon$ used in
+         *   the sequential test. Typical values are around 0.01 to 0.1.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &)> &log_prior,
+                const std::function<double (const OutputType &, const std::size_t)> &log_likelihood_term,
+                const std::size_t n_data,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const unsigned int n_samples,
+                const std::size_t batch_size,
+                const double error_tolerance);
+    };
+
+
+    template <typename OutputType>
+    void
+    AusterityMetropolisHastings<OutputType>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &)> &log_prior,
+            const std::function<double (const OutputType &, const std::size_t)> &log_likelihood_term,
+            const std::size_t n_data,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+            const unsigned int n_samples,
+            const std::size_t batch_size,
+            const double error_tolerance)
+    {
+      assert (batch_size >= 2);
+      assert (n_data >= 2);
+
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      std::mt19937 rng;
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      // A permutation of the data indices. In each step, we draw data points
+      // without replacement by moving randomly selected indices to the front
+      // of this array (a partial Fisher-Yates shuffle). Because we just
+      // continue shuffling the permutation of the previous step, the result
+      // is a uniformly distributed subset in each step.
+      std::vector<std::size_t> permutation (n_data);
+      std::iota (permutation.begin(), permutation.end(), std::size_t(0));
+
+      OutputType current_sample          = starting_point;
+      double     current_log_prior       = log_prior (current_sample);
+
+      // Loop over the desired number of samples
+      for (unsigned int i=0; i<n_samples; ++i)
+        {
+          // Obtain a new sample by perturbation
+          std::pair<OutputType,double> trial_sample_and_ratio = perturb (current_sample);
+          OutputType trial_sample = std::move(trial_sample_and_ratio.first);
+          const double proposal_distribution_ratio = trial_sample_and_ratio.second;
+
+          const double trial_log_prior = log_prior (trial_sample);
+
+          // Compute the threshold mu_0 the mean of the log likelihood
+          // differences has to exceed:
+          const double mu_0 = (std::log(uniform_distribution(rng))
+                               + current_log_prior - trial_log_prior
+                               + std::log(proposal_distribution_ratio)) / n_data;
+
+          // Then run the sequential test on growing subsets of the data:
+          // Accumulate the mean and the sum of squared deviations from
+          // the mean of the l_i with Welford's update. Unlike computing
+          // the variance from the sum of squares, this yields exactly
+          // zero if all l_i are the same.
+          double mean = 0;
+          double sum_of_squared_deviations = 0;
+          std::size_t n_used = 0;
+          bool accept;
+          while (true)
+            {
+              const std::size_t n_new = std::min (batch_size, n_data-n_used);
+              for (std::size_t k=n_used; k<n_used+n_new; ++k)
+                {
+                  std::uniform_int_distribution<std::size_t> index_distribution (k, n_data-1);
+                  std::swap (permutation[k], permutation[index_distribution(rng)]);
+
+                  const double l = log_likelihood_term (trial_sample, permutation[k])
+                                   - log_likelihood_term (current_sample, permutation[k]);
+                  const double deviation = l - mean;
+                  mean += deviation / (k+1);
+                  sum_of_squared_deviations += deviation * (l - mean);
+                }
+              n_used += n_new;
+
+              // If we have looked at all data, we have the exact answer:
+              if (n_used == n_data)
+                {
+                  accept = (mean > mu_0);
+                  break;
+                }
+
+              // Otherwise compute the standard error of the mean,
+              // including the finite population correction:
+              const double variance = sum_of_squared_deviations / (n_used-1);
+              const double standard_error = std::sqrt(variance / n_used)
+                                            * std::sqrt(1. - (n_used-1.)/(n_data-1.));
+
+              // If all of the differences seen so far are the same (for
+              // example because of duplicated data points), then the
+              // estimated standard error is zero. This does not mean that
+              // there is no uncertainty about the data points we have not
+              // looked at yet, and the t-test is meaningless in this case;
+              // so just look at more data. Otherwise compute the
+              // probability of exceeding the t-statistic.
+              if (standard_error == 0)
+                continue;
+
+              const double t = (mean - mu_0) / standard_error;
+              const boost::math::students_t distribution (n_used-1);
+              const double delta = boost::math::cdf (boost::math::complement (distribution,
+                                                                               std::fabs(t)));
+              if (delta < error_tolerance)
+                {
+                  accept = (mean > mu_0);
+                  break;
+                }
+            }
+
+          if (accept)
+            {
+              current_sample    = std::move(trial_sample);
+              current_log_prior = trial_log_prior;
+            }
+
+          // Output the new sample (which may be equal to the old sample).
+          this->issue_sample (current_sample,
+          {
+            {"sample is repeated", boost::any(!accept)},
+            {"number of data points evaluated", boost::any(types::sample_index(n_used))}
+          });
+        }
+    }
+
+  }
+}
+
+
+#endif
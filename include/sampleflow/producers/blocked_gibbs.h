@@ -0,0 +1,226 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_BLOCKED_GIBBS_H
+#define SAMPLEFLOW_PRODUCERS_BLOCKED_GIBBS_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/types.h>
+
+#include <random>
+#include <cstddef>
+#include <vector>
+#include <functional>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of a (blocked) Gibbs sampler for distributions
+     * $\pi(x)$ where $x=(x_0,x_1,\ldots,x_{N-1})$ consists of components
+     * (or blocks of components) $x_i$ for each of which one can draw
+     * directly from the conditional distribution
+     * $\pi(x_i|x_{\setminus i})$ of that component given all others.
+     * A Gibbs sampler then produces a Markov chain whose stationary
+     * distribution is $\pi$ by repeatedly replacing each component by a
+     * draw from its conditional distribution.
+     *
+     * In many models -- in particular Markov random fields defined on
+     * graphs or meshes -- the conditional distribution of $x_i$ only
+     * depends on a small number of "neighboring" components. If one
+     * partitions the components into groups ("colors") so that no two
+     * components of the same color are neighbors of each other, then all
+     * components of one color are conditionally independent given the
+     * components of all other colors, and they can therefore be updated
+     * at the same time. For example, for a chain or a regular grid, one
+     * can use a "red-black" coloring with two colors. This class uses
+     * such a coloring to update all components of one color in parallel
+     * on the threads of a Utilities::ThreadPool object, and does so for
+     * one color after the other. Once all colors have been processed
+     * (a "sweep"), the current state is issued to all connected consumers.
+     *
+     * The state is updated in place: The user-provided conditional sampler
+     * receives a reference to the current state and only overwrites the
+     * component it is asked to update, and the state is never copied
+     * between colors. As a consequence, the conditional sampler is called
+     * concurrently from several threads on the same state object, and it
+     * must only read from components of other colors and only write to the
+     * component it is asked to update. In particular, the `OutputType`
+     * must allow concurrent writes to different components -- which is
+     * the case for `std::valarray<double>` or `std::vector<double>`, but
+     * not for `std::vector<bool>`.
+     *
+     * To update the components of one color, the list `colors[c]` of these
+     * components is cut into a number of contiguous "chunks", and each chunk
+     * is a unit of work for the thread pool: its components are updated one
+     * after the other using a random number generator that belongs to the
+     * chunk and that is seeded with the index of the sweep, the color, and
+     * the chunk. The random numbers a component's update draws therefore
+     * only depend on which chunk it falls into and which components precede
+     * it within that chunk -- not on which thread happens to execute the
+     * chunk or when. As long as the number of chunks stays the same, a run
+     * consequently produces the same samples on every machine.
+     *
+     * Since the Gibbs sampler never evaluates $\pi(x)$, the samples issued
+     * by this class are not accompanied by any auxiliary data.
+     *
+     * @tparam OutputType The type of the samples $x$. It needs to be a type
+     *   whose components can be updated in place, for example
+     *   `std::valarray<double>`.
+     */
+    template <typename OutputType>
+    class BlockedGibbs : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] thread_pool The thread pool on which the components of
+         *   each color are updated. This class stores a reference to this
+         *   object, so it needs to live at least as long as the current
+         *   object.
+         * @param[in] n_chunks The number of chunks into which the list of
+         *   components of each color is cut. Since the chunk boundaries
+         *   determine which random number stream each component's update
+         *   uses, changing this number changes the samples that are
+         *   produced, and the default is a fixed value for this reason.
+         *   Using more chunks than threads also helps balance the work if
+         *   the cost of `conditional_sampler` differs between components.
+         *   Passing zero selects one chunk per thread of `thread_pool`, in
+         *   which case the samples depend on the size of the pool.
+         */
+        BlockedGibbs (Utilities::ThreadPool &thread_pool,
+                      const unsigned int n_chunks = 16);
+
+        /**
+         * The principal function of this class. Starting from the given
+         * initial state $x_0$, it performs `n_samples` sweeps over all
+         * colors and issues the state after each sweep.
+         *
+         * @param[in] starting_point The initial state $x_0$.
+         * @param[in] conditional_sampler A function that, when called with
+         *   the current state $x$, the index $i$ of a component (or block
+         *   of components), and a random number generator, replaces $x_i$
+         *   by a draw from $\pi(x_i|x_{\setminus i})$. What a "component"
+         *   is, is entirely up to this function: it may be a single entry
+         *   of a vector, or a block of entries. This function is called
+         *   concurrently from several threads for different components of
+         *   the same color, but each call receives a random number generator
+         *   that is not shared with any other concurrent call.
+         * @param[in] colors A partition of the components into colors:
+         *   `colors[c]` is the list of indices of all components of color
+         *   `c`. Components of the same color must be conditionally
+         *   independent given the components of all other colors. Every
+         *   component should appear in exactly one color.
+         * @param[in] n_samples The number of sweeps to be performed, and
+         *   consequently the number of samples to be produced.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<void (OutputType &, const std::size_t, std::mt19937 &)> &conditional_sampler,
+                const std::vector<std::vector<std::size_t>> &colors,
+                const types::sample_index n_samples);
+
+      private:
+        /**
+         * A reference to the thread pool on which we do our work.
+         */
+        Utilities::ThreadPool &thread_pool;
+
+        /**
+         * The number of chunks into which the components of each color
+         * are split.
+         */
+        const unsigned int n_chunks;
+
+        /**
+         * The number of sweeps performed so far. This is used to seed the
+         * random number generators of each chunk so that subsequent calls
+         * to sample() produce different samples.
+         */
+        types::sample_index n_sweeps;
+    };
+
+
+
+    template <typename OutputType>
+    BlockedGibbs<OutputType>::
+    BlockedGibbs (Utilities::ThreadPool &thread_pool,
+                  const unsigned int n_chunks)
+      :
+      thread_pool (thread_pool),
+      n_chunks (n_chunks == 0 ? thread_pool.n_threads() : n_chunks),
+      n_sweeps (0)
+    {}
+
+
+
+    template <typename OutputType>
+    void
+    BlockedGibbs<OutputType>::
+    sample (const OutputType &starting_point,
+            const std::function<void (OutputType &, const std::size_t, std::mt19937 &)> &conditional_sampler,
+            const std::vector<std::vector<std::size_t>> &colors,
+            const types::sample_index n_samples)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      OutputType current_sample = starting_point;
+
+      for (types::sample_index i=0; i<n_samples; ++i)
+        {
+          const types::sample_index sweep = n_sweeps++;
+
+          // Update one color after the other. Within each color, the
+          // components are independent of each other, so we can update
+          // them in parallel and in place.
+          for (unsigned int color=0; color<colors.size(); ++color)
+            {
+              const std::vector<std::size_t> &components = colors[color];
+
+              thread_pool.parallel_for (0, components.size(), n_chunks,
+                                        [&](const std::size_t begin,
+                                            const std::size_t end,
+                                            const unsigned int chunk)
+              {
+                std::seed_seq seed {static_cast<unsigned int>(sweep),
+                                    static_cast<unsigned int>(sweep >> 32),
+                                    color,
+                                    chunk};
+                std::mt19937 rng (seed);
+
+                for (std::size_t c=begin; c<end; ++c)
+                  conditional_sampler (current_sample, components[c], rng);
+              });
+            }
+
+          // Output the state at the end of the sweep.
+          this->issue_sample (current_sample, {});
+        }
+    }
+
+  }
+}
+
+
+#endif
@@ -0,0 +1,270 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_DELAYED_REJECTION_METROPOLIS_HASTINGS_H
+#define SAMPLEFLOW_PRODUCERS_DELAYED_REJECTION_METROPOLIS_HASTINGS_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/scope_exit.h>
+
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the two-stage "delayed rejection" variant of
+     * the Metropolis-Hastings algorithm described in
+     * L. Tierney, A. Mira: "Some adaptive Monte Carlo methods for Bayesian
+     * inference", Statistics in Medicine, vol. 18, pp. 2507-2515, 1999,
+     * and A. Mira: "On Metropolis-Hastings algorithms with delayed
+     * rejection", Metron, vol. 59, pp. 231-241, 2001.
+     *
+     * In the MetropolisHastings class, every trial sample requires an
+     * evaluation of the likelihood $\pi(x)$, and if the trial sample is
+     * rejected, the chain simply repeats the previous sample. If evaluating
+     * the likelihood is expensive, this is wasteful. The delayed rejection
+     * algorithm instead uses a rejection of a first trial sample $y_1$
+     * (drawn from a proposal distribution $q_1(y_1|x)$ that is typically
+     * rather wide) as the trigger to try a second trial sample $y_2$ that
+     * is drawn from a second proposal distribution $q_2(y_2|x)$, typically
+     * one with a smaller scale. The first trial sample is accepted with the
+     * usual probability
+     * @f{align*}{
+     *   \alpha_1(x,y_1) = \min\left\{1,
+     *     \frac{\pi(y_1) q_1(x|y_1)}{\pi(x) q_1(y_1|x)} \right\},
+     * @f}
+     * whereas the second trial sample, if it is needed, is accepted with
+     * probability
+     * @f{align*}{
+     *   \alpha_2(x,y_1,y_2) = \min\left\{1,
+     *     \frac{\pi(y_2) q_1(y_1|y_2) q_2(x|y_2) [1-\alpha_1(y_2,y_1)]}
+     *          {\pi(x) q_1(y_1|x) q_2(y_2|x) [1-\alpha_1(x,y_1)]} \right\}.
+     * @f}
+     * This choice preserves detailed balance with respect to $\pi$, and
+     * consequently the chain still has $\pi$ as its stationary distribution.
+     * Importantly, evaluating $\alpha_2$ requires $\pi(y_1)$, which has
+     * already been computed in the first stage; the only additional
+     * likelihood evaluation is the one for $y_2$. As a consequence, each
+     * step requires either one or two evaluations of the likelihood, and
+     * because the second stage only happens when the first trial sample
+     * was rejected, the fraction of repeated samples is lower than for
+     * the MetropolisHastings class using the first stage proposal
+     * distribution alone.
+     *
+     * Unlike for the MetropolisHastings class, it is not sufficient to know
+     * the *ratio* of proposal probabilities for the first stage: The formula
+     * for $\alpha_2$ contains the factor $q_1(y_1|y_2)/q_1(y_1|x)$ that
+     * compares transitions from two different points to $y_1$, and this
+     * factor is not equal to one even for symmetric proposal distributions.
+     * As a consequence, the sample() function also requires a function
+     * that evaluates (the logarithm of) $q_1$. Because only ratios of
+     * $q_1$ values are ever needed, this function need not be normalized.
+     * On the other hand, the second stage proposal distribution is only
+     * allowed to depend on the current sample $x$, not on the rejected
+     * first trial sample $y_1$; for $q_2$, only the ratio
+     * $q_2(y_2|x)/q_2(x|y_2)$ is then needed, just as for the
+     * MetropolisHastings class.
+     *
+     * The result of calling this class's sample() function is a sequence of
+     * samples $x_k$ approximating $\pi(x)$ that are passed to all
+     * Consumer objects connected to the corresponding signal. The
+     * AuxiliaryData object associated with each sample $x_k$ stores three
+     * entries:
+     * - An entry with name "relative log likelihood" of type
+     *   `double` that stores $\log(\pi(x_k))$;
+     * - An entry with name "sample is repeated" that stores a `bool`
+     *   indicating whether the algorithm has chosen the current
+     *   sample as an accepted trial sample (if `false`) or whether
+     *   it is a repeated sample because both trial samples have been
+     *   rejected (if `true`).
+     * - An entry with name "delayed rejection stage" of type
+     *   `unsigned int` that stores the stage at which the current
+     *   sample was accepted (i.e., either one or two), or zero if
+     *   the sample is repeated. The number of likelihood evaluations
+     *   for the current step is one if this value is one, and two
+     *   otherwise.
+     *
+     * Because the first two entries are the same as the ones produced
+     * by the MetropolisHastings class, consumers such as AcceptanceRatio
+     * can be used with this class without change.
+     */
+    template <typename OutputType>
+    class DelayedRejectionMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects.
+         *
+         * @param[in] starting_point The initial sample $x_0$.
+         * @param[in] log_likelihood A function object that, when called
+         *   with a sample $x$, returns $\log(\pi(x))$, i.e., the natural
+         *   logarithm of the likelihood function evaluated at the sample.
+         * @param[in] perturb A function object that, when given a sample
+         *   $x$, returns the first stage trial sample $y_1$ along with the
+         *   ratio $\frac{q_1(y_1|x)}{q_1(x|y_1)}$, in the same way as the
+         *   corresponding argument of MetropolisHastings::sample().
+         * @param[in] log_proposal_density A function object that, when
+         *   given two samples $x$ and $y$, returns $\log(q_1(y|x))$, i.e.,
+         *   the logarithm of the probability density of the first stage
+         *   proposal distribution for the transition $x\to y$. The density
+         *   need not be normalized, but the same normalization needs to be
+         *   used for all pairs $x,y$. For example, if `perturb` draws
+         *   $y_1$ from a Gaussian with standard deviation $\sigma$ centered
+         *   at $x$, then this function can simply return
+         *   $-\frac{\|y-x\|^2}{2\sigma^2}$.
+         * @param[in] second_stage_perturb A function object that, when given
+         *   a sample $x$, returns the second stage trial sample $y_2$ along
+         *   with the ratio $\frac{q_2(y_2|x)}{q_2(x|y_2)}$. This function is
+         *   only called if the first stage trial sample has been rejected.
+         * @param[in] n_samples The number of (new) samples to be produced
+         *   by this function. This is also the number of times the
+         *   signal is called that notifies Consumer objects that a new
+         *   sample is available.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<double (const OutputType &)> &log_likelihood,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const std::function<double (const OutputType &, const OutputType &)> &log_proposal_density,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &second_stage_perturb,
+                const unsigned int n_samples);
+    };
+
+
+    template <typename OutputType>
+    void
+    DelayedRejectionMetropolisHastings<OutputType>::
+    sample (const OutputType &starting_point,
+            const std::function<double (const OutputType &)> &log_likelihood,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+            const std::function<double (const OutputType &, const OutputType &)> &log_proposal_density,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &second_stage_perturb,
+            const unsigned int n_samples)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      std::mt19937 rng;
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      OutputType current_sample         = starting_point;
+      double     current_log_likelihood = log_likelihood (current_sample);
+
+      // Loop over the desired number of samples
+      for (unsigned int i=0; i<n_samples; ++i)
+        {
+          unsigned int accepted_stage = 0;
+
+          // First stage: This is exactly the same as in the
+          // MetropolisHastings class.
+          std::pair<OutputType,double> first_trial_sample_and_ratio = perturb (current_sample);
+          OutputType first_trial_sample = std::move(first_trial_sample_and_ratio.first);
+          const double first_proposal_distribution_ratio = first_trial_sample_and_ratio.second;
+
+          const double first_trial_log_likelihood = log_likelihood (first_trial_sample);
+
+          const double first_stage_acceptance
+            = std::min (1.,
+                        std::exp(first_trial_log_likelihood - current_log_likelihood)
+                        / first_proposal_distribution_ratio);
+
+          if (uniform_distribution(rng) < first_stage_acceptance)
+            {
+              current_sample         = std::move(first_trial_sample);
+              current_log_likelihood = first_trial_log_likelihood;
+
+              accepted_stage = 1;
+            }
+          else
+            {
+              // Second stage: Draw another trial sample and evaluate
+              // its likelihood. Everything else we need for the
+              // acceptance probability is either already known from
+              // the first stage (in particular the likelihood of the
+              // first trial sample) or only involves the proposal
+              // distributions.
+              std::pair<OutputType,double> second_trial_sample_and_ratio = second_stage_perturb (current_sample);
+              OutputType second_trial_sample = std::move(second_trial_sample_and_ratio.first);
+              const double second_proposal_distribution_ratio = second_trial_sample_and_ratio.second;
+
+              const double second_trial_log_likelihood = log_likelihood (second_trial_sample);
+
+              // Compute the probability with which the first stage would
+              // have accepted the move from the second trial sample to the
+              // first trial sample. If that probability is one, then the
+              // reverse path through y_1 can never be rejected in the first
+              // stage, and the second trial sample can therefore not be
+              // accepted either.
+              const double log_q1_from_second_trial
+                = log_proposal_density (second_trial_sample, first_trial_sample);
+              const double log_q1_from_current
+                = log_proposal_density (current_sample, first_trial_sample);
+
+              const double reverse_first_stage_acceptance
+                = std::min (1.,
+                            std::exp(first_trial_log_likelihood - second_trial_log_likelihood
+                                     - log_q1_from_second_trial
+                                     + log_proposal_density (first_trial_sample, second_trial_sample)));
+
+              if (reverse_first_stage_acceptance < 1)
+                {
+                  const double log_second_stage_acceptance
+                    = (second_trial_log_likelihood - current_log_likelihood)
+                      + (log_q1_from_second_trial - log_q1_from_current)
+                      - std::log(second_proposal_distribution_ratio)
+                      + std::log(1-reverse_first_stage_acceptance)
+                      - std::log(1-first_stage_acceptance);
+
+                  if (uniform_distribution(rng) < std::exp(log_second_stage_acceptance))
+                    {
+                      current_sample         = std::move(second_trial_sample);
+                      current_log_likelihood = second_trial_log_likelihood;
+
+                      accepted_stage = 2;
+                    }
+                }
+            }
+
+          // Output the new sample (which may be equal to the old sample).
+          this->issue_sample (current_sample,
+          {
+            {"relative log likelihood", boost::any(current_log_likelihood)},
+            {"sample is repeated", boost::any(accepted_stage == 0)},
+            {"delayed rejection stage", boost::any(accepted_stage)}
+          });
+        }
+
+      this->flush_consumers();
+    }
+
+  }
+}
+
+
+#endif
@@ -0,0 +1,316 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_IMPORTANCE_SAMPLING_H
+#define SAMPLEFLOW_PRODUCERS_IMPORTANCE_SAMPLING_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/types.h>
+
+#include <random>
+#include <cmath>
+#include <cassert>
+#include <limits>
+#include <vector>
+#include <functional>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of self-normalized importance sampling. Given a
+     * (non-normalized) target distribution $\pi(x)$ and a proposal
+     * distribution $q(x)$ from which one can draw samples directly, this
+     * class draws samples $x_k\sim q$ and attaches to each of them the
+     * logarithm of its importance weight
+     * @f{align*}{
+     *   \log w_k = \log\pi(x_k) - \log q(x_k).
+     * @f}
+     * Expectations with respect to $\pi$ can then be estimated as
+     * weighted averages $\frac{\sum_k w_k f(x_k)}{\sum_k w_k}$; because the
+     * estimator divides by the sum of weights, neither $\pi$ nor $q$
+     * needs to be normalized. The Consumers::WeightedMeanValue class
+     * computes such averages if it is told to read logarithmic weights
+     * from the "log weight" entry of the AuxiliaryData objects:
+     * @code
+     *   SampleFlow::Consumers::WeightedMeanValue<SampleType>
+     *     mean_value ("log weight",
+     *                 SampleFlow::Consumers::WeightedMeanValue<SampleType>::WeightType::logarithmic);
+     *   mean_value.connect_to_producer (importance_sampler);
+     * @endcode
+     *
+     * Unlike the MetropolisHastings class, samples are independent of each
+     * other, and so drawing and evaluating them is embarrassingly parallel.
+     * This class therefore works on batches of samples: For each batch, the
+     * samples are drawn, and the target and proposal log densities are
+     * evaluated, in parallel on the threads of a Utilities::ThreadPool
+     * object. Each batch is split into a fixed number of chunks, and each
+     * chunk uses its own random number generator whose seed only depends on
+     * the index of the batch and of the chunk. The samples produced are
+     * therefore the same from run to run, regardless of how threads are
+     * scheduled and of how many threads the pool has (unless one asks the
+     * constructor to use as many chunks as there are threads). Once a batch
+     * is complete, its samples are issued to consumers in order from the
+     * thread that called sample().
+     *
+     * Each sample is accompanied by an AuxiliaryData object with the
+     * following entries:
+     * - "log weight" of type `double`: The value $\log w_k$.
+     * - "relative log likelihood" of type `double`: The value
+     *   $\log\pi(x_k)$.
+     *
+     * The class also keeps track of the effective sample size
+     * @f{align*}{
+     *   \text{ESS} = \frac{\left(\sum_k w_k\right)^2}{\sum_k w_k^2}
+     * @f}
+     * of all samples produced so far, which can be queried using
+     * get_effective_sample_size(). Because importance weights often span
+     * many orders of magnitude, the two sums are accumulated as logarithms
+     * via the "log-sum-exp" trick and never formed explicitly.
+     *
+     * @tparam OutputType The type of the samples $x$.
+     */
+    template <typename OutputType>
+    class ImportanceSampling : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Constructor.
+         *
+         * @param[in] thread_pool The thread pool on which samples are drawn
+         *   and evaluated. This class stores a reference to this object, so
+         *   it needs to live at least as long as the current object.
+         * @param[in] n_chunks The number of chunks into which each batch is
+         *   split. The sequence of samples depends on this number, but not
+         *   on the number of threads; the default is therefore a fixed
+         *   number, so that the same samples are produced on every machine.
+         *   If zero, the number of threads of the thread pool is used, which
+         *   makes better use of machines with many cores, but ties the
+         *   sequence of samples to the size of the thread pool.
+         */
+        ImportanceSampling (Utilities::ThreadPool &thread_pool,
+                            const unsigned int n_chunks = 16);
+
+        /**
+         * The principal function of this class. It draws `n_samples`
+         * samples from the proposal distribution in batches of size
+         * `batch_size`, and issues them along with their log weights.
+         *
+         * @param[in] draw_from_proposal A function that, given a random
+         *   number generator, returns a sample $x\sim q$. This function is
+         *   called concurrently from several threads, but each call
+         *   receives a random number generator that is not shared with any
+         *   other concurrent call.
+         * @param[in] log_target A function that returns $\log\pi(x)$. This
+         *   function is called concurrently from several threads.
+         * @param[in] log_proposal A function that returns $\log q(x)$. This
+         *   function is called concurrently from several threads.
+         * @param[in] n_samples The number of samples to be produced.
+         * @param[in] batch_size The number of samples that are drawn and
+         *   evaluated in parallel before they are issued to consumers.
+         */
+        void
+        sample (const std::function<OutputType (std::mt19937 &)> &draw_from_proposal,
+                const std::function<double (const OutputType &)> &log_target,
+                const std::function<double (const OutputType &)> &log_proposal,
+                const types::sample_index n_samples,
+                const unsigned int batch_size = 1024);
+
+        /**
+         * Return the effective sample size of all samples produced so far
+         * by this object, as defined in the class documentation. If no
+         * samples have been produced yet, return zero.
+         */
+        double
+        get_effective_sample_size () const;
+
+        /**
+         * Return $\log\sum_k w_k$ for all samples produced so far by this
+         * object. The average weight $\frac 1N\sum_k w_k$ is an estimate of
+         * the ratio of normalization constants of $\pi$ and $q$, and this
+         * function therefore provides the logarithm of the "evidence" if
+         * $\pi$ is a prior times a likelihood and $q$ is normalized.
+         */
+        double
+        get_log_sum_of_weights () const;
+
+      private:
+        /**
+         * A reference to the thread pool on which we do our work.
+         */
+        Utilities::ThreadPool &thread_pool;
+
+        /**
+         * The number of chunks per batch.
+         */
+        const unsigned int n_chunks;
+
+        /**
+         * The number of batches drawn so far. This is used to seed the
+         * random number generators of each chunk so that subsequent calls
+         * to sample() produce different samples.
+         */
+        types::sample_index n_batches;
+
+        /**
+         * The logarithms of $\sum_k w_k$ and $\sum_k w_k^2$.
+         */
+        double log_sum_of_weights;
+        double log_sum_of_squared_weights;
+    };
+
+
+
+    namespace internal
+    {
+      namespace ImportanceSampling
+      {
+        /**
+         * Given $a=\log A$ and $b=\log B$, return $\log(A+B)$ without
+         * forming $A$ or $B$ explicitly. Either of the two arguments may
+         * be $-\infty$.
+         */
+        inline
+        double
+        log_add_exp (const double a, const double b)
+        {
+          if (a == -std::numeric_limits<double>::infinity())
+            return b;
+          if (b == -std::numeric_limits<double>::infinity())
+            return a;
+
+          return (a > b
+                  ?
+                  a + std::log1p (std::exp(b-a))
+                  :
+                  b + std::log1p (std::exp(a-b)));
+        }
+      }
+    }
+
+
+
+    template <typename OutputType>
+    ImportanceSampling<OutputType>::
+    ImportanceSampling (Utilities::ThreadPool &thread_pool,
+                        const unsigned int n_chunks)
+      :
+      thread_pool (thread_pool),
+      n_chunks (n_chunks == 0 ? thread_pool.n_threads() : n_chunks),
+      n_batches (0),
+      log_sum_of_weights (-std::numeric_limits<double>::infinity()),
+      log_sum_of_squared_weights (-std::numeric_limits<double>::infinity())
+    {}
+
+
+
+    template <typename OutputType>
+    void
+    ImportanceSampling<OutputType>::
+    sample (const std::function<OutputType (std::mt19937 &)> &draw_from_proposal,
+            const std::function<double (const OutputType &)> &log_target,
+            const std::function<double (const OutputType &)> &log_proposal,
+            const types::sample_index n_samples,
+            const unsigned int batch_size)
+    {
+      assert (batch_size > 0);
+
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      // Allocate the memory for one batch once, and re-use it for all
+      // batches:
+      std::vector<OutputType> samples (batch_size);
+      std::vector<double>     log_targets (batch_size);
+      std::vector<double>     log_weights (batch_size);
+
+      for (types::sample_index batch_begin=0; batch_begin<n_samples; batch_begin+=batch_size)
+        {
+          const unsigned int this_batch_size
+            = std::min<types::sample_index> (batch_size, n_samples-batch_begin);
+          const types::sample_index batch = n_batches++;
+
+          // Draw and evaluate the samples of this batch in parallel:
+          thread_pool.parallel_for (0, this_batch_size, n_chunks,
+                                    [&](const std::size_t begin,
+                                        const std::size_t end,
+                                        const unsigned int chunk)
+          {
+            std::seed_seq seed {static_cast<unsigned int>(batch),
+                                static_cast<unsigned int>(batch >> 32),
+                                chunk};
+            std::mt19937 rng (seed);
+
+            for (std::size_t i=begin; i<end; ++i)
+              {
+                samples[i]     = draw_from_proposal (rng);
+                log_targets[i] = log_target (samples[i]);
+                log_weights[i] = log_targets[i] - log_proposal (samples[i]);
+              }
+          });
+
+          // Then update the running sums and issue the samples in order:
+          for (unsigned int i=0; i<this_batch_size; ++i)
+            {
+              log_sum_of_weights
+                = internal::ImportanceSampling::log_add_exp (log_sum_of_weights,
+                                                             log_weights[i]);
+              log_sum_of_squared_weights
+                = internal::ImportanceSampling::log_add_exp (log_sum_of_squared_weights,
+                                                             2*log_weights[i]);
+
+              this->issue_sample (samples[i],
+              {
+                {"log weight", boost::any(log_weights[i])},
+                {"relative log likelihood", boost::any(log_targets[i])}
+              });
+            }
+        }
+    }
+
+
+
+    template <typename OutputType>
+    double
+    ImportanceSampling<OutputType>::
+    get_effective_sample_size () const
+    {
+      if (log_sum_of_weights == -std::numeric_limits<double>::infinity())
+        return 0;
+
+      return std::exp (2*log_sum_of_weights - log_sum_of_squared_weights);
+    }
+
+
+
+    template <typename OutputType>
+    double
+    ImportanceSampling<OutputType>::
+    get_log_sum_of_weights () const
+    {
+      return log_sum_of_weights;
+    }
+  }
+}
+
+
+#endif
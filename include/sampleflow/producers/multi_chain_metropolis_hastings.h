@@ -0,0 +1,302 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_MULTI_CHAIN_METROPOLIS_HASTINGS_H
+#define SAMPLEFLOW_PRODUCERS_MULTI_CHAIN_METROPOLIS_HASTINGS_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <random>
+#include <vector>
+#include <cmath>
+#include <cassert>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the Metropolis-Hastings algorithm that advances
+     * $W$ independent Markov chains in lockstep. Conceptually, this is the
+     * same as running $W$ copies of the MetropolisHastings class, but the
+     * way the work is organized is quite different: The MetropolisHastings
+     * class calls a `std::function` object for every trial sample, takes
+     * a logarithm and an exponential, and draws one random number. For
+     * likelihoods that are cheap to evaluate -- say, a Gaussian in a
+     * ${\mathbb R}^d$ with $d\le 20$ -- this overhead dominates the
+     * cost of each step and leaves most of the arithmetic units of a
+     * modern processor idle.
+     *
+     * The current class instead stores the states of all $W$ chains in
+     * a "structure-of-arrays" layout: A single `std::vector` of length
+     * $d\times W$ in which component $c$ of chain $w$ is stored at index
+     * $cW+w$. In other words, the $c$th components of all chains are
+     * stored contiguously. The user provides a *batched* log likelihood
+     * function that evaluates $\log(\pi(x^{(w)}))$ for all chains at once,
+     * and a batched perturbation function that generates trial samples for
+     * all chains at once. Because both functions see the states of all
+     * chains in the layout above, they can be written as loops over $w$
+     * that the compiler can vectorize -- i.e., one chain per lane of a
+     * SIMD register. The accept/reject step of this class is written the
+     * same way: It computes the acceptance decisions for all chains
+     * in one loop and then uses branch-free selections between the current
+     * and the trial states in another.
+     *
+     * After each lockstep step, the class issues one sample per chain, in
+     * the order of the chains. In other words, if the sample() function is
+     * asked to do $n$ steps, then $nW$ samples will be sent to the connected
+     * consumers. Each sample is of type `OutputType`, just as for the
+     * MetropolisHastings class, and the AuxiliaryData object associated with
+     * each sample stores the following entries:
+     * - An entry with name "relative log likelihood" of type
+     *   `double` that stores $\log(\pi(x_k))$;
+     * - An entry with name "sample is repeated" that stores a `bool`
+     *   indicating whether the algorithm has chosen the current
+     *   sample as an accepted trial sample (if `false`) or whether
+     *   it is a repeated sample because the trial sample has been
+     *   rejected (if `true`);
+     * - An entry with name "chain index" of type `unsigned int` that
+     *   stores which of the $W$ chains the sample belongs to.
+     *
+     * Consumers that need to see the samples of each chain separately
+     * (for example the Consumers::AcceptanceRatio or
+     * Consumers::AutoCovarianceTrace classes, which assume that
+     * successive samples belong to the same chain) must not be connected
+     * to the current class directly. Instead, create one
+     * Filters::SelectChain object per chain, which passes on only the
+     * samples whose "chain index" entry matches, and connect a separate
+     * consumer object to each of these filters.
+     * Order-independent consumers such as Consumers::MeanValue or
+     * Consumers::CovarianceMatrix can simply be connected to the current
+     * class directly and then compute statistics over all chains.
+     *
+     *
+     * <h3>Example</h3>
+     *
+     * The following code samples from a Gaussian distribution
+     * $\pi(x) \propto e^{-\frac 12 |x|^2}$ in ${\mathbb R}^2$ using
+     * eight chains:
+     * @code
+     *   using SampleType = std::valarray<double>;
+     *   using Producer   = SampleFlow::Producers::MultiChainMetropolisHastings<SampleType>;
+     *
+     *   const unsigned int n_chains = 8;
+     *
+     *   auto log_likelihood = [](const std::vector<double> &x,
+     *                            std::vector<double> &log_likelihoods)
+     *   {
+     *     const unsigned int W = log_likelihoods.size();
+     *     for (unsigned int w=0; w<W; ++w)
+     *       log_likelihoods[w] = 0;
+     *     for (unsigned int c=0; c<2; ++c)
+     *       for (unsigned int w=0; w<W; ++w)
+     *         log_likelihoods[w] -= 0.5 * x[c*W+w] * x[c*W+w];
+     *   };
+     *
+     *   std::mt19937 rng;
+     *   std::normal_distribution<double> normal (0, 0.5);
+     *   auto perturb = [&](const std::vector<double> &x,
+     *                      std::vector<double> &trial_x,
+     *                      std::vector<double> &log_proposal_ratios)
+     *   {
+     *     for (unsigned int i=0; i<x.size(); ++i)
+     *       trial_x[i] = x[i] + normal(rng);
+     *     for (auto &r : log_proposal_ratios)
+     *       r = 0;
+     *   };
+     *
+     *   Producer sampler;
+     *   ...connect consumers to the sampler...
+     *   sampler.sample (std::vector<SampleType>(n_chains, SampleType(0., 2)),
+     *                   log_likelihood, perturb, 10000);
+     * @endcode
+     *
+     * @tparam OutputType The type of the samples. This needs to be a type
+     *   for which the functions Utilities::size() and
+     *   Utilities::get_nth_element() are defined, i.e., a scalar type or
+     *   a vector-like type such as `std::valarray<double>` or
+     *   `std::vector<double>`.
+     */
+    template <typename OutputType>
+    class MultiChainMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * The data type of the elements of the output type.
+         */
+        using scalar_type = types::ScalarType<OutputType>;
+
+        /**
+         * The data type used to store the states of all chains in
+         * structure-of-arrays layout. Component $c$ of chain $w$ is
+         * stored at index $cW+w$ where $W$ is the number of chains.
+         */
+        using ChainStates = std::vector<scalar_type>;
+
+        /**
+         * The principal function of this class. Starting from the given
+         * initial samples $x_0^{(w)}$, one for each chain, it produces
+         * `n_steps` steps for each chain and issues the resulting samples
+         * through the signal of the base class to Consumer objects.
+         *
+         * @param[in] starting_points The initial samples $x_0^{(w)}$. The
+         *   number of chains $W$ is the size of this vector. All starting
+         *   points need to have the same size $d$.
+         * @param[in] log_likelihood A function object that, when called
+         *   with the states $x^{(w)}$ of all chains in the layout described
+         *   by the ChainStates type, writes $\log(\pi(x^{(w)}))$ into the
+         *   $w$th element of its second argument. The second argument
+         *   already has size $W$ when the function is called.
+         * @param[in] perturb A function object that, given the current
+         *   states $x^{(w)}$ of all chains (first argument), writes trial
+         *   states $\tilde x^{(w)}$ into the second argument and the
+         *   logarithms of the ratios
+         *   $\frac{\pi_\text{proposal}(\tilde x^{(w)}|x^{(w)})}
+         *         {\pi_\text{proposal}(x^{(w)}|\tilde x^{(w)})}$
+         *   into the third argument. (Note that, unlike for the
+         *   MetropolisHastings class, this function returns the *logarithm*
+         *   of the ratio, so that the accept/reject step does not have to
+         *   compute it.) The second and third arguments already have their
+         *   correct sizes $dW$ and $W$ when the function is called. For
+         *   symmetric proposal distributions, the third argument should
+         *   be filled with zeros.
+         * @param[in] n_steps The number of (new) steps each chain should
+         *   make. The total number of samples issued by this function
+         *   is `n_steps` times the number of chains.
+         */
+        void
+        sample (const std::vector<OutputType> &starting_points,
+                const std::function<void (const ChainStates &, std::vector<double> &)> &log_likelihood,
+                const std::function<void (const ChainStates &, ChainStates &, std::vector<double> &)> &perturb,
+                const unsigned int n_steps);
+    };
+
+
+    template <typename OutputType>
+    void
+    MultiChainMetropolisHastings<OutputType>::
+    sample (const std::vector<OutputType> &starting_points,
+            const std::function<void (const ChainStates &, std::vector<double> &)> &log_likelihood,
+            const std::function<void (const ChainStates &, ChainStates &, std::vector<double> &)> &perturb,
+            const unsigned int n_steps)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      const unsigned int n_chains = starting_points.size();
+      assert (n_chains > 0);
+      const unsigned int dim = Utilities::size(starting_points[0]);
+
+      std::mt19937 rng;
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      // Set up all of the state we need. All of these arrays are allocated
+      // once and then reused in every step, and with the exception of the
+      // output samples they are all stored in structure-of-arrays layout.
+      ChainStates current_states (dim*n_chains);
+      ChainStates trial_states (dim*n_chains);
+      for (unsigned int w=0; w<n_chains; ++w)
+        {
+          assert (Utilities::size(starting_points[w]) == dim);
+          for (unsigned int c=0; c<dim; ++c)
+            current_states[c*n_chains+w] = Utilities::get_nth_element(starting_points[w], c);
+        }
+
+      std::vector<double> current_log_likelihoods (n_chains);
+      std::vector<double> trial_log_likelihoods (n_chains);
+      std::vector<double> log_proposal_ratios (n_chains);
+      std::vector<double> log_uniforms (n_chains);
+      std::vector<unsigned char> accept (n_chains);
+
+      // The samples we hand out downstream. We copy the starting points
+      // once so that these objects have the right size, and then only
+      // overwrite their elements.
+      std::vector<OutputType> chain_samples = starting_points;
+
+      log_likelihood (current_states, current_log_likelihoods);
+
+      for (unsigned int step=0; step<n_steps; ++step)
+        {
+          // Obtain trial samples for all chains and evaluate their
+          // log likelihoods in one batch:
+          perturb (current_states, trial_states, log_proposal_ratios);
+          log_likelihood (trial_states, trial_log_likelihoods);
+
+          // Draw the random numbers for the accept/reject decisions. This
+          // is the only part of the algorithm that is inherently sequential
+          // because it uses a single random number generator. The
+          // logarithms are then taken in a separate loop that the compiler
+          // can vectorize.
+          for (unsigned int w=0; w<n_chains; ++w)
+            log_uniforms[w] = uniform_distribution(rng);
+          for (unsigned int w=0; w<n_chains; ++w)
+            log_uniforms[w] = std::log(log_uniforms[w]);
+
+          // Now decide which trial samples to accept. This is the same
+          // criterion as in the MetropolisHastings class, namely
+          //   u <= pi(x_trial)/pi(x) / ratio
+          // but written in terms of logarithms and without branches:
+          for (unsigned int w=0; w<n_chains; ++w)
+            accept[w] = (log_uniforms[w]
+                         <=
+                         trial_log_likelihoods[w] - current_log_likelihoods[w]
+                         - log_proposal_ratios[w]);
+
+          // Select between the current and trial states. The conditional
+          // expressions below do not branch but translate into blend
+          // instructions when vectorized.
+          for (unsigned int c=0; c<dim; ++c)
+            for (unsigned int w=0; w<n_chains; ++w)
+              current_states[c*n_chains+w] = (accept[w]
+                                              ?
+                                              trial_states[c*n_chains+w]
+                                              :
+                                              current_states[c*n_chains+w]);
+          for (unsigned int w=0; w<n_chains; ++w)
+            current_log_likelihoods[w] = (accept[w]
+                                          ?
+                                          trial_log_likelihoods[w]
+                                          :
+                                          current_log_likelihoods[w]);
+
+          // Finally output the new sample of each chain (which may be
+          // equal to the old sample of that chain).
+          for (unsigned int w=0; w<n_chains; ++w)
+            {
+              for (unsigned int c=0; c<dim; ++c)
+                Utilities::get_nth_element(chain_samples[w], c) = current_states[c*n_chains+w];
+
+              this->issue_sample (chain_samples[w],
+              {
+                {"relative log likelihood", boost::any(current_log_likelihoods[w])},
+                {"sample is repeated", boost::any(accept[w] == 0)},
+                {"chain index", boost::any(w)}
+              });
+            }
+        }
+    }
+
+  }
+}
+
+
+#endif
@@ -0,0 +1,526 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_MULTILEVEL_METROPOLIS_HASTINGS_H
+#define SAMPLEFLOW_PRODUCERS_MULTILEVEL_METROPOLIS_HASTINGS_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/types.h>
+
+#include <random>
+#include <cmath>
+#include <cassert>
+#include <vector>
+#include <functional>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the multilevel Markov chain Monte Carlo method
+     * described in T. J. Dodwell, C. Ketelsen, R. Scheichl, A. L.
+     * Teckentrup: "A hierarchical multilevel Markov chain Monte Carlo
+     * algorithm with applications to uncertainty quantification in
+     * subsurface flow", SIAM/ASA Journal on Uncertainty Quantification,
+     * vol. 3, pp. 1075-1108, 2015.
+     *
+     * The method is intended for the common situation where the
+     * likelihood $\pi(x)$ involves solving a forward model -- say, a
+     * partial differential equation -- that can be discretized at
+     * several levels of resolution $\ell=0,\ldots,L$, with level $L$ the
+     * finest and most expensive one. This results in a hierarchy of
+     * approximate likelihoods $\pi_0,\ldots,\pi_L$, where $\pi_L$ is the
+     * distribution one is actually interested in. The expectation of a
+     * quantity $Q$ under $\pi_L$ can then be written as the telescoping
+     * sum
+     * @f{align*}{
+     *   E_{\pi_L}[Q] = E_{\pi_0}[Q] + \sum_{\ell=1}^L
+     *     \left(E_{\pi_\ell}[Q] - E_{\pi_{\ell-1}}[Q]\right)
+     *   = \sum_{\ell=0}^L E[Y_\ell],
+     * @f}
+     * and each of the terms can be estimated with a separate set of
+     * samples. Because the differences $Y_\ell$ have small variance
+     * if the two levels are coupled well, only few samples are necessary
+     * for the expensive fine levels, whereas many samples are drawn on the
+     * cheap, coarse levels.
+     *
+     * The algorithm works as follows:
+     * - For level $\ell=0$, it runs a standard Metropolis-Hastings chain
+     *   targeting $\pi_0$, using the `perturb` function to generate trial
+     *   samples. Each sample $x^0_k$ of this chain contributes
+     *   $Y_0=Q(x^0_k)$.
+     * - For each level $\ell\ge 1$, it runs a pair of chains. The
+     *   "coarse" chain is a standard Metropolis-Hastings chain targeting
+     *   $\pi_{\ell-1}$. The "fine" chain targets $\pi_\ell$, but instead of
+     *   using `perturb`, it takes the current state $\Theta$ of the coarse
+     *   chain (after `subsampling_rate` coarse steps, to reduce correlation)
+     *   as its trial sample, accepting it with probability
+     *   @f{align*}{
+     *     \alpha = \min\left\{1,
+     *       \frac{\pi_\ell(\Theta)\,\pi_{\ell-1}(x^\ell_k)}
+     *            {\pi_\ell(x^\ell_k)\,\pi_{\ell-1}(\Theta)}\right\}.
+     *   @f}
+     *   Each step of the fine chain then contributes
+     *   $Y_\ell = Q(x^\ell_{k+1}) - Q(\Theta)$. Because the coarse samples
+     *   are cheap and already distributed according to $\pi_{\ell-1}$,
+     *   the acceptance rate of the fine chain is typically high and
+     *   $x^\ell_{k+1}$ is usually equal to $\Theta$, making the variance
+     *   of $Y_\ell$ small. If none of the `subsampling_rate` coarse steps
+     *   has been accepted, $\Theta$ is the same trial sample as in the
+     *   previous step of the fine chain, and its fine log likelihood
+     *   $\log(\pi_\ell(\Theta))$ -- usually by far the most expensive
+     *   quantity in the algorithm -- is not evaluated again.
+     *
+     * Samples from all levels are issued through the same signal. Each
+     * sample is accompanied by an AuxiliaryData object with the following
+     * entries:
+     * - "level" of type `unsigned int`: The level $\ell$ of the estimator
+     *   this sample belongs to.
+     * - "coarse sample" of type `OutputType`: Only present for $\ell\ge 1$;
+     *   the coarse sample $\Theta$ with which the fine sample $x^\ell$
+     *   has to be paired to form $Y_\ell$.
+     * - "relative log likelihood" of type `double`: The value
+     *   $\log(\pi_\ell(x^\ell))$.
+     * - "sample is repeated" of type `bool`: Whether the current sample
+     *   is the same as the previous one on the same level. This is the
+     *   case if the trial sample has been rejected, but on levels
+     *   $\ell\ge 1$ also if the coarse chain has not moved since the fine
+     *   chain last accepted its state.
+     *
+     * The Consumers::MultilevelMeanValue class consumes samples of this
+     * form and computes the telescoping-sum estimator of the mean value.
+     * Consumers that do not know about levels (such as
+     * Consumers::MeanValue) will simply see a mix of samples from all
+     * levels and are therefore of limited use.
+     *
+     * There are two ways to determine how many samples are to be
+     * drawn on each level: Either one passes these numbers explicitly, or
+     * one provides the cost of evaluating each of the likelihoods along
+     * with a scalar quantity of interest and a desired accuracy; the
+     * class then first runs a pilot phase with a fixed number of samples
+     * per level, estimates the variances $V_\ell$ of the $Y_\ell$ from it,
+     * and then continues the chains until each level has
+     * @f{align*}{
+     *   N_\ell = \left\lceil 2\varepsilon^{-2} \sqrt{\frac{V_\ell}{C_\ell}}
+     *            \sum_{k=0}^L \sqrt{V_k C_k} \right\rceil
+     * @f}
+     * samples, where $C_\ell$ is the cost of one sample on level $\ell$.
+     * This choice minimizes the total cost under the constraint that the
+     * variance of the estimator is $\sum_\ell V_\ell/N_\ell=\varepsilon^2/2$
+     * (ignoring the effects of correlation between samples of the same
+     * chain). This is the usual split of the mean squared error
+     * $\varepsilon^2$ of the estimator into equal parts for the variance
+     * and for the squared bias due to the discretization on the finest
+     * level.
+     *
+     * @tparam OutputType The type of the samples $x$. The same
+     *   requirements hold as for the MetropolisHastings class.
+     */
+    template <typename OutputType>
+    class MultilevelMetropolisHastings : public Producer<OutputType>
+    {
+      public:
+        /**
+         * Draw a given number of samples on each level.
+         *
+         * @param[in] starting_point The initial sample with which all of the
+         *   chains are started.
+         * @param[in] log_likelihoods A vector of function objects, one per
+         *   level, that return $\log(\pi_\ell(x))$ for a given sample $x$.
+         *   The first element corresponds to the coarsest level.
+         * @param[in] perturb A function object that generates trial samples
+         *   for the Metropolis-Hastings chains on the coarse levels. This is
+         *   the same as for the MetropolisHastings class.
+         * @param[in] subsampling_rate The number of steps of the coarse
+         *   chain on level $\ell-1$ that are taken between two steps of the
+         *   fine chain on level $\ell$. The analysis of the method assumes
+         *   that the coarse samples used as trial samples are independent;
+         *   in practice, this number should therefore be at least as large
+         *   as the integrated autocorrelation time of the coarse chains,
+         *   or the estimates of the level differences will be biased.
+         * @param[in] n_samples_per_level The number of samples $N_\ell$ to
+         *   be produced on each level. Must have the same size as
+         *   `log_likelihoods`.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::vector<std::function<double (const OutputType &)>> &log_likelihoods,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const unsigned int subsampling_rate,
+                const std::vector<types::sample_index> &n_samples_per_level);
+
+        /**
+         * Draw samples on each level with a number of samples per level
+         * determined by the cost/variance rule discussed in the class
+         * documentation.
+         *
+         * @param[in] starting_point The initial sample with which all of the
+         *   chains are started.
+         * @param[in] log_likelihoods A vector of function objects, one per
+         *   level, that return $\log(\pi_\ell(x))$.
+         * @param[in] perturb A function object that generates trial samples
+         *   for the Metropolis-Hastings chains on the coarse levels.
+         * @param[in] subsampling_rate The number of steps of the coarse
+         *   chain between two steps of the fine chain.
+         * @param[in] costs The cost of evaluating each of the
+         *   `log_likelihoods`, in arbitrary but consistent units (e.g.,
+         *   seconds, or the number of unknowns of the forward model). The
+         *   cost $C_\ell$ of one sample is then computed from these values
+         *   and the subsampling rate.
+         * @param[in] quantity_of_interest A function that maps samples to
+         *   the scalar quantity $Q$ whose variances $V_\ell$ are used in the
+         *   sample count rule.
+         * @param[in] n_pilot_samples The number of samples per level of the
+         *   pilot phase. Must be at least two.
+         * @param[in] tolerance The desired accuracy $\varepsilon$.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::vector<std::function<double (const OutputType &)>> &log_likelihoods,
+                const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                const unsigned int subsampling_rate,
+                const std::vector<double> &costs,
+                const std::function<double (const OutputType &)> &quantity_of_interest,
+                const types::sample_index n_pilot_samples,
+                const double tolerance);
+
+        /**
+         * Return the numbers of samples
+         * $N_\ell = \left\lceil 2\varepsilon^{-2} \sqrt{V_\ell/C_\ell}
+         * \sum_k \sqrt{V_k C_k} \right\rceil$ that minimize the total cost
+         * of the multilevel estimator for given variances $V_\ell$ of the
+         * $Y_\ell$, costs per sample $C_\ell$, and desired accuracy
+         * $\varepsilon$.
+         */
+        static
+        std::vector<types::sample_index>
+        optimal_sample_counts (const std::vector<double> &variances,
+                               const std::vector<double> &costs,
+                               const double tolerance);
+
+      private:
+        /**
+         * A structure that holds the state of the chains of one level.
+         */
+        struct LevelState
+        {
+          /**
+           * The current state of the chain on level $\ell-1$ (or, for
+           * $\ell=0$, of the only chain of this level) and its log
+           * likelihood $\log(\pi_{\ell-1}(\Theta))$.
+           */
+          OutputType coarse_sample;
+          double     coarse_log_likelihood;
+
+          /**
+           * The log likelihood $\log(\pi_\ell(\Theta))$ of the current
+           * state of the coarse chain on the fine level, and whether the
+           * current state of the fine chain is the current state of the
+           * coarse chain, i.e., whether it has been accepted from it and
+           * the coarse chain has not moved since. Unused for $\ell=0$.
+           */
+          double     coarse_fine_log_likelihood;
+          bool       fine_sample_is_coarse_sample;
+
+          /**
+           * The current state of the chain on level $\ell$ along with the
+           * log likelihoods $\log(\pi_\ell(x^\ell))$ and
+           * $\log(\pi_{\ell-1}(x^\ell))$. Unused for $\ell=0$.
+           */
+          OutputType fine_sample;
+          double     fine_log_likelihood;
+          double     fine_coarse_log_likelihood;
+        };
+
+        /**
+         * Create the initial state of the chains on the given level.
+         */
+        static
+        LevelState
+        initialize_level (const unsigned int level,
+                          const OutputType &starting_point,
+                          const std::vector<std::function<double (const OutputType &)>> &log_likelihoods);
+
+        /**
+         * Advance the chains of the given level by one sample and issue
+         * the resulting sample. If `quantity_of_interest` is not empty, then
+         * also return $Y_\ell$ for this sample.
+         */
+        double
+        advance_level (const unsigned int level,
+                       LevelState &state,
+                       const std::vector<std::function<double (const OutputType &)>> &log_likelihoods,
+                       const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                       const unsigned int subsampling_rate,
+                       const std::function<double (const OutputType &)> &quantity_of_interest,
+                       std::mt19937 &rng);
+    };
+
+
+
+    template <typename OutputType>
+    void
+    MultilevelMetropolisHastings<OutputType>::
+    sample (const OutputType &starting_point,
+            const std::vector<std::function<double (const OutputType &)>> &log_likelihoods,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+            const unsigned int subsampling_rate,
+            const std::vector<types::sample_index> &n_samples_per_level)
+    {
+      assert (log_likelihoods.size() > 0);
+      assert (n_samples_per_level.size() == log_likelihoods.size());
+      assert (subsampling_rate >= 1);
+
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      std::mt19937 rng;
+
+      for (unsigned int level=0; level<log_likelihoods.size(); ++level)
+        {
+          LevelState state = initialize_level (level, starting_point, log_likelihoods);
+          for (types::sample_index k=0; k<n_samples_per_level[level]; ++k)
+            advance_level (level, state, log_likelihoods, perturb, subsampling_rate,
+                           std::function<double (const OutputType &)>(), rng);
+        }
+    }
+
+
+
+    template <typename OutputType>
+    void
+    MultilevelMetropolisHastings<OutputType>::
+    sample (const OutputType &starting_point,
+            const std::vector<std::function<double (const OutputType &)>> &log_likelihoods,
+            const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+            const unsigned int subsampling_rate,
+            const std::vector<double> &costs,
+            const std::function<double (const OutputType &)> &quantity_of_interest,
+            const types::sample_index n_pilot_samples,
+            const double tolerance)
+    {
+      assert (log_likelihoods.size() > 0);
+      assert (costs.size() == log_likelihoods.size());
+      assert (subsampling_rate >= 1);
+      assert (n_pilot_samples >= 2);
+      assert (tolerance > 0);
+
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      std::mt19937 rng;
+
+      const unsigned int n_levels = log_likelihoods.size();
+
+      // Set up all chains. Unlike the other sample() function, we need to
+      // keep the state of all levels around because we continue the
+      // chains after the pilot phase.
+      std::vector<LevelState> states;
+      for (unsigned int level=0; level<n_levels; ++level)
+        states.emplace_back (initialize_level (level, starting_point, log_likelihoods));
+
+      // Run the pilot phase and estimate the variance of the Y_l on each
+      // level using Welford's algorithm:
+      std::vector<double> variances (n_levels);
+      for (unsigned int level=0; level<n_levels; ++level)
+        {
+          double mean = 0;
+          double sum_of_squares = 0;
+          for (types::sample_index k=0; k<n_pilot_samples; ++k)
+            {
+              const double Y = advance_level (level, states[level], log_likelihoods, perturb,
+                                              subsampling_rate, quantity_of_interest, rng);
+              const double delta = Y - mean;
+              mean += delta / (k+1);
+              sum_of_squares += delta * (Y - mean);
+            }
+          variances[level] = sum_of_squares / (n_pilot_samples-1);
+        }
+
+      // Compute the cost of one sample on each level. On level zero, this
+      // is one evaluation of the coarsest likelihood; on all other levels,
+      // it is one evaluation of the fine likelihood plus the steps of
+      // the coarse chain.
+      std::vector<double> costs_per_sample (n_levels);
+      costs_per_sample[0] = costs[0];
+      for (unsigned int level=1; level<n_levels; ++level)
+        costs_per_sample[level] = costs[level] + subsampling_rate * costs[level-1];
+
+      // Then continue each chain until it has the desired number of samples:
+      const std::vector<types::sample_index> n_samples_per_level
+        = optimal_sample_counts (variances, costs_per_sample, tolerance);
+      for (unsigned int level=0; level<n_levels; ++level)
+        for (types::sample_index k=n_pilot_samples; k<n_samples_per_level[level]; ++k)
+          advance_level (level, states[level], log_likelihoods, perturb, subsampling_rate,
+                         std::function<double (const OutputType &)>(), rng);
+    }
+
+
+
+    template <typename OutputType>
+    std::vector<types::sample_index>
+    MultilevelMetropolisHastings<OutputType>::
+    optimal_sample_counts (const std::vector<double> &variances,
+                           const std::vector<double> &costs,
+                           const double tolerance)
+    {
+      assert (variances.size() == costs.size());
+
+      double sum = 0;
+      for (unsigned int level=0; level<variances.size(); ++level)
+        sum += std::sqrt (variances[level] * costs[level]);
+
+      std::vector<types::sample_index> n_samples (variances.size());
+      for (unsigned int level=0; level<variances.size(); ++level)
+        n_samples[level] = static_cast<types::sample_index>
+                           (std::ceil (2 * std::sqrt (variances[level] / costs[level]) * sum
+                                       / (tolerance * tolerance)));
+
+      return n_samples;
+    }
+
+
+
+    template <typename OutputType>
+    typename MultilevelMetropolisHastings<OutputType>::LevelState
+    MultilevelMetropolisHastings<OutputType>::
+    initialize_level (const unsigned int level,
+                      const OutputType &starting_point,
+                      const std::vector<std::function<double (const OutputType &)>> &log_likelihoods)
+    {
+      LevelState state;
+      state.coarse_sample = starting_point;
+      state.coarse_log_likelihood = log_likelihoods[level == 0 ? 0 : level-1] (starting_point);
+
+      if (level > 0)
+        {
+          state.fine_sample = starting_point;
+          state.fine_log_likelihood = log_likelihoods[level] (starting_point);
+          state.fine_coarse_log_likelihood = state.coarse_log_likelihood;
+
+          state.coarse_fine_log_likelihood   = state.fine_log_likelihood;
+          state.fine_sample_is_coarse_sample = true;
+        }
+
+      return state;
+    }
+
+
+
+    template <typename OutputType>
+    double
+    MultilevelMetropolisHastings<OutputType>::
+    advance_level (const unsigned int level,
+                   LevelState &state,
+                   const std::vector<std::function<double (const OutputType &)>> &log_likelihoods,
+                   const std::function<std::pair<OutputType,double> (const OutputType &)> &perturb,
+                   const unsigned int subsampling_rate,
+                   const std::function<double (const OutputType &)> &quantity_of_interest,
+                   std::mt19937 &rng)
+    {
+      std::uniform_real_distribution<> uniform_distribution(0,1);
+
+      // First advance the coarse chain, i.e., the chain on level l-1 (or,
+      // on level zero, the only chain), by the appropriate number of
+      // Metropolis-Hastings steps:
+      const auto &coarse_log_likelihood = log_likelihoods[level == 0 ? 0 : level-1];
+      const unsigned int n_coarse_steps = (level == 0 ? 1 : subsampling_rate);
+      bool coarse_sample_is_repeated = true;
+      for (unsigned int step=0; step<n_coarse_steps; ++step)
+        {
+          std::pair<OutputType,double> trial_sample_and_ratio = perturb (state.coarse_sample);
+          const double trial_log_likelihood = coarse_log_likelihood (trial_sample_and_ratio.first);
+
+          if ((trial_log_likelihood - std::log(trial_sample_and_ratio.second) > state.coarse_log_likelihood)
+              ||
+              (std::exp(trial_log_likelihood - state.coarse_log_likelihood) / trial_sample_and_ratio.second
+               >= uniform_distribution(rng)))
+            {
+              state.coarse_sample         = std::move(trial_sample_and_ratio.first);
+              state.coarse_log_likelihood = trial_log_likelihood;
+              coarse_sample_is_repeated   = false;
+            }
+        }
+
+      // On level zero, we are done: Output the sample.
+      if (level == 0)
+        {
+          this->issue_sample (state.coarse_sample,
+          {
+            {"level", boost::any(0U)},
+            {"relative log likelihood", boost::any(state.coarse_log_likelihood)},
+            {"sample is repeated", boost::any(coarse_sample_is_repeated)}
+          });
+
+          return (quantity_of_interest ? quantity_of_interest(state.coarse_sample) : 0.);
+        }
+
+      // Otherwise use the state of the coarse chain as the trial sample for
+      // the fine chain and accept or reject it with the two-level
+      // acceptance probability. If the coarse chain has not moved, then
+      // this is the same trial sample as last time and we already know
+      // its fine log likelihood.
+      if (coarse_sample_is_repeated == false)
+        {
+          state.coarse_fine_log_likelihood   = log_likelihoods[level] (state.coarse_sample);
+          state.fine_sample_is_coarse_sample = false;
+        }
+      const double trial_log_likelihood = state.coarse_fine_log_likelihood;
+      const double log_alpha = (trial_log_likelihood - state.fine_log_likelihood)
+                               + (state.fine_coarse_log_likelihood - state.coarse_log_likelihood);
+
+      const bool accept = ((log_alpha > 0)
+                           ||
+                           (std::exp(log_alpha) >= uniform_distribution(rng)));
+
+      // Accepting the trial sample only changes the state of the fine
+      // chain if the fine chain has not already accepted the same sample
+      // before.
+      const bool fine_sample_is_repeated = (!accept || state.fine_sample_is_coarse_sample);
+      if (fine_sample_is_repeated == false)
+        {
+          state.fine_sample                  = state.coarse_sample;
+          state.fine_log_likelihood          = trial_log_likelihood;
+          state.fine_coarse_log_likelihood   = state.coarse_log_likelihood;
+          state.fine_sample_is_coarse_sample = true;
+        }
+
+      this->issue_sample (state.fine_sample,
+      {
+        {"level", boost::any(level)},
+        {"coarse sample", boost::any(state.coarse_sample)},
+        {"relative log likelihood", boost::any(state.fine_log_likelihood)},
+        {"sample is repeated", boost::any(fine_sample_is_repeated)}
+      });
+
+      return (quantity_of_interest
+              ?
+              quantity_of_interest(state.fine_sample) - quantity_of_interest(state.coarse_sample)
+              :
+              0.);
+    }
+  }
+}
+
+
+#endif
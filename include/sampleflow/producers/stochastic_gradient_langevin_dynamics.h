@@ -0,0 +1,274 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_PRODUCERS_STOCHASTIC_GRADIENT_LANGEVIN_DYNAMICS_H
+#define SAMPLEFLOW_PRODUCERS_STOCHASTIC_GRADIENT_LANGEVIN_DYNAMICS_H
+
+#include <sampleflow/producer.h>
+#include <sampleflow/scope_exit.h>
+#include <sampleflow/types.h>
+#include <sampleflow/element_access.h>
+
+#include <random>
+#include <cmath>
+#include <functional>
+
+namespace SampleFlow
+{
+  namespace Producers
+  {
+    /**
+     * An implementation of the stochastic gradient Langevin dynamics (SGLD)
+     * method of M. Welling and Y. W. Teh: "Bayesian learning via stochastic
+     * gradient Langevin dynamics", Proceedings of the 28th International
+     * Conference on Machine Learning, 2011, optionally with the diagonal
+     * RMSprop-style preconditioner of C. Li, C. Chen, D. Carlson, L. Carin:
+     * "Preconditioned stochastic gradient Langevin dynamics for deep neural
+     * networks", AAAI 2016.
+     *
+     * Like the MetropolisHastings class, this class samples from a
+     * probability distribution $\pi(x)$ on ${\mathbb R}^d$. But instead of
+     * evaluating $\log\pi(x)$ and accepting or rejecting trial samples, it
+     * simulates a discretized Langevin diffusion that only requires the
+     * *gradient* $\nabla \log\pi(x)$ -- and, importantly, only a noisy,
+     * unbiased estimate of it. In the typical situation where
+     * $\pi(x) \propto p(x)\prod_{i=1}^N p(y_i|x)$ for a large data set
+     * $\{y_i\}$, such an estimate is
+     * $g(x) = \nabla\log p(x) + \frac{N}{n}\sum_{i\in B}\nabla\log p(y_i|x)$
+     * where $B$ is a randomly chosen "minibatch" of $n\ll N$ data points.
+     * Each step therefore only touches a small fraction of the data set.
+     *
+     * Without preconditioning, the iteration reads
+     * @f{align*}{
+     *   x_{k+1} = x_k + \frac{\epsilon_k}{2} g(x_k) + \sqrt{\epsilon_k}\,\xi_k,
+     * @f}
+     * where $\xi_k$ is a vector of independent standard normal random
+     * variables and $\epsilon_k$ is a step size. With RMSprop
+     * preconditioning, the iteration instead reads
+     * @f{align*}{
+     *   V_{k} &= \alpha V_{k-1} + (1-\alpha) g(x_k)\odot g(x_k),
+     *   \\
+     *   G_k &= \text{diag}\left(\frac{1}{\lambda + \sqrt{V_k}}\right),
+     *   \\
+     *   x_{k+1} &= x_k + \frac{\epsilon_k}{2} G_k g(x_k) + \sqrt{\epsilon_k G_k}\,\xi_k,
+     * @f}
+     * which adapts the effective step size to the local curvature of each
+     * component. (As is common in practice, the correction term $\Gamma$
+     * of the paper by Li et al. is omitted.)
+     *
+     * Because there is no accept/reject step, the samples do not exactly
+     * follow $\pi(x)$ unless $\epsilon_k\to 0$. Welling and Teh show
+     * that with decreasing step sizes, averages of the form
+     * $\frac{\sum_k \epsilon_k f(x_k)}{\sum_k \epsilon_k}$ converge to the
+     * expectation of $f$ under $\pi$. To make computing such averages
+     * possible, the AuxiliaryData object associated with each sample stores
+     * an entry with name "step size" of type `double` that contains the
+     * step size $\epsilon_k$ that was used to produce the sample. The
+     * Consumers::WeightedMeanValue class can then be used with this entry
+     * to compute step-size weighted averages.
+     *
+     * All of the state of the algorithm (the current sample, the gradient,
+     * and the preconditioner) is allocated once at the beginning of the
+     * sample() function and then updated in place. In particular, the user
+     * provided gradient function writes into a preallocated object rather
+     * than returning a new one in each step.
+     *
+     * @tparam OutputType The type of the samples $x$. This needs to be a
+     *   type for which the functions Utilities::size() and
+     *   Utilities::get_nth_element() are defined and whose elements are
+     *   floating point numbers, for example `double`,
+     *   `std::valarray<double>`, or `std::vector<double>`.
+     */
+    template <typename OutputType>
+    class StochasticGradientLangevinDynamics : public Producer<OutputType>
+    {
+      public:
+        /**
+         * An enum describing which preconditioner should be used.
+         */
+        enum class Preconditioner
+        {
+          /**
+           * Do not use a preconditioner, i.e., use $G_k=I$.
+           */
+          none,
+
+          /**
+           * Use the diagonal RMSprop preconditioner described in the
+           * documentation of this class.
+           */
+          rmsprop
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param[in] preconditioner The preconditioner to be used.
+         * @param[in] rmsprop_decay The parameter $\alpha$ in the RMSprop
+         *   preconditioner. Ignored if no preconditioner is used.
+         * @param[in] rmsprop_regularization The parameter $\lambda$ in the
+         *   RMSprop preconditioner. Ignored if no preconditioner is used.
+         */
+        StochasticGradientLangevinDynamics (const Preconditioner preconditioner = Preconditioner::none,
+                                            const double rmsprop_decay = 0.99,
+                                            const double rmsprop_regularization = 1e-5);
+
+        /**
+         * The principal function of this class. Starting from the given
+         * initial sample $x_0$, it produces a sequence of samples $x_k$
+         * that are passed through the signal of the base class to
+         * Consumer objects.
+         *
+         * @param[in] starting_point The initial sample $x_0$.
+         * @param[in] gradient A function object that, when called with a
+         *   sample $x$ as first argument, writes an unbiased estimate $g(x)$
+         *   of $\nabla\log\pi(x)$ into its second argument. The second
+         *   argument is an object that has been created as a copy of
+         *   `starting_point` at the beginning of this function and that is
+         *   reused for all steps; it therefore already has the correct size.
+         * @param[in] step_size A function object that, given the index $k$
+         *   of a step, returns the step size $\epsilon_k$. The function
+         *   polynomial_step_size() returns an object that implements the
+         *   commonly used schedule $\epsilon_k=a(b+k)^{-\gamma}$.
+         * @param[in] n_samples The number of (new) samples to be produced
+         *   by this function.
+         */
+        void
+        sample (const OutputType &starting_point,
+                const std::function<void (const OutputType &, OutputType &)> &gradient,
+                const std::function<double (const types::sample_index)> &step_size,
+                const unsigned int n_samples);
+
+        /**
+         * Return a function object that implements the step size schedule
+         * $\epsilon_k=a(b+k)^{-\gamma}$ suggested by Welling and Teh. For
+         * $\gamma\in(0.5,1]$, this sequence satisfies the conditions
+         * $\sum_k\epsilon_k=\infty, \sum_k\epsilon_k^2<\infty$ necessary
+         * for convergence.
+         */
+        static
+        std::function<double (const types::sample_index)>
+        polynomial_step_size (const double a,
+                              const double b,
+                              const double gamma);
+
+      private:
+        /**
+         * The preconditioner and its parameters.
+         */
+        const Preconditioner preconditioner;
+        const double rmsprop_decay;
+        const double rmsprop_regularization;
+    };
+
+
+
+    template <typename OutputType>
+    StochasticGradientLangevinDynamics<OutputType>::
+    StochasticGradientLangevinDynamics (const Preconditioner preconditioner,
+                                        const double rmsprop_decay,
+                                        const double rmsprop_regularization)
+      :
+      preconditioner (preconditioner),
+      rmsprop_decay (rmsprop_decay),
+      rmsprop_regularization (rmsprop_regularization)
+    {}
+
+
+
+    template <typename OutputType>
+    std::function<double (const types::sample_index)>
+    StochasticGradientLangevinDynamics<OutputType>::
+    polynomial_step_size (const double a,
+                          const double b,
+                          const double gamma)
+    {
+      return [ = ](const types::sample_index k)
+      {
+        return a * std::pow (b + k, -gamma);
+      };
+    }
+
+
+
+    template <typename OutputType>
+    void
+    StochasticGradientLangevinDynamics<OutputType>::
+    sample (const OutputType &starting_point,
+            const std::function<void (const OutputType &, OutputType &)> &gradient,
+            const std::function<double (const types::sample_index)> &step_size,
+            const unsigned int n_samples)
+    {
+      // Make sure the flush_consumers() function is called at any point
+      // where we exit the current function.
+      Utilities::ScopeExit scope_exit ([this]()
+      {
+        this->flush_consumers();
+      });
+
+      std::mt19937 rng;
+      std::normal_distribution<> normal_distribution(0,1);
+
+      // Allocate all state once. The gradient and the preconditioner
+      // are copies of the starting point so that they have the right
+      // size; their values are overwritten before they are used.
+      OutputType current_sample = starting_point;
+      OutputType current_gradient = starting_point;
+      OutputType square_gradient_average = starting_point;
+      const unsigned int dim = Utilities::size(starting_point);
+
+      for (unsigned int c=0; c<dim; ++c)
+        Utilities::get_nth_element(square_gradient_average, c) = 0;
+
+      // Loop over the desired number of samples
+      for (unsigned int k=0; k<n_samples; ++k)
+        {
+          const double epsilon = step_size(k);
+
+          gradient (current_sample, current_gradient);
+
+          for (unsigned int c=0; c<dim; ++c)
+            {
+              const double g = Utilities::get_nth_element(current_gradient, c);
+
+              // Compute the diagonal entry of the preconditioner:
+              double G = 1;
+              if (preconditioner == Preconditioner::rmsprop)
+                {
+                  double &V = Utilities::get_nth_element(square_gradient_average, c);
+                  V = rmsprop_decay * V + (1-rmsprop_decay) * g * g;
+                  G = 1. / (rmsprop_regularization + std::sqrt(V));
+                }
+
+              // Then take a step in this component:
+              Utilities::get_nth_element(current_sample, c)
+              += epsilon / 2 * G * g
+                 + std::sqrt(epsilon * G) * normal_distribution(rng);
+            }
+
+          // Output the new sample along with the step size that was
+          // used to obtain it.
+          this->issue_sample (current_sample,
+          {
+            {"step size", boost::any(epsilon)}
+          });
+        }
+    }
+
+  }
+}
+
+
+#endif
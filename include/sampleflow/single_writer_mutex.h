@@ -0,0 +1,341 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+#ifndef SAMPLEFLOW_SINGLE_WRITER_MUTEX_H
+#define SAMPLEFLOW_SINGLE_WRITER_MUTEX_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+
+namespace SampleFlow
+{
+  namespace Utilities
+  {
+    /**
+     * A mutex that distinguishes between a *writer* that modifies the state
+     * the mutex protects, and *readers* that only look at it. This is the
+     * situation in classes derived from Consumer: The consume() function
+     * modifies the state of the object, whereas functions such as `get()`
+     * only read it.
+     *
+     * By default, this class simply wraps a `std::mutex`, and both writers
+     * and readers acquire it. However, if it is known that there is only
+     * ever one thread at a time that writes -- for example, because the
+     * consumer is fed by a single producer that works synchronously, see
+     * Consumer::declare_single_producer() -- then one can call
+     * set_single_writer(). In that mode, the writer no longer acquires the
+     * mutex but only announces through an atomic flag that it is working
+     * on the protected state. Readers still acquire the mutex (so that
+     * they are serialized among themselves), then ask the writer to step
+     * aside, and wait until the writer has finished its current update.
+     * A writer that finds a reader waiting falls back to acquiring the
+     * mutex, and consequently waits until the reader is done.
+     *
+     * In the common case where no reader is active, a writer therefore
+     * only executes one atomic store and one atomic load when acquiring
+     * the lock, and one (cheaper) atomic store when releasing it, rather
+     * than the two atomic read-modify-write operations of a `std::mutex`.
+     * Readers become more expensive, but they are typically called far
+     * less often.
+     *
+     * Writers use the lock() and unlock() functions, usually through a
+     * `std::lock_guard<SingleWriterMutex>` object. Readers use an object
+     * of type SingleWriterMutex::ReadLock instead. Functions that modify
+     * the protected state but are not called by the writer -- for example,
+     * a function that resets a consumer's state from a thread other than
+     * the one that feeds it samples -- must not call lock(), because the
+     * writer does not acquire the mutex in single-writer mode. They use an
+     * object of type SingleWriterMutex::ExclusiveLock, which goes through
+     * the same protocol as readers and so excludes both the writer and all
+     * readers.
+     */
+    class SingleWriterMutex
+    {
+      public:
+        /**
+         * A class that, in the spirit of `std::lock_guard`, acquires the
+         * mutex for reading in its constructor and releases it in its
+         * destructor.
+         */
+        class ReadLock
+        {
+          public:
+            /**
+             * Constructor. Acquire the given mutex for reading.
+             */
+            explicit ReadLock (SingleWriterMutex &mutex);
+
+            /**
+             * Destructor. Release the mutex again.
+             */
+            ~ReadLock ();
+
+            ReadLock (const ReadLock &) = delete;
+            ReadLock &operator= (const ReadLock &) = delete;
+
+          private:
+            /**
+             * The mutex we have acquired.
+             */
+            SingleWriterMutex &mutex;
+        };
+
+        /**
+         * A class that, in the spirit of `std::lock_guard`, acquires
+         * exclusive access to the protected state from a thread other than
+         * the writer's in its constructor, and releases it in its
+         * destructor. While an object of this type exists, neither the
+         * writer nor any reader can access the protected state, and the
+         * owner of the object may modify it.
+         */
+        class ExclusiveLock
+        {
+          public:
+            /**
+             * Constructor. Acquire the given mutex for exclusive access.
+             */
+            explicit ExclusiveLock (SingleWriterMutex &mutex);
+
+            /**
+             * Destructor. Release the mutex again.
+             */
+            ~ExclusiveLock ();
+
+            ExclusiveLock (const ExclusiveLock &) = delete;
+            ExclusiveLock &operator= (const ExclusiveLock &) = delete;
+
+          private:
+            /**
+             * The mutex we have acquired.
+             */
+            SingleWriterMutex &mutex;
+        };
+
+        /**
+         * Constructor. The mutex starts out in the mode where writers
+         * acquire the underlying `std::mutex`.
+         */
+        SingleWriterMutex ();
+
+        /**
+         * Set whether only one thread at a time will ever call lock().
+         * This function must not be called while the mutex is held by
+         * anyone, and in practice should only be called before any samples
+         * are sent to the consumer that owns the mutex.
+         */
+        void
+        set_single_writer (const bool single_writer);
+
+        /**
+         * Return whether set_single_writer() has been called with `true`.
+         */
+        bool
+        is_single_writer () const;
+
+        /**
+         * Acquire the mutex for writing.
+         */
+        void
+        lock ();
+
+        /**
+         * Release the mutex after writing.
+         */
+        void
+        unlock ();
+
+      private:
+        /**
+         * The underlying mutex.
+         */
+        std::mutex mutex;
+
+        /**
+         * Whether we are operating in single-writer mode.
+         */
+        bool single_writer;
+
+        /**
+         * In single-writer mode, flags that indicate whether the writer is
+         * currently working on the protected state without holding the
+         * mutex, and whether a reader is waiting for it to step aside.
+         */
+        std::atomic<bool> writer_is_active;
+        std::atomic<bool> reader_is_waiting;
+
+        /**
+         * In single-writer mode, whether the writer has fallen back to
+         * acquiring the mutex. This variable is only ever accessed by the
+         * writer.
+         */
+        bool writer_holds_mutex;
+
+        /**
+         * Acquire and release the mutex on behalf of a thread other than
+         * the writer, i.e., for a ReadLock or an ExclusiveLock object.
+         */
+        void
+        lock_from_other_thread ();
+
+        void
+        unlock_from_other_thread ();
+    };
+
+
+
+    inline
+    SingleWriterMutex::ReadLock::ReadLock (SingleWriterMutex &mutex)
+      :
+      mutex (mutex)
+    {
+      this->mutex.lock_from_other_thread();
+    }
+
+
+
+    inline
+    SingleWriterMutex::ReadLock::~ReadLock ()
+    {
+      mutex.unlock_from_other_thread();
+    }
+
+
+
+    inline
+    SingleWriterMutex::ExclusiveLock::ExclusiveLock (SingleWriterMutex &mutex)
+      :
+      mutex (mutex)
+    {
+      this->mutex.lock_from_other_thread();
+    }
+
+
+
+    inline
+    SingleWriterMutex::ExclusiveLock::~ExclusiveLock ()
+    {
+      mutex.unlock_from_other_thread();
+    }
+
+
+
+    inline
+    SingleWriterMutex::SingleWriterMutex ()
+      :
+      single_writer (false),
+      writer_is_active (false),
+      reader_is_waiting (false),
+      writer_holds_mutex (false)
+    {}
+
+
+
+    inline
+    void
+    SingleWriterMutex::set_single_writer (const bool single_writer)
+    {
+      std::lock_guard<std::mutex> lock (mutex);
+      this->single_writer = single_writer;
+    }
+
+
+
+    inline
+    bool
+    SingleWriterMutex::is_single_writer () const
+    {
+      return single_writer;
+    }
+
+
+
+    inline
+    void
+    SingleWriterMutex::lock ()
+    {
+      if (single_writer == false)
+        mutex.lock();
+      else
+        {
+          // Announce that we are working on the state, then check whether
+          // a reader is waiting. If so, step aside and wait for the reader
+          // to finish by acquiring the mutex.
+          writer_is_active.store (true);
+          if (reader_is_waiting.load())
+            {
+              writer_is_active.store (false);
+              mutex.lock();
+              writer_holds_mutex = true;
+            }
+        }
+    }
+
+
+
+    inline
+    void
+    SingleWriterMutex::unlock ()
+    {
+      if ((single_writer == false) || writer_holds_mutex)
+        {
+          writer_holds_mutex = false;
+          mutex.unlock();
+        }
+      else
+        // Make the changes we have made visible to readers that see
+        // that we are no longer active:
+        writer_is_active.store (false, std::memory_order_release);
+    }
+
+
+
+    inline
+    void
+    SingleWriterMutex::lock_from_other_thread ()
+    {
+      mutex.lock();
+
+      if (single_writer)
+        {
+          // Announce that we want to access the state, then wait for the
+          // writer to finish what it is currently doing. Once we have
+          // announced our intent, the writer will not start another update
+          // without acquiring the mutex, which we are holding.
+          //
+          // The announcement and the writer's flag use sequentially
+          // consistent operations: Either the writer sees our announcement
+          // when it checks for it, or we see that it is active.
+          reader_is_waiting.store (true);
+          while (writer_is_active.load())
+            std::this_thread::yield();
+        }
+    }
+
+
+
+    inline
+    void
+    SingleWriterMutex::unlock_from_other_thread ()
+    {
+      if (single_writer)
+        reader_is_waiting.store (false);
+
+      mutex.unlock();
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,227 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_SPAN_H
+#define SAMPLEFLOW_SPAN_H
+
+#include <cstddef>
+#include <cassert>
+#include <type_traits>
+
+
+namespace SampleFlow
+{
+  namespace types
+  {
+    /**
+     * A class that represents a non-owning view of a contiguous array of
+     * elements of type `T`, i.e., a pointer to the first element and the
+     * number of elements. This is similar to `std::span` in C++20.
+     *
+     * The purpose of this class is to allow using data that is stored
+     * elsewhere -- for example, in a large buffer owned by a simulation
+     * code -- as samples without copying it into an object of type
+     * `std::vector<double>` or `std::valarray<double>` first. Objects of
+     * type `Span<const double>` can be issued by producers and
+     * passed through filters and to consumers just like other sample
+     * types: They provide `size()` and `operator[]`, and so the functions
+     * Utilities::size() and Utilities::get_nth_element() work on them.
+     *
+     * Because a Span does not own the data it points to, it is only valid
+     * as long as the underlying array is. This has two consequences:
+     * - Consumers that need to store samples (for example, to compute
+     *   a running mean, or to keep a history of past samples) cannot
+     *   store the Span itself. They instead store an object of type
+     *   `types::StorageType<Span<T>>`, which is a `std::valarray` that
+     *   owns a copy of the data, and they create such a copy explicitly
+     *   via Utilities::to_storage().
+     * - Consumers that receive Span samples can only be run in
+     *   synchronous mode (see ParallelMode), because in asynchronous mode,
+     *   the sample would be processed at a time when the producer may
+     *   already have overwritten or released the underlying array. This
+     *   is checked by an assertion in Consumer::set_parallel_mode().
+     *
+     * @tparam T The type of the elements the Span refers to. This will
+     *   typically be `const double` or similar.
+     */
+    template <typename T>
+    class Span
+    {
+      public:
+        /**
+         * The type of the elements of the array, without `const` or
+         * `volatile` qualifiers. This is consistent with the `value_type`
+         * of standard containers.
+         */
+        using value_type = typename std::remove_cv<T>::type;
+
+        /**
+         * The type of the elements of the array, including qualifiers.
+         */
+        using element_type = T;
+
+        /**
+         * Iterator types.
+         */
+        using iterator = T *;
+        using const_iterator = T *;
+
+        /**
+         * Default constructor. Create an empty span.
+         */
+        Span ();
+
+        /**
+         * Constructor. Create a span that points to `size` elements
+         * starting at `data`.
+         */
+        Span (T *data,
+              const std::size_t size);
+
+        /**
+         * Conversion constructor from a span of non-`const` elements to
+         * a span of `const` elements.
+         */
+        template <typename U,
+                  typename = typename std::enable_if<std::is_same<const U, T>::value>::type>
+        Span (const Span<U> &span);
+
+        /**
+         * Return the number of elements.
+         */
+        std::size_t
+        size () const;
+
+        /**
+         * Access the `index`th element.
+         */
+        T &
+        operator[] (const std::size_t index) const;
+
+        /**
+         * Return a pointer to the first element.
+         */
+        T *
+        data () const;
+
+        /**
+         * Return iterators to the beginning and end of the array.
+         */
+        iterator begin () const;
+        iterator end () const;
+
+      private:
+        /**
+         * A pointer to the first element and the number of elements.
+         */
+        T           *data_pointer;
+        std::size_t  n_elements;
+    };
+
+
+    /**
+     * A type trait that indicates whether its template argument is a
+     * Span type.
+     */
+    template <typename T>
+    struct is_span : std::false_type
+    {};
+
+
+    /**
+     * Specialization of the is_span trait for Span types.
+     */
+    template <typename T>
+    struct is_span<Span<T>> : std::true_type
+    {};
+
+
+
+    template <typename T>
+    Span<T>::Span ()
+      :
+      data_pointer (nullptr),
+      n_elements (0)
+    {}
+
+
+
+    template <typename T>
+    Span<T>::Span (T *data,
+                   const std::size_t size)
+      :
+      data_pointer (data),
+      n_elements (size)
+    {}
+
+
+
+    template <typename T>
+    template <typename U, typename>
+    Span<T>::Span (const Span<U> &span)
+      :
+      data_pointer (span.data()),
+      n_elements (span.size())
+    {}
+
+
+
+    template <typename T>
+    std::size_t
+    Span<T>::size () const
+    {
+      return n_elements;
+    }
+
+
+
+    template <typename T>
+    T &
+    Span<T>::operator[] (const std::size_t index) const
+    {
+      assert (index < n_elements);
+      return data_pointer[index];
+    }
+
+
+
+    template <typename T>
+    T *
+    Span<T>::data () const
+    {
+      return data_pointer;
+    }
+
+
+
+    template <typename T>
+    typename Span<T>::iterator
+    Span<T>::begin () const
+    {
+      return data_pointer;
+    }
+
+
+
+    template <typename T>
+    typename Span<T>::iterator
+    Span<T>::end () const
+    {
+      return data_pointer + n_elements;
+    }
+  }
+}
+
+#endif
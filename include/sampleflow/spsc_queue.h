@@ -0,0 +1,281 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+#ifndef SAMPLEFLOW_SPSC_QUEUE_H
+#define SAMPLEFLOW_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace SampleFlow
+{
+  namespace Utilities
+  {
+    /**
+     * A bounded, lock-free queue for the case where exactly one thread
+     * pushes elements into the queue (the "producer") and exactly one
+     * (possibly different) thread removes them (the "consumer"). This is
+     * the data structure underlying ParallelMode::ingestion: Each
+     * connection of a Consumer object to a Producer writes into its own
+     * queue of this type, and a single thread drains all of these queues.
+     *
+     * The queue is implemented as a ring buffer whose size is a power of
+     * two. The producer only ever writes the index of the next free slot,
+     * and the consumer only ever writes the index of the next element to
+     * be read. Neither side therefore needs to take a lock, and the two
+     * indices are placed on separate cache lines so that the two threads
+     * do not invalidate each other's caches on every operation.
+     *
+     * Elements are removed in two steps: front() returns a pointer to the
+     * oldest element, and pop() removes it. This allows the consumer to
+     * process an element in place, and to remove it only once it is done
+     * with it. Observers can then use empty() to find out whether all
+     * elements that have been pushed have also been fully processed.
+     *
+     * @tparam T The type of the elements stored in the queue. It must be
+     *   move-constructible, but need not be default-constructible: Elements
+     *   are only constructed when they are pushed into the queue, and
+     *   destroyed when they are popped.
+     */
+    template <typename T>
+    class SPSCQueue
+    {
+      public:
+        /**
+         * Constructor. Create a queue that can hold at least `capacity`
+         * elements.
+         */
+        SPSCQueue (const std::size_t capacity);
+
+        /**
+         * Destructor. Destroy all elements that are still in the queue.
+         */
+        ~SPSCQueue ();
+
+        /**
+         * Try to move the given element into the queue. If the queue is
+         * full, then return `false` and leave `element` untouched.
+         * Otherwise, move from `element` and return `true`.
+         *
+         * This function may only be called by the producer thread.
+         */
+        bool
+        try_push (T &&element);
+
+        /**
+         * Return a pointer to the oldest element in the queue, or `nullptr`
+         * if the queue is empty. The element stays in the queue until
+         * pop() is called.
+         *
+         * This function may only be called by the consumer thread.
+         */
+        T *
+        front ();
+
+        /**
+         * Remove the oldest element from the queue. The queue must not be
+         * empty.
+         *
+         * This function may only be called by the consumer thread.
+         */
+        void
+        pop ();
+
+        /**
+         * Return whether the queue is empty, i.e., whether all elements
+         * that have been pushed have also been popped. This function can
+         * be called from any thread, but the answer may of course be
+         * out of date by the time it is returned if the producer is
+         * still pushing elements.
+         */
+        bool
+        empty () const;
+
+        /**
+         * Return the maximal number of elements the queue can hold.
+         */
+        std::size_t
+        capacity () const;
+
+      private:
+        /**
+         * The (uninitialized) storage for the elements of the ring buffer,
+         * its size, and a mask with which to compute the position of an
+         * element in it.
+         */
+        using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+        const std::size_t       n_slots;
+        const std::size_t       mask;
+        std::unique_ptr<Slot[]> slots;
+
+        /**
+         * Return a pointer to the element stored in the given slot.
+         */
+        T *
+        element (const std::size_t index);
+
+        /**
+         * The number of elements popped so far. This is only written by
+         * the consumer thread. The padding arrays ensure that this
+         * variable and the next live on separate cache lines.
+         */
+        char                     padding_1[64];
+        std::atomic<std::size_t> head;
+
+        /**
+         * The number of elements pushed so far. This is only written by
+         * the producer thread.
+         */
+        char                     padding_2[64];
+        std::atomic<std::size_t> tail;
+        char                     padding_3[64];
+    };
+
+
+
+    namespace internal
+    {
+      /**
+       * Return the smallest power of two that is at least `n`.
+       */
+      inline
+      std::size_t
+      next_power_of_two (const std::size_t n)
+      {
+        std::size_t p = 1;
+        while (p < n)
+          p *= 2;
+        return p;
+      }
+    }
+
+
+
+    template <typename T>
+    SPSCQueue<T>::
+    SPSCQueue (const std::size_t capacity)
+      :
+      n_slots (internal::next_power_of_two(capacity)),
+      mask (n_slots - 1),
+      slots (new Slot[n_slots]),
+      head (0),
+      tail (0)
+    {
+      assert (capacity > 0);
+    }
+
+
+
+    template <typename T>
+    SPSCQueue<T>::
+    ~SPSCQueue ()
+    {
+      while (front() != nullptr)
+        pop();
+    }
+
+
+
+    template <typename T>
+    T *
+    SPSCQueue<T>::
+    element (const std::size_t index)
+    {
+      return reinterpret_cast<T *>(&slots[index & mask]);
+    }
+
+
+
+    template <typename T>
+    bool
+    SPSCQueue<T>::
+    try_push (T &&element)
+    {
+      // Only we write 'tail', so we can read it without synchronization.
+      // 'head' is written by the consumer; we need to see the value it
+      // wrote after it was done with an element before we can overwrite
+      // that element.
+      const std::size_t current_tail = tail.load (std::memory_order_relaxed);
+      if (current_tail - head.load (std::memory_order_acquire) == n_slots)
+        return false;
+
+      new (this->element(current_tail)) T (std::move(element));
+
+      // Publish the element. This store is sequentially consistent (rather
+      // than just a 'release' store) so that users of this class can
+      // reason about its order relative to other sequentially consistent
+      // operations, for example when deciding whether a sleeping consumer
+      // needs to be woken up.
+      tail.store (current_tail + 1);
+      return true;
+    }
+
+
+
+    template <typename T>
+    T *
+    SPSCQueue<T>::
+    front ()
+    {
+      const std::size_t current_head = head.load (std::memory_order_relaxed);
+      if (current_head == tail.load ())
+        return nullptr;
+      else
+        return element(current_head);
+    }
+
+
+
+    template <typename T>
+    void
+    SPSCQueue<T>::
+    pop ()
+    {
+      const std::size_t current_head = head.load (std::memory_order_relaxed);
+      assert (current_head != tail.load ());
+
+      // Destroy the element before handing the slot back to the producer.
+      element(current_head)->~T();
+      head.store (current_head + 1, std::memory_order_release);
+    }
+
+
+
+    template <typename T>
+    bool
+    SPSCQueue<T>::
+    empty () const
+    {
+      return (head.load () == tail.load ());
+    }
+
+
+
+    template <typename T>
+    std::size_t
+    SPSCQueue<T>::
+    capacity () const
+    {
+      return n_slots;
+    }
+  }
+}
+
+#endif
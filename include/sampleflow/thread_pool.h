@@ -0,0 +1,371 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+#ifndef SAMPLEFLOW_THREAD_POOL_H
+#define SAMPLEFLOW_THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+namespace SampleFlow
+{
+  namespace Utilities
+  {
+    /**
+     * A simple pool of worker threads to which one can submit tasks.
+     * Unlike `std::async(std::launch::async, ...)`, which (at least in
+     * common implementations) creates a new thread for every task, the
+     * threads of this class are created once in the constructor and
+     * then reused for all tasks. This makes the class suitable for
+     * situations where one wants to execute many small pieces of work
+     * in parallel -- for example, evaluating a likelihood function that
+     * is a sum over many data points once per step of a sampling algorithm.
+     *
+     * Tasks can be submitted with a priority. Whenever a worker thread
+     * becomes available, it starts the pending task with the highest
+     * priority; tasks with the same priority are started in the order in
+     * which they were submitted, though of course several tasks may be
+     * running concurrently on different threads. This allows, for example,
+     * to let latency-sensitive work overtake bulk work that has been queued
+     * up earlier; see Consumer::set_priority().
+     *
+     * Most of SampleFlow uses its own ThreadPool objects, but there is
+     * also one object that is shared by all parts of the library that do
+     * not have a specific reason to use their own pool, and that can be
+     * accessed via shared_thread_pool().
+     *
+     * @note Tasks submitted to a thread pool must not wait for the
+     *   completion of other tasks submitted to the same pool. If all
+     *   worker threads were busy waiting, the tasks they are waiting for
+     *   could never be started.
+     */
+    class ThreadPool
+    {
+      public:
+        /**
+         * Constructor. Start the given number of worker threads. By default,
+         * this is the number of hardware threads the system reports (or one
+         * if the system does not report a number).
+         */
+        ThreadPool (const unsigned int n_threads
+                    = std::max (1U, std::thread::hardware_concurrency()));
+
+        /**
+         * Destructor. Wait for all tasks that have already been submitted
+         * to finish, and then shut down the worker threads.
+         */
+        ~ThreadPool ();
+
+        /**
+         * Return the number of worker threads of this pool.
+         */
+        unsigned int
+        n_threads () const;
+
+        /**
+         * Submit a task for execution on one of the worker threads.
+         *
+         * @return A future object that becomes ready once the task has
+         *   finished. If the task throws an exception, the exception is
+         *   re-thrown when calling `get()` on the returned object.
+         */
+        std::future<void>
+        submit (const std::function<void ()> &task);
+
+        /**
+         * Like the previous function, but submit the task with the given
+         * priority. Tasks with higher priorities are started before tasks
+         * with lower priorities, regardless of the order in which they
+         * were submitted. The previous function submits tasks with
+         * priority zero.
+         */
+        std::future<void>
+        submit (const std::function<void ()> &task,
+                const int priority);
+
+        /**
+         * Split the index range `[begin,end)` into `n_chunks` contiguous
+         * chunks of (almost) equal size and call `f(chunk_begin,chunk_end,chunk)`
+         * for each of them, where `chunk` is the number of the chunk.
+         * All but one of the chunks are executed on the worker threads; the
+         * last one is executed on the calling thread. The function returns
+         * once all chunks have been processed.
+         *
+         * The way the range is split into chunks only depends on `begin`,
+         * `end`, and `n_chunks`, but not on the number of worker threads or
+         * the order in which chunks are executed. Callers that accumulate
+         * results per chunk and then combine them in the order of chunks
+         * therefore obtain results that are reproducible bit by bit,
+         * regardless of how threads are scheduled.
+         *
+         * If `n_chunks` is zero, then the number of worker threads is used.
+         */
+        void
+        parallel_for (const std::size_t begin,
+                      const std::size_t end,
+                      const unsigned int n_chunks,
+                      const std::function<void (std::size_t, std::size_t, unsigned int)> &f);
+
+      private:
+        /**
+         * The worker threads.
+         */
+        std::vector<std::thread> threads;
+
+        /**
+         * A structure describing a task that has been submitted but not yet
+         * started, along with its priority and a number that indicates the
+         * order of submission.
+         */
+        struct PendingTask
+        {
+          int priority;
+          unsigned long long sequence_number;
+          std::shared_ptr<std::packaged_task<void ()>> task;
+
+          /**
+           * Comparison operator for the priority queue: A task is "less"
+           * than another if it should be started later.
+           */
+          bool operator< (const PendingTask &other) const
+          {
+            return ((priority < other.priority)
+                    ||
+                    ((priority == other.priority) && (sequence_number > other.sequence_number)));
+          }
+        };
+
+        /**
+         * The queue of tasks that have been submitted but not yet started,
+         * sorted by priority and order of submission.
+         */
+        std::priority_queue<PendingTask> tasks;
+
+        /**
+         * The number of tasks that have been submitted so far.
+         */
+        unsigned long long n_submitted_tasks;
+
+        /**
+         * A mutex guarding access to the queue of tasks and to the
+         * `shutting_down` flag.
+         */
+        std::mutex mutex;
+
+        /**
+         * A condition variable that worker threads wait on when there is
+         * nothing to do.
+         */
+        std::condition_variable condition;
+
+        /**
+         * A flag that indicates that the destructor has been called and
+         * that worker threads should exit once the queue is empty.
+         */
+        bool shutting_down;
+
+        /**
+         * The function executed by each worker thread.
+         */
+        void worker_loop ();
+    };
+
+
+
+    inline
+    ThreadPool::ThreadPool (const unsigned int n_threads)
+      :
+      n_submitted_tasks (0),
+      shutting_down (false)
+    {
+      for (unsigned int i=0; i<std::max(n_threads,1U); ++i)
+        threads.emplace_back ([this]()
+      {
+        this->worker_loop();
+      });
+    }
+
+
+
+    inline
+    ThreadPool::~ThreadPool ()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutting_down = true;
+      }
+      condition.notify_all();
+
+      for (auto &thread : threads)
+        thread.join();
+    }
+
+
+
+    inline
+    unsigned int
+    ThreadPool::n_threads () const
+    {
+      return threads.size();
+    }
+
+
+
+    inline
+    std::future<void>
+    ThreadPool::submit (const std::function<void ()> &task)
+    {
+      return submit (task, 0);
+    }
+
+
+
+    inline
+    std::future<void>
+    ThreadPool::submit (const std::function<void ()> &task,
+                        const int priority)
+    {
+      // std::priority_queue only gives access to its elements through
+      // a const reference, so we can not move a packaged_task out of it.
+      // Store it through a shared_ptr instead.
+      std::shared_ptr<std::packaged_task<void ()>>
+      packaged_task = std::make_shared<std::packaged_task<void ()>> (task);
+      std::future<void> future = packaged_task->get_future();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push ({priority, n_submitted_tasks++, std::move(packaged_task)});
+      }
+      condition.notify_one();
+
+      return future;
+    }
+
+
+
+    inline
+    void
+    ThreadPool::parallel_for (const std::size_t begin,
+                              const std::size_t end,
+                              const unsigned int n_chunks,
+                              const std::function<void (std::size_t, std::size_t, unsigned int)> &f)
+    {
+      const unsigned int n = (n_chunks == 0 ? n_threads() : n_chunks);
+      const std::size_t length = (end > begin ? end-begin : 0);
+
+      // Compute the chunk boundaries. The first (length % n) chunks
+      // get one more element than the rest.
+      auto chunk_begin = [ = ](const unsigned int chunk)
+      {
+        return begin + chunk*(length/n) + std::min<std::size_t>(chunk, length%n);
+      };
+
+      std::vector<std::future<void>> futures;
+      futures.reserve (n);
+      for (unsigned int chunk=0; chunk+1<n; ++chunk)
+        futures.emplace_back (submit ([ &, chunk]()
+        {
+          f (chunk_begin(chunk), chunk_begin(chunk+1), chunk);
+        }));
+
+      // Do the last chunk on the current thread, then wait for the others.
+      // We must wait for all chunks even if one of them throws an exception
+      // because the tasks reference local variables of this function. Only
+      // then re-throw the first exception we have encountered.
+      std::exception_ptr exception;
+      try
+        {
+          f (chunk_begin(n-1), chunk_begin(n), n-1);
+        }
+      catch (...)
+        {
+          exception = std::current_exception();
+        }
+
+      for (auto &future : futures)
+        try
+          {
+            future.get();
+          }
+        catch (...)
+          {
+            if (!exception)
+              exception = std::current_exception();
+          }
+
+      if (exception)
+        std::rethrow_exception (exception);
+    }
+
+
+
+    inline
+    void
+    ThreadPool::worker_loop ()
+    {
+      while (true)
+        {
+          std::shared_ptr<std::packaged_task<void ()>> task;
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait (lock, [this]()
+            {
+              return (shutting_down || !tasks.empty());
+            });
+
+            if (tasks.empty())
+              return;
+
+            task = tasks.top().task;
+            tasks.pop();
+          }
+
+          // Execute the task outside the lock. Exceptions are captured
+          // by the packaged_task and stored in the associated future.
+          (*task)();
+        }
+    }
+
+
+
+    /**
+     * Return a reference to a ThreadPool object that is shared by all parts
+     * of SampleFlow that do not use their own thread pool -- in particular,
+     * by consumers that process samples asynchronously and for which a
+     * priority has been set via Consumer::set_priority(). The pool is
+     * created upon the first call to this function and uses the default
+     * number of threads.
+     */
+    inline
+    ThreadPool &
+    shared_thread_pool ()
+    {
+      static ThreadPool thread_pool;
+      return thread_pool;
+    }
+  }
+}
+
+#endif
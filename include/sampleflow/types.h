@@ -18,8 +18,12 @@
 
 #include <cstddef>
 #include <complex>
+#include <valarray>
+#include <utility>
+#include <type_traits>
 
 #include <sampleflow/element_access.h>
+#include <sampleflow/span.h>
 
 
 namespace SampleFlow
@@ -61,6 +65,47 @@ namespace SampleFlow
      */
     template <typename SampleType>
     using ScalarType = decltype(Utilities::get_nth_element(std::declval<SampleType>(), 0));
+
+
+    namespace internal
+    {
+      /**
+       * A class whose member type `type` is the type in which consumers
+       * store objects of type `SampleType`. For most types, this is
+       * `SampleType` itself.
+       */
+      template <typename SampleType>
+      struct StorageType
+      {
+        using type = SampleType;
+      };
+
+
+      /**
+       * Specialization of the class above for Span types, which do not
+       * own their data and can consequently not be stored. Rather, they
+       * are stored as `std::valarray` objects of the underlying element
+       * type.
+       */
+      template <typename T>
+      struct StorageType<Span<T>>
+      {
+        using type = std::valarray<typename std::remove_cv<T>::type>;
+      };
+    }
+
+
+    /**
+     * Declaration of a type that consumers use when they need to store
+     * objects of type `SampleType`, for example to keep track of a running
+     * mean or of a history of previous samples. For most sample types, this
+     * is simply `SampleType` itself. But for non-owning types such as
+     * Span, it is a type that holds a copy of the data. Objects of type
+     * `StorageType<SampleType>` can be created from samples using
+     * Utilities::to_storage().
+     */
+    template <typename SampleType>
+    using StorageType = typename internal::StorageType<SampleType>::type;
   }
 
 
@@ -88,6 +133,69 @@ namespace SampleFlow
     {
       return std::conj(value);
     }
+
+
+
+    /**
+     * Convert a sample into an object of type `types::StorageType<SampleType>`
+     * so that it can be stored by a consumer. This template is chosen for
+     * all sample types other than Span and, because the storage type is
+     * then the sample type itself, simply returns (a copy of, or if passed
+     * an rvalue, the moved-from) argument.
+     */
+    template <typename SampleType>
+    auto to_storage (SampleType &&sample)
+    -> typename std::enable_if<types::is_span<typename std::decay<SampleType>::type>::value == false,
+    typename std::decay<SampleType>::type>::type
+    {
+      return std::forward<SampleType>(sample);
+    }
+
+
+
+    /**
+     * Convert a sample into an object of type `types::StorageType<SampleType>`
+     * so that it can be stored by a consumer. This template is chosen for
+     * Span samples and copies the data the span points to.
+     */
+    template <typename T>
+    types::StorageType<types::Span<T>>
+    to_storage (const types::Span<T> &sample)
+    {
+      return types::StorageType<types::Span<T>> (sample.data(), sample.size());
+    }
+
+
+
+    /**
+     * The inverse of to_storage(): Create an object of type `SampleType`
+     * from an object of type `types::StorageType<SampleType>`, for example
+     * to send a stored sample to a consumer. This template is chosen for all
+     * sample types other than Span and, because the storage type is then the
+     * sample type itself, simply returns a copy of the argument.
+     */
+    template <typename SampleType>
+    auto from_storage (types::StorageType<SampleType> &sample)
+    -> typename std::enable_if<types::is_span<SampleType>::value == false,
+    SampleType>::type
+    {
+      return sample;
+    }
+
+
+
+    /**
+     * The inverse of to_storage() for Span samples. The returned object
+     * points into the argument, which therefore needs to live at least as
+     * long as the returned object is used.
+     */
+    template <typename SampleType>
+    auto from_storage (types::StorageType<SampleType> &sample)
+    -> typename std::enable_if<types::is_span<SampleType>::value == true,
+    SampleType>::type
+    {
+      return SampleType (&sample[0], sample.size());
+    }
   }
 }
 
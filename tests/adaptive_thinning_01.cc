@@ -0,0 +1,78 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the AdaptiveThinning filter on a two-component autoregressive
+// process x_{k+1} = rho x_k + sqrt(1-rho^2) xi_k, for which the
+// integrated autocorrelation time is (1+rho)/(1-rho). The first
+// component has rho=0.9 (tau=19), the second rho=0.5 (tau=3), so the
+// filter should pick a thinning factor close to 19 after the first
+// window.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/adaptive_thinning.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  std::mt19937 rng;
+  std::normal_distribution<> normal_distribution(0,1);
+
+  const double rho[2] = {0.9, 0.5};
+  std::vector<SampleType> samples;
+  SampleType x = {0., 0.};
+  for (unsigned int k=0; k<50000; ++k)
+    {
+      for (unsigned int c=0; c<2; ++c)
+        x[c] = rho[c]*x[c] + std::sqrt(1-rho[c]*rho[c])*normal_distribution(rng);
+      samples.push_back (x);
+    }
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Filters::AdaptiveThinning<SampleType> adaptive_thinning (10000);
+  adaptive_thinning.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (adaptive_thinning);
+
+  // During the first window, all samples are passed on:
+  range_producer.sample (std::vector<SampleType>(samples.begin(), samples.begin()+9999));
+  std::cout << "After 9999 samples: every_nth=" << adaptive_thinning.get_every_nth()
+            << ", count=" << count_samples.get() << std::endl;
+
+  // Then the thinning factor is adapted:
+  range_producer.sample (std::vector<SampleType>(samples.begin()+9999, samples.end()));
+  const double tau = adaptive_thinning.get_integrated_autocorrelation_time();
+  std::cout << "IAT estimate within 25% of 19: " << (std::fabs(tau-19) < 0.25*19) << std::endl;
+  std::cout << "Thinning factor matches IAT: "
+            << (adaptive_thinning.get_every_nth() == std::ceil(tau)) << std::endl;
+
+  // The remaining 40001 samples should have been thinned by a factor
+  // around 19 (each window yields a somewhat different estimate):
+  const double n_thinned = count_samples.get() - 9999;
+  std::cout << "Samples passed after first window within 40% of 40001/19: "
+            << (std::fabs(n_thinned - 40001./19) < 0.4*40001./19) << std::endl;
+}
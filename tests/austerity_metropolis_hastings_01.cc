@@ -0,0 +1,99 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the AusterityMetropolisHastings producer: Sample the mean of
+// normally distributed data points (with a flat prior) and check that
+// the posterior mean is close to the mean of the data while the
+// sequential test only needs to look at a fraction of the data set in
+// most steps.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/austerity_metropolis_hastings.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+#include <sampleflow/consumers/action.h>
+
+using SampleType = double;
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::uniform_real_distribution<double> distribution(-0.02, 0.02);
+
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  // Create a data set of normally distributed values with mean 2:
+  std::mt19937 rng;
+  std::normal_distribution<double> normal(2, 1);
+  std::vector<double> data (10000);
+  for (auto &d : data)
+    d = normal(rng);
+
+  double data_mean = 0;
+  for (const auto d : data)
+    data_mean += d;
+  data_mean /= data.size();
+  std::cout << "Mean of the data: " << data_mean << std::endl;
+
+  SampleFlow::Producers::AusterityMetropolisHastings<SampleType> sampler;
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+  acceptance_ratio.connect_to_producer (sampler);
+
+  SampleFlow::types::sample_index n_data_evaluated = 0;
+  SampleFlow::Consumers::Action<SampleType> count_data
+  ([&](SampleType, SampleFlow::AuxiliaryData aux_data)
+  {
+    n_data_evaluated
+    += boost::any_cast<SampleFlow::types::sample_index>(aux_data["number of data points evaluated"]);
+  });
+  count_data.connect_to_producer (sampler);
+
+  auto log_prior = [](const SampleType &)
+  {
+    return 0.;
+  };
+  auto log_likelihood_term = [&](const SampleType &x, const std::size_t i)
+  {
+    return -0.5*(data[i]-x)*(data[i]-x);
+  };
+
+  const unsigned int n_samples = 5000;
+  sampler.sample (data_mean,
+                  log_prior,
+                  log_likelihood_term,
+                  data.size(),
+                  &perturb,
+                  n_samples,
+                  200,
+                  0.05);
+
+  std::cout << "Posterior mean: " << mean_value.get() << std::endl;
+  std::cout << "Acceptance ratio: " << acceptance_ratio.get() << std::endl;
+  std::cout << "Average fraction of data evaluated per step: "
+            << 1.*n_data_evaluated/n_samples/data.size() << std::endl;
+}
@@ -0,0 +1,74 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the AutoCovarianceMatrix consumer for complex-valued samples:
+// Multiplying all samples by the same phase factor e^{i phi} must not
+// change the auto-covariance matrices, because the second factor of
+// each outer product is conjugated. We compare against the results
+// for the same (real-valued) samples stored in complex form.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <complex>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/auto_covariance_matrix.h>
+
+
+using SampleType = std::valarray<std::complex<double>>;
+
+
+int main ()
+{
+  const unsigned int lag = 4;
+  const std::complex<double> phase = std::polar (1., 0.7);
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  SampleFlow::Consumers::AutoCovarianceMatrix<SampleType> real_autocovariance (lag);
+  real_autocovariance.connect_to_producer(range_producer);
+
+  SampleFlow::Producers::Range<SampleType> rotated_range_producer;
+  SampleFlow::Consumers::AutoCovarianceMatrix<SampleType> rotated_autocovariance (lag);
+  rotated_autocovariance.connect_to_producer(rotated_range_producer);
+
+  std::vector<SampleType> samples, rotated_samples;
+  for (unsigned int k=0; k<50; ++k)
+    {
+      samples.push_back (SampleType {std::cos(1.*k), 1.*(k%5)});
+      rotated_samples.push_back (samples.back() * phase);
+    }
+  range_producer.sample (samples);
+  rotated_range_producer.sample (rotated_samples);
+
+  const auto A = real_autocovariance.get();
+  const auto B = rotated_autocovariance.get();
+  double max_difference = 0;
+  for (unsigned int l=0; l<=lag; ++l)
+    {
+      std::cout << "Lag " << l << ": ";
+      for (unsigned int i=0; i<2; ++i)
+        for (unsigned int j=0; j<2; ++j)
+          {
+            std::cout << B[l](i,j) << ' ';
+            max_difference = std::max (max_difference, std::abs(A[l](i,j) - B[l](i,j)));
+          }
+      std::cout << std::endl;
+    }
+  std::cout << "Invariant under phase rotation: " << (max_difference < 1e-12) << std::endl;
+}
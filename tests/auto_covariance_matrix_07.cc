@@ -0,0 +1,92 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the AutoCovarianceMatrix functions that compute only some of the
+// auto-covariance matrices, or only their traces, or that write into
+// existing objects: their results need to be the same as the corresponding
+// parts of what get() returns.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/auto_covariance_matrix.h>
+
+
+using SampleType = std::valarray<double>;
+using MatrixType = boost::numeric::ublas::matrix<double>;
+
+
+double difference (const MatrixType &A, const MatrixType &B)
+{
+  double max_difference = 0;
+  for (unsigned int i=0; i<A.size1(); ++i)
+    for (unsigned int j=0; j<A.size2(); ++j)
+      max_difference = std::max (max_difference, std::fabs(A(i,j) - B(i,j)));
+  return max_difference;
+}
+
+
+int main ()
+{
+  const unsigned int max_lag = 6;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  SampleFlow::Consumers::AutoCovarianceMatrix<SampleType> autocovariance (max_lag);
+  autocovariance.connect_to_producer(range_producer);
+
+  std::vector<SampleType> samples;
+  for (unsigned int k=0; k<100; ++k)
+    samples.push_back (SampleType {std::sin(0.3*k), 1.*(k%7), std::cos(1.*k*k)});
+
+  // Send the samples in two batches and compare results after each
+  // of them. In between, the objects filled by get_into() are reused.
+  std::vector<MatrixType> all_lags_into;
+  MatrixType              one_lag_into;
+  for (unsigned int batch=0; batch<2; ++batch)
+    {
+      range_producer.sample (std::vector<SampleType>(samples.begin() + batch*50,
+                                                     samples.begin() + (batch+1)*50));
+
+      const auto all_lags = autocovariance.get();
+      const auto some_lags = autocovariance.get (2, 4);
+      const auto traces = autocovariance.get_trace();
+      autocovariance.get_into (all_lags_into);
+
+      std::cout << "Batch " << batch << ':' << std::endl;
+      for (unsigned int l=0; l<=max_lag; ++l)
+        {
+          autocovariance.get_into (one_lag_into, l);
+
+          double trace = 0;
+          for (unsigned int i=0; i<3; ++i)
+            trace += all_lags[l](i,i);
+
+          std::cout << "  Lag " << l
+                    << ": trace=" << trace
+                    << ", get(lag): " << (difference (autocovariance.get(l), all_lags[l]) < 1e-12)
+                    << ", get(first,last): " << ((l<2 || l>4) ||
+                                                 (difference (some_lags[l-2], all_lags[l]) < 1e-12))
+                    << ", get_trace: " << (std::fabs (traces[l] - trace) < 1e-12)
+                    << ", get_into: " << (difference (all_lags_into[l], all_lags[l]) < 1e-12)
+                    << ' ' << (difference (one_lag_into, all_lags[l]) < 1e-12)
+                    << std::endl;
+        }
+    }
+}
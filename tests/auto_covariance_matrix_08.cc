@@ -0,0 +1,74 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the AutoCovarianceMatrix consumer with a sparse set of lags: The
+// results have to be the same as the corresponding entries computed by
+// an object that considers all lags up to the maximal lag.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/auto_covariance_matrix.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+int main ()
+{
+  const std::vector<unsigned int> lags = {0, 1, 5, 17, 30};
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::AutoCovarianceMatrix<SampleType> all_lags (lags.back());
+  all_lags.connect_to_producer(range_producer);
+
+  SampleFlow::Consumers::AutoCovarianceMatrix<SampleType> sparse_lags (lags);
+  sparse_lags.connect_to_producer(range_producer);
+
+  std::vector<SampleType> samples;
+  for (unsigned int k=0; k<200; ++k)
+    samples.push_back (SampleType {std::sin(0.1*k), 1.*(k%13)});
+  range_producer.sample (samples);
+
+  const auto A = all_lags.get();
+  const auto B = sparse_lags.get();
+  const auto traces = sparse_lags.get_trace();
+  const auto some_lags = sparse_lags.get (2, 20);
+  for (unsigned int i=0; i<lags.size(); ++i)
+    {
+      double max_difference = 0;
+      for (unsigned int r=0; r<2; ++r)
+        for (unsigned int c=0; c<2; ++c)
+          max_difference = std::max (max_difference,
+                                     std::fabs(A[lags[i]](r,c) - B[i](r,c)));
+
+      std::cout << "Lag " << lags[i] << ": "
+                << B[i](0,0) << ' ' << B[i](0,1) << ' '
+                << B[i](1,0) << ' ' << B[i](1,1)
+                << ", trace=" << traces[i]
+                << ", same as all lags: " << (max_difference < 1e-12)
+                << std::endl;
+    }
+
+  std::cout << "Lags between 2 and 20: " << some_lags.size() << std::endl;
+  const auto lag_17 = sparse_lags.get(17);
+  std::cout << "Lag 17: " << (std::fabs (lag_17(0,1) - B[3](0,1)) < 1e-12) << std::endl;
+}
@@ -0,0 +1,65 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the AutoCovarianceTrace consumer with a sparse set of lags: The
+// results have to be the same as the corresponding entries computed by
+// an object that considers all lags up to the maximal lag. Also output the
+// set of lags returned by geometric_lags().
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/auto_covariance_trace.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+int main ()
+{
+  const auto lags = SampleFlow::Utilities::geometric_lags (40);
+  std::cout << "Lags:";
+  for (const auto l : lags)
+    std::cout << ' ' << l;
+  std::cout << std::endl;
+  std::cout << "Number of geometric lags up to 10000: "
+            << SampleFlow::Utilities::geometric_lags (10000).size()
+            << std::endl;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::AutoCovarianceTrace<SampleType> all_lags (lags.back());
+  all_lags.connect_to_producer(range_producer);
+
+  SampleFlow::Consumers::AutoCovarianceTrace<SampleType> sparse_lags (lags);
+  sparse_lags.connect_to_producer(range_producer);
+
+  std::vector<SampleType> samples;
+  for (unsigned int k=0; k<200; ++k)
+    samples.push_back (SampleType {std::sin(0.1*k), 1.*(k%13)});
+  range_producer.sample (samples);
+
+  const auto A = all_lags.get();
+  const auto B = sparse_lags.get();
+  for (unsigned int i=0; i<lags.size(); ++i)
+    std::cout << "Lag " << sparse_lags.get_lags()[i] << ": " << B[i]
+              << ' ' << (std::fabs(A[lags[i]] - B[i]) < 1e-12)
+              << std::endl;
+}
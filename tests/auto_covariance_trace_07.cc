@@ -0,0 +1,75 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the AutoCovarianceTrace consumer for complex-valued samples by
+// comparing against a brute-force evaluation of
+//   1/(n-l-1) sum_t sum_j (x_{t+l,j}-xbar_j) conj(x_{t,j}-xbar_j)
+// and against the traces computed by the AutoCovarianceMatrix class.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <complex>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/auto_covariance_trace.h>
+#include <sampleflow/consumers/auto_covariance_matrix.h>
+
+
+using SampleType = std::valarray<std::complex<double>>;
+
+
+int main ()
+{
+  const unsigned int max_lag = 3;
+  const unsigned int n_samples = 40;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  SampleFlow::Consumers::AutoCovarianceTrace<SampleType> autocovariance_trace (max_lag);
+  autocovariance_trace.connect_to_producer(range_producer);
+  SampleFlow::Consumers::AutoCovarianceMatrix<SampleType> autocovariance_matrix (max_lag);
+  autocovariance_matrix.connect_to_producer(range_producer);
+
+  std::vector<SampleType> samples;
+  for (unsigned int k=0; k<n_samples; ++k)
+    samples.push_back (SampleType {std::complex<double>(std::cos(1.*k), std::sin(0.3*k)),
+                                   std::complex<double>(1.*(k%5), -0.5*(k%3))
+                                  });
+  range_producer.sample (samples);
+
+  SampleType mean (std::complex<double>(0.), 2);
+  for (const auto &x : samples)
+    mean += x;
+  mean /= std::complex<double>(n_samples);
+
+  const auto traces = autocovariance_trace.get();
+  const auto matrix_traces = autocovariance_matrix.get_trace();
+  for (unsigned int l=0; l<=max_lag; ++l)
+    {
+      std::complex<double> brute_force = 0;
+      for (unsigned int t=0; t<n_samples-l; ++t)
+        for (unsigned int j=0; j<2; ++j)
+          brute_force += (samples[t+l][j]-mean[j]) * std::conj(samples[t][j]-mean[j]);
+      brute_force /= (n_samples-l-1.);
+
+      std::cout << "Lag " << l << ": brute force: " << brute_force
+                << ", matches AutoCovarianceTrace: " << (std::abs(traces[l]-brute_force) < 1e-12)
+                << ", matches AutoCovarianceMatrix: "
+                << (std::abs(traces[l]-matrix_traces[l]) < 1e-12)
+                << std::endl;
+    }
+}
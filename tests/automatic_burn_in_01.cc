@@ -0,0 +1,75 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the AutomaticBurnIn filter: Run a Metropolis-Hastings sampler
+// for a standard normal distribution, but start it far away from the
+// mode at x=100. The random walk needs several hundred steps to get
+// there, and the filter should detect this based on the relative log
+// likelihood of the samples, and then only pass on samples that are
+// distributed according to the target.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/filters/automatic_burn_in.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+using SampleType = double;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -x*x/2;
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::normal_distribution<double> distribution(0, 0.5);
+  return {x + distribution(rng), 1.};
+}
+
+
+int main ()
+{
+  SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+
+  SampleFlow::Filters::AutomaticBurnIn<SampleType> burn_in (1000, 10000);
+  burn_in.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (burn_in);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (burn_in);
+
+  mh_sampler.sample ({100}, &log_likelihood, &perturb, 20000);
+
+  // The chain needs at least 100/0.5=200 steps to reach the mode. The
+  // filter tests cutoffs in steps of 1/10 of the buffer, so the cutoff
+  // should be detected in the first few thousand samples.
+  const SampleFlow::types::sample_index cutoff = *burn_in.get_cutoff();
+  std::cout << "Cutoff in [200,5000]: " << (cutoff >= 200 && cutoff <= 5000) << std::endl;
+  std::cout << "All samples after the cutoff passed on: "
+            << (count_samples.get() == 20000 - cutoff) << std::endl;
+  std::cout << "Mean close to zero: " << (std::fabs(mean_value.get()) < 0.2) << std::endl;
+}
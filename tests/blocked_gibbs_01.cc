@@ -0,0 +1,150 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the BlockedGibbs producer: Sample from a Gaussian Markov random
+// field on a chain of N nodes, i.e., from
+//   pi(x) ~ exp(-1/2 x^T Q x + b^T x)
+// where Q is the tridiagonal matrix with entries tau+kappa*deg(i) on the
+// diagonal and -kappa on the off-diagonals. Each component only depends
+// on its neighbors, so a red-black coloring of the nodes allows updating
+// all even and then all odd components in parallel. Compare the mean and
+// the variances of the samples with the exact values Q^{-1} b and
+// diag(Q^{-1}).
+
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <cmath>
+#include <vector>
+#include <valarray>
+
+#include <sampleflow/producers/blocked_gibbs.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/count_samples.h>
+
+using SampleType = std::valarray<double>;
+
+
+int main ()
+{
+  const unsigned int N = 8;
+  const double kappa = 1;
+  const double tau = 0.5;
+  const double b = 1;
+
+  // Set up the precision matrix as a dense matrix so that we can
+  // compute the exact covariance matrix below.
+  std::vector<std::vector<double>> Q (N, std::vector<double>(N, 0.));
+  for (unsigned int i=0; i<N; ++i)
+    {
+      Q[i][i] = tau;
+      if (i > 0)
+        {
+          Q[i][i]   += kappa;
+          Q[i][i-1]  = -kappa;
+        }
+      if (i < N-1)
+        {
+          Q[i][i]   += kappa;
+          Q[i][i+1]  = -kappa;
+        }
+    }
+
+  // The conditional distribution of x_i given all other components is a
+  // normal distribution with variance 1/Q_ii and mean
+  // (b + kappa * sum of neighbors)/Q_ii.
+  auto conditional_sampler = [&](SampleType &x,
+                                 const std::size_t i,
+                                 std::mt19937 &rng)
+  {
+    double neighbor_sum = 0;
+    if (i > 0)
+      neighbor_sum += x[i-1];
+    if (i < N-1)
+      neighbor_sum += x[i+1];
+
+    std::normal_distribution<double> distribution ((b + kappa*neighbor_sum) / Q[i][i],
+                                                   1./std::sqrt(Q[i][i]));
+    x[i] = distribution(rng);
+  };
+
+  std::vector<std::vector<std::size_t>> colors (2);
+  for (unsigned int i=0; i<N; ++i)
+    colors[i % 2].push_back (i);
+
+  SampleFlow::Utilities::ThreadPool thread_pool (2);
+  SampleFlow::Producers::BlockedGibbs<SampleType> sampler (thread_pool, 4);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (sampler);
+
+  sampler.sample (SampleType (0., N),
+                  conditional_sampler,
+                  colors,
+                  20000);
+
+  // Compute the exact covariance matrix Q^{-1} via Gauss-Jordan
+  // elimination (Q is symmetric positive definite, so we do not need
+  // pivoting), and from it the exact mean Q^{-1} b.
+  std::vector<std::vector<double>> A = Q;
+  std::vector<std::vector<double>> Q_inverse (N, std::vector<double>(N, 0.));
+  for (unsigned int i=0; i<N; ++i)
+    Q_inverse[i][i] = 1;
+  for (unsigned int k=0; k<N; ++k)
+    {
+      const double pivot = A[k][k];
+      for (unsigned int j=0; j<N; ++j)
+        {
+          A[k][j] /= pivot;
+          Q_inverse[k][j] /= pivot;
+        }
+      for (unsigned int i=0; i<N; ++i)
+        if (i != k)
+          {
+            const double factor = A[i][k];
+            for (unsigned int j=0; j<N; ++j)
+              {
+                A[i][j] -= factor * A[k][j];
+                Q_inverse[i][j] -= factor * Q_inverse[k][j];
+              }
+          }
+    }
+
+  std::cout << "Number of samples: " << count_samples.get() << std::endl;
+
+  const SampleType mean = mean_value.get();
+  const auto covariance = covariance_matrix.get();
+  std::cout << std::setprecision(4);
+  for (unsigned int i=0; i<N; ++i)
+    {
+      double exact_mean = 0;
+      for (unsigned int j=0; j<N; ++j)
+        exact_mean += Q_inverse[i][j] * b;
+
+      std::cout << "Component " << i
+                << ": mean " << mean[i] << " (exact: " << exact_mean << ")"
+                << ", variance " << covariance(i,i) << " (exact: " << Q_inverse[i][i] << ")"
+                << std::endl;
+    }
+}
@@ -0,0 +1,81 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the CovarianceMatrix consumer for complex-valued samples: The
+// result must be Hermitian and agree with the covariance matrix
+// computed directly from all samples via
+//   C = 1/(n-1) \sum (x-x*) conj(x-x*)^T
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <complex>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+
+
+using SampleType = std::valarray<std::complex<double>>;
+
+
+int main ()
+{
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer(range_producer);
+
+  const unsigned int n = 100;
+  std::vector<SampleType> samples;
+  for (unsigned int k=0; k<n; ++k)
+    samples.push_back (SampleType {{std::cos(1.*k), std::sin(2.*k)},
+      {1.*(k%7), -0.5*(k%3)},
+      {std::sin(3.*k), 0.}
+    });
+  range_producer.sample (samples);
+
+  // Compute the covariance matrix directly:
+  SampleType mean (std::complex<double>(0.), 3);
+  for (const auto &x : samples)
+    mean += x;
+  mean /= std::complex<double>(n);
+
+  std::complex<double> reference[3][3] = {};
+  for (const auto &x : samples)
+    for (unsigned int i=0; i<3; ++i)
+      for (unsigned int j=0; j<3; ++j)
+        reference[i][j] += (x[i]-mean[i]) * std::conj(x[j]-mean[j]) / (n-1.);
+
+  const auto C = covariance_matrix.get();
+  double max_error = 0;
+  for (unsigned int i=0; i<3; ++i)
+    {
+      for (unsigned int j=0; j<3; ++j)
+        {
+          std::cout << C(i,j) << ' ';
+          max_error = std::max (max_error, std::abs(C(i,j) - reference[i][j]));
+        }
+      std::cout << std::endl;
+    }
+
+  std::cout << "Agrees with direct computation: " << (max_error < 1e-12) << std::endl;
+  std::cout << "Hermitian: "
+            << (C(0,1) == std::conj(C(1,0)) && C(0,2) == std::conj(C(2,0))
+                && C(1,2) == std::conj(C(2,1)) && C(1,1).imag() == 0)
+            << std::endl;
+}
@@ -0,0 +1,89 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the DataParallelLogLikelihood class: Evaluate a log likelihood
+// that is a sum over many data points on a thread pool and compare
+// against a serial evaluation. Then use it to sample the mean of the
+// data points with the Metropolis-Hastings sampler; with a flat prior,
+// the posterior mean is the sample mean of the data.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/data_parallel_log_likelihood.h>
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/consumers/mean_value.h>
+
+using SampleType = double;
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::uniform_real_distribution<double> distribution(-0.02, 0.02);
+
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  // Create a data set of normally distributed values with mean 2:
+  std::mt19937 rng;
+  std::normal_distribution<double> normal(2, 1);
+  std::vector<double> data (10000);
+  for (auto &d : data)
+    d = normal(rng);
+
+  double data_mean = 0;
+  for (const auto d : data)
+    data_mean += d;
+  data_mean /= data.size();
+  std::cout << "Mean of the data: " << data_mean << std::endl;
+
+  auto term = [&](const SampleType &x, const std::size_t i)
+  {
+    return -0.5*(data[i]-x)*(data[i]-x);
+  };
+
+  SampleFlow::Utilities::ThreadPool thread_pool (3);
+  SampleFlow::Utilities::DataParallelLogLikelihood<SampleType>
+  log_likelihood (term, data.size(), thread_pool, 7);
+
+  // Compare against a serial evaluation. The results need not be
+  // exactly the same because the summation order is different, but
+  // evaluating the parallel version twice has to give identical results.
+  double serial = 0;
+  for (std::size_t i=0; i<data.size(); ++i)
+    serial += term(1.5, i);
+  std::cout << "Serial:   " << serial << std::endl;
+  std::cout << "Parallel: " << log_likelihood(1.5) << std::endl;
+  std::cout << "Reproducible: " << (log_likelihood(1.5) == log_likelihood(1.5)) << std::endl;
+
+  // Now sample:
+  SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (mh_sampler);
+
+  mh_sampler.sample (data_mean,
+                     log_likelihood,
+                     &perturb,
+                     5000);
+
+  std::cout << "Posterior mean: " << mean_value.get() << std::endl;
+}
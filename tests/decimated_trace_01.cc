@@ -0,0 +1,59 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the DecimatedTrace class: Send 1000 two-component samples through
+// a consumer with 8 buckets, and output the decimated trace.
+
+
+#include <iostream>
+#include <valarray>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/decimated_trace.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::DecimatedTrace<SampleType> decimated_trace (8);
+  decimated_trace.connect_to_producer (range_producer);
+
+  // Samples alternate between two values in the second component, so that
+  // the min and max of each bucket differ:
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<1000; ++i)
+    samples.push_back ({1.*i, (i%2 == 0 ? 1. : -1.)*i});
+  range_producer.sample (samples);
+
+  std::cout << "Bucket width: " << decimated_trace.get_bucket_width() << std::endl;
+  const auto trace = decimated_trace.get();
+  for (unsigned int c=0; c<trace.size(); ++c)
+    {
+      std::cout << "Component " << c << ':' << std::endl;
+      for (const auto &bucket : trace[c])
+        std::cout << "  samples " << bucket.first_sample_index
+                  << "..." << bucket.first_sample_index + bucket.n_samples - 1
+                  << ": min=" << bucket.min
+                  << ", max=" << bucket.max
+                  << ", mean=" << bucket.mean
+                  << std::endl;
+    }
+
+  decimated_trace.write_gnuplot (std::move(std::cout));
+}
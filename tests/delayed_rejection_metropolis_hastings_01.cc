@@ -0,0 +1,132 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the DelayedRejectionMetropolisHastings producer: Sample from a
+// Gaussian with mean 1 and standard deviation 1, using a first stage
+// proposal distribution that is far too wide and a second stage
+// proposal distribution with a much smaller scale. The mean and
+// variance of the samples should be close to one, and the acceptance
+// ratio should be substantially larger than that of the plain
+// MetropolisHastings sampler with the first stage proposal
+// distribution alone, at the cost of fewer than two likelihood
+// evaluations per sample.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/producers/delayed_rejection_metropolis_hastings.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+#include <sampleflow/consumers/action.h>
+
+using SampleType = double;
+
+const double first_stage_sigma = 10;
+const double second_stage_sigma = 1;
+
+
+double log_likelihood (const SampleType &x)
+{
+  return -(x-1)*(x-1)/2;
+}
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::normal_distribution<double> distribution(0, first_stage_sigma);
+
+  return {x + distribution(rng), 1.0};
+}
+
+
+double log_proposal_density (const SampleType &x, const SampleType &y)
+{
+  return -(y-x)*(y-x)/(2*first_stage_sigma*first_stage_sigma);
+}
+
+
+std::pair<SampleType,double> second_stage_perturb (const SampleType &x)
+{
+  static std::mt19937 rng (1);
+  std::normal_distribution<double> distribution(0, second_stage_sigma);
+
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  const unsigned int n_samples = 100000;
+
+  // First run the plain Metropolis-Hastings sampler for comparison
+  {
+    SampleFlow::Producers::MetropolisHastings<SampleType> sampler;
+
+    SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+    acceptance_ratio.connect_to_producer (sampler);
+
+    sampler.sample (1., &log_likelihood, &perturb, n_samples);
+
+    std::cout << "MH acceptance ratio: " << acceptance_ratio.get() << std::endl;
+  }
+
+  // Then the delayed rejection sampler
+  {
+    SampleFlow::Producers::DelayedRejectionMetropolisHastings<SampleType> sampler;
+
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    mean_value.connect_to_producer (sampler);
+
+    SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+    covariance_matrix.connect_to_producer (sampler);
+
+    SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+    acceptance_ratio.connect_to_producer (sampler);
+
+    unsigned int n_second_stage_accepted = 0;
+    unsigned int n_likelihood_evaluations = 0;
+    SampleFlow::Consumers::Action<SampleType> count_stages
+    ([&](SampleType, SampleFlow::AuxiliaryData aux_data)
+    {
+      const unsigned int stage
+        = boost::any_cast<unsigned int>(aux_data["delayed rejection stage"]);
+      if (stage == 2)
+        ++n_second_stage_accepted;
+      n_likelihood_evaluations += (stage == 1 ? 1 : 2);
+    });
+    count_stages.connect_to_producer (sampler);
+
+    sampler.sample (1.,
+                    &log_likelihood,
+                    &perturb,
+                    &log_proposal_density,
+                    &second_stage_perturb,
+                    n_samples);
+
+    std::cout << "DR mean value: " << mean_value.get() << std::endl;
+    std::cout << "DR variance: " << covariance_matrix.get()(0,0) << std::endl;
+    std::cout << "DR acceptance ratio: " << acceptance_ratio.get() << std::endl;
+    std::cout << "Fraction accepted in the second stage: "
+              << 1.*n_second_stage_accepted/n_samples << std::endl;
+    std::cout << "Likelihood evaluations per sample: "
+              << 1.*n_likelihood_evaluations/n_samples << std::endl;
+  }
+}
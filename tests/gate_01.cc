@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check Consumer::enable(), Consumer::disable(), and
+// Consumer::set_gate_schedule(): One consumer is toggled by another
+// consumer while samples are being produced, and two others only look
+// at every 10th sample and at the first 5 out of every 20 samples.
+
+
+#include <iostream>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/action.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/gate_schedule.h>
+
+
+int main ()
+{
+  using SampleType = double;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  // A consumer that is switched off for samples 50...79. The action is
+  // connected first, so it is executed before the counter sees a sample.
+  SampleFlow::Consumers::CountSamples<SampleType> toggled_count;
+  SampleFlow::Consumers::Action<SampleType> toggle
+  ([&](SampleType sample,
+       SampleFlow::AuxiliaryData)
+  {
+    if (sample == 50)
+      toggled_count.disable();
+    else if (sample == 80)
+      toggled_count.enable();
+  });
+  toggle.connect_to_producer(range_producer);
+  toggled_count.connect_to_producer(range_producer);
+
+  // Consumers with gate schedules:
+  SampleFlow::Consumers::MeanValue<SampleType> every_10th_mean;
+  every_10th_mean.set_gate_schedule (SampleFlow::GateSchedule::every_nth(10, 5));
+  every_10th_mean.connect_to_producer(range_producer);
+
+  SampleFlow::Consumers::CountSamples<SampleType> window_count;
+  SampleFlow::Consumers::MeanValue<SampleType> window_mean;
+  window_count.set_gate_schedule (SampleFlow::GateSchedule::periodic_window(5, 20));
+  window_mean.set_gate_schedule (SampleFlow::GateSchedule::periodic_window(5, 20));
+  window_count.connect_to_producer(range_producer);
+  window_mean.connect_to_producer(range_producer);
+
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<100; ++i)
+    samples.push_back (i);
+  range_producer.sample (samples);
+
+  // 100 samples minus the 30 in 50...79:
+  std::cout << "Toggled count: " << toggled_count.get()
+            << ", enabled: " << toggled_count.is_enabled() << std::endl;
+
+  // Samples 5, 15, ..., 95:
+  std::cout << "Mean of every 10th sample: " << every_10th_mean.get() << std::endl;
+
+  // Samples 0...4, 20...24, ..., 80...84:
+  std::cout << "Windowed count: " << window_count.get() << std::endl;
+  std::cout << "Windowed mean: " << window_mean.get() << std::endl;
+
+  // Disable one of the gated consumers entirely; this must not advance
+  // its schedule either.
+  window_count.disable();
+  range_producer.sample (samples);
+  std::cout << "Windowed count after disabling: " << window_count.get() << std::endl;
+}
@@ -0,0 +1,89 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that a disabled consumer is skipped by the producer without
+// copying samples for it, also if it is connected while disabled, and
+// that it receives samples again once it is enabled.
+
+
+#include <iostream>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/action.h>
+
+
+// A sample type that counts how often it is copied.
+struct Sample
+{
+  Sample (const int value)
+    : value (value)
+  {}
+
+  Sample (const Sample &sample)
+    : value (sample.value)
+  {
+    ++n_copies;
+  }
+
+  Sample &operator= (const Sample &sample)
+  {
+    value = sample.value;
+    ++n_copies;
+    return *this;
+  }
+
+  int value;
+  static unsigned int n_copies;
+};
+
+unsigned int Sample::n_copies = 0;
+
+
+int main ()
+{
+  std::vector<Sample> samples;
+  for (int i=0; i<10; ++i)
+    samples.emplace_back (i);
+
+  // First see how many copies a producer without any consumer makes:
+  SampleFlow::Producers::Range<Sample> lonely_producer;
+  Sample::n_copies = 0;
+  lonely_producer.sample (samples);
+  const unsigned int n_copies_without_consumer = Sample::n_copies;
+
+  // Then connect a consumer that is disabled before it is connected:
+  SampleFlow::Producers::Range<Sample> range_producer;
+  int sum = 0;
+  SampleFlow::Consumers::Action<Sample> action
+  ([&](Sample sample,
+       SampleFlow::AuxiliaryData)
+  {
+    sum += sample.value;
+  });
+  action.disable();
+  action.connect_to_producer(range_producer);
+
+  Sample::n_copies = 0;
+  range_producer.sample (samples);
+  std::cout << "Sum while disabled: " << sum << std::endl;
+  std::cout << "Extra copies while disabled: "
+            << Sample::n_copies - n_copies_without_consumer << std::endl;
+
+  action.enable();
+  range_producer.sample (samples);
+  std::cout << "Sum after enabling: " << sum << std::endl;
+}
@@ -0,0 +1,194 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the get_into() and visit() functions of a number of consumers:
+// they need to provide the same information as get(), and get_into()
+// must not allocate new memory when it is called a second time with the
+// same object.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <cmath>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/histogram.h>
+#include <sampleflow/consumers/marginal_histograms.h>
+#include <sampleflow/consumers/auto_covariance_trace.h>
+#include <sampleflow/consumers/decimated_trace.h>
+
+
+using SampleType = std::valarray<double>;
+
+
+// Call get(), get_into() twice, and visit() on the given consumer and check
+// that all of them return the same information. The comparison function
+// is passed as an argument, as is a function that returns a pointer to the
+// memory a result object owns.
+template <typename ConsumerType, typename Compare, typename Data>
+void check (const std::string    &name,
+            const ConsumerType &consumer,
+            const Compare      &compare,
+            const Data         &data)
+{
+  const typename ConsumerType::value_type reference = consumer.get();
+
+  typename ConsumerType::value_type result;
+  consumer.get_into (result);
+  const bool first_call_ok = compare (result, reference);
+
+  const auto *storage = data(result);
+  consumer.get_into (result);
+  const bool second_call_ok = compare (result, reference);
+  const bool same_storage = (data(result) == storage);
+
+  bool visit_ok = false;
+  consumer.visit ([&](const typename ConsumerType::value_type &value)
+  {
+    visit_ok = compare (value, reference);
+  });
+
+  std::cout << name << ": "
+            << first_call_ok << ' '
+            << second_call_ok << ' '
+            << same_storage << ' '
+            << visit_ok << std::endl;
+}
+
+
+// A function object that compares objects via operator==.
+struct Equal
+{
+  template <typename T>
+  bool operator() (const T &a, const T &b) const
+  {
+    return (a == b);
+  }
+};
+
+
+int main ()
+{
+  SampleFlow::Producers::Range<SampleType> range_producer;
+  SampleFlow::Producers::Range<double>     scalar_range_producer;
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::MarginalHistograms<SampleType> marginal_histograms (8, 10);
+  marginal_histograms.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::AutoCovarianceTrace<SampleType> autocovariance (5);
+  autocovariance.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::DecimatedTrace<SampleType> decimated_trace (4);
+  decimated_trace.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::CountSamples<double> count_samples;
+  count_samples.connect_to_producer (scalar_range_producer);
+
+  SampleFlow::Consumers::Histogram<double> histogram (-1, 1, 10);
+  histogram.connect_to_producer (scalar_range_producer);
+
+  std::vector<SampleType> samples;
+  std::vector<double>     scalar_samples;
+  for (unsigned int k=0; k<100; ++k)
+    {
+      samples.push_back (SampleType {std::sin(1.*k), 1.*(k%7), std::cos(0.1*k)});
+      scalar_samples.push_back (std::sin(1.*k));
+    }
+  range_producer.sample (samples);
+  scalar_range_producer.sample (scalar_samples);
+
+  check ("MeanValue", mean_value,
+         [](const SampleType &a, const SampleType &b)
+  {
+    return (a.size() == b.size()) && (std::abs(a-b).max() == 0);
+  },
+  [](const SampleType &a)
+  {
+    return &a[0];
+  });
+
+  check ("CovarianceMatrix", covariance_matrix,
+         [](const boost::numeric::ublas::matrix<double> &a,
+            const boost::numeric::ublas::matrix<double> &b)
+  {
+    return (a.size1() == b.size1()) && (a.size2() == b.size2()) &&
+           std::equal (a.data().begin(), a.data().end(), b.data().begin());
+  },
+  [](const boost::numeric::ublas::matrix<double> &a)
+  {
+    return &a.data()[0];
+  });
+
+  check ("MarginalHistograms", marginal_histograms, Equal(),
+         [](const SampleFlow::Consumers::MarginalHistograms<SampleType>::value_type &a)
+  {
+    return a.data();
+  });
+
+  check ("AutoCovarianceTrace", autocovariance, Equal(),
+         [](const std::vector<double> &a)
+  {
+    return a.data();
+  });
+
+  check ("DecimatedTrace", decimated_trace,
+         [](const SampleFlow::Consumers::DecimatedTrace<SampleType>::value_type &a,
+            const SampleFlow::Consumers::DecimatedTrace<SampleType>::value_type &b)
+  {
+    if (a.size() != b.size())
+      return false;
+    for (unsigned int c=0; c<a.size(); ++c)
+      {
+        if (a[c].size() != b[c].size())
+          return false;
+        for (unsigned int i=0; i<a[c].size(); ++i)
+          if ((a[c][i].first_sample_index != b[c][i].first_sample_index) ||
+              (a[c][i].min != b[c][i].min) ||
+              (a[c][i].max != b[c][i].max) ||
+              (a[c][i].mean != b[c][i].mean))
+            return false;
+      }
+    return true;
+  },
+  [](const SampleFlow::Consumers::DecimatedTrace<SampleType>::value_type &a)
+  {
+    return a.data();
+  });
+
+  check ("CountSamples", count_samples, Equal(),
+         [](const SampleFlow::types::sample_index &a)
+  {
+    return &a;
+  });
+
+  check ("Histogram", histogram, Equal(),
+         [](const SampleFlow::Consumers::Histogram<double>::value_type &a)
+  {
+    return a.data();
+  });
+
+  std::cout << "Number of samples: " << count_samples.get() << std::endl;
+}
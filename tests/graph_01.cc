@@ -0,0 +1,84 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the Graph class: Create a producer, a filter, and several
+// consumers inside a graph (in an order that is not the order in which
+// samples flow), connect them, and check the topological order, which
+// nodes build() puts into asynchronous mode, and the results.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/graph.h>
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/auto_covariance_trace.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  SampleFlow::Graph graph;
+
+  auto &count = graph.add<SampleFlow::Consumers::CountSamples<SampleType>>();
+  auto &thinning = graph.add<SampleFlow::Filters::TakeEveryNth<SampleType>>(2);
+  auto &covariance = graph.add<SampleFlow::Consumers::CovarianceMatrix<SampleType>>();
+  auto &autocovariance = graph.add<SampleFlow::Consumers::AutoCovarianceTrace<SampleType>>(2);
+  auto &producer = graph.add<SampleFlow::Producers::Range<SampleType>>();
+  auto &mean = graph.add<SampleFlow::Consumers::MeanValue<SampleType>>();
+
+  graph.connect (thinning, count);
+  graph.connect (producer, thinning);
+  graph.connect (thinning, covariance);
+  graph.connect (thinning, autocovariance);
+  graph.connect (producer, mean);
+
+  // Both of these are leaves, but the autocovariance needs samples in
+  // order and so can not run asynchronously:
+  graph.mark_as_expensive (covariance, 4);
+  graph.mark_as_expensive (autocovariance);
+
+  graph.build ();
+
+  std::cout << "Number of nodes: " << graph.n_nodes() << std::endl;
+  std::cout << "Topological order:";
+  for (const auto n : graph.topological_order())
+    std::cout << ' ' << n;
+  std::cout << std::endl;
+
+  std::cout << "Asynchronous: covariance=" << graph.is_asynchronous(covariance)
+            << ", autocovariance=" << graph.is_asynchronous(autocovariance)
+            << ", count=" << graph.is_asynchronous(count) << std::endl;
+
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<100; ++i)
+    samples.push_back (SampleType {1.*i, -1.*i});
+  producer.sample (samples);
+  graph.flush ();
+
+  // The thinned samples are 1, 3, ..., 99:
+  std::cout << "Count: " << count.get() << std::endl;
+  std::cout << "Mean: " << mean.get()[0] << ' ' << mean.get()[1] << std::endl;
+  std::cout << "Covariance: " << covariance.get()(0,0) << ' '
+            << covariance.get()(0,1) << std::endl;
+  std::cout << "Autocovariance(0): " << autocovariance.get()[0] << std::endl;
+}
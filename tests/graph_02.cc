@@ -0,0 +1,77 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check that Graph::connect() and Graph::mark_as_expensive() find a
+// filter when it is passed by a reference to its Producer or Consumer
+// base class (which, for the Producer base, is at a different address
+// than the filter itself), and that objects not created by Graph::add()
+// are rejected with an exception.
+
+
+#include <iostream>
+#include <stdexcept>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/graph.h>
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  SampleFlow::Graph graph;
+
+  auto &producer = graph.add<SampleFlow::Producers::Range<SampleType>>();
+  auto &thinning = graph.add<SampleFlow::Filters::TakeEveryNth<SampleType>>(2);
+  auto &count = graph.add<SampleFlow::Consumers::CountSamples<SampleType>>();
+
+  SampleFlow::Consumer<SampleType> &thinning_as_consumer = thinning;
+  SampleFlow::Producer<SampleType> &thinning_as_producer = thinning;
+
+  graph.connect (producer, thinning_as_consumer);
+  graph.connect (thinning_as_producer, count);
+  graph.mark_as_expensive (count);
+
+  // An object that is not owned by the graph:
+  SampleFlow::Consumers::CountSamples<SampleType> other_count;
+  try
+    {
+      graph.connect (thinning_as_producer, other_count);
+    }
+  catch (const std::invalid_argument &)
+    {
+      std::cout << "Caught exception for an object not created by add()"
+                << std::endl;
+    }
+
+  graph.build ();
+
+  std::cout << "Topological order:";
+  for (const auto n : graph.topological_order())
+    std::cout << ' ' << n;
+  std::cout << std::endl;
+
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<100; ++i)
+    samples.push_back (SampleType {1.*i});
+  producer.sample (samples);
+  graph.flush ();
+
+  std::cout << "Count: " << count.get() << std::endl;
+}
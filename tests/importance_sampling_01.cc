@@ -0,0 +1,76 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the ImportanceSampling producer: Draw samples from a wide normal
+// proposal distribution and weight them so that they represent a
+// narrower normal distribution with a different mean. Compare the
+// weighted mean with the mean of the target, the effective sample size
+// with its theoretical value, and the sum of weights with the ratio of
+// normalization constants.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/importance_sampling.h>
+#include <sampleflow/consumers/weighted_mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+
+using SampleType = double;
+
+
+int main ()
+{
+  // The proposal is N(0,2^2), normalized. The target is a non-normalized
+  // N(1,1), i.e., exp(-(x-1)^2/2) without the factor 1/sqrt(2 pi).
+  const double sigma_q = 2;
+  auto draw_from_proposal = [&](std::mt19937 &rng)
+  {
+    std::normal_distribution<double> distribution (0, sigma_q);
+    return distribution(rng);
+  };
+  auto log_proposal = [&](const SampleType &x)
+  {
+    return -0.5*x*x/(sigma_q*sigma_q) - std::log(sigma_q*std::sqrt(2*M_PI));
+  };
+  auto log_target = [](const SampleType &x)
+  {
+    return -0.5*(x-1)*(x-1);
+  };
+
+  SampleFlow::Utilities::ThreadPool thread_pool (2);
+  SampleFlow::Producers::ImportanceSampling<SampleType> sampler (thread_pool, 4);
+
+  using WeightedMeanValue = SampleFlow::Consumers::WeightedMeanValue<SampleType>;
+  WeightedMeanValue mean_value ("log weight",
+                                WeightedMeanValue::WeightType::logarithmic);
+  mean_value.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (sampler);
+
+  const unsigned int n_samples = 100000;
+  sampler.sample (draw_from_proposal, log_target, log_proposal,
+                  n_samples, 1000);
+
+  std::cout << "Number of samples: " << count_samples.get() << std::endl;
+  std::cout << "Weighted mean: " << mean_value.get() << std::endl;
+  std::cout << "Relative effective sample size: "
+            << sampler.get_effective_sample_size() / n_samples << std::endl;
+  std::cout << "Estimated normalization constant of the target: "
+            << std::exp(sampler.get_log_sum_of_weights()) / n_samples
+            << " (exact: " << std::sqrt(2*M_PI) << ")" << std::endl;
+}
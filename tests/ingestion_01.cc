@@ -0,0 +1,125 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check ParallelMode::ingestion: Connect a consumer to several producers
+// that run on separate threads, and verify that all samples arrive, that
+// samples from each producer arrive in order, and that consume() is never
+// called concurrently.
+
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+// A consumer that checks that samples from each producer arrive in order
+// and that it is only ever called from one thread at a time. Each sample
+// encodes the number of the producer that generated it, times 10000,
+// plus the number of the sample.
+class CheckOrder : public SampleFlow::Consumer<double>
+{
+  public:
+    CheckOrder (const unsigned int n_producers)
+      :
+      last_sample (n_producers, -1),
+      n_active_calls (0),
+      n_violations (0)
+    {}
+
+    ~CheckOrder ()
+    {
+      this->disconnect_and_flush();
+    }
+
+    virtual
+    void
+    consume (double sample, SampleFlow::AuxiliaryData) override
+    {
+      if (++n_active_calls != 1)
+        ++n_violations;
+
+      const unsigned int producer = static_cast<unsigned int>(sample) / 10000;
+      const int index = static_cast<int>(sample) % 10000;
+      if (index != last_sample[producer] + 1)
+        ++n_violations;
+      last_sample[producer] = index;
+
+      --n_active_calls;
+    }
+
+    std::vector<int>  last_sample;
+    std::atomic<int>  n_active_calls;
+    unsigned int      n_violations;
+};
+
+
+int main ()
+{
+  const unsigned int n_producers = 8;
+  const unsigned int n_samples   = 5000;
+
+  std::vector<std::unique_ptr<SampleFlow::Producers::Range<double>>> producers;
+  for (unsigned int p=0; p<n_producers; ++p)
+    producers.emplace_back (new SampleFlow::Producers::Range<double>());
+
+  SampleFlow::Consumers::MeanValue<double> mean_value;
+  mean_value.set_parallel_mode (SampleFlow::ParallelMode::ingestion, 16);
+
+  SampleFlow::Consumers::CountSamples<double> count_samples;
+  count_samples.set_parallel_mode (SampleFlow::ParallelMode::ingestion, 16);
+
+  // CheckOrder only supports synchronous processing, but can still
+  // be used in ingestion mode:
+  CheckOrder check_order (n_producers);
+  check_order.set_parallel_mode (SampleFlow::ParallelMode::ingestion, 16);
+
+  for (auto &producer : producers)
+    {
+      mean_value.connect_to_producer (*producer);
+      count_samples.connect_to_producer (*producer);
+      check_order.connect_to_producer (*producer);
+    }
+
+  std::vector<std::thread> threads;
+  for (unsigned int p=0; p<n_producers; ++p)
+    threads.emplace_back ([&producers,p,n_samples]()
+  {
+    std::vector<double> samples;
+    for (unsigned int i=0; i<n_samples; ++i)
+      samples.push_back (10000.*p + i);
+    producers[p]->sample (samples);
+  });
+  for (auto &thread : threads)
+    thread.join();
+
+  // Every producer flushes its consumers at the end of sample(), so
+  // all samples have been processed at this point.
+  std::cout << "Count: " << count_samples.get() << std::endl;
+  std::cout << "Mean: " << mean_value.get() << std::endl;
+
+  unsigned int n_complete = 0;
+  for (const int last : check_order.last_sample)
+    if (last == static_cast<int>(n_samples)-1)
+      ++n_complete;
+  std::cout << "Producers whose samples all arrived: " << n_complete << std::endl;
+  std::cout << "Ordering or concurrency violations: " << check_order.n_violations << std::endl;
+}
@@ -0,0 +1,77 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the MarginalHistograms consumer with fixed ranges, and compare
+// against what the Histogram class computes for individual components.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <tuple>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/component_splitter.h>
+#include <sampleflow/consumers/histogram.h>
+#include <sampleflow/consumers/marginal_histograms.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  // Create samples whose first component runs from 0 to 9.9 and whose
+  // second runs from 9.9 down to 0. The third component is 100 and so
+  // outside the range of its histogram.
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<100; ++i)
+    samples.push_back (SampleType {0.1*i+0.05, 9.95-0.1*i, 100.});
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::MarginalHistograms<SampleType>
+  marginal_histograms ({0., 0., 0.}, {10., 5., 10.}, 10, 2);
+  marginal_histograms.connect_to_producer (range_producer);
+
+  SampleFlow::Filters::ComponentSplitter<SampleType> component_splitter (1);
+  component_splitter.connect_to_producer (range_producer);
+  SampleFlow::Consumers::Histogram<double> histogram (0., 5., 10);
+  histogram.connect_to_producer (component_splitter);
+
+  range_producer.sample (samples);
+
+  const auto histograms = marginal_histograms.get();
+  for (unsigned int c=0; c<histograms.size(); ++c)
+    {
+      std::cout << "Component " << c << ':' << std::endl;
+      for (const auto &bin : histograms[c])
+        std::cout << "  [" << std::get<0>(bin) << ',' << std::get<1>(bin) << "): "
+                  << std::get<2>(bin) << std::endl;
+    }
+
+  // Compare the second component with the Histogram class:
+  const auto reference = histogram.get();
+  bool same = true;
+  for (unsigned int b=0; b<10; ++b)
+    if (std::get<2>(reference[b]) != std::get<2>(histograms[1][b]))
+      same = false;
+  std::cout << "Same as Histogram: " << same << std::endl;
+
+  // Check the layout of the contiguous array of counts:
+  const auto counts = marginal_histograms.get_counts();
+  std::cout << "Number of counts: " << counts.size()
+            << ", counts[10]=" << counts[10] << std::endl;
+}
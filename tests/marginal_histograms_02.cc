@@ -0,0 +1,66 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the MarginalHistograms consumer with automatically chosen
+// ranges in asynchronous mode: The first 100 samples determine the
+// initial ranges, and later samples outside these ranges require the
+// ranges to grow. Every sample needs to be counted exactly once, and
+// the result must not depend on the order in which samples are
+// processed.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <tuple>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/marginal_histograms.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  // The first component cycles through 0...9, the second grows linearly
+  // and so will eventually exceed any initial range, the third is
+  // constant.
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<10000; ++i)
+    samples.push_back (SampleType {1.*(i%10), 0.01*i, 3.});
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::MarginalHistograms<SampleType> marginal_histograms (8, 100, 4);
+  marginal_histograms.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 10);
+  marginal_histograms.connect_to_producer (range_producer);
+
+  range_producer.sample (samples);
+
+  const auto histograms = marginal_histograms.get();
+  for (unsigned int c=0; c<histograms.size(); ++c)
+    {
+      SampleFlow::types::sample_index total = 0;
+      std::cout << "Component " << c << ':' << std::endl;
+      for (const auto &bin : histograms[c])
+        {
+          std::cout << "  [" << std::get<0>(bin) << ',' << std::get<1>(bin) << "): "
+                    << std::get<2>(bin) << std::endl;
+          total += std::get<2>(bin);
+        }
+      std::cout << "  total: " << total << std::endl;
+    }
+}
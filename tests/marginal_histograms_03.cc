@@ -0,0 +1,97 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the MarginalHistograms consumer with samples whose components
+// are not finite or so far outside the range that their bin index does
+// not fit into an integer. These must simply not be counted with fixed
+// ranges. With adaptive ranges, the non-finite values must not be
+// counted nor affect the ranges; the extreme but finite value is
+// counted after growing the range.
+
+
+#include <iostream>
+#include <valarray>
+#include <vector>
+#include <tuple>
+#include <limits>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/marginal_histograms.h>
+
+
+template <typename Histograms>
+void output (const Histograms &histograms)
+{
+  for (unsigned int c=0; c<histograms.size(); ++c)
+    {
+      SampleFlow::types::sample_index total = 0;
+      for (const auto &bin : histograms[c])
+        total += std::get<2>(bin);
+      std::cout << "  Component " << c << ": ["
+                << std::get<0>(histograms[c].front()) << ','
+                << std::get<1>(histograms[c].back()) << "), total count "
+                << total << std::endl;
+    }
+}
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  const double inf = std::numeric_limits<double>::infinity();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+
+  // The first component always has a regular value. The second one is
+  // regular in all but three samples, in which it is NaN, +infinity, or
+  // -infinity. The third one is regular in all but one sample, in which
+  // it is 1e300.
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<100; ++i)
+    samples.push_back (SampleType {0.1*i, 0.1*i, 0.1*i});
+  samples[20][1] = nan;
+  samples[40][1] = inf;
+  samples[60][1] = -inf;
+  samples[80][2] = 1e300;
+
+  std::cout << "Fixed ranges:" << std::endl;
+  {
+    SampleFlow::Producers::Range<SampleType> range_producer;
+
+    SampleFlow::Consumers::MarginalHistograms<SampleType>
+    marginal_histograms ({0, 0, 0}, {10, 10, 10}, 10);
+    marginal_histograms.connect_to_producer (range_producer);
+
+    range_producer.sample (samples);
+    output (marginal_histograms.get());
+  }
+
+  std::cout << "Adaptive ranges:" << std::endl;
+  {
+    // Use a non-finite value already during calibration:
+    std::vector<SampleType> adaptive_samples = samples;
+    adaptive_samples[1][1] = nan;
+
+    SampleFlow::Producers::Range<SampleType> range_producer;
+
+    SampleFlow::Consumers::MarginalHistograms<SampleType>
+    marginal_histograms (10, 10);
+    marginal_histograms.connect_to_producer (range_producer);
+
+    range_producer.sample (adaptive_samples);
+    output (marginal_histograms.get());
+  }
+}
@@ -0,0 +1,86 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the ModeDiscovery class: Send samples that alternate between three
+// clusters (staying in each for a while) through the consumer, and output
+// the modes and transition counts found. Also check that a projection onto
+// the first component merges the two clusters that only differ in the
+// second component.
+
+
+#include <cmath>
+#include <iostream>
+#include <valarray>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/mode_discovery.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::ModeDiscovery<SampleType> mode_discovery (5, 3.);
+  mode_discovery.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::ModeDiscovery<SampleType>
+  projected_mode_discovery (5, 3.,
+                            [](const SampleType &x)
+  {
+    return std::vector<double> (1, x[0]);
+  });
+  projected_mode_discovery.connect_to_producer (range_producer);
+
+  // Visit the clusters in the order 0,1,0,2,0,1,... and stay in each
+  // for 50 samples. The samples are scattered around the cluster centers
+  // in a deterministic way.
+  const SampleType cluster_centers[3] = {{0,0}, {10,0}, {0,10}};
+  const unsigned int cluster_sequence[4] = {0, 1, 0, 2};
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<1000; ++i)
+    {
+      const unsigned int cluster = cluster_sequence[(i/50) % 4];
+      const SampleType perturbation = {1.*((i*7)%5) - 2., 1.*((i*3)%5) - 2.};
+      samples.push_back (cluster_centers[cluster] + 0.5*perturbation);
+    }
+  range_producer.sample (samples);
+
+  for (const auto *consumer : {&mode_discovery, &projected_mode_discovery})
+    {
+      std::cout << "Modes:" << std::endl;
+      for (const auto &mode : consumer->get())
+        {
+          std::cout << "  location=";
+          // Suppress round-off in the mode locations:
+          for (const double x : mode.location)
+            std::cout << (std::fabs(x) < 1e-12 ? 0. : x) << ' ';
+          std::cout << "n_samples=" << mode.n_samples
+                    << " weight=" << mode.weight
+                    << std::endl;
+        }
+
+      std::cout << "Transition counts:" << std::endl;
+      for (const auto &row : consumer->get_transition_counts())
+        {
+          std::cout << " ";
+          for (const auto n : row)
+            std::cout << ' ' << n;
+          std::cout << std::endl;
+        }
+    }
+}
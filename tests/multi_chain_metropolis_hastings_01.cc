@@ -0,0 +1,71 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// A simple test for the MultiChainMetropolisHastings producer: Like the
+// metropolis_hasting_producer_01 test, use a probability distribution
+// that increases left to right and always move to the right. Every
+// trial sample is then accepted, and each of the three chains should
+// simply count upward from its starting point. Output the samples
+// along with the chain they belong to.
+
+
+#include <iostream>
+#include <sampleflow/producers/multi_chain_metropolis_hastings.h>
+#include <sampleflow/consumers/action.h>
+
+using SampleType = double;
+using Producer = SampleFlow::Producers::MultiChainMetropolisHastings<SampleType>;
+
+
+void log_likelihood (const Producer::ChainStates &x,
+                     std::vector<double> &log_likelihoods)
+{
+  for (unsigned int w=0; w<log_likelihoods.size(); ++w)
+    log_likelihoods[w] = x[w]+1;
+}
+
+
+void perturb (const Producer::ChainStates &x,
+              Producer::ChainStates &trial_x,
+              std::vector<double> &log_proposal_ratios)
+{
+  for (unsigned int i=0; i<x.size(); ++i)
+    trial_x[i] = x[i]+1;
+  for (auto &r : log_proposal_ratios)
+    r = 0;
+}
+
+
+int main ()
+{
+  Producer mh_sampler;
+
+  SampleFlow::Consumers::Action<SampleType> action
+  ([](SampleType sample,
+      SampleFlow::AuxiliaryData aux_data)
+  {
+    std::cout << "chain " << boost::any_cast<unsigned int>(aux_data["chain index"])
+              << ": " << sample
+              << " repeated=" << boost::any_cast<bool>(aux_data["sample is repeated"])
+              << std::endl;
+  });
+  action.connect_to_producer(mh_sampler);
+
+  mh_sampler.sample ({0, 10, 100},
+                     &log_likelihood,
+                     &perturb,
+                     4);
+}
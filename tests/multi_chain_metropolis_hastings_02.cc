@@ -0,0 +1,88 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Use the MultiChainMetropolisHastings producer with eight chains to
+// sample from a two-dimensional Gaussian with mean (1,-1) and
+// covariance diag(1,4). The mean and covariance computed over all
+// chains should approximate these values.
+
+
+#include <iostream>
+#include <valarray>
+#include <random>
+
+#include <sampleflow/producers/multi_chain_metropolis_hastings.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/count_samples.h>
+
+using SampleType = std::valarray<double>;
+using Producer = SampleFlow::Producers::MultiChainMetropolisHastings<SampleType>;
+
+
+void log_likelihood (const Producer::ChainStates &x,
+                     std::vector<double> &log_likelihoods)
+{
+  const unsigned int W = log_likelihoods.size();
+  for (unsigned int w=0; w<W; ++w)
+    log_likelihoods[w] = -0.5 * (x[w]-1) * (x[w]-1)
+                         -0.5 * (x[W+w]+1) * (x[W+w]+1) / 4;
+}
+
+
+void perturb (const Producer::ChainStates &x,
+              Producer::ChainStates &trial_x,
+              std::vector<double> &log_proposal_ratios)
+{
+  static std::mt19937 rng;
+  std::normal_distribution<double> distribution(0, 1);
+
+  for (unsigned int i=0; i<x.size(); ++i)
+    trial_x[i] = x[i] + distribution(rng);
+  for (auto &r : log_proposal_ratios)
+    r = 0;
+}
+
+
+int main ()
+{
+  Producer mh_sampler;
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (mh_sampler);
+
+  const unsigned int n_chains = 8;
+  mh_sampler.sample (std::vector<SampleType>(n_chains, SampleType(0., 2)),
+                     &log_likelihood,
+                     &perturb,
+                     20000);
+
+  std::cout << "Number of samples: " << count_samples.get() << std::endl;
+  std::cout << "Mean value: " << mean_value.get()[0] << ' ' << mean_value.get()[1] << std::endl;
+  std::cout << "Covariance matrix: " << std::endl;
+  for (unsigned int i=0; i<2; ++i)
+    {
+      for (unsigned int j=0; j<2; ++j)
+        std::cout << covariance_matrix.get()(i,j) << ' ';
+      std::cout << std::endl;
+    }
+}
@@ -0,0 +1,85 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the MultilevelMetropolisHastings producer with a given number of
+// samples per level: The likelihoods on the three levels are Gaussians
+// whose means converge to one as the level increases, mimicking forward
+// models whose discretization error halves from one level to the
+// next. The telescoping-sum estimator must then approximate the mean of
+// the finest level, and the per-level differences must approximate the
+// differences of the means of successive levels.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/multilevel_metropolis_hastings.h>
+#include <sampleflow/consumers/multilevel_mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+
+using SampleType = double;
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::uniform_real_distribution<double> distribution(-1.5, 1.5);
+
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  // The log likelihoods of the three levels. The mean on level l is
+  // 1-2^{-(l+1)}, i.e., 0.5, 0.75, 0.875.
+  std::vector<std::function<double (const SampleType &)>> log_likelihoods;
+  for (unsigned int level=0; level<3; ++level)
+    {
+      const double mu = 1 - std::pow(2., -1.*(level+1));
+      log_likelihoods.emplace_back ([mu](const SampleType &x)
+      {
+        return -0.5*(x-mu)*(x-mu);
+      });
+    }
+
+  SampleFlow::Producers::MultilevelMetropolisHastings<SampleType> sampler;
+
+  SampleFlow::Consumers::MultilevelMeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (sampler);
+
+  sampler.sample (0.,
+                  log_likelihoods,
+                  &perturb,
+                  20,
+                  {40000, 10000, 2500});
+
+  std::cout << "Total number of samples: " << count_samples.get() << std::endl;
+  std::cout << "Multilevel estimate of the mean: " << mean_value.get() << std::endl;
+
+  const auto level_means = mean_value.get_level_means();
+  const auto level_variances = mean_value.get_level_variances();
+  const auto level_counts = mean_value.get_level_sample_counts();
+  for (unsigned int level=0; level<level_means.size(); ++level)
+    std::cout << "Level " << level
+              << ": N=" << level_counts[level]
+              << ", mean(Y)=" << level_means[level]
+              << ", var(Y)=" << level_variances[level]
+              << std::endl;
+}
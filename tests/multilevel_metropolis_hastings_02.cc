@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the MultilevelMetropolisHastings producer with sample counts
+// chosen by the cost/variance rule. We use the same hierarchy of
+// likelihoods as in the _01 test, but with costs that grow by a factor
+// of four from one level to the next. The variances of the level
+// differences are much smaller than the variance on the coarsest
+// level, so the rule has to choose many samples on level zero and
+// only few on the finer levels.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/multilevel_metropolis_hastings.h>
+#include <sampleflow/consumers/multilevel_mean_value.h>
+
+using SampleType = double;
+using Sampler = SampleFlow::Producers::MultilevelMetropolisHastings<SampleType>;
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::uniform_real_distribution<double> distribution(-1.5, 1.5);
+
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  std::vector<std::function<double (const SampleType &)>> log_likelihoods;
+  for (unsigned int level=0; level<3; ++level)
+    {
+      const double mu = 1 - std::pow(2., -1.*(level+1));
+      log_likelihoods.emplace_back ([mu](const SampleType &x)
+      {
+        return -0.5*(x-mu)*(x-mu);
+      });
+    }
+
+  // First check the sample count rule by itself:
+  for (const auto n : Sampler::optimal_sample_counts ({1, 0.25, 0.0625},
+                                                      {1, 4, 16},
+                                                      0.1))
+    std::cout << n << ' ';
+  std::cout << std::endl;
+
+  // Then run the adaptive algorithm:
+  Sampler sampler;
+
+  SampleFlow::Consumers::MultilevelMeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (sampler);
+
+  sampler.sample (0.,
+                  log_likelihoods,
+                  &perturb,
+                  20,
+                  {1, 4, 16},
+                  [](const SampleType &x)
+  {
+    return x;
+  },
+  1000,
+  0.02);
+
+  std::cout << "Multilevel estimate of the mean: " << mean_value.get() << std::endl;
+
+  const auto level_counts = mean_value.get_level_sample_counts();
+  for (unsigned int level=0; level<level_counts.size(); ++level)
+    std::cout << "Level " << level << ": N=" << level_counts[level] << std::endl;
+}
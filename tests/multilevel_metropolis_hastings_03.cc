@@ -0,0 +1,107 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that the MultilevelMetropolisHastings producer only evaluates the
+// fine log likelihood of a coarse sample once, even if the coarse chain
+// does not move for several steps of the fine chain, and that it reports
+// samples as repeated exactly if the fine chain did not move. The
+// trial samples of the coarse chain are chosen so that they are rejected
+// frequently.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/multilevel_metropolis_hastings.h>
+#include <sampleflow/consumers/action.h>
+
+using SampleType = double;
+
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::uniform_real_distribution<double> distribution(-5, 5);
+
+  return {x + distribution(rng), 1.0};
+}
+
+
+int main ()
+{
+  unsigned int n_fine_evaluations = 0;
+  std::vector<std::function<double (const SampleType &)>> log_likelihoods;
+  log_likelihoods.emplace_back ([](const SampleType &x)
+  {
+    return -0.5*x*x;
+  });
+  log_likelihoods.emplace_back ([&](const SampleType &x)
+  {
+    ++n_fine_evaluations;
+    return -0.5*(x-0.1)*(x-0.1);
+  });
+
+  SampleFlow::Producers::MultilevelMetropolisHastings<SampleType> sampler;
+
+  // Compare the "sample is repeated" flag of the fine samples with whether
+  // the sample actually differs from the previous one, and count how
+  // often the coarse chain has moved.
+  SampleType previous_fine_sample = 0;
+  SampleType previous_coarse_sample = 0;
+  unsigned int n_fine_samples = 0;
+  unsigned int n_repeated_fine_samples = 0;
+  unsigned int n_wrongly_flagged_samples = 0;
+  unsigned int n_coarse_moves = 0;
+  SampleFlow::Consumers::Action<SampleType> check
+  ([&](SampleType sample,
+       SampleFlow::AuxiliaryData aux_data)
+  {
+    if (boost::any_cast<unsigned int>(aux_data["level"]) != 1)
+      return;
+
+    const SampleType coarse_sample = boost::any_cast<SampleType>(aux_data["coarse sample"]);
+    const bool is_repeated = boost::any_cast<bool>(aux_data["sample is repeated"]);
+
+    ++n_fine_samples;
+    if (is_repeated)
+      ++n_repeated_fine_samples;
+    if (is_repeated != (sample == previous_fine_sample))
+      ++n_wrongly_flagged_samples;
+    if (coarse_sample != previous_coarse_sample)
+      ++n_coarse_moves;
+
+    previous_fine_sample = sample;
+    previous_coarse_sample = coarse_sample;
+  });
+  check.connect_to_producer (sampler);
+
+  sampler.sample (0.,
+                  log_likelihoods,
+                  &perturb,
+                  1,
+                  {0, 1000});
+
+  std::cout << "Fine samples: " << n_fine_samples << std::endl;
+  std::cout << "Some fine samples are repeated: " << (n_repeated_fine_samples > 0) << std::endl;
+  std::cout << "Wrongly flagged samples: " << n_wrongly_flagged_samples << std::endl;
+  std::cout << "Coarse chain stood still in some steps: " << (n_coarse_moves < n_fine_samples) << std::endl;
+
+  // One evaluation for the starting point, and one for every new coarse
+  // sample:
+  std::cout << "Fine evaluations = 1 + coarse moves: "
+            << (n_fine_evaluations == 1 + n_coarse_moves) << std::endl;
+}
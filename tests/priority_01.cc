@@ -0,0 +1,92 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that the ThreadPool class starts pending tasks in the order of
+// their priorities, and that consumers with a priority process samples
+// asynchronously on the shared thread pool.
+
+
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <future>
+
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+int main ()
+{
+  // Use a pool with a single thread, and block it with a task that waits
+  // until all other tasks have been submitted:
+  {
+    SampleFlow::Utilities::ThreadPool thread_pool (1);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    thread_pool.submit ([released]()
+    {
+      released.wait();
+    });
+
+    std::mutex mutex;
+    std::vector<int> order;
+    std::vector<std::future<void>> futures;
+    for (const int priority : {0, -1, 1, 0, 2, -1})
+      futures.emplace_back (thread_pool.submit ([&order, &mutex, priority]()
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back (priority);
+      },
+      priority));
+
+    release.set_value();
+    for (auto &future : futures)
+      future.get();
+
+    std::cout << "Execution order of priorities:";
+    for (const int priority : order)
+      std::cout << ' ' << priority;
+    std::cout << std::endl;
+  }
+
+  // Then check consumers with priorities:
+  {
+    using SampleType = double;
+
+    SampleFlow::Producers::Range<SampleType> range_producer;
+
+    SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+    count_samples.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 10);
+    count_samples.set_priority (SampleFlow::Priority::low);
+    count_samples.connect_to_producer (range_producer);
+
+    SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+    mean_value.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 10);
+    mean_value.set_priority (SampleFlow::Priority::high);
+    mean_value.connect_to_producer (range_producer);
+
+    std::vector<SampleType> samples;
+    for (unsigned int i=0; i<1000; ++i)
+      samples.push_back (i);
+    range_producer.sample (samples);
+
+    std::cout << "Count: " << count_samples.get() << std::endl;
+    std::cout << "Mean: " << mean_value.get() << std::endl;
+  }
+}
@@ -0,0 +1,113 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check that a consumer with a low priority does not accumulate tasks
+// without bound while the shared thread pool is busy with more urgent
+// work: We occupy all threads of the pool with high-priority tasks that
+// wait until the last sample has been processed, and send samples to a
+// consumer with a queue size of 10. The first 10 samples then have to
+// be queued on the pool, and all others have to be processed on the
+// thread that sends them. The last of these releases the pool.
+
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <future>
+
+#include <sampleflow/consumer.h>
+#include <sampleflow/thread_pool.h>
+#include <sampleflow/producers/range.h>
+
+
+class RecordThreads : public SampleFlow::Consumer<double>
+{
+  public:
+    RecordThreads (const double last_sample,
+                   std::promise<void> &release)
+      :
+      SampleFlow::Consumer<double>(SampleFlow::ParallelMode::asynchronous),
+      last_sample (last_sample),
+      release (release),
+      n_on_main_thread (0),
+      n_on_other_threads (0)
+    {}
+
+    ~RecordThreads ()
+    {
+      this->disconnect_and_flush();
+    }
+
+    virtual
+    void
+    consume (double sample, SampleFlow::AuxiliaryData) override
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (std::this_thread::get_id() == main_thread)
+        ++n_on_main_thread;
+      else
+        ++n_on_other_threads;
+
+      if (sample == last_sample)
+        release.set_value();
+    }
+
+    const std::thread::id main_thread = std::this_thread::get_id();
+    const double          last_sample;
+    std::promise<void>   &release;
+    std::mutex            mutex;
+    unsigned int          n_on_main_thread;
+    unsigned int          n_on_other_threads;
+};
+
+
+int main ()
+{
+  const unsigned int n_samples = 100;
+
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+
+  SampleFlow::Utilities::ThreadPool &thread_pool
+    = SampleFlow::Utilities::shared_thread_pool();
+  std::vector<std::future<void>> blockers;
+  for (unsigned int i=0; i<thread_pool.n_threads(); ++i)
+    blockers.emplace_back (thread_pool.submit ([released]()
+    {
+      released.wait();
+    },
+    static_cast<int>(SampleFlow::Priority::high)));
+
+  SampleFlow::Producers::Range<double> range_producer;
+
+  RecordThreads record_threads (n_samples-1, release);
+  record_threads.set_parallel_mode (SampleFlow::ParallelMode::asynchronous, 10);
+  record_threads.set_priority (SampleFlow::Priority::low);
+  record_threads.connect_to_producer (range_producer);
+
+  std::vector<double> samples;
+  for (unsigned int i=0; i<n_samples; ++i)
+    samples.push_back (i);
+  range_producer.sample (samples);
+
+  for (auto &blocker : blockers)
+    blocker.get();
+
+  std::cout << "Samples processed on the producer's thread: "
+            << record_threads.n_on_main_thread << std::endl;
+  std::cout << "Samples processed on the thread pool: "
+            << record_threads.n_on_other_threads << std::endl;
+}
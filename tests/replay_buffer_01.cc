@@ -0,0 +1,133 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the ReplayBuffer filter: attach consumers while a producer on
+// another thread is generating samples, and verify that they see every
+// sample exactly once and in order. Also check a buffer with bounded
+// capacity and compression of repeated samples.
+
+
+#include <iostream>
+#include <thread>
+#include <chrono>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/replay_buffer.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+
+
+// A consumer that checks that samples 0,1,2,... arrive in order, and
+// counts the samples it receives.
+class CheckOrder : public SampleFlow::Consumer<double>
+{
+  public:
+    CheckOrder ()
+      :
+      next_sample (0),
+      n_violations (0)
+    {}
+
+    ~CheckOrder ()
+    {
+      this->disconnect_and_flush();
+    }
+
+    virtual
+    void
+    consume (double sample, SampleFlow::AuxiliaryData) override
+    {
+      if (sample != next_sample)
+        ++n_violations;
+      next_sample = sample + 1;
+    }
+
+    double       next_sample;
+    unsigned int n_violations;
+};
+
+
+int main ()
+{
+  // Attach consumers while samples are being produced on another thread:
+  {
+    const unsigned int n_samples = 100000;
+
+    SampleFlow::Producers::Range<double> range_producer;
+
+    SampleFlow::Filters::ReplayBuffer<double> replay_buffer;
+    replay_buffer.connect_to_producer (range_producer);
+
+    CheckOrder check_order_1, check_order_2;
+    SampleFlow::Consumers::MeanValue<double> mean_value;
+
+    std::thread producer_thread ([&]()
+    {
+      std::vector<double> samples;
+      for (unsigned int i=0; i<n_samples; ++i)
+        samples.push_back (i);
+      range_producer.sample (samples);
+    });
+
+    replay_buffer.connect_with_history (check_order_1);
+    std::this_thread::sleep_for (std::chrono::milliseconds(1));
+    replay_buffer.connect_with_history (mean_value);
+    replay_buffer.connect_with_history (check_order_2);
+
+    producer_thread.join();
+
+    // The producer has called flush() at the end, which has waited for
+    // all consumers to catch up.
+    std::cout << "Received: " << replay_buffer.get_history_size().first << std::endl;
+    std::cout << "Next samples: " << check_order_1.next_sample
+              << ' ' << check_order_2.next_sample << std::endl;
+    std::cout << "Order violations: " << check_order_1.n_violations
+              << ' ' << check_order_2.n_violations << std::endl;
+    std::cout << "Mean: " << mean_value.get() << std::endl;
+  }
+
+  // Use a buffer with bounded capacity and compression. Each value is
+  // repeated three times.
+  {
+    SampleFlow::Producers::Range<double> range_producer;
+
+    SampleFlow::Filters::ReplayBuffer<double> replay_buffer (100, true);
+    replay_buffer.connect_to_producer (range_producer);
+
+    std::vector<double> samples;
+    for (unsigned int i=0; i<100; ++i)
+      for (unsigned int r=0; r<3; ++r)
+        samples.push_back (i);
+    range_producer.sample (samples);
+
+    std::cout << "History size: " << replay_buffer.get_history_size().first
+              << ' ' << replay_buffer.get_history_size().second << std::endl;
+
+    SampleFlow::Consumers::CountSamples<double> count_samples;
+    SampleFlow::Consumers::MeanValue<double> mean_value;
+    replay_buffer.connect_with_history (count_samples);
+    replay_buffer.connect_with_history (mean_value);
+    replay_buffer.flush();
+
+    std::cout << "Replayed: " << count_samples.get()
+              << ", mean " << mean_value.get() << std::endl;
+
+    // Now send more samples that both consumers should see live:
+    range_producer.sample (std::vector<double>(10, 1000.));
+    std::cout << "After live samples: " << count_samples.get()
+              << ", mean " << mean_value.get() << std::endl;
+  }
+}
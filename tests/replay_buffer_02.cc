@@ -0,0 +1,65 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check that the ReplayBuffer filter replays the auxiliary data of each
+// sample when repeated samples are compressed, including for repeated
+// samples that have partly been dropped from the history because it has
+// exceeded its capacity.
+
+
+#include <iostream>
+#include <vector>
+
+#include <sampleflow/producer.h>
+#include <sampleflow/filters/replay_buffer.h>
+#include <sampleflow/consumers/action.h>
+
+
+// A producer that attaches the index of each sample as auxiliary data.
+class IndexedProducer : public SampleFlow::Producer<double>
+{
+  public:
+    void sample (const std::vector<double> &samples)
+    {
+      for (unsigned int i=0; i<samples.size(); ++i)
+        this->issue_sample (samples[i], {{"index", boost::any(i)}});
+      this->flush_consumers();
+    }
+};
+
+
+int main ()
+{
+  IndexedProducer producer;
+
+  SampleFlow::Filters::ReplayBuffer<double> replay_buffer (6, true);
+  replay_buffer.connect_to_producer (producer);
+
+  // The history can hold the last six samples, which are the last three
+  // repetitions of the value 1 and the three repetitions of the value 2.
+  producer.sample ({0, 1, 1, 1, 1, 2, 2, 2});
+  std::cout << "History size: " << replay_buffer.get_history_size().first
+            << ' ' << replay_buffer.get_history_size().second << std::endl;
+
+  SampleFlow::Consumers::Action<double> output
+  ([](double sample, SampleFlow::AuxiliaryData aux_data)
+  {
+    std::cout << "Sample " << sample << ", index "
+              << boost::any_cast<unsigned int>(aux_data["index"]) << std::endl;
+  });
+  replay_buffer.connect_with_history (output);
+  replay_buffer.flush();
+}
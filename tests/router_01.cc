@@ -0,0 +1,84 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the Router filter: Distribute the samples of a Range producer
+// over four replicas using the round-robin policy, compute the mean value
+// on each replica, and merge the per-replica results. Then do the same
+// with the least-loaded policy, for which only the total number of
+// samples and the merged mean value are deterministic.
+
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/router.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+
+using SampleType = double;
+
+
+void test (const SampleFlow::Filters::Router<SampleType>::Policy policy,
+           const bool output_replica_counts)
+{
+  std::vector<SampleType> samples (10000);
+  for (unsigned int i=0; i<samples.size(); ++i)
+    samples[i] = i;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Filters::Router<SampleType> router (4, policy, 16);
+  router.connect_to_producer (range_producer);
+
+  std::vector<std::unique_ptr<SampleFlow::Consumers::MeanValue<SampleType>>> means;
+  std::vector<std::unique_ptr<SampleFlow::Consumers::CountSamples<SampleType>>> counts;
+  for (unsigned int r=0; r<router.n_replicas(); ++r)
+    {
+      means.emplace_back (new SampleFlow::Consumers::MeanValue<SampleType>());
+      means.back()->connect_to_producer (router.replica(r));
+
+      counts.emplace_back (new SampleFlow::Consumers::CountSamples<SampleType>());
+      counts.back()->connect_to_producer (router.replica(r));
+    }
+
+  range_producer.sample (samples);
+
+  std::vector<SampleType> replica_means;
+  SampleFlow::types::sample_index total_count = 0;
+  for (unsigned int r=0; r<router.n_replicas(); ++r)
+    {
+      replica_means.push_back (means[r]->get());
+      total_count += counts[r]->get();
+
+      if (output_replica_counts)
+        std::cout << "Replica " << r << ": " << counts[r]->get()
+                  << " samples, mean=" << means[r]->get() << std::endl;
+    }
+
+  std::cout << "Total number of samples: " << total_count << std::endl;
+  std::cout << "Merged mean value: " << router.merge_averages (replica_means) << std::endl;
+}
+
+
+int main ()
+{
+  std::cout << "Round robin:" << std::endl;
+  test (SampleFlow::Filters::Router<SampleType>::Policy::round_robin, true);
+
+  std::cout << "Least loaded:" << std::endl;
+  test (SampleFlow::Filters::Router<SampleType>::Policy::least_loaded, false);
+}
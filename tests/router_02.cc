@@ -0,0 +1,109 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check Router::merge_covariances(): Distribute vector-valued samples
+// over three replicas, compute mean values and covariance matrices on
+// each replica, and compare the merged covariance matrix with the one
+// computed by a CovarianceMatrix consumer that sees all samples. Then
+// check that if only a single sample has been issued, the covariance
+// matrix of the replica that issued it is returned.
+
+
+#include <iostream>
+#include <cmath>
+#include <memory>
+#include <valarray>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/router.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+
+using SampleType = std::valarray<double>;
+
+
+int main ()
+{
+  // Samples whose two components are correlated, and whose mean drifts
+  // over the course of the sequence so that the replicas' means differ.
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<1000; ++i)
+    samples.push_back ({1.*(i%17) + 0.01*i, 1.*(i%5) - 0.5*(i%17)});
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (range_producer);
+
+  SampleFlow::Filters::Router<SampleType> router (3);
+  router.connect_to_producer (range_producer);
+
+  std::vector<std::unique_ptr<SampleFlow::Consumers::MeanValue<SampleType>>> means;
+  std::vector<std::unique_ptr<SampleFlow::Consumers::CovarianceMatrix<SampleType>>> covariances;
+  for (unsigned int r=0; r<router.n_replicas(); ++r)
+    {
+      means.emplace_back (new SampleFlow::Consumers::MeanValue<SampleType>());
+      means.back()->connect_to_producer (router.replica(r));
+
+      covariances.emplace_back (new SampleFlow::Consumers::CovarianceMatrix<SampleType>());
+      covariances.back()->connect_to_producer (router.replica(r));
+    }
+
+  range_producer.sample (samples);
+
+  std::vector<SampleType> replica_means;
+  std::vector<SampleFlow::Consumers::CovarianceMatrix<SampleType>::value_type> replica_covariances;
+  for (unsigned int r=0; r<router.n_replicas(); ++r)
+    {
+      replica_means.push_back (means[r]->get());
+      replica_covariances.push_back (covariances[r]->get());
+    }
+
+  const auto merged = router.merge_covariances (replica_means, replica_covariances);
+  const auto reference = covariance_matrix.get();
+
+  for (unsigned int i=0; i<2; ++i)
+    for (unsigned int j=0; j<2; ++j)
+      std::cout << "C(" << i << ',' << j << "): merged=" << merged(i,j)
+                << ", difference to reference=" << std::abs(merged(i,j)-reference(i,j))
+                << std::endl;
+
+  // Now the case of a single sample. Since the covariance matrix of a
+  // single sample is zero, pass in made-up matrices for each replica
+  // to see which one is returned.
+  {
+    SampleFlow::Producers::Range<SampleType> single_sample_producer;
+    SampleFlow::Filters::Router<SampleType> single_sample_router (3);
+    single_sample_router.connect_to_producer (single_sample_producer);
+    single_sample_producer.sample (std::vector<SampleType> {samples[0]});
+
+    const auto counts = single_sample_router.get_replica_sample_counts();
+    std::vector<SampleFlow::Consumers::CovarianceMatrix<SampleType>::value_type>
+    made_up_covariances (3, SampleFlow::Consumers::CovarianceMatrix<SampleType>::value_type(2,2));
+    for (unsigned int r=0; r<3; ++r)
+      {
+        std::cout << "Replica " << r << " issued " << counts[r] << " sample(s)" << std::endl;
+        for (unsigned int i=0; i<2; ++i)
+          for (unsigned int j=0; j<2; ++j)
+            made_up_covariances[r](i,j) = 1.+r;
+      }
+
+    const auto single = single_sample_router.merge_covariances (std::vector<SampleType>(3, samples[0]),
+                                                                made_up_covariances);
+    std::cout << "Single sample: C(0,0)=" << single(0,0) << std::endl;
+  }
+}
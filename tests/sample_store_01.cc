@@ -0,0 +1,100 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the SampleStore class: store samples that are repeated a varying
+// number of times, with and without compression of repeated samples and
+// with chunks that are much smaller than the number of samples, and
+// access them by index, by replaying them into other consumers, and
+// through views of the stored columns.
+
+
+#include <iostream>
+#include <valarray>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/sample_store.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  // Sample i is repeated (i%3)+1 times:
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<20; ++i)
+    for (unsigned int r=0; r<(i%3)+1; ++r)
+      samples.push_back ({1.*i, -1.*i});
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::SampleStore<SampleType> store ({}, false, 8);
+  store.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::SampleStore<SampleType> compressed_store ({}, true, 8);
+  compressed_store.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (range_producer);
+
+  range_producer.sample (samples);
+
+  std::cout << "Samples: " << store.size() << ' ' << compressed_store.size() << std::endl;
+  std::cout << "Rows: " << store.n_rows() << ' ' << compressed_store.n_rows() << std::endl;
+
+  // Random access:
+  for (const SampleFlow::types::sample_index i : {0, 1, 2, 3, 11, 12, 38})
+    {
+      const auto sample = compressed_store.get(i);
+      std::cout << "Sample " << i << ": "
+                << sample.first[0] << ' ' << sample.first[1]
+                << (boost::any_cast<bool>(sample.second.at("sample is repeated")) ?
+                    " (repeated)" : "")
+                << std::endl;
+      if ((store.get(i).first[0] != sample.first[0])
+          ||
+          (samples[i][0] != sample.first[0]))
+        std::cout << "Mismatch!" << std::endl;
+    }
+
+  // Replay everything into a mean value consumer and compare with the one
+  // that was connected to the producer. Then replay a range:
+  {
+    SampleFlow::Consumers::MeanValue<SampleType> replayed_mean_value;
+    compressed_store.replay (replayed_mean_value);
+    std::cout << "Mean: " << mean_value.get()[0] << ' ' << replayed_mean_value.get()[0] << std::endl;
+
+    SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+    compressed_store.replay (count_samples, 5, 25);
+    std::cout << "Replayed samples in [5,25): " << count_samples.get() << std::endl;
+  }
+
+  // Compute the sum over the first component via column views:
+  {
+    double sum = 0;
+    unsigned int n_chunks = 0;
+    compressed_store.visit_chunks ([&](const SampleFlow::Consumers::SampleStore<SampleType>::ChunkView &chunk)
+    {
+      const auto column = chunk.column(0);
+      const auto multiplicities = chunk.multiplicities();
+      for (std::size_t row=0; row<chunk.n_rows(); ++row)
+        sum += column[row] * multiplicities[row];
+      ++n_chunks;
+    });
+    std::cout << "Sum via " << n_chunks << " chunks: " << sum << std::endl;
+  }
+}
@@ -0,0 +1,83 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the SampleStore class with samples produced by a Metropolis-Hastings
+// sampler: Store them with their relative log likelihoods, compressing
+// rejected (repeated) samples, and check that replaying the stored samples
+// into consumers yields the same results as connecting the consumers to
+// the sampler directly.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/metropolis_hastings.h>
+#include <sampleflow/consumers/sample_store.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/maximum_probability_sample.h>
+
+
+using SampleType = double;
+
+double log_likelihood (const SampleType &x)
+{
+  return -x*x/2;
+}
+
+std::pair<SampleType,double> perturb (const SampleType &x)
+{
+  static std::mt19937 rng;
+  std::uniform_real_distribution<double> distribution(-1,1);
+  return {x + distribution(rng), 1.0};
+}
+
+int main ()
+{
+  SampleFlow::Producers::MetropolisHastings<SampleType> mh_sampler;
+
+  SampleFlow::Consumers::SampleStore<SampleType> store ({"relative log likelihood"}, true);
+  store.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+  acceptance_ratio.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (mh_sampler);
+
+  SampleFlow::Consumers::MaximumProbabilitySample<SampleType> max_probability;
+  max_probability.connect_to_producer (mh_sampler);
+
+  mh_sampler.sample (0, &log_likelihood, &perturb, 10000);
+
+  std::cout << "Samples: " << store.size() << std::endl;
+  std::cout << "Fraction of rows: " << 1.*store.n_rows()/store.size() << std::endl;
+
+  SampleFlow::Consumers::AcceptanceRatio<SampleType> replayed_acceptance_ratio;
+  SampleFlow::Consumers::MeanValue<SampleType> replayed_mean_value;
+  SampleFlow::Consumers::MaximumProbabilitySample<SampleType> replayed_max_probability;
+  store.replay (replayed_acceptance_ratio);
+  store.replay (replayed_mean_value);
+  store.replay (replayed_max_probability);
+
+  std::cout << "Acceptance ratio: " << acceptance_ratio.get()
+            << ' ' << replayed_acceptance_ratio.get() << std::endl;
+  std::cout << "Mean value: " << mean_value.get()
+            << ' ' << replayed_mean_value.get() << std::endl;
+  std::cout << "Maximum probability sample: " << max_probability.get().first
+            << ' ' << replayed_max_probability.get().first << std::endl;
+}
@@ -0,0 +1,92 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the SelectChain filter: Use the same setup as the
+// multi_chain_metropolis_hastings_01 test, in which each of three chains
+// simply counts upward from its starting point, and split the
+// interleaved samples back into the individual chains.
+
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <sampleflow/producers/multi_chain_metropolis_hastings.h>
+#include <sampleflow/filters/select_chain.h>
+#include <sampleflow/consumers/action.h>
+
+using SampleType = double;
+using Producer = SampleFlow::Producers::MultiChainMetropolisHastings<SampleType>;
+
+
+void log_likelihood (const Producer::ChainStates &x,
+                     std::vector<double> &log_likelihoods)
+{
+  for (unsigned int w=0; w<log_likelihoods.size(); ++w)
+    log_likelihoods[w] = x[w]+1;
+}
+
+
+void perturb (const Producer::ChainStates &x,
+              Producer::ChainStates &trial_x,
+              std::vector<double> &log_proposal_ratios)
+{
+  for (unsigned int i=0; i<x.size(); ++i)
+    trial_x[i] = x[i]+1;
+  for (auto &r : log_proposal_ratios)
+    r = 0;
+}
+
+
+int main ()
+{
+  const unsigned int n_chains = 3;
+
+  std::vector<std::vector<SampleType>> samples (n_chains);
+
+  Producer mh_sampler;
+
+  std::vector<std::unique_ptr<SampleFlow::Filters::SelectChain<SampleType>>> chains;
+  std::vector<std::unique_ptr<SampleFlow::Consumers::Action<SampleType>>> actions;
+  for (unsigned int w=0; w<n_chains; ++w)
+    {
+      chains.emplace_back (new SampleFlow::Filters::SelectChain<SampleType>(w));
+      chains.back()->connect_to_producer (mh_sampler);
+
+      actions.emplace_back (new SampleFlow::Consumers::Action<SampleType>
+                            ([w, &samples](SampleType sample,
+                                           SampleFlow::AuxiliaryData aux_data)
+      {
+        if (boost::any_cast<unsigned int>(aux_data["chain index"]) != w)
+          std::cout << "Wrong chain!" << std::endl;
+        samples[w].push_back (sample);
+      }));
+      actions.back()->connect_to_producer (*chains.back());
+    }
+
+  mh_sampler.sample ({0, 10, 100},
+                     &log_likelihood,
+                     &perturb,
+                     4);
+
+  for (unsigned int w=0; w<n_chains; ++w)
+    {
+      std::cout << "chain " << w << ":";
+      for (const auto sample : samples[w])
+        std::cout << ' ' << sample;
+      std::cout << std::endl;
+    }
+}
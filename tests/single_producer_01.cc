@@ -0,0 +1,109 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check Consumer::declare_single_producer(): Consumers that are declared
+// to have a single producer need to produce the same results as before,
+// and other threads must be able to call get() on them while samples are
+// being processed.
+
+
+#include <iostream>
+#include <vector>
+#include <valarray>
+#include <cmath>
+#include <thread>
+#include <atomic>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/last_sample.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+
+
+int main ()
+{
+  using SampleType = std::valarray<double>;
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.declare_single_producer();
+  count_samples.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.declare_single_producer();
+  mean_value.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::LastSample<SampleType> last_sample;
+  last_sample.declare_single_producer();
+  last_sample.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.declare_single_producer();
+  covariance_matrix.connect_to_producer (range_producer);
+
+  // Samples are of the form (i,2i). Poll the consumers from a separate
+  // thread while samples are being produced, and check that what we
+  // read is consistent: the number of samples never decreases, and the
+  // last sample always has the form (i,2i).
+  const unsigned int n_samples = 20000;
+  std::atomic<bool> done (false);
+  unsigned int n_inconsistencies = 0;
+  std::thread reader ([&]()
+  {
+    SampleFlow::types::sample_index previous_count = 0;
+    while (!done)
+      {
+        const SampleFlow::types::sample_index count = count_samples.get();
+        if (count < previous_count)
+          ++n_inconsistencies;
+        previous_count = count;
+
+        const SampleType last = last_sample.get();
+        if ((last.size() != 0)
+            &&
+            ((last.size() != 2) || (last[1] != 2*last[0])))
+          ++n_inconsistencies;
+
+        const SampleType mean = mean_value.get();
+        if ((mean.size() != 0)
+            &&
+            ((mean.size() != 2) || (std::fabs(mean[1] - 2*mean[0]) > 1e-8*(1+mean[1]))))
+          ++n_inconsistencies;
+      }
+  });
+
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<n_samples; ++i)
+    samples.push_back ({1.*i, 2.*i});
+  range_producer.sample (samples);
+
+  done = true;
+  reader.join();
+
+  std::cout << "Count: " << count_samples.get() << std::endl;
+  std::cout << "Mean: " << mean_value.get()[0] << ' ' << mean_value.get()[1] << std::endl;
+  std::cout << "Last sample: " << last_sample.get()[0] << ' ' << last_sample.get()[1] << std::endl;
+  std::cout << "Covariance matrix:" << std::endl;
+  for (unsigned int i=0; i<2; ++i)
+    {
+      for (unsigned int j=0; j<2; ++j)
+        std::cout << covariance_matrix.get()(i,j) << ' ';
+      std::cout << std::endl;
+    }
+  std::cout << "Inconsistent reads: " << n_inconsistencies << std::endl;
+}
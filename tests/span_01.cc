@@ -0,0 +1,119 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check that types::Span can be used as a sample type: Issue spans that
+// point into rows of an external buffer, pass them through filters and
+// to consumers, and verify that consumers that store samples make copies
+// of the data, by overwriting the buffer afterwards.
+
+
+#include <iostream>
+#include <vector>
+
+#include <sampleflow/producers/range.h>
+#include <sampleflow/filters/take_every_nth.h>
+#include <sampleflow/filters/component_splitter.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+#include <sampleflow/consumers/auto_covariance_trace.h>
+#include <sampleflow/consumers/last_sample.h>
+#include <sampleflow/consumers/acceptance_ratio.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/stream_output.h>
+
+using SampleType = SampleFlow::types::Span<const double>;
+
+
+int main ()
+{
+  // Create a buffer with 6 samples of 3 components each, where the
+  // fourth sample is a repeat of the third:
+  const unsigned int n_components = 3;
+  std::vector<double> buffer = {1, 2, 3,
+                                2, 4, 6,
+                                3, 6, 9,
+                                3, 6, 9,
+                                4, 8, 12,
+                                5, 10, 15
+                               };
+
+  std::vector<SampleType> samples;
+  for (unsigned int i=0; i<buffer.size()/n_components; ++i)
+    samples.emplace_back (&buffer[i*n_components], n_components);
+
+  SampleFlow::Producers::Range<SampleType> range_producer;
+
+  SampleFlow::Consumers::StreamOutput<SampleType> stream_output (std::cout);
+  stream_output.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::AutoCovarianceTrace<SampleType> autocovariance (2);
+  autocovariance.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::LastSample<SampleType> last_sample;
+  last_sample.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::AcceptanceRatio<SampleType> acceptance_ratio;
+  acceptance_ratio.connect_to_producer (range_producer);
+
+  SampleFlow::Filters::TakeEveryNth<SampleType> take_every_second (2);
+  take_every_second.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (take_every_second);
+
+  SampleFlow::Filters::ComponentSplitter<SampleType> component_splitter (1);
+  component_splitter.connect_to_producer (range_producer);
+
+  SampleFlow::Consumers::MeanValue<double> component_mean;
+  component_mean.connect_to_producer (component_splitter);
+
+  range_producer.sample (samples);
+
+  // Now overwrite the buffer. None of the results below may change.
+  std::fill (buffer.begin(), buffer.end(), -1.);
+
+  std::cout << "Mean value: ";
+  for (const auto x : mean_value.get())
+    std::cout << x << ' ';
+  std::cout << std::endl;
+
+  std::cout << "Covariance matrix:" << std::endl;
+  for (unsigned int i=0; i<n_components; ++i)
+    {
+      for (unsigned int j=0; j<n_components; ++j)
+        std::cout << covariance_matrix.get()(i,j) << ' ';
+      std::cout << std::endl;
+    }
+
+  std::cout << "Autocovariance trace: ";
+  for (const auto x : autocovariance.get())
+    std::cout << x << ' ';
+  std::cout << std::endl;
+
+  std::cout << "Last sample: ";
+  for (const auto x : last_sample.get())
+    std::cout << x << ' ';
+  std::cout << std::endl;
+
+  std::cout << "Acceptance ratio: " << acceptance_ratio.get() << std::endl;
+  std::cout << "Every second sample: " << count_samples.get() << std::endl;
+  std::cout << "Mean of component 1: " << component_mean.get() << std::endl;
+}
@@ -0,0 +1,87 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the StochasticGradientLangevinDynamics producer: Sample the
+// posterior distribution of the mean of normally distributed data
+// points (with a flat prior) using minibatch estimates of the
+// gradient and a decreasing step size. Compare the step-size weighted
+// mean with the mean of the data, and check that the samples carry
+// the step size that was used to produce them.
+
+
+#include <iostream>
+#include <random>
+#include <cmath>
+
+#include <sampleflow/producers/stochastic_gradient_langevin_dynamics.h>
+#include <sampleflow/consumers/weighted_mean_value.h>
+#include <sampleflow/consumers/count_samples.h>
+#include <sampleflow/consumers/action.h>
+
+using SampleType = double;
+
+
+int main ()
+{
+  // Create a data set of normally distributed values with mean 2:
+  std::mt19937 rng;
+  std::normal_distribution<double> normal(2, 1);
+  std::vector<double> data (10000);
+  for (auto &d : data)
+    d = normal(rng);
+
+  double data_mean = 0;
+  for (const auto d : data)
+    data_mean += d;
+  data_mean /= data.size();
+  std::cout << "Mean of the data: " << data_mean << std::endl;
+
+  using Sampler = SampleFlow::Producers::StochasticGradientLangevinDynamics<SampleType>;
+  Sampler sampler;
+
+  SampleFlow::Consumers::WeightedMeanValue<SampleType> mean_value ("step size");
+  mean_value.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::CountSamples<SampleType> count_samples;
+  count_samples.connect_to_producer (sampler);
+
+  double sum_of_step_sizes = 0;
+  SampleFlow::Consumers::Action<SampleType> sum_step_sizes
+  ([&](SampleType, SampleFlow::AuxiliaryData aux_data)
+  {
+    sum_of_step_sizes += boost::any_cast<double>(aux_data["step size"]);
+  });
+  sum_step_sizes.connect_to_producer (sampler);
+
+  // Estimate the gradient of the log likelihood from a randomly
+  // chosen minibatch of 100 data points:
+  const unsigned int batch_size = 100;
+  std::uniform_int_distribution<std::size_t> index_distribution (0, data.size()-1);
+  auto gradient = [&](const SampleType &x, SampleType &g)
+  {
+    g = 0;
+    for (unsigned int k=0; k<batch_size; ++k)
+      g += data[index_distribution(rng)] - x;
+    g *= 1.*data.size()/batch_size;
+  };
+
+  const auto step_size = Sampler::polynomial_step_size (1e-3, 100, 0.55);
+
+  sampler.sample (0., gradient, step_size, 10000);
+
+  std::cout << "Number of samples: " << count_samples.get() << std::endl;
+  std::cout << "Weighted posterior mean: " << mean_value.get() << std::endl;
+  std::cout << "Sum of step sizes: " << sum_of_step_sizes << std::endl;
+}
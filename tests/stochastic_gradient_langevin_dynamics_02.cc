@@ -0,0 +1,74 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+// Check the StochasticGradientLangevinDynamics producer with RMSprop
+// preconditioning: Sample from a two-dimensional Gaussian whose
+// variances differ by a factor of 100. The preconditioner adapts the
+// step size to each component, so a single step size suffices even
+// though the problem is badly scaled. Output the mean and covariance
+// of the samples; the covariance is only approximately correct since
+// SGLD does not have an accept/reject step.
+
+
+#include <iostream>
+#include <valarray>
+
+#include <sampleflow/producers/stochastic_gradient_langevin_dynamics.h>
+#include <sampleflow/filters/discard_first_n.h>
+#include <sampleflow/consumers/mean_value.h>
+#include <sampleflow/consumers/covariance_matrix.h>
+
+using SampleType = std::valarray<double>;
+
+
+int main ()
+{
+  using Sampler = SampleFlow::Producers::StochasticGradientLangevinDynamics<SampleType>;
+  Sampler sampler (Sampler::Preconditioner::rmsprop);
+
+  SampleFlow::Filters::DiscardFirstN<SampleType> discard_burn_in (1000);
+  discard_burn_in.connect_to_producer (sampler);
+
+  SampleFlow::Consumers::MeanValue<SampleType> mean_value;
+  mean_value.connect_to_producer (discard_burn_in);
+
+  SampleFlow::Consumers::CovarianceMatrix<SampleType> covariance_matrix;
+  covariance_matrix.connect_to_producer (discard_burn_in);
+
+  // The gradient of log(pi(x)) for pi(x) ~ exp(-x0^2/2 - x1^2/200):
+  auto gradient = [](const SampleType &x, SampleType &g)
+  {
+    g[0] = -x[0];
+    g[1] = -x[1]/100;
+  };
+
+  sampler.sample ({5., 5.},
+                  gradient,
+                  Sampler::polynomial_step_size (0.2, 1, 0),
+                  100000);
+
+  std::cout << "Mean value = ";
+  for (auto x : mean_value.get())
+    std::cout << x << ' ';
+  std::cout << std::endl;
+
+  std::cout << "Covariance matrix = " << std::endl;
+  for (unsigned int i=0; i<2; ++i)
+    {
+      for (unsigned int j=0; j<2; ++j)
+        std::cout << covariance_matrix.get()(i,j) << ' ';
+      std::cout << std::endl;
+    }
+}
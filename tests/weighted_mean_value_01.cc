@@ -0,0 +1,52 @@
+// ---------------------------------------------------------------------
+//
+// Copyright (C) 2019 by the SampleFlow authors.
+//
+// This file is part of the SampleFlow library.
+//
+// The SampleFlow library is free software; you can use it, redistribute
+// it, and/or modify it under the terms of the GNU Lesser General
+// Public License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+// The full text of the license can be found in the file LICENSE.md at
+// the top level directory of SampleFlow.
+//
+// ---------------------------------------------------------------------
+
+
+// Check the WeightedMeanValue consumer with logarithmic weights when the
+// first sample has a log weight of -infinity (i.e., zero weight). Such
+// samples must not affect the mean, and in particular must not be used
+// as the reference weight. The samples (5,-inf), (1,0), (3,0), (7,-inf)
+// should therefore have a mean of 2.
+
+
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <sampleflow/consumers/weighted_mean_value.h>
+
+using SampleType = double;
+
+
+int main ()
+{
+  const double minus_infinity = -std::numeric_limits<double>::infinity();
+  const std::vector<SampleType> samples = {5, 1, 3, 7};
+  const std::vector<double> log_weights = {minus_infinity, 0, 0, minus_infinity};
+
+  using WeightedMeanValue = SampleFlow::Consumers::WeightedMeanValue<SampleType>;
+  WeightedMeanValue mean_value ("log weight",
+                                WeightedMeanValue::WeightType::logarithmic);
+
+  for (unsigned int i=0; i<samples.size(); ++i)
+    {
+      mean_value.consume (samples[i],
+      {
+        {"log weight", boost::any(log_weights[i])}
+      });
+      std::cout << "Mean after " << i+1 << " samples: "
+                << mean_value.get() << std::endl;
+    }
+}